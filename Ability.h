@@ -0,0 +1,439 @@
+// =================================================================
+//
+// File: Ability.h
+// Author: Alexis Berthou
+// Description: This file contains the Ability class, the bytecode of
+// an attack, and the compiler that builds it from the text written
+// in the content files.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef ABILITY_H
+#define ABILITY_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Stats an ability can read, as self.<name> or target.<name>.
+// Strength and shield are the effective ones, with equipment and
+// status effects; only health and mana can be written.
+// =================================================================
+
+const char* const abilityFieldNames[] = { "health", "mana", "maxHealth", "maxMana", "strength", "shield" };
+const int AbilityFieldCount = 6;
+
+// =================================================================
+// Contains the definition of the Ability class
+// An attack as a program of a small register machine, run by
+// Character::perform(). The text form has one statement per line
+// (or separated by ';'), and a statement may start with "label:":
+//   set D, X              D = X
+//   add D, X, Y           also sub, mul, div, min and max
+//   if X < Y goto label   also <=, >, >=, == and !=
+//   goto label
+//   damage self|target, X the character takes X damage, less its shield
+//   heal self|target, X   the character gains X health, or loses it
+//   end
+// X and Y are registers r0 to r7, whole numbers or stats such as
+// self.mana; D is a register, self.health, self.mana, target.health
+// or target.mana. The program ends after its last statement.
+//
+// Every instruction is 32 bits: an opcode and three 8-bit operands.
+// The registers hold the 8 of the program, scratch ones and the
+// numbers the program uses, so numbers cost nothing to read. Stats
+// are read where they are used: comparisons and arithmetic take a
+// stat as their first operand, and "add self.mana, self.mana, X" is
+// one instruction, so the usual statement is one instruction too.
+// Jumps only go forward, so every ability ends, after at most
+// MaxInstructions steps.
+// =================================================================
+
+class Ability {
+    friend class Character;
+
+public:
+    static const int UserRegisters = 8;
+    static const int FirstScratch = UserRegisters;
+    static const int FirstConstant = FirstScratch + 4;
+    static const int MaxConstants = 20;
+    static const int Registers = FirstConstant + MaxConstants;
+    static const int MaxInstructions = 255;
+
+    // A stat operand is the combatant (0 self, 1 target) times 8
+    // plus the index of the stat in abilityFieldNames
+    enum Op : uint8_t {
+        Move,                   // r[a] = r[b]
+        Load,                   // r[a] = stat b
+        StoreHealth,            // health of combatant a = r[b]
+        StoreMana,              // mana of combatant a = r[b]
+        AddHealth,              // health of combatant a += r[b]
+        AddMana,                // mana of combatant a += r[b]
+        Add,                    // r[a] = r[b] + r[c]
+        Sub,
+        Mul,
+        Div,
+        Min,
+        Max,
+        AddStat,                // r[a] = stat b + r[c]
+        SubStat,
+        MulStat,
+        DivStat,
+        MinStat,
+        MaxStat,
+        JumpLess,               // if r[a] < r[b], go to instruction c
+        JumpLessEqual,
+        JumpEqual,
+        JumpNotEqual,
+        JumpStatLess,           // if stat a < r[b], go to instruction c
+        JumpStatLessEqual,
+        JumpStatGreater,
+        JumpStatGreaterEqual,
+        JumpStatEqual,
+        JumpStatNotEqual,
+        Jump,                   // go to instruction a
+        Damage,                 // combatant a takes r[b] damage
+        Heal,                   // combatant a gains r[b] health
+        End
+    };
+    static const int OpCount = End + 1;
+
+private:
+    // A parsed operand: a register, or a stat not loaded yet
+    struct Operand {
+        bool stat;
+        int value;
+    };
+
+    vector<uint32_t> code;
+    int32_t constants[MaxConstants];
+    int constantCount;
+
+    Ability();
+
+    void emit(int op, int a, int b = 0, int c = 0);
+    int constant(int32_t value);
+    bool parseOperand(const string& text, Operand& operand, string& error);
+    int load(const Operand& operand, int scratch);
+    int combatant(const string& text, string& error) const;
+
+public:
+    static shared_ptr<const Ability> compile(const string& source, string& error);
+    static shared_ptr<const Ability> builtin(const char* source);
+
+    size_t size() const;
+};
+
+// =================================================================
+// Constructor. The program starts empty.
+// =================================================================
+
+Ability::Ability() : constants{}, constantCount(0) {}
+
+// =================================================================
+// Appends an instruction
+//
+// @param op The opcode
+// @param a, b, c The operands
+// =================================================================
+
+void Ability::emit(int op, int a, int b, int c) {
+    code.push_back(uint32_t(op) | uint32_t(a) << 8 | uint32_t(b) << 16 | uint32_t(c) << 24);
+}
+
+// =================================================================
+// Returns the register of a number, giving it one the first time
+//
+// @param value The number
+// @return The register, or -1 if the program uses too many numbers
+// =================================================================
+
+int Ability::constant(int32_t value) {
+    for (int i = 0; i < constantCount; ++i) {
+        if (constants[i] == value) return FirstConstant + i;
+    }
+    if (constantCount == MaxConstants) return -1;
+    constants[constantCount] = value;
+    return FirstConstant + constantCount++;
+}
+
+// =================================================================
+// Parses an operand
+//
+// @param text A register, a number or a stat
+// @param operand Receives the register or the stat
+// @param error Receives the reason when the operand is malformed
+// @return false if it is malformed
+// =================================================================
+
+bool Ability::parseOperand(const string& text, Operand& operand, string& error) {
+    if (text.size() == 2 && text[0] == 'r' && text[1] >= '0' && text[1] < '0' + UserRegisters) {
+        operand = { false, text[1] - '0' };
+        return true;
+    }
+    if (!text.empty() && (isdigit((unsigned char)text[0]) || text[0] == '-')) {
+        char* end = nullptr;
+        long long value = strtoll(text.c_str(), &end, 10);
+        if (*end != '\0' || value < INT32_MIN || value > INT32_MAX) {
+            error = "bad number " + text;
+            return false;
+        }
+        operand = { false, constant(int32_t(value)) };
+        if (operand.value < 0) error = "too many numbers, at most " + to_string(MaxConstants);
+        return operand.value >= 0;
+    }
+    size_t dot = text.find('.');
+    int who = dot == string::npos ? -1 : combatant(text.substr(0, dot), error);
+    if (who < 0) {
+        error = "unknown operand " + text;
+        return false;
+    }
+    string field = text.substr(dot + 1);
+    for (int i = 0; i < AbilityFieldCount; ++i) {
+        if (field == abilityFieldNames[i]) {
+            operand = { true, who * 8 + i };
+            return true;
+        }
+    }
+    error = "unknown stat " + field;
+    return false;
+}
+
+// =================================================================
+// Returns the register of an operand, loading a stat into a scratch
+// register first
+//
+// @param operand The operand
+// @param scratch The scratch register for a stat
+// =================================================================
+
+int Ability::load(const Operand& operand, int scratch) {
+    if (!operand.stat) return operand.value;
+    emit(Load, scratch, operand.value);
+    return scratch;
+}
+
+// =================================================================
+// Parses who a statement acts on
+//
+// @param text "self" or "target"
+// @param error Receives the reason when it is neither
+// @return 0 for self, 1 for the target, or -1
+// =================================================================
+
+int Ability::combatant(const string& text, string& error) const {
+    if (text == "self") return 0;
+    if (text == "target") return 1;
+    error = "expected self or target, not " + text;
+    return -1;
+}
+
+// =================================================================
+// Compiles the text of an ability
+//
+// @param source The statements
+// @param error Receives the reason, with its line, when the text is
+// malformed
+// @return The ability, or nullptr
+// =================================================================
+
+shared_ptr<const Ability> Ability::compile(const string& source, string& error) {
+    shared_ptr<Ability> ability(new Ability());
+    unordered_map<string, int> labels;
+    struct Fixup {
+        size_t at;
+        string label;
+        int line;
+    };
+    vector<Fixup> fixups;
+
+    const char* const arithmetic[] = { "add", "sub", "mul", "div", "min", "max" };
+    // Comparisons in the order of the JumpStat opcodes; the first
+    // four have reg-reg opcodes, with > and >= as swapped < and <=
+    const char* const comparisons[] = { "<", "<=", ">", ">=", "==", "!=" };
+    const Op registerJumps[] = { JumpLess, JumpLessEqual, JumpLess, JumpLessEqual, JumpEqual, JumpNotEqual };
+    const int mirrored[] = { 2, 3, 0, 1, 4, 5 };    // X < Y is Y > X, and so on
+
+    stringstream lines(source);
+    string line;
+    int number = 0;
+    while (getline(lines, line)) {
+        ++number;
+        stringstream statements(line);
+        string statement;
+        while (getline(statements, statement, ';')) {
+            string where = "line " + to_string(number) + ": ";
+            for (char& ch : statement) {
+                if (ch == ',') ch = ' ';
+            }
+            stringstream in(statement);
+            vector<string> words;
+            string word;
+            while (in >> word) words.push_back(word);
+            if (!words.empty() && words[0].back() == ':') {
+                string label = words[0].substr(0, words[0].size() - 1);
+                if (label.empty() || labels.count(label)) {
+                    error = where + "label " + label + " is empty or repeated";
+                    return nullptr;
+                }
+                labels[label] = int(ability->code.size());
+                words.erase(words.begin());
+            }
+            if (words.empty()) continue;
+
+            const string& verb = words[0];
+            int arithmeticOp = -1;
+            for (int i = 0; i < 6; ++i) {
+                if (verb == arithmetic[i]) arithmeticOp = i;
+            }
+            Operand x, y;
+            bool ok = true;
+
+            if (verb == "end" && words.size() == 1) {
+                ability->emit(End, 0);
+            } else if (verb == "goto" && words.size() == 2) {
+                fixups.push_back({ ability->code.size(), words[1], number });
+                ability->emit(Jump, 0);
+            } else if ((verb == "damage" || verb == "heal") && words.size() == 3) {
+                int who = ability->combatant(words[1], error);
+                ok = who >= 0 && ability->parseOperand(words[2], x, error);
+                if (ok) ability->emit(verb == "damage" ? Damage : Heal, who, ability->load(x, FirstScratch));
+            } else if (verb == "if" && words.size() == 6 && words[4] == "goto") {
+                int test = 0;
+                while (test < 6 && words[2] != comparisons[test]) ++test;
+                ok = ability->parseOperand(words[1], x, error) && ability->parseOperand(words[3], y, error);
+                if (ok && test == 6) {
+                    error = "unknown comparison " + words[2];
+                    ok = false;
+                }
+                if (ok) {
+                    // The stat goes first, so it is read by the jump
+                    if (!x.stat && y.stat) {
+                        swap(x, y);
+                        test = mirrored[test];
+                    }
+                    int right = ability->load(y, FirstScratch);
+                    size_t at = ability->code.size();
+                    if (x.stat) {
+                        ability->emit(JumpStatLess + test, x.value, right);
+                    } else if (test == 2 || test == 3) {
+                        ability->emit(registerJumps[test], right, x.value);
+                    } else {
+                        ability->emit(registerJumps[test], x.value, right);
+                    }
+                    fixups.push_back({ at, words[5], number });
+                }
+            } else if ((verb == "set" && words.size() == 3) || (arithmeticOp >= 0 && words.size() == 4)) {
+                Operand d;
+                ok = ability->parseOperand(words[1], d, error) && ability->parseOperand(words[2], x, error) &&
+                     (verb == "set" || ability->parseOperand(words[3], y, error));
+                bool writable = d.stat ? d.value % 8 <= 1 : d.value < UserRegisters;
+                if (ok && !writable) {
+                    error = "cannot write to " + words[1];
+                    ok = false;
+                }
+                if (ok) {
+                    int who = d.value / 8;
+                    Op store = d.value % 8 == 0 ? StoreHealth : StoreMana;
+                    Op change = d.value % 8 == 0 ? AddHealth : AddMana;
+                    bool inPlace = d.stat && x.stat && x.value == d.value;
+                    if (verb == "set") {
+                        if (d.stat) {
+                            ability->emit(store, who, ability->load(x, FirstScratch));
+                        } else if (x.stat) {
+                            ability->emit(Load, d.value, x.value);
+                        } else {
+                            ability->emit(Move, d.value, x.value);
+                        }
+                    } else if (inPlace && arithmeticOp == 0) {
+                        ability->emit(change, who, ability->load(y, FirstScratch));
+                    } else if (inPlace && arithmeticOp == 1 && !y.stat && y.value >= FirstConstant &&
+                               ability->constants[y.value - FirstConstant] != INT32_MIN) {
+                        int negated = ability->constant(-ability->constants[y.value - FirstConstant]);
+                        ok = negated >= 0;
+                        if (ok) ability->emit(change, who, negated);
+                        else error = "too many numbers, at most " + to_string(MaxConstants);
+                    } else {
+                        int result = d.stat ? FirstScratch + 2 : d.value;
+                        int right = ability->load(y, FirstScratch + 1);
+                        if (x.stat) {
+                            ability->emit(AddStat + arithmeticOp, result, x.value, right);
+                        } else {
+                            ability->emit(Add + arithmeticOp, result, x.value, right);
+                        }
+                        if (d.stat) ability->emit(store, who, result);
+                    }
+                }
+            } else {
+                error = "cannot understand \"" + statement + "\"";
+                ok = false;
+            }
+
+            if (!ok) {
+                error = where + error;
+                return nullptr;
+            }
+            if (ability->code.size() >= size_t(MaxInstructions)) {
+                error = where + "too long, at most " + to_string(MaxInstructions) + " instructions";
+                return nullptr;
+            }
+        }
+    }
+    ability->emit(End, 0);
+
+    for (const Fixup& fixup : fixups) {
+        auto found = labels.find(fixup.label);
+        if (found == labels.end()) {
+            error = "line " + to_string(fixup.line) + ": unknown label " + fixup.label;
+            return nullptr;
+        }
+        if (found->second <= int(fixup.at)) {
+            error = "line " + to_string(fixup.line) + ": jumps can only go forward";
+            return nullptr;
+        }
+        uint32_t& jump = ability->code[fixup.at];
+        if ((jump & 0xFF) == Jump) {
+            jump |= uint32_t(found->second) << 8;
+        } else {
+            jump |= uint32_t(found->second) << 24;
+        }
+    }
+    return ability;
+}
+
+// =================================================================
+// Compiles an ability built into the game
+//
+// @param source The statements, which must be valid
+// @return The ability
+// =================================================================
+
+shared_ptr<const Ability> Ability::builtin(const char* source) {
+    string error;
+    shared_ptr<const Ability> ability = compile(source, error);
+    if (!ability) throw logic_error("built-in ability: " + error);
+    return ability;
+}
+
+// =================================================================
+// Returns the number of instructions
+// =================================================================
+
+size_t Ability::size() const {
+    return code.size();
+}
+
+#endif
@@ -0,0 +1,335 @@
+// =================================================================
+//
+// File: Animation.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the Tween
+// and FrameScheduler classes used to animate the UI.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "Clock.h"
+#include "EventLoop.h"
+#include <ctime>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the Tween class
+// A value that moves from where it is to a target over a fixed
+// duration with an ease-out curve.
+// =================================================================
+
+class Tween {
+private:
+    float from, to;
+    float elapsed, duration;
+
+public:
+    Tween();
+
+    void set(float value);
+    void retarget(float target, float seconds);
+    void advance(float dt);
+    void finish();
+    float value() const;
+    float target() const;
+    bool active() const;
+};
+
+// =================================================================
+// Default constructor. The tween rests at zero.
+// =================================================================
+
+Tween::Tween() : from(0), to(0), elapsed(0), duration(0) {}
+
+// =================================================================
+// Jumps to a value without animating
+//
+// @param value The new value
+// =================================================================
+
+void Tween::set(float value) {
+    from = to = value;
+    elapsed = duration = 0;
+}
+
+// =================================================================
+// Starts moving from the current value to a new target
+//
+// @param target The value to reach
+// @param seconds How long the movement takes
+// =================================================================
+
+void Tween::retarget(float target, float seconds) {
+    if (target == to) return;
+    from = value();
+    to = target;
+    elapsed = 0;
+    duration = seconds;
+}
+
+// =================================================================
+// Advances the animation
+//
+// @param dt Seconds since the last call
+// =================================================================
+
+void Tween::advance(float dt) {
+    elapsed += dt;
+    if (elapsed >= duration) finish();
+}
+
+// =================================================================
+// Jumps to the target
+// =================================================================
+
+void Tween::finish() {
+    from = to;
+    elapsed = duration = 0;
+}
+
+// =================================================================
+// Returns the current value
+// =================================================================
+
+float Tween::value() const {
+    if (duration <= 0) return to;
+    float t = elapsed / duration;
+    float eased = 1 - (1 - t) * (1 - t);
+    return from + (to - from) * eased;
+}
+
+// =================================================================
+// Returns the value the tween is moving to
+// =================================================================
+
+float Tween::target() const {
+    return to;
+}
+
+// =================================================================
+// Checks if the tween is still moving
+// =================================================================
+
+bool Tween::active() const {
+    return duration > 0;
+}
+
+// =================================================================
+// Contains the definition of the FrameScheduler class
+// Calls an animation function at a fixed frame rate on the event
+// loop, only while something is animating. Each frame receives the
+// real time since the previous one, so frames dropped under load
+// are skipped instead of slowing the animation down. The cost of
+// each frame is measured; when it would exceed the CPU budget the
+// frame interval is stretched until it fits.
+// =================================================================
+
+class FrameScheduler {
+public:
+    typedef function<bool(float dt)> Animate; // returns true while active
+
+private:
+    EventLoop& loop;
+    Animate animate;
+    int fps;
+    float budget;        // fraction of one core animations may use
+    bool enabled;
+    int timerId;
+    int intervalMs;
+    int64_t lastFrame;
+    float averageCost;   // seconds per frame, moving average
+    long frames;
+    vector<function<void()>> idleCallbacks;
+
+    void tick();
+    void schedule(int interval);
+
+public:
+    FrameScheduler(EventLoop& eventLoop);
+
+    void setAnimate(Animate function);
+    void setFrameRate(int framesPerSecond);
+    void setBudget(float fraction);
+    void setEnabled(bool on);
+    bool isEnabled() const;
+    bool isRunning() const;
+    long getFrameCount() const;
+
+    void start();
+    void stop();
+    void whenIdle(function<void()> callback);
+};
+
+// =================================================================
+// Constructor. 30 frames per second with a 10% CPU budget.
+//
+// @param eventLoop The loop that runs the frame timer
+// =================================================================
+
+FrameScheduler::FrameScheduler(EventLoop& eventLoop)
+    : loop(eventLoop), fps(30), budget(0.1f), enabled(true), timerId(0),
+      intervalMs(0), lastFrame(0), averageCost(0), frames(0) {}
+
+// =================================================================
+// Sets the function called on every frame
+//
+// @param function Advances and draws the animations; returns true
+// while there is still something moving
+// =================================================================
+
+void FrameScheduler::setAnimate(Animate function) {
+    animate = function;
+}
+
+// =================================================================
+// Sets the target frame rate
+//
+// @param framesPerSecond Frames per second, at least 1
+// =================================================================
+
+void FrameScheduler::setFrameRate(int framesPerSecond) {
+    fps = framesPerSecond < 1 ? 1 : framesPerSecond;
+}
+
+// =================================================================
+// Sets the CPU budget of the animations
+//
+// @param fraction Fraction of one core, between 0.01 and 1
+// =================================================================
+
+void FrameScheduler::setBudget(float fraction) {
+    budget = fraction < 0.01f ? 0.01f : (fraction > 1 ? 1 : fraction);
+}
+
+// =================================================================
+// Enables or disables animations. When disabled, start() runs a
+// single frame that finishes everything at once.
+//
+// @param on true to animate
+// =================================================================
+
+void FrameScheduler::setEnabled(bool on) {
+    enabled = on;
+    if (!on) stop();
+}
+
+// =================================================================
+// Checks if animations are enabled
+// =================================================================
+
+bool FrameScheduler::isEnabled() const {
+    return enabled;
+}
+
+// =================================================================
+// Checks if the frame timer is running
+// =================================================================
+
+bool FrameScheduler::isRunning() const {
+    return timerId != 0;
+}
+
+// =================================================================
+// Returns the number of frames run so far
+// =================================================================
+
+long FrameScheduler::getFrameCount() const {
+    return frames;
+}
+
+// =================================================================
+// (Re)arms the frame timer with a new interval
+//
+// @param interval Milliseconds between frames
+// =================================================================
+
+void FrameScheduler::schedule(int interval) {
+    if (timerId) loop.cancelTimer(timerId);
+    intervalMs = interval;
+    timerId = loop.addTimer(interval, interval, [this]() { tick(); });
+}
+
+// =================================================================
+// Starts the frame timer if it is not running. Called whenever a
+// new animation begins.
+// =================================================================
+
+void FrameScheduler::start() {
+    if (!animate) return;
+    if (!enabled) {
+        // Huge dt: every tween reaches its target in one frame
+        animate(1e9f);
+        return;
+    }
+    if (timerId) return;
+    lastFrame = monotonicNow();
+    schedule(1000 / fps);
+}
+
+// =================================================================
+// Stops the frame timer
+// =================================================================
+
+void FrameScheduler::stop() {
+    if (timerId) loop.cancelTimer(timerId);
+    timerId = 0;
+
+    vector<function<void()>> callbacks;
+    callbacks.swap(idleCallbacks);
+    for (function<void()>& callback : callbacks) {
+        callback();
+    }
+}
+
+// =================================================================
+// Calls a function once nothing is animating anymore
+//
+// @param callback Called when the frame timer stops, or right away
+// if it is not running
+// =================================================================
+
+void FrameScheduler::whenIdle(function<void()> callback) {
+    if (!timerId) {
+        callback();
+        return;
+    }
+    idleCallbacks.push_back(callback);
+}
+
+// =================================================================
+// Runs one frame and adapts the interval to the CPU budget
+// =================================================================
+
+void FrameScheduler::tick() {
+    int64_t begin = monotonicNow();
+    float dt = (begin - lastFrame) / 1e9f;
+    lastFrame = begin;
+
+    bool active = animate(dt);
+    ++frames;
+
+    float cost = (monotonicNow() - begin) / 1e9f;
+    averageCost = averageCost == 0 ? cost : averageCost * 0.8f + cost * 0.2f;
+
+    if (!active) {
+        stop();
+        return;
+    }
+
+    // The interval that keeps cost / interval under the budget
+    int wanted = max(1000 / fps, int(averageCost / budget * 1000) + 1);
+    if (wanted != intervalMs) schedule(wanted);
+}
+
+#endif
@@ -0,0 +1,216 @@
+// =================================================================
+//
+// File: BattleLog.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// BattleLog class, a fixed-capacity ring buffer of battle messages
+// with scrollback.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef BATTLELOG_H
+#define BATTLELOG_H
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the BattleLog class
+// Every line is stored in a preallocated slot of the ring, so
+// pushing a message never allocates. Messages wider than the log
+// are wrapped at word boundaries into several lines. Once the ring
+// is full the oldest lines are overwritten.
+// =================================================================
+
+class BattleLog {
+public:
+    static const int Capacity = 1024;
+    static const int LineLength = 128;
+
+private:
+    struct Line {
+        char text[LineLength];
+        int color;
+    };
+
+    vector<Line> lines; // allocated once, Capacity slots
+    long total;         // lines pushed since the last clear()
+    int offset;         // lines scrolled back from the newest one
+    int width;          // wrap width
+
+    void pushLine(const char* text, int length, int color);
+
+public:
+    BattleLog();
+
+    void clear();
+    void setWidth(int w);
+    void push(int color, const char* format, ...);
+    void pushText(int color, const char* text);
+
+    int size() const;
+    int getScroll() const;
+    void scrollUp(int count);
+    void scrollDown(int count);
+    int getVisible(int rows, const char** text, int* colors) const;
+};
+
+// =================================================================
+// Constructor. Allocates every slot of the ring.
+// =================================================================
+
+BattleLog::BattleLog() : lines(Capacity), total(0), offset(0), width(LineLength - 1) {}
+
+// =================================================================
+// Removes every line and resets the scrollback
+// =================================================================
+
+void BattleLog::clear() {
+    total = 0;
+    offset = 0;
+}
+
+// =================================================================
+// Sets the width used to wrap the following messages
+//
+// @param w The width in columns
+// =================================================================
+
+void BattleLog::setWidth(int w) {
+    width = w < 1 ? 1 : (w > LineLength - 1 ? LineLength - 1 : w);
+}
+
+// =================================================================
+// Formats a message and pushes it into the log
+//
+// @param color The color pair of the message
+// @param format printf-style format string
+// =================================================================
+
+void BattleLog::push(int color, const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    pushText(color, buffer);
+}
+
+// =================================================================
+// Pushes a message into the log, wrapping it at word boundaries
+//
+// @param color The color pair of the message
+// @param text The message
+// =================================================================
+
+void BattleLog::pushText(int color, const char* text) {
+    int length = strlen(text);
+    int start = 0;
+    while (start < length) {
+        int end = start + width;
+        if (end >= length) {
+            end = length;
+        } else {
+            // Break at the last space that fits, or hard-break a long word
+            int space = end;
+            while (space > start && text[space] != ' ') --space;
+            if (space > start) end = space;
+        }
+        pushLine(text + start, end - start, color);
+        start = end;
+        while (start < length && text[start] == ' ') ++start;
+    }
+    if (length == 0) pushLine(text, 0, color);
+}
+
+// =================================================================
+// Copies one line into the next slot of the ring. A reader that is
+// scrolled back keeps looking at the same lines.
+//
+// @param text The line
+// @param length The number of characters of the line
+// @param color The color pair of the line
+// =================================================================
+
+void BattleLog::pushLine(const char* text, int length, int color) {
+    Line& line = lines[total % Capacity];
+    memcpy(line.text, text, length);
+    line.text[length] = '\0';
+    line.color = color;
+    ++total;
+    if (offset > 0) scrollUp(1);
+}
+
+// =================================================================
+// Returns the number of lines that can still be read
+// =================================================================
+
+int BattleLog::size() const {
+    return total < Capacity ? int(total) : Capacity;
+}
+
+// =================================================================
+// Returns how many lines the view is scrolled back
+// =================================================================
+
+int BattleLog::getScroll() const {
+    return offset;
+}
+
+// =================================================================
+// Scrolls towards older lines
+//
+// @param count The number of lines to scroll
+// =================================================================
+
+void BattleLog::scrollUp(int count) {
+    offset += count;
+    if (offset > size() - 1) offset = size() > 0 ? size() - 1 : 0;
+}
+
+// =================================================================
+// Scrolls towards newer lines
+//
+// @param count The number of lines to scroll
+// =================================================================
+
+void BattleLog::scrollDown(int count) {
+    offset -= count;
+    if (offset < 0) offset = 0;
+}
+
+// =================================================================
+// Returns the lines that fit in a window of the given height,
+// oldest first, ending at the current scroll position. The cost
+// depends only on the window height.
+//
+// @param rows The height of the window
+// @param text Receives up to rows pointers to the lines
+// @param colors Receives up to rows color pairs
+// @return The number of lines written
+// =================================================================
+
+int BattleLog::getVisible(int rows, const char** text, int* colors) const {
+    long last = total - 1 - offset;       // newest visible line
+    long first = last - rows + 1;
+    long oldest = total - size();
+    if (first < oldest) first = oldest;
+    int count = 0;
+    for (long i = first; i <= last; ++i) {
+        const Line& line = lines[i % Capacity];
+        text[count] = line.text;
+        colors[count] = line.color;
+        ++count;
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,802 @@
+// =================================================================
+//
+// File: BattleSim.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// BattleSim class, which runs a battle on its own thread and
+// publishes what happens as a stream of combat events.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef BATTLESIM_H
+#define BATTLESIM_H
+
+#include "Character.h"
+#include "Coroutine.h"
+#include "EventLoop.h"
+#include "History.h"
+#include "Metrics.h"
+#include "Random.h"
+#include "Trace.h"
+#include "SpscQueue.h"
+#include "StatusEffects.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// State of a combatant right after an event
+// =================================================================
+
+struct CombatantState {
+    int health, mana;
+    float healthPercent, manaPercent;
+    bool alive;
+};
+
+// =================================================================
+// Something that happened in a battle. Events are plain values:
+// once published they are never changed, and they carry the state
+// of both combatants so the UI never reads the characters while the
+// simulation owns them.
+// =================================================================
+
+struct CombatEvent {
+    enum class Type : uint8_t {
+        Attack,        // actor dealt amount damage
+        Absorbed,      // the target's shield absorbed the attack
+        Recover,       // actor recovered health and mana
+        Death,         // actor died
+        AwaitAction,   // the simulation waits for the player's action
+        AwaitContinue, // the simulation waits before the enemy's turn
+        End,           // the battle is over; amount is 1 if the hero won
+        Afflicted,     // an effect of kind amount was put on actor
+        EffectTick,    // actor's effects changed its health by amount
+        Stunned,       // actor is stunned and loses its turn
+        EffectEnded,   // an effect of kind amount on actor ended
+        Missed,        // actor's attack missed
+        Critical,      // actor dealt amount damage with a critical hit
+        Rewound        // the battle went back to the start of turn amount
+    };
+
+    Type type;
+    uint8_t actor;     // 0 for the hero, 1 for the enemy
+    int amount;
+    CombatantState hero, enemy;
+};
+
+// =================================================================
+// Command sent by the UI to the simulation
+// =================================================================
+
+enum class BattleCommand : uint8_t {
+    Attack,
+    Recover,
+    Continue,
+    Exit,
+    Rewind      // undo the hero's last action
+};
+
+typedef function<void(const CombatEvent&)> CombatEventSink;
+
+// =================================================================
+// Builds an event with the current state of both combatants
+//
+// @param type The type of the event
+// @param actor 0 for the hero, 1 for the enemy
+// @param amount The amount of the event, if any
+// @param hero The hero
+// @param enemy The enemy
+// =================================================================
+
+CombatEvent makeCombatEvent(CombatEvent::Type type, int actor, int amount, const Character* hero, const Character* enemy) {
+    CombatEvent event;
+    event.type = type;
+    event.actor = actor;
+    event.amount = amount;
+    event.hero = { hero->getHealth(), hero->getMana(), hero->getHealthPercent(), hero->getManaPercent(), hero->isAlive() };
+    event.enemy = { enemy->getHealth(), enemy->getMana(), enemy->getHealthPercent(), enemy->getManaPercent(), enemy->isAlive() };
+    return event;
+}
+
+// =================================================================
+// What a battle came to for the hero, counted from its events, as
+// the battle history keeps it. A rewound turn no longer counts.
+// =================================================================
+
+struct BattleTally {
+    int turns = 0;          // of the hero, stunned ones included
+    int damageDealt = 0;
+    int damageTaken = 0;
+    vector<array<int, 3>> turnStarts;   // the counts at the start of turns 1, 2, ...
+
+    void count(const CombatEvent& event);
+    BattleRow toRow(HeroClass heroClass, const Character* hero, const Character* enemy, BattleOutcome outcome) const;
+};
+
+// =================================================================
+// Counts an event. Damage over time counts for whoever put the
+// effect on: a wound on the enemy was dealt by the hero. The
+// enemy's action ends a turn, so the counts are noted then for a
+// rewind to go back to.
+//
+// @param event The event
+// =================================================================
+
+void BattleTally::count(const CombatEvent& event) {
+    switch (event.type) {
+        case CombatEvent::Type::Attack:
+        case CombatEvent::Type::Critical:
+            (event.actor == 0 ? damageDealt : damageTaken) += event.amount;
+            [[fallthrough]];
+        case CombatEvent::Type::Missed:
+        case CombatEvent::Type::Absorbed:
+        case CombatEvent::Type::Stunned:
+            if (event.actor == 0) ++turns;
+            else turnStarts.push_back({ turns, damageDealt, damageTaken });
+            break;
+        case CombatEvent::Type::Recover:
+            ++turns;
+            break;
+        case CombatEvent::Type::EffectTick:
+            if (event.amount < 0) (event.actor == 0 ? damageTaken : damageDealt) -= event.amount;
+            break;
+        case CombatEvent::Type::Rewound: {
+            size_t turn = min(size_t(event.amount), turnStarts.size());
+            array<int, 3> start = turn ? turnStarts[turn - 1] : array<int, 3>{};
+            turns = start[0];
+            damageDealt = start[1];
+            damageTaken = start[2];
+            turnStarts.resize(turn);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// =================================================================
+// Returns the battle as a row of the battle history, stamped now
+//
+// @param heroClass The class of the hero
+// @param hero The hero, after the battle
+// @param enemy The enemy
+// @param outcome How the battle ended
+// =================================================================
+
+BattleRow BattleTally::toRow(HeroClass heroClass, const Character* hero, const Character* enemy, BattleOutcome outcome) const {
+    BattleRow row;
+    row.timestamp = time(nullptr);
+    row.heroClass = heroClass;
+    row.heroLevel = hero->getLevel();
+    row.enemy = enemy->getName();
+    row.turns = turns;
+    row.damageDealt = damageDealt;
+    row.damageTaken = damageTaken;
+    row.outcome = outcome;
+    return row;
+}
+
+// =================================================================
+// The rolls of an attack: it misses MissPercent of the time, is a
+// critical hit CriticalPercent of the time and deals CriticalDamage
+// percent then, and otherwise deals its damage give or take
+// DamageSpread percent
+// =================================================================
+
+const int MissPercent = 5;
+const int CriticalPercent = 10;
+const int CriticalDamage = 150;
+const int DamageSpread = 10;
+
+struct AttackRoll {
+    int damagePercent;  // 0 for a miss
+    bool critical;
+};
+
+// =================================================================
+// Rolls an attack. All three rolls are made every time, so the
+// rolls of later turns do not depend on how earlier ones came out.
+//
+// @param rolls The stream of the battle
+// =================================================================
+
+AttackRoll rollAttack(RandomStream& rolls) {
+    bool miss = rolls.chance(MissPercent);
+    bool critical = rolls.chance(CriticalPercent);
+    int spread = rolls.range(100 - DamageSpread, 100 + DamageSpread);
+    if (miss) return { 0, false };
+    return { (critical ? CriticalDamage : 100) * spread / 100, critical };
+}
+
+// =================================================================
+// Rolls an attack and runs it. The attack runs even when it misses,
+// so what it costs is still paid.
+//
+// @param attacker The attacking character
+// @param target The attacked character
+// @param rolls The stream of the battle
+// @return The rolls of the attack
+// =================================================================
+
+AttackRoll strike(Character* attacker, Character* target, RandomStream& rolls) {
+    AttackRoll roll = rollAttack(rolls);
+    attacker->setDamagePercent(roll.damagePercent);
+    attacker->attack(target);
+    attacker->setDamagePercent(100);
+    return roll;
+}
+
+// =================================================================
+// Runs an attack and publishes its outcome
+//
+// @param attacker The attacking character
+// @param target The attacked character
+// @param actor 0 if the hero attacks, 1 if the enemy does
+// @param hero The hero
+// @param enemy The enemy
+// @param rolls The stream of the battle
+// @param sink Receives the events
+// =================================================================
+
+void combatAttack(Character* attacker, Character* target, int actor, const Character* hero, const Character* enemy,
+                  RandomStream& rolls, const CombatEventSink& sink) {
+    TRACE_SPAN("battle", actor == 0 ? "heroAttack" : "enemyAttack");
+    int before = target->getHealth();
+    AttackRoll roll = strike(attacker, target, rolls);
+    int damage = before - target->getHealth();
+    if (roll.damagePercent == 0) {
+        METRICS_COUNT("battle.misses", 1);
+        sink(makeCombatEvent(CombatEvent::Type::Missed, actor, 0, hero, enemy));
+    } else if (damage <= 0) {
+        sink(makeCombatEvent(CombatEvent::Type::Absorbed, actor, 0, hero, enemy));
+    } else if (roll.critical) {
+        METRICS_COUNT("battle.criticals", 1);
+        sink(makeCombatEvent(CombatEvent::Type::Critical, actor, damage, hero, enemy));
+    } else {
+        sink(makeCombatEvent(CombatEvent::Type::Attack, actor, damage, hero, enemy));
+    }
+    if (!target->isAlive()) sink(makeCombatEvent(CombatEvent::Type::Death, 1 - actor, 0, hero, enemy));
+}
+
+// =================================================================
+// Contains the definition of the BattleState class
+// The hero, the enemy, their status effects and the rolls of a
+// battle, and the steps a turn is made of. The battle coroutine
+// runs the steps between commands; a rewind runs them back to back
+// with no one listening.
+// =================================================================
+
+class BattleState {
+private:
+    Character* hero;
+    Character* enemy;
+    const Enemy* foe;
+    RandomStream rolls;
+    StatusEngine status;
+    int heroSlot, enemySlot;
+
+public:
+    // Everything a turn can change, at the start of a turn
+    struct Keyframe {
+        BattleStats hero, enemy;
+        StatusEngine::Snapshot status;
+        uint64_t rolls;
+    };
+
+    BattleState(Character* heroCharacter, Character* enemyCharacter, const RandomStream& battleRolls);
+
+    bool beginTurn(const CombatEventSink& sink);
+    bool heroStunned() const;
+    void heroTurn(BattleCommand command, const CombatEventSink& sink);
+    void enemyTurn(const CombatEventSink& sink);
+
+    Keyframe keyframe() const;
+    void restore(const Keyframe& frame);
+};
+
+// =================================================================
+// Constructor
+//
+// @param heroCharacter The hero
+// @param enemyCharacter The enemy
+// @param battleRolls The stream of the battle
+// =================================================================
+
+BattleState::BattleState(Character* heroCharacter, Character* enemyCharacter, const RandomStream& battleRolls)
+    : hero(heroCharacter), enemy(enemyCharacter), foe(dynamic_cast<const Enemy*>(enemyCharacter)), rolls(battleRolls) {
+    heroSlot = status.addCombatant(hero);
+    enemySlot = status.addCombatant(enemy);
+}
+
+// =================================================================
+// Starts a turn: the status effects tick and the ones that are over
+// end
+//
+// @param sink Receives the events
+// @return false if a combatant died of its effects
+// =================================================================
+
+bool BattleState::beginTurn(const CombatEventSink& sink) {
+    status.beginTurn(
+        [&](int slot, int change) {
+            sink(makeCombatEvent(CombatEvent::Type::EffectTick, slot, change, hero, enemy));
+            if (!(slot == heroSlot ? hero : enemy)->isAlive()) {
+                sink(makeCombatEvent(CombatEvent::Type::Death, slot, 0, hero, enemy));
+            }
+        },
+        [&](int slot, EffectKind kind) {
+            sink(makeCombatEvent(CombatEvent::Type::EffectEnded, slot, int(kind), hero, enemy));
+        });
+    return hero->isAlive() && enemy->isAlive();
+}
+
+// =================================================================
+// Checks whether the hero loses its action this turn
+// =================================================================
+
+bool BattleState::heroStunned() const {
+    return status.isStunned(heroSlot);
+}
+
+// =================================================================
+// Runs the hero's action. A stunned hero only loses it.
+//
+// @param command Attack or Recover; ignored when the hero is stunned
+// @param sink Receives the events
+// =================================================================
+
+void BattleState::heroTurn(BattleCommand command, const CombatEventSink& sink) {
+    if (status.isStunned(heroSlot)) {
+        sink(makeCombatEvent(CombatEvent::Type::Stunned, 0, 0, hero, enemy));
+    } else if (command == BattleCommand::Attack) {
+        combatAttack(hero, enemy, 0, hero, enemy, rolls, sink);
+    } else {
+        TRACE_SPAN("battle", "heroRecover");
+        hero->recover();
+        sink(makeCombatEvent(CombatEvent::Type::Recover, 0, 0, hero, enemy));
+    }
+}
+
+// =================================================================
+// Runs the enemy's answer. Harmful effects ride on hits that land;
+// helpful ones go on the enemy whenever it attacks.
+//
+// @param sink Receives the events
+// =================================================================
+
+void BattleState::enemyTurn(const CombatEventSink& sink) {
+    if (status.isStunned(enemySlot)) {
+        sink(makeCombatEvent(CombatEvent::Type::Stunned, 1, 0, hero, enemy));
+        return;
+    }
+    int before = hero->getHealth();
+    combatAttack(enemy, hero, 1, hero, enemy, rolls, sink);
+    if (foe && hero->isAlive()) {
+        for (const EffectSpec& effect : foe->getInflicts()) {
+            bool harmful = isHarmful(effect.kind);
+            if (harmful && hero->getHealth() == before) continue;
+            status.apply(harmful ? heroSlot : enemySlot, effect);
+            sink(makeCombatEvent(CombatEvent::Type::Afflicted, harmful ? 0 : 1, int(effect.kind), hero, enemy));
+        }
+    }
+}
+
+// =================================================================
+// Returns the state of the battle, to come back to later
+// =================================================================
+
+BattleState::Keyframe BattleState::keyframe() const {
+    return { hero->getBattleStats(), enemy->getBattleStats(), status.snapshot(), rolls.position() };
+}
+
+// =================================================================
+// Puts the battle back as it was
+//
+// @param frame A keyframe of this battle
+// =================================================================
+
+void BattleState::restore(const Keyframe& frame) {
+    hero->setBattleStats(frame.hero);
+    enemy->setBattleStats(frame.enemy);
+    status.restore(frame.status);
+    rolls.seek(frame.rolls);
+}
+
+// =================================================================
+// Contains the definition of the BattleTimeline class
+// The turns of a battle, kept so it can be rewound to the start of
+// any of them. A battle is a pure function of its state, its rolls
+// and the player's commands, so the change a turn makes is kept as
+// the one command that made it: a byte a turn. Every
+// KeyframeInterval turns the whole state is kept as well: 120 bytes,
+// plus the status engine's arrays on the heap, 24 bytes for each of
+// the two combatants, 40 for each effect slot and 4 for each free
+// one. Going back to a turn restores the keyframe at or before it
+// and plays the commands after the keyframe again, never more than
+// KeyframeInterval - 1 turns however long the battle.
+// =================================================================
+
+class BattleTimeline {
+public:
+    static const size_t KeyframeInterval = 16;
+
+private:
+    vector<BattleCommand> commands;                 // the hero's command of every turn played
+    vector<BattleState::Keyframe> keyframes;        // at the start of turns 0, KeyframeInterval, ...
+
+public:
+    size_t turn() const;
+    size_t lastAction() const;
+    void startTurn(const BattleState& state);
+    void record(BattleCommand command);
+    size_t rewind(BattleState& state, size_t turn);
+};
+
+// =================================================================
+// Returns the number of turns played; the current turn, from 0
+// =================================================================
+
+size_t BattleTimeline::turn() const {
+    return commands.size();
+}
+
+// =================================================================
+// Returns the turn of the hero's last action. Stunned turns are
+// recorded as Continue and skipped, since the hero chose nothing in
+// them.
+//
+// @return The turn, or 0 if the hero has not acted yet
+// =================================================================
+
+size_t BattleTimeline::lastAction() const {
+    for (size_t turn = commands.size(); turn > 0; --turn) {
+        if (commands[turn - 1] != BattleCommand::Continue) return turn - 1;
+    }
+    return 0;
+}
+
+// =================================================================
+// Marks the start of the current turn, keeping a keyframe if one is
+// due and not kept yet
+//
+// @param state The battle, before the effects tick
+// =================================================================
+
+void BattleTimeline::startTurn(const BattleState& state) {
+    if (commands.size() % KeyframeInterval == 0 && keyframes.size() == commands.size() / KeyframeInterval) {
+        keyframes.push_back(state.keyframe());
+    }
+}
+
+// =================================================================
+// Records the hero's command of the current turn, which ends it
+//
+// @param command The command; Continue for a stunned hero
+// =================================================================
+
+void BattleTimeline::record(BattleCommand command) {
+    commands.push_back(command);
+}
+
+// =================================================================
+// Takes the battle back to the start of a turn. The turns after it
+// are forgotten, since the player will play them differently.
+//
+// @param state The battle, restored
+// @param turn The turn to go back to
+// @return The turn reached, turn() from now on
+// =================================================================
+
+size_t BattleTimeline::rewind(BattleState& state, size_t turn) {
+    turn = min(turn, commands.size());
+    size_t frame = turn / KeyframeInterval;
+    state.restore(keyframes[frame]);
+    CombatEventSink quiet = [](const CombatEvent&) {};
+    for (size_t replayed = frame * KeyframeInterval; replayed < turn; ++replayed) {
+        // Every turn before the last one went all the way round
+        state.beginTurn(quiet);
+        state.heroTurn(commands[replayed], quiet);
+        state.enemyTurn(quiet);
+    }
+    commands.resize(turn);
+    keyframes.resize(frame + 1);
+    return turn;
+}
+
+// =================================================================
+// Takes the battle back to the start of the turn of the hero's last
+// action, past the turns the hero spent stunned, or of the first
+// turn if the hero has not acted yet
+//
+// @param timeline The turns of the battle
+// @param state The battle, restored
+// @param hero The hero
+// @param enemy The enemy
+// @param sink Receives the Rewound event
+// =================================================================
+
+void undoLastAction(BattleTimeline& timeline, BattleState& state, const Character* hero, const Character* enemy,
+                    const CombatEventSink& sink) {
+    size_t turn = timeline.rewind(state, timeline.lastAction());
+    METRICS_COUNT("battle.rewinds", 1);
+    sink(makeCombatEvent(CombatEvent::Type::Rewound, 0, int(turn), hero, enemy));
+}
+
+// =================================================================
+// The turn sequence of a battle as a coroutine: the status effects
+// tick, the hero acts, then the enemy answers, until one of them
+// dies or the player leaves. A stunned combatant loses its action.
+// Waiting for a command suspends the coroutine, so any number of
+// battles can share one thread; each one costs its frame and its
+// command channel. The rolls of the attacks come from the battle's
+// own stream, so the same seed, battle id and commands always play
+// the same battle. Rewind, sent instead of an action or instead of
+// letting the enemy answer, undoes the hero's last action.
+//
+// @param hero The hero
+// @param enemy The enemy
+// @param rolls The stream of the battle
+// @param commands The commands of the player
+// @param sink Receives the events of the battle
+// @return true if the hero won
+// =================================================================
+
+Task<bool> battleFlow(Character* hero, Character* enemy, RandomStream rolls, Channel<BattleCommand>& commands,
+                      CombatEventSink sink) {
+    BattleState state(hero, enemy, rolls);
+    BattleTimeline timeline;
+
+    // A command that changes nothing keeps the turn going
+    bool newTurn = true;
+    while (true) {
+        if (newTurn) {
+            timeline.startTurn(state);
+            if (!state.beginTurn(sink)) {
+                sink(makeCombatEvent(CombatEvent::Type::End, 0, hero->isAlive() ? 1 : 0, hero, enemy));
+                co_return hero->isAlive();
+            }
+        }
+
+        bool stunned = state.heroStunned();
+        BattleCommand command = BattleCommand::Continue;
+        if (!stunned) {
+            sink(makeCombatEvent(CombatEvent::Type::AwaitAction, 0, 0, hero, enemy));
+            command = co_await commands.receive();
+            if (command == BattleCommand::Exit) co_return false;
+            if (command == BattleCommand::Rewind) {
+                undoLastAction(timeline, state, hero, enemy, sink);
+                newTurn = true;
+                continue;
+            }
+            newTurn = command != BattleCommand::Continue;
+            if (!newTurn) continue;
+        }
+        METRICS_MARK_ALLOCATIONS(turnAllocations);
+        timeline.record(command);
+        state.heroTurn(command, sink);
+        METRICS_COUNT("battle.turns", 1);
+
+        if (!enemy->isAlive()) {
+            sink(makeCombatEvent(CombatEvent::Type::End, 0, 1, hero, enemy));
+            METRICS_RECORD_ALLOCATIONS(turnAllocations, "battle.turn.allocations");
+            co_return true;
+        }
+
+        sink(makeCombatEvent(CombatEvent::Type::AwaitContinue, 0, 0, hero, enemy));
+        command = co_await commands.receive();
+        if (command == BattleCommand::Exit) co_return false;
+        newTurn = true;
+        if (command == BattleCommand::Rewind) {
+            undoLastAction(timeline, state, hero, enemy, sink);
+            continue;
+        }
+        state.enemyTurn(sink);
+        METRICS_RECORD_ALLOCATIONS(turnAllocations, "battle.turn.allocations");
+        if (!hero->isAlive()) {
+            sink(makeCombatEvent(CombatEvent::Type::End, 0, 0, hero, enemy));
+            co_return false;
+        }
+    }
+}
+
+// =================================================================
+// Contains the definition of the BattleSim class
+// The battle runs on a simulation thread that owns the hero and the
+// enemy until it ends. Events go to the UI thread over a lock-free
+// SPSC ring; after each one an eventfd is written so the UI's event
+// loop wakes up. Commands come back over a second ring with its own
+// eventfd. The simulation thread runs battleFlow() on an executor
+// and sleeps in poll() while the coroutine waits for a command, so
+// a slow terminal never holds up the combat logic and neither side
+// ever takes a lock.
+// =================================================================
+
+class BattleSim {
+public:
+    static const size_t EventCapacity = 256;
+    static const size_t CommandCapacity = 8; // the size of a Channel
+
+private:
+    Character* hero;
+    Character* enemy;
+    RandomStream rolls;
+    SpscQueue<CombatEvent, EventCapacity> events;
+    SpscQueue<BattleCommand, CommandCapacity> commands;
+    int notifyFd;  // readable when events are waiting for the UI
+    int commandFd; // readable when commands are waiting for the simulation
+    atomic<bool> stopping; // set by the destructor: events are dropped
+    atomic<bool> finished; // set when the battle is over: commands are dropped
+    thread worker;
+
+    void run();
+    void publish(const CombatEvent& event);
+
+public:
+    BattleSim();
+    ~BattleSim();
+
+    void start(Character* heroCharacter, Character* enemyCharacter, const RandomStream& battleRolls);
+    void send(BattleCommand command);
+    bool poll(CombatEvent& event);
+    int eventFd() const;
+    void clearNotify();
+    void join();
+};
+
+// =================================================================
+// Constructor. Creates the eventfd that signals new events.
+// =================================================================
+
+BattleSim::BattleSim() : hero(nullptr), enemy(nullptr), stopping(false), finished(false) {
+    notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    commandFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+// =================================================================
+// Destructor. Stops the simulation if it is still running. Nobody
+// reads the events any more, so the simulation stops waiting for
+// room for them.
+// =================================================================
+
+BattleSim::~BattleSim() {
+    if (worker.joinable()) {
+        stopping.store(true, memory_order_release);
+        send(BattleCommand::Exit);
+        worker.join();
+    }
+    if (notifyFd >= 0) close(notifyFd);
+    if (commandFd >= 0) close(commandFd);
+}
+
+// =================================================================
+// Starts the battle on the simulation thread. The characters must
+// not be touched by the caller until join() returns.
+//
+// @param heroCharacter The hero
+// @param enemyCharacter The enemy
+// @param battleRolls The stream of the battle
+// =================================================================
+
+void BattleSim::start(Character* heroCharacter, Character* enemyCharacter, const RandomStream& battleRolls) {
+    hero = heroCharacter;
+    enemy = enemyCharacter;
+    rolls = battleRolls;
+    worker = thread([this]() { run(); });
+}
+
+// =================================================================
+// Sends a command to the simulation. UI thread only. Commands sent
+// after the battle is over are dropped.
+//
+// @param command The command
+// =================================================================
+
+void BattleSim::send(BattleCommand command) {
+    while (!commands.push(command)) {
+        if (finished.load(memory_order_acquire)) return;
+        this_thread::yield();
+    }
+    uint64_t one = 1;
+    ssize_t written = write(commandFd, &one, sizeof(one));
+    (void)written;
+}
+
+// =================================================================
+// Takes the next event published by the simulation. UI thread only.
+//
+// @param event Receives the event
+// @return false if there is no event yet
+// =================================================================
+
+bool BattleSim::poll(CombatEvent& event) {
+    return events.pop(event);
+}
+
+// =================================================================
+// Returns the descriptor that becomes readable when events arrive
+// =================================================================
+
+int BattleSim::eventFd() const {
+    return notifyFd;
+}
+
+// =================================================================
+// Resets the event descriptor once the UI woke up for it
+// =================================================================
+
+void BattleSim::clearNotify() {
+    uint64_t count;
+    ssize_t got = read(notifyFd, &count, sizeof(count));
+    (void)got;
+}
+
+// =================================================================
+// Waits for the simulation thread to finish
+// =================================================================
+
+void BattleSim::join() {
+    if (worker.joinable()) worker.join();
+}
+
+// =================================================================
+// Pushes an event to the UI and wakes its event loop
+//
+// @param event The event
+// =================================================================
+
+void BattleSim::publish(const CombatEvent& event) {
+    while (!events.push(event)) {
+        if (stopping.load(memory_order_acquire)) return;
+        this_thread::yield();
+    }
+    uint64_t one = 1;
+    ssize_t written = write(notifyFd, &one, sizeof(one));
+    (void)written;
+}
+
+// =================================================================
+// The simulation thread: runs the battle coroutine on an executor
+// and feeds it the commands sent by the UI. Commands that do not
+// fit in the channel stay in the ring, and the descriptor is
+// written again so they are moved once the battle has taken some.
+// =================================================================
+
+void BattleSim::run() {
+    TRACE_THREAD("simulation");
+    EventLoop loop;
+    Executor executor(loop);
+    Channel<BattleCommand> channel(executor);
+
+    loop.addWatch(commandFd, [this, &channel]() {
+        uint64_t count;
+        ssize_t got = read(commandFd, &count, sizeof(count));
+        (void)got;
+        BattleCommand command;
+        while (!channel.full() && commands.pop(command)) {
+            channel.send(command);
+        }
+        if (!commands.empty()) {
+            uint64_t one = 1;
+            ssize_t written = write(commandFd, &one, sizeof(one));
+            (void)written;
+        }
+    });
+    executor.run(battleFlow(hero, enemy, rolls, channel, [this](const CombatEvent& event) { publish(event); }));
+    finished.store(true, memory_order_release);
+}
+
+#endif
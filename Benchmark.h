@@ -0,0 +1,267 @@
+// =================================================================
+//
+// File: Benchmark.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// BenchmarkSuite class, a small harness for micro-benchmarks with
+// stable statistics.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Keeps the compiler from optimizing a value away without costing
+// more than a register move
+//
+// @param value The value to keep
+// =================================================================
+
+template <typename T>
+inline void keepValue(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// =================================================================
+// Result of one benchmark. Times are nanoseconds per operation.
+// =================================================================
+
+struct BenchmarkResult {
+    string name;
+    long iterations;    // operations per repetition
+    int repetitions;
+    double median, mad, fastest;
+};
+
+// =================================================================
+// Contains the definition of the BenchmarkSuite class
+// Each benchmark is a function that runs a given number of
+// operations. The suite first doubles that number until one
+// repetition takes the minimum time, so the clock's resolution and
+// the cost of reading it do not matter, then runs warmup repetitions
+// that are thrown away, then the measured ones. The median and the
+// median absolute deviation are reported instead of the mean and
+// the standard deviation, so one preempted repetition does not move
+// the numbers.
+// =================================================================
+
+class BenchmarkSuite {
+public:
+    typedef function<void(long iterations)> Body;
+    enum class Format { Text, Json, Csv };
+
+private:
+    struct Entry {
+        string name;
+        Body body;
+    };
+
+    vector<Entry> entries;
+    int warmup, repetitions;
+    double minTimeNs;
+    string filter;
+
+    static double median(vector<double> values);
+    double timeOnce(const Body& body, long iterations) const;
+
+public:
+    BenchmarkSuite();
+
+    void add(const string& name, Body body);
+    void setWarmup(int count);
+    void setRepetitions(int count);
+    void setMinTime(double milliseconds);
+    void setFilter(const string& text);
+
+    BenchmarkResult measure(const string& name, const Body& body) const;
+    vector<BenchmarkResult> run() const;
+    static void print(const vector<BenchmarkResult>& results, Format format, FILE* out);
+};
+
+// =================================================================
+// Constructor. Defaults to 3 warmup and 15 measured repetitions of
+// at least 5 ms each.
+// =================================================================
+
+BenchmarkSuite::BenchmarkSuite() : warmup(3), repetitions(15), minTimeNs(5e6) {}
+
+// =================================================================
+// Adds a benchmark
+//
+// @param name The name, as "group/case"
+// @param body Runs the given number of operations
+// =================================================================
+
+void BenchmarkSuite::add(const string& name, Body body) {
+    entries.push_back({ name, body });
+}
+
+// =================================================================
+// Sets the number of repetitions thrown away before measuring
+//
+// @param count The number of repetitions
+// =================================================================
+
+void BenchmarkSuite::setWarmup(int count) {
+    warmup = max(0, count);
+}
+
+// =================================================================
+// Sets the number of measured repetitions
+//
+// @param count The number of repetitions
+// =================================================================
+
+void BenchmarkSuite::setRepetitions(int count) {
+    repetitions = max(1, count);
+}
+
+// =================================================================
+// Sets the minimum length of one repetition
+//
+// @param milliseconds The length
+// =================================================================
+
+void BenchmarkSuite::setMinTime(double milliseconds) {
+    minTimeNs = max(0.01, milliseconds) * 1e6;
+}
+
+// =================================================================
+// Runs only the benchmarks whose name contains a text
+//
+// @param text The text, empty for every benchmark
+// =================================================================
+
+void BenchmarkSuite::setFilter(const string& text) {
+    filter = text;
+}
+
+// =================================================================
+// Returns the median of some values
+//
+// @param values The values, copied to be sorted
+// =================================================================
+
+double BenchmarkSuite::median(vector<double> values) {
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    if (values.size() % 2) return values[middle];
+    return (values[middle - 1] + values[middle]) / 2;
+}
+
+// =================================================================
+// Times one repetition
+//
+// @param body The benchmark
+// @param iterations The number of operations
+// @return The elapsed nanoseconds
+// =================================================================
+
+double BenchmarkSuite::timeOnce(const Body& body, long iterations) const {
+    auto start = chrono::steady_clock::now();
+    body(iterations);
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count();
+}
+
+// =================================================================
+// Measures one benchmark
+//
+// @param name The name of the benchmark
+// @param body The benchmark
+// @return Its statistics
+// =================================================================
+
+BenchmarkResult BenchmarkSuite::measure(const string& name, const Body& body) const {
+    long iterations = 1;
+    while (timeOnce(body, iterations) < minTimeNs && iterations < (1L << 40)) {
+        iterations *= 2;
+    }
+    for (int i = 0; i < warmup; ++i) {
+        timeOnce(body, iterations);
+    }
+
+    vector<double> perOperation;
+    for (int i = 0; i < repetitions; ++i) {
+        perOperation.push_back(timeOnce(body, iterations) / iterations);
+    }
+    double middle = median(perOperation);
+    vector<double> deviations;
+    for (double value : perOperation) {
+        deviations.push_back(fabs(value - middle));
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.repetitions = repetitions;
+    result.median = middle;
+    result.mad = median(deviations);
+    result.fastest = *min_element(perOperation.begin(), perOperation.end());
+    return result;
+}
+
+// =================================================================
+// Runs every benchmark that passes the filter, in the order added
+// =================================================================
+
+vector<BenchmarkResult> BenchmarkSuite::run() const {
+    vector<BenchmarkResult> results;
+    for (const Entry& entry : entries) {
+        if (!filter.empty() && entry.name.find(filter) == string::npos) continue;
+        results.push_back(measure(entry.name, entry.body));
+    }
+    return results;
+}
+
+// =================================================================
+// Prints results. Json writes one object per line and Csv one row
+// per line after a header, so runs of different commits can be
+// joined by name.
+//
+// @param results The results
+// @param format The output format
+// @param out The stream
+// =================================================================
+
+void BenchmarkSuite::print(const vector<BenchmarkResult>& results, Format format, FILE* out) {
+    if (format == Format::Csv) fprintf(out, "name,iterations,repetitions,median_ns,mad_ns,min_ns\n");
+    if (format == Format::Text) {
+        fprintf(out, "%-32s %12s %12s %8s %12s\n", "benchmark", "median ns", "mad ns", "mad %", "iterations");
+    }
+    for (const BenchmarkResult& r : results) {
+        switch (format) {
+            case Format::Json:
+                fprintf(out, "{\"name\":\"%s\",\"iterations\":%ld,\"repetitions\":%d,"
+                             "\"median_ns\":%.3f,\"mad_ns\":%.3f,\"min_ns\":%.3f}\n",
+                        r.name.c_str(), r.iterations, r.repetitions, r.median, r.mad, r.fastest);
+                break;
+            case Format::Csv:
+                fprintf(out, "%s,%ld,%d,%.3f,%.3f,%.3f\n",
+                        r.name.c_str(), r.iterations, r.repetitions, r.median, r.mad, r.fastest);
+                break;
+            default:
+                fprintf(out, "%-32s %12.2f %12.2f %7.1f%% %12ld\n", r.name.c_str(), r.median, r.mad,
+                        r.median > 0 ? 100 * r.mad / r.median : 0.0, r.iterations);
+                break;
+        }
+    }
+}
+
+#endif
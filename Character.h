@@ -14,13 +14,54 @@
 #ifndef CHARACTER_H
 #define CHARACTER_H
 
+#include "Ability.h"
+#include "Inventory.h"
+#include "Progression.h"
+#include "Rating.h"
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
 
 using namespace std;
 
+// =================================================================
+// Kinds of status effect. What each one does is described in
+// StatusEffects.h.
+// =================================================================
+
+enum class EffectKind : uint8_t {
+    Poison,
+    Regeneration,
+    Strengthen,
+    Weaken,
+    Ward,
+    Sunder,
+    Stun
+};
+
+// =================================================================
+// A status effect and how long it lasts, in turns
+// =================================================================
+
+struct EffectSpec {
+    EffectKind kind;
+    int magnitude, turns;
+};
+
+// =================================================================
+// What a battle changes in a character, as battle rewinds save it
+// =================================================================
+
+struct BattleStats {
+    int health, mana;
+    int strengthModifier, shieldModifier;
+};
+
 // =================================================================
 // Contains the definition of the Character class
 // =================================================================
@@ -29,10 +70,23 @@ class Character {
 protected:
     string name;
     int health, mana, strength, shield, maxHealth, maxMana;
+    int strengthModifier, shieldModifier;      // from status effects
+    int effectiveStrength, effectiveShield;    // with equipment and modifiers, never negative
+    Inventory inventory;
+    const StatLine* growth;     // the stats of the class at every level, nullptr if it does not grow
+    int level;
+    int32_t xp;
+    int damagePercent;          // of the damage its attacks deal, set by the combat rolls
+    Rating rating;
+
+    void updateEffectiveStats();
+    void applyLevel();
+    void setHealthClamped(int value);
 
 public:
     Character();
     Character(const Character &c);
+    Character& operator=(const Character &c) = default;
     Character(string n, int h, int m, int s, int d);
     virtual ~Character();
 
@@ -42,11 +96,38 @@ public:
     int getMana() const;
     int getStrength() const;
     int getShield() const;
+    int getEffectiveStrength() const;
+    int getEffectiveShield() const;
     
     // Other methods
     bool isAlive() const;
     void takeDamage(int damage);
     void consumeMana(int amount);
+    void changeHealth(int amount);
+    void addModifiers(int strengthAmount, int shieldAmount);
+    void perform(const Ability& ability, Character* target);
+    void setDamagePercent(int percent);
+    BattleStats getBattleStats() const;
+    void setBattleStats(const BattleStats& stats);
+    int scaleDamage(int damage) const;
+
+    // Items and equipment
+    const Inventory& getInventory() const;
+    void setInventory(const Inventory& items);
+    bool equip(int place);
+    bool unequip(EquipSlot slot);
+    bool pickUp(uint16_t item);
+
+    // Experience and levels
+    int getLevel() const;
+    int32_t getXp() const;
+    bool canLevel() const;
+    int gainXp(int32_t amount);
+    void setProgress(int32_t total);
+
+    // Strength measured by the battles it has fought
+    const Rating& getRating() const;
+    void setRating(const Rating& value);
 
     virtual float getHealthPercent() const = 0;
     virtual float getManaPercent() const = 0;
@@ -60,7 +141,10 @@ public:
 // Default constructor
 // =================================================================
 
-Character::Character() : name(""), health(100), mana(50), strength(10), shield(5) {}
+Character::Character()
+    : name(""), health(100), mana(50), strength(10), shield(5), strengthModifier(0), shieldModifier(0),
+      effectiveStrength(10), effectiveShield(5), growth(nullptr), level(1), xp(0),
+      damagePercent(100) {}
 
 // =================================================================
 // Copy constructor
@@ -69,7 +153,11 @@ Character::Character() : name(""), health(100), mana(50), strength(10), shield(5
 // =================================================================
 
 Character::Character(const Character &c) 
-    : name(c.name), health(c.health), mana(c.mana), strength(c.strength), shield(c.shield) {}
+    : name(c.name), health(c.health), mana(c.mana), strength(c.strength), shield(c.shield),
+      maxHealth(c.maxHealth), maxMana(c.maxMana), strengthModifier(c.strengthModifier),
+      shieldModifier(c.shieldModifier), effectiveStrength(c.effectiveStrength),
+      effectiveShield(c.effectiveShield), inventory(c.inventory), growth(c.growth), level(c.level), xp(c.xp),
+      damagePercent(c.damagePercent), rating(c.rating) {}
 
 // =================================================================
 // Parameterized constructor
@@ -82,7 +170,9 @@ Character::Character(const Character &c)
 // =================================================================
 
 Character::Character(string n, int h, int m, int s, int d)
-    : name(n), health(h), mana(m), strength(s), shield(d), maxHealth(h), maxMana(m) {}
+    : name(n), health(h), mana(m), strength(s), shield(d), maxHealth(h), maxMana(m),
+      strengthModifier(0), shieldModifier(0), effectiveStrength(s), effectiveShield(d), growth(nullptr),
+      level(1), xp(0), damagePercent(100) {}
 
 
 // =================================================================
@@ -131,6 +221,24 @@ int Character::getShield() const {
     return shield;
 }
 
+// =================================================================
+// Returns the strength the character attacks with, after its
+// status effects
+// =================================================================
+
+int Character::getEffectiveStrength() const {
+    return effectiveStrength;
+}
+
+// =================================================================
+// Returns the shield the character defends with, after its status
+// effects
+// =================================================================
+
+int Character::getEffectiveShield() const {
+    return effectiveShield;
+}
+
 // =================================================================
 // Checks if the character is alive
 // =================================================================
@@ -148,12 +256,402 @@ bool Character::isAlive() const {
 // =================================================================
 
 void Character::takeDamage(int damage) {
-    if (damage > shield) {
-        health -= (damage - shield);
+    if (damage > effectiveShield) {
+        health -= (damage - effectiveShield);
         if (health < 0) health = 0;
     }
 }
 
+// =================================================================
+// Sets how hard the next attacks of the character land, as rolled
+// by the battle for a miss, a critical hit or the usual spread
+//
+// @param percent The percent of their damage they deal; 100 deals
+// it all and 0 misses
+// =================================================================
+
+void Character::setDamagePercent(int percent) {
+    damagePercent = percent;
+}
+
+// =================================================================
+// Returns what a battle has changed in the character so far
+// =================================================================
+
+BattleStats Character::getBattleStats() const {
+    return { health, mana, strengthModifier, shieldModifier };
+}
+
+// =================================================================
+// Puts the character back as it was at an earlier point of a battle
+//
+// @param stats What getBattleStats() returned then
+// =================================================================
+
+void Character::setBattleStats(const BattleStats& stats) {
+    health = stats.health;
+    mana = stats.mana;
+    strengthModifier = stats.strengthModifier;
+    shieldModifier = stats.shieldModifier;
+    updateEffectiveStats();
+}
+
+// =================================================================
+// Returns the damage an attack of the character deals, before the
+// shield of the target
+//
+// @param damage The damage of the attack
+// =================================================================
+
+int Character::scaleDamage(int damage) const {
+    return damagePercent == 100 ? damage : damage * damagePercent / 100;
+}
+
+// =================================================================
+// Changes the health of the character, ignoring the shield. Used by
+// effects that act over time, such as poison.
+//
+// @param amount Health gained, or lost if negative; health stays
+// between 0 and the maximum
+// =================================================================
+
+void Character::changeHealth(int amount) {
+    if (!isAlive()) return;
+    health += amount;
+    if (health < 0) health = 0;
+    if (health > maxHealth) health = maxHealth;
+}
+
+// =================================================================
+// Adds to the modifiers of strength and shield. The modifiers are
+// kept exactly, so removing an effect restores the stats, while the
+// effective values never drop below 0.
+//
+// @param strengthAmount Added to the strength modifier
+// @param shieldAmount Added to the shield modifier
+// =================================================================
+
+void Character::addModifiers(int strengthAmount, int shieldAmount) {
+    strengthModifier += strengthAmount;
+    shieldModifier += shieldAmount;
+    updateEffectiveStats();
+}
+
+// =================================================================
+// Runs an ability of the character against a target. Dispatch goes
+// through a table of label addresses, one indirect jump per
+// instruction, and the registers live on the stack, so running an
+// ability allocates nothing.
+//
+// @param ability The ability
+// @param target The character it is used on
+// =================================================================
+
+void Character::perform(const Ability& ability, Character* target) {
+    if (target == nullptr) return;
+    static const void* const dispatch[Ability::OpCount] = {
+        &&opMove, &&opLoad, &&opStoreHealth, &&opStoreMana, &&opAddHealth, &&opAddMana,
+        &&opAdd, &&opSub, &&opMul, &&opDiv, &&opMin, &&opMax,
+        &&opAddStat, &&opSubStat, &&opMulStat, &&opDivStat, &&opMinStat, &&opMaxStat,
+        &&opJumpLess, &&opJumpLessEqual, &&opJumpEqual, &&opJumpNotEqual,
+        &&opJumpStatLess, &&opJumpStatLessEqual, &&opJumpStatGreater, &&opJumpStatGreaterEqual,
+        &&opJumpStatEqual, &&opJumpStatNotEqual,
+        &&opJump, &&opDamage, &&opHeal, &&opEnd
+    };
+    static int Character::* const fields[8] = {
+        &Character::health, &Character::mana, &Character::maxHealth, &Character::maxMana,
+        &Character::effectiveStrength, &Character::effectiveShield
+    };
+    Character* const who[2] = { this, target };
+    int32_t r[Ability::Registers];
+    for (int i = 0; i < Ability::UserRegisters; ++i) {
+        r[i] = 0;
+    }
+    memcpy(r + Ability::FirstConstant, ability.constants, sizeof(ability.constants));
+
+    const uint32_t* const code = ability.code.data();
+    const uint32_t* ip = code;
+    uint32_t in;
+
+// The operands of the current instruction
+#define OP_A (in >> 8 & 0xFF)
+#define OP_B (in >> 16 & 0xFF)
+#define OP_C (in >> 24)
+#define STAT(operand) (who[(operand) >> 3]->*fields[(operand) & 7])
+#define NEXT() do { in = *ip++; goto *dispatch[in & 0xFF]; } while (0)
+// Arithmetic wraps around rather than overflowing
+#define ARITHMETIC(left, expr) do { int64_t x = (left), y = r[OP_C]; r[OP_A] = int32_t(expr); NEXT(); } while (0)
+#define JUMP_IF(test) do { if (test) ip = code + OP_C; NEXT(); } while (0)
+
+    NEXT();
+opMove:
+    r[OP_A] = r[OP_B];
+    NEXT();
+opLoad:
+    r[OP_A] = STAT(OP_B);
+    NEXT();
+opStoreHealth:
+    who[OP_A]->setHealthClamped(r[OP_B]);
+    NEXT();
+opStoreMana:
+    who[OP_A]->mana = r[OP_B] < 0 ? 0 : r[OP_B];
+    NEXT();
+opAddHealth:
+    who[OP_A]->setHealthClamped(int32_t(int64_t(who[OP_A]->health) + r[OP_B]));
+    NEXT();
+opAddMana: {
+        int32_t mana = int32_t(int64_t(who[OP_A]->mana) + r[OP_B]);
+        who[OP_A]->mana = mana < 0 ? 0 : mana;
+        NEXT();
+    }
+opAdd:
+    ARITHMETIC(r[OP_B], x + y);
+opSub:
+    ARITHMETIC(r[OP_B], x - y);
+opMul:
+    ARITHMETIC(r[OP_B], uint64_t(x) * uint64_t(y));
+opDiv:
+    ARITHMETIC(r[OP_B], y == 0 ? 0 : x / y);
+opMin:
+    ARITHMETIC(r[OP_B], x < y ? x : y);
+opMax:
+    ARITHMETIC(r[OP_B], x > y ? x : y);
+opAddStat:
+    ARITHMETIC(STAT(OP_B), x + y);
+opSubStat:
+    ARITHMETIC(STAT(OP_B), x - y);
+opMulStat:
+    ARITHMETIC(STAT(OP_B), uint64_t(x) * uint64_t(y));
+opDivStat:
+    ARITHMETIC(STAT(OP_B), y == 0 ? 0 : x / y);
+opMinStat:
+    ARITHMETIC(STAT(OP_B), x < y ? x : y);
+opMaxStat:
+    ARITHMETIC(STAT(OP_B), x > y ? x : y);
+opJumpLess:
+    JUMP_IF(r[OP_A] < r[OP_B]);
+opJumpLessEqual:
+    JUMP_IF(r[OP_A] <= r[OP_B]);
+opJumpEqual:
+    JUMP_IF(r[OP_A] == r[OP_B]);
+opJumpNotEqual:
+    JUMP_IF(r[OP_A] != r[OP_B]);
+opJumpStatLess:
+    JUMP_IF(STAT(OP_A) < r[OP_B]);
+opJumpStatLessEqual:
+    JUMP_IF(STAT(OP_A) <= r[OP_B]);
+opJumpStatGreater:
+    JUMP_IF(STAT(OP_A) > r[OP_B]);
+opJumpStatGreaterEqual:
+    JUMP_IF(STAT(OP_A) >= r[OP_B]);
+opJumpStatEqual:
+    JUMP_IF(STAT(OP_A) == r[OP_B]);
+opJumpStatNotEqual:
+    JUMP_IF(STAT(OP_A) != r[OP_B]);
+opJump:
+    ip = code + OP_A;
+    NEXT();
+opDamage:
+    who[OP_A]->takeDamage(scaleDamage(r[OP_B]));
+    NEXT();
+opHeal:
+    who[OP_A]->changeHealth(r[OP_B]);
+    NEXT();
+opEnd:
+    return;
+
+#undef OP_A
+#undef OP_B
+#undef OP_C
+#undef STAT
+#undef NEXT
+#undef ARITHMETIC
+#undef JUMP_IF
+}
+
+// =================================================================
+// Sets the health, kept between 0 and the maximum. Used when an
+// ability writes the health.
+//
+// @param value The new health
+// =================================================================
+
+void Character::setHealthClamped(int value) {
+    health = value < 0 ? 0 : value > maxHealth ? maxHealth : value;
+}
+
+// =================================================================
+// Recomputes the effective strength and shield from the base stats,
+// the equipment sums and the modifiers, so combat reads them without
+// adding anything up
+// =================================================================
+
+void Character::updateEffectiveStats() {
+    effectiveStrength = strength + inventory.getBonusStrength() + strengthModifier;
+    if (effectiveStrength < 0) effectiveStrength = 0;
+    effectiveShield = shield + inventory.getBonusShield() + shieldModifier;
+    if (effectiveShield < 0) effectiveShield = 0;
+}
+
+// =================================================================
+// Returns the items and equipment of the character
+// =================================================================
+
+const Inventory& Character::getInventory() const {
+    return inventory;
+}
+
+// =================================================================
+// Replaces the items and equipment of the character, as when a
+// save file is loaded
+//
+// @param items The inventory
+// =================================================================
+
+void Character::setInventory(const Inventory& items) {
+    inventory = items;
+    updateEffectiveStats();
+}
+
+// =================================================================
+// Equips an item of the inventory
+//
+// @param place The place of the item in the inventory
+// @return false if the place was empty
+// =================================================================
+
+bool Character::equip(int place) {
+    if (!inventory.equip(place)) return false;
+    updateEffectiveStats();
+    return true;
+}
+
+// =================================================================
+// Takes off the item of a slot
+//
+// @param slot The slot
+// @return false if the slot was empty or the inventory is full
+// =================================================================
+
+bool Character::unequip(EquipSlot slot) {
+    if (!inventory.unequip(slot)) return false;
+    updateEffectiveStats();
+    return true;
+}
+
+// =================================================================
+// Takes an item found in battle. It is equipped at once when its
+// slot is empty or it gives more than the item worn there.
+//
+// @param item The item
+// @return false if the character already owns one or has no room
+// =================================================================
+
+bool Character::pickUp(uint16_t item) {
+    if (item >= ItemCount || inventory.owns(item)) return false;
+    int place = inventory.add(item);
+    if (place < 0) return false;
+    uint16_t worn = inventory.equippedItem(itemDef(item).slot);
+    if (worn == NoItem || itemDef(item).strength + itemDef(item).shield > itemDef(worn).strength + itemDef(worn).shield) {
+        equip(place);
+    }
+    return true;
+}
+
+// =================================================================
+// Returns the level of the character, 1 for those that do not grow
+// =================================================================
+
+int Character::getLevel() const {
+    return level;
+}
+
+// =================================================================
+// Returns the experience of the character
+// =================================================================
+
+int32_t Character::getXp() const {
+    return xp;
+}
+
+// =================================================================
+// Checks whether the character gains levels, as heroes do
+// =================================================================
+
+bool Character::canLevel() const {
+    return growth != nullptr;
+}
+
+// =================================================================
+// Adds experience. Every level gained sets the stats of the class
+// at the new level and adds the health and mana it brings.
+//
+// @param amount The experience gained
+// @return The number of levels gained
+// =================================================================
+
+int Character::gainXp(int32_t amount) {
+    if (!growth || amount <= 0) return 0;
+    xp = amount >= MaxXp - xp ? MaxXp : xp + amount;
+    int reached = levelForXp(xp);
+    if (reached == level) return 0;
+
+    const StatLine& before = growth[level];
+    const StatLine& after = growth[reached];
+    int gained = reached - level;
+    level = reached;
+    if (isAlive()) health += after.maxHealth - before.maxHealth;
+    mana += after.maxMana - before.maxMana;
+    applyLevel();
+    return gained;
+}
+
+// =================================================================
+// Sets the experience, and the level and stats it gives, without
+// healing. Used when a save file is loaded.
+//
+// @param total The experience
+// =================================================================
+
+void Character::setProgress(int32_t total) {
+    if (!growth) return;
+    xp = total < 0 ? 0 : total > MaxXp ? MaxXp : total;
+    level = levelForXp(xp);
+    applyLevel();
+}
+
+// =================================================================
+// Returns the rating of the character
+// =================================================================
+
+const Rating& Character::getRating() const {
+    return rating;
+}
+
+// =================================================================
+// Sets the rating of the character, as after a battle or on load
+//
+// @param value The rating
+// =================================================================
+
+void Character::setRating(const Rating& value) {
+    rating = value;
+}
+
+// =================================================================
+// Sets the stats of the class at the current level. Levels only go
+// up, so the maximums never drop below the health and mana.
+// =================================================================
+
+void Character::applyLevel() {
+    const StatLine& stats = growth[level];
+    maxHealth = stats.maxHealth;
+    maxMana = stats.maxMana;
+    strength = stats.strength;
+    shield = stats.shield;
+    updateEffectiveStats();
+}
+
 // =================================================================
 // Warrior class inherits from Character
 // =================================================================
@@ -162,7 +660,9 @@ class Warrior : public Character {
 public:
     Warrior();
     Warrior(const Warrior &w);
+    Warrior& operator=(const Warrior &w) = default;
     Warrior(string n);
+    Warrior(string n, int h, int m, int s, int d);
 
     void attack(Character* target) override;
     void recover() override;
@@ -179,6 +679,7 @@ public:
 Warrior::Warrior() : Character("Warrior", 80, 30, 40, 20) {
     maxHealth = 80;
     maxMana = 30;
+    growth = growthOf(HeroClass::Warrior);
 }
 
 // =================================================================
@@ -196,26 +697,47 @@ Warrior::Warrior(const Warrior &w): Character(w) {}
 Warrior::Warrior(string n) : Character(n, 80, 30, 40, 20) {
     maxHealth = 80;
     maxMana = 30;
+    growth = growthOf(HeroClass::Warrior);
+}
+
+// =================================================================
+// Constructor for a Warrior restored from a save file
+//
+// @param n The name of the warrior
+// @param h The current health of the warrior
+// @param m The current mana of the warrior
+// @param s The strength of the warrior
+// @param d The shield of the warrior
+// =================================================================
+
+Warrior::Warrior(string n, int h, int m, int s, int d) : Character(n, h, m, s, d) {
+    maxHealth = 80;
+    maxMana = 30;
+    growth = growthOf(HeroClass::Warrior);
 }
 
 // =================================================================
 // Warrior attacks the target character
 //
-// If the warrior has 10 or more mana, it deals double damage
+// If the warrior has 10 or more mana, it deals double damage. The
+// attack is a built-in ability, compiled on first use.
 //
 // @param target The character to attack
 // =================================================================
 
 void Warrior::attack(Character* target) {
-    if (isAlive() && target != nullptr && target->isAlive()) {
-        if (mana >= 10) {
-            target->takeDamage(strength * 2);
-            mana -= 10;
-        } else {
-            target->takeDamage(strength);
-            mana += 5;
-        }
-    }
+    static const shared_ptr<const Ability> strike = Ability::builtin(
+        "if self.health <= 0 goto done\n"
+        "if target.health <= 0 goto done\n"
+        "if self.mana < 10 goto weak\n"
+        "mul r0, self.strength, 2\n"
+        "damage target, r0\n"
+        "sub self.mana, self.mana, 10\n"
+        "end\n"
+        "weak: damage target, self.strength\n"
+        "add self.mana, self.mana, 5\n"
+        "done:\n");
+    perform(*strike, target);
 }
 
 // =================================================================
@@ -285,7 +807,9 @@ class Archer : public Character {
 public:
     Archer();
     Archer(const Archer &a);
+    Archer& operator=(const Archer &a) = default;
     Archer(string n);
+    Archer(string n, int h, int m, int s, int d);
 
     void attack(Character* target) override;
     void recover() override;
@@ -302,6 +826,7 @@ public:
 Archer::Archer() : Character("Archer", 60, 50, 30, 15) {
     maxHealth = 60;
     maxMana = 50;
+    growth = growthOf(HeroClass::Archer);
 }
 
 // =================================================================
@@ -321,27 +846,47 @@ Archer::Archer(const Archer &a) : Character(a) {}
 Archer::Archer(string n) : Character(n, 60, 50, 30, 15) {
     maxHealth = 60;
     maxMana = 50;
+    growth = growthOf(HeroClass::Archer);
+}
+
+// =================================================================
+// Constructor for a Archer restored from a save file
+//
+// @param n The name of the archer
+// @param h The current health of the archer
+// @param m The current mana of the archer
+// @param s The strength of the archer
+// @param d The shield of the archer
+// =================================================================
+
+Archer::Archer(string n, int h, int m, int s, int d) : Character(n, h, m, s, d) {
+    maxHealth = 60;
+    maxMana = 50;
+    growth = growthOf(HeroClass::Archer);
 }
 
 // =================================================================
 // Archer attacks the target character
 //
-// If the archer has 20 or more mana, it deals double damage
+// If the archer has 20 or more mana, it deals double damage, as a
+// built-in ability
 // @param target The character to attack
 // =================================================================
 
 void Archer::attack(Character* target) {
-    if (isAlive() && target != nullptr && target->isAlive()) {
-        if (mana >= 20) {
-            target->takeDamage(strength*2);
-            mana -= 20;
-        } else {
-            target->takeDamage(strength);
-            if (mana < maxMana) {
-                mana += 10;
-            }
-        }
-    }
+    static const shared_ptr<const Ability> strike = Ability::builtin(
+        "if self.health <= 0 goto done\n"
+        "if target.health <= 0 goto done\n"
+        "if self.mana < 20 goto weak\n"
+        "mul r0, self.strength, 2\n"
+        "damage target, r0\n"
+        "sub self.mana, self.mana, 20\n"
+        "end\n"
+        "weak: damage target, self.strength\n"
+        "if self.mana >= self.maxMana goto done\n"
+        "add self.mana, self.mana, 10\n"
+        "done:\n");
+    perform(*strike, target);
 }
 
 // =================================================================
@@ -415,7 +960,9 @@ class Mage : public Character {
 public:
     Mage();
     Mage(const Mage &m);
+    Mage& operator=(const Mage &m) = default;
     Mage(string n);
+    Mage(string n, int h, int m, int s, int d);
 
     void attack(Character* target) override;
     void recover() override;
@@ -432,6 +979,7 @@ public:
 Mage::Mage() : Character("Mage", 65, 100, 20, 10) {
     maxHealth = 65;
     maxMana = 100;
+    growth = growthOf(HeroClass::Mage);
 }
 
 // =================================================================
@@ -451,27 +999,47 @@ Mage::Mage(const Mage &m) : Character(m) {}
 Mage::Mage(string n) : Character(n, 60, 100, 20, 10) {
     maxHealth = 65;
     maxMana = 100;
+    growth = growthOf(HeroClass::Mage);
+}
+
+// =================================================================
+// Constructor for a Mage restored from a save file
+//
+// @param n The name of the mage
+// @param h The current health of the mage
+// @param m The current mana of the mage
+// @param s The strength of the mage
+// @param d The shield of the mage
+// =================================================================
+
+Mage::Mage(string n, int h, int m, int s, int d) : Character(n, h, m, s, d) {
+    maxHealth = 65;
+    maxMana = 100;
+    growth = growthOf(HeroClass::Mage);
 }
 
 // =================================================================
 // Mage attacks the target character
-// If the mage has 30 or more mana, it deals double damage
+// If the mage has 30 or more mana, it deals double damage, as a
+// built-in ability
 //
 // @param target The character to attack
 // =================================================================
 
 void Mage::attack(Character* target) {
-    if (isAlive() && target != nullptr && target->isAlive()) {
-        if (mana >= 30) {
-            target->takeDamage(strength * 2);
-            mana -= 30;
-        } else {
-            target->takeDamage(strength);
-            if (mana < maxMana) {
-                mana += 10;
-            }
-        }
-    }
+    static const shared_ptr<const Ability> strike = Ability::builtin(
+        "if self.health <= 0 goto done\n"
+        "if target.health <= 0 goto done\n"
+        "if self.mana < 30 goto weak\n"
+        "mul r0, self.strength, 2\n"
+        "damage target, r0\n"
+        "sub self.mana, self.mana, 30\n"
+        "end\n"
+        "weak: damage target, self.strength\n"
+        "if self.mana >= self.maxMana goto done\n"
+        "add self.mana, self.mana, 10\n"
+        "done:\n");
+    perform(*strike, target);
 }
 
 // =================================================================
@@ -542,11 +1110,22 @@ float Mage::getManaPercent() const {
 // =================================================================
 
 class Enemy : public Character {
+private:
+    vector<EffectSpec> inflicts;
+    shared_ptr<const Ability> ability;
+
 public:
     Enemy();
     Enemy(const Enemy &e);
+    Enemy& operator=(const Enemy &e) = default;
     Enemy(string n, int h, int m, int s, int d);
 
+    void setInflicts(const vector<EffectSpec>& effects);
+    const vector<EffectSpec>& getInflicts() const;
+    void setAbility(shared_ptr<const Ability> program);
+    shared_ptr<const Ability> getAbility() const;
+    int32_t getXpValue() const;
+
     void attack(Character* target) override;
     void recover() override;
     string toString() const override;
@@ -569,7 +1148,7 @@ Enemy::Enemy() : Character("Enemy", 30, 0, 15, 5) {
 // @param e The enemy to copy
 // =================================================================
 
-Enemy::Enemy(const Enemy &e) : Character(e) {}
+Enemy::Enemy(const Enemy &e) : Character(e), inflicts(e.inflicts), ability(e.ability) {}
 
 // =================================================================
 // Parameterized constructor for Enemy
@@ -586,13 +1165,64 @@ Enemy::Enemy(string n, int h, int m, int s, int d) : Character(n, h, m, s, d) {
 }
 
 // =================================================================
-// Enemy attacks the target character
+// Sets the status effects of the enemy's attacks. Harmful ones are
+// put on the hero it hits and helpful ones on the enemy itself.
+//
+// @param effects The effects
+// =================================================================
+
+void Enemy::setInflicts(const vector<EffectSpec>& effects) {
+    inflicts = effects;
+}
+
+// =================================================================
+// Returns the status effects of the enemy's attacks
+// =================================================================
+
+const vector<EffectSpec>& Enemy::getInflicts() const {
+    return inflicts;
+}
+
+// =================================================================
+// Sets the ability the enemy attacks with
+//
+// @param program The ability, or nullptr for a plain hit
+// =================================================================
+
+void Enemy::setAbility(shared_ptr<const Ability> program) {
+    ability = move(program);
+}
+
+// =================================================================
+// Returns the ability the enemy attacks with, or nullptr
+// =================================================================
+
+shared_ptr<const Ability> Enemy::getAbility() const {
+    return ability;
+}
+
+// =================================================================
+// Returns the experience a hero gains by defeating the enemy: its
+// maximum health plus twice its strength and shield
+// =================================================================
+
+int32_t Enemy::getXpValue() const {
+    return maxHealth + 2 * (strength + shield);
+}
+
+// =================================================================
+// Enemy attacks the target character, with its ability if it has
+// one and otherwise with a plain hit of its strength
 //
 // @param target The character to attack
 // =================================================================
 
 void Enemy::attack(Character* target) {
-    target->takeDamage(getStrength());
+    if (ability) {
+        perform(*ability, target);
+    } else {
+        target->takeDamage(scaleDamage(getEffectiveStrength()));
+    }
 }
 
 // =================================================================
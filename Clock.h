@@ -0,0 +1,32 @@
+// =================================================================
+//
+// File: Clock.h
+// Author: Alexis Berthou
+// Description: This file contains the monotonic clock shared by the
+// event loop, the animations, the metrics and the trace.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+#include <ctime>
+using namespace std;
+
+// =================================================================
+// Returns the monotonic clock in nanoseconds. Safe from a signal
+// handler.
+// =================================================================
+
+int64_t monotonicNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+#endif
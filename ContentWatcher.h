@@ -0,0 +1,444 @@
+// =================================================================
+//
+// File: ContentWatcher.h
+// Author: Alexis Berthou
+// Description: This file contains the parser of the content files
+// and the ContentWatcher class, which reloads them when they change.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef CONTENTWATCHER_H
+#define CONTENTWATCHER_H
+
+#include "Character.h"
+#include "LevelCatalog.h"
+#include "StatusEffects.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// A level as written in levels.txt; the enemy is still a name
+// =================================================================
+
+struct LevelSpec {
+    string name, prologue, epilogue, enemy;
+    uint16_t reward;
+};
+
+// =================================================================
+// Reads the blocks of a content file. A block starts with a
+// "[kind]" line and holds "key = value" lines; a key given on
+// several lines keeps all of them, one per line. Blank lines and
+// lines starting with '#' are ignored.
+//
+// @param in The file
+// @param kind The kind of block the file holds
+// @param blocks Receives the keys of every block and the line it started on
+// @param error Receives the reason when the file is malformed
+// @return false if the file is malformed
+// =================================================================
+
+bool parseContentBlocks(istream& in, const string& kind, vector<pair<int, unordered_map<string, string>>>& blocks, string& error) {
+    string line;
+    int number = 0;
+    while (getline(in, line)) {
+        ++number;
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t\r");
+        line = line.substr(first, last - first + 1);
+
+        if (line[0] == '[') {
+            if (line != "[" + kind + "]") {
+                error = "line " + to_string(number) + ": expected [" + kind + "]";
+                return false;
+            }
+            blocks.push_back({ number, {} });
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (blocks.empty() || equals == string::npos) {
+            error = "line " + to_string(number) + ": expected key = value inside a [" + kind + "] block";
+            return false;
+        }
+        string key = line.substr(0, line.find_last_not_of(" \t", equals - 1) + 1);
+        size_t valueStart = line.find_first_not_of(" \t", equals + 1);
+        string value = valueStart == string::npos ? "" : line.substr(valueStart);
+        auto found = blocks.back().second.find(key);
+        if (found != blocks.back().second.end()) {
+            found->second += "\n" + value;
+        } else {
+            blocks.back().second[key] = value;
+        }
+    }
+    return true;
+}
+
+// =================================================================
+// Parses enemies.txt
+//
+// @param in The file
+// @param enemies Receives the enemies
+// @param error Receives the reason when the file is malformed
+// @return false if the file is malformed
+// =================================================================
+
+bool parseEnemies(istream& in, vector<Enemy>& enemies, string& error) {
+    vector<pair<int, unordered_map<string, string>>> blocks;
+    if (!parseContentBlocks(in, "enemy", blocks, error)) return false;
+
+    const char* stats[] = { "health", "mana", "strength", "shield" };
+    for (auto& block : blocks) {
+        string where = "enemy at line " + to_string(block.first);
+        auto& keys = block.second;
+        if (keys["name"].empty()) {
+            error = where + ": missing name";
+            return false;
+        }
+        int values[4];
+        for (int i = 0; i < 4; ++i) {
+            const string& text = keys[stats[i]];
+            char* end = nullptr;
+            long value = strtol(text.c_str(), &end, 10);
+            if (text.empty() || *end != '\0' || value < 0 || value > 30000) {
+                error = where + ": " + stats[i] + " must be a number from 0 to 30000";
+                return false;
+            }
+            values[i] = int(value);
+        }
+        vector<EffectSpec> inflicts;
+        if (!parseEffectList(keys["inflicts"], inflicts, error)) {
+            error = where + ": " + error;
+            return false;
+        }
+        shared_ptr<const Ability> ability;
+        if (!keys["ability"].empty()) {
+            ability = Ability::compile(keys["ability"], error);
+            if (!ability) {
+                error = where + ": ability " + error;
+                return false;
+            }
+        }
+        enemies.push_back(Enemy(keys["name"], values[0], values[1], values[2], values[3]));
+        enemies.back().setInflicts(inflicts);
+        enemies.back().setAbility(ability);
+    }
+    if (enemies.empty()) {
+        error = "no enemies defined";
+        return false;
+    }
+    return true;
+}
+
+// =================================================================
+// Parses levels.txt
+//
+// @param in The file
+// @param levels Receives the levels, in campaign order
+// @param error Receives the reason when the file is malformed
+// @return false if the file is malformed
+// =================================================================
+
+bool parseLevels(istream& in, vector<LevelSpec>& levels, string& error) {
+    vector<pair<int, unordered_map<string, string>>> blocks;
+    if (!parseContentBlocks(in, "level", blocks, error)) return false;
+
+    for (auto& block : blocks) {
+        auto& keys = block.second;
+        if (keys["name"].empty() || keys["enemy"].empty()) {
+            error = "level at line " + to_string(block.first) + ": name and enemy are required";
+            return false;
+        }
+        uint16_t reward = NoItem;
+        if (!keys["reward"].empty()) {
+            reward = findItem(keys["reward"]);
+            if (reward == NoItem) {
+                error = "level at line " + to_string(block.first) + ": unknown item " + keys["reward"];
+                return false;
+            }
+        }
+        levels.push_back({ keys["name"], keys["prologue"], keys["epilogue"], keys["enemy"], reward });
+    }
+    if (levels.empty()) {
+        error = "no levels defined";
+        return false;
+    }
+    return true;
+}
+
+// =================================================================
+// Combines parsed levels and enemies into a catalog
+//
+// @param levels The levels
+// @param enemies The enemies they refer to
+// @param error Receives the reason when a level names an unknown enemy
+// @return The catalog, or nullptr
+// =================================================================
+
+shared_ptr<const LevelCatalog> buildCatalog(const vector<LevelSpec>& levels, const vector<Enemy>& enemies, string& error) {
+    vector<LevelDef> definitions;
+    definitions.reserve(levels.size());
+    for (const LevelSpec& spec : levels) {
+        const Enemy* found = nullptr;
+        for (const Enemy& enemy : enemies) {
+            if (enemy.getName() == spec.enemy) {
+                found = &enemy;
+                break;
+            }
+        }
+        if (!found) {
+            error = "level \"" + spec.name + "\": unknown enemy " + spec.enemy;
+            return nullptr;
+        }
+        definitions.push_back({ spec.name, spec.prologue, spec.epilogue, *found, spec.reward });
+    }
+    return make_shared<const LevelCatalog>(move(definitions));
+}
+
+// =================================================================
+// Contains the definition of the ContentWatcher class
+// Holds the current LevelCatalog and replaces it when the content
+// files change. A background thread waits on inotify for the
+// directory, reparses only the file that was written and builds a
+// new catalog from it and the last good parse of the other file.
+// The catalog is published with one atomic store, so readers never
+// wait and anyone holding the old catalog keeps it until they let
+// go: a battle in progress finishes on the definitions it started
+// with. A file that fails to parse leaves the current catalog in
+// place.
+// =================================================================
+
+class ContentWatcher {
+public:
+    typedef function<void(bool ok, const string& message)> Listener;
+
+private:
+    string directory;
+    atomic<shared_ptr<const LevelCatalog>> catalog;
+    atomic<uint64_t> version;
+    vector<Enemy> enemies;        // last good parse, watcher thread only once started
+    vector<LevelSpec> levels;
+    bool enemiesOk, levelsOk;
+    Listener listener;
+    int inotifyFd, stopFd;
+    thread watcher;
+
+    bool reload(const string& file, string& error);
+    bool publish(string& error);
+    void watch();
+
+public:
+    ContentWatcher(const string& contentDirectory);
+    ~ContentWatcher();
+
+    bool load(string& error);
+    bool start();
+    void setListener(Listener onReload);
+
+    shared_ptr<const LevelCatalog> current() const;
+    uint64_t generation() const;
+};
+
+// =================================================================
+// Constructor. Until load() succeeds the catalog holds the levels
+// built into the game.
+//
+// @param contentDirectory The directory of levels.txt and enemies.txt
+// =================================================================
+
+ContentWatcher::ContentWatcher(const string& contentDirectory)
+    : directory(contentDirectory), catalog(LevelCatalog::builtin()), version(0),
+      enemiesOk(false), levelsOk(false), inotifyFd(-1), stopFd(-1) {}
+
+// =================================================================
+// Destructor. Stops the watcher thread.
+// =================================================================
+
+ContentWatcher::~ContentWatcher() {
+    if (watcher.joinable()) {
+        uint64_t one = 1;
+        ssize_t written = write(stopFd, &one, sizeof(one));
+        (void)written;
+        watcher.join();
+    }
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (stopFd >= 0) close(stopFd);
+}
+
+// =================================================================
+// Reads both content files and publishes their catalog
+//
+// @param error Receives the reason when the files cannot be used
+// @return false if the built-in levels are still in use
+// =================================================================
+
+bool ContentWatcher::load(string& error) {
+    string enemyError;
+    reload("enemies.txt", enemyError);
+    if (!reload("levels.txt", error)) return false;
+    if (!enemyError.empty()) {
+        error = enemyError;
+        return false;
+    }
+    return publish(error);
+}
+
+// =================================================================
+// Reparses one content file and keeps the result if it is valid
+//
+// @param file The name of the file in the content directory
+// @param error Receives the reason when it is not valid
+// @return false if the file is missing or malformed
+// =================================================================
+
+bool ContentWatcher::reload(const string& file, string& error) {
+    ifstream in(directory + "/" + file);
+    if (!in) {
+        error = file + ": cannot open";
+        return false;
+    }
+    bool ok;
+    if (file == "enemies.txt") {
+        vector<Enemy> parsed;
+        ok = parseEnemies(in, parsed, error);
+        if (ok) enemies = move(parsed);
+        enemiesOk = enemiesOk || ok;
+    } else {
+        vector<LevelSpec> parsed;
+        ok = parseLevels(in, parsed, error);
+        if (ok) levels = move(parsed);
+        levelsOk = levelsOk || ok;
+    }
+    if (!ok) error = file + ": " + error;
+    return ok;
+}
+
+// =================================================================
+// Builds a catalog from the last good parse of both files and makes
+// it the current one
+//
+// @param error Receives the reason when they do not fit together
+// @return false if the current catalog was kept
+// =================================================================
+
+bool ContentWatcher::publish(string& error) {
+    if (!enemiesOk || !levelsOk) {
+        error = "waiting for both content files";
+        return false;
+    }
+    shared_ptr<const LevelCatalog> built = buildCatalog(levels, enemies, error);
+    if (!built) return false;
+    catalog.store(move(built), memory_order_release);
+    version.fetch_add(1, memory_order_release);
+    METRICS_COUNT("content.reloads", 1);
+    return true;
+}
+
+// =================================================================
+// Starts watching the content directory
+//
+// @return false if the directory cannot be watched
+// =================================================================
+
+bool ContentWatcher::start() {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) return false;
+    // Editors often save by renaming a new file over the old one,
+    // so the directory is watched rather than the files
+    if (inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+        return false;
+    }
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    watcher = thread([this]() { watch(); });
+    return true;
+}
+
+// =================================================================
+// Sets the function told about every reload. It runs on the
+// watcher thread; call before start().
+//
+// @param onReload Receives whether the reload worked and why not
+// =================================================================
+
+void ContentWatcher::setListener(Listener onReload) {
+    listener = onReload;
+}
+
+// =================================================================
+// Returns the current catalog. Safe from any thread.
+// =================================================================
+
+shared_ptr<const LevelCatalog> ContentWatcher::current() const {
+    return catalog.load(memory_order_acquire);
+}
+
+// =================================================================
+// Returns the number of catalogs published so far. A reader that
+// sees a new generation finds at least that catalog in current().
+// =================================================================
+
+uint64_t ContentWatcher::generation() const {
+    return version.load(memory_order_acquire);
+}
+
+// =================================================================
+// The watcher thread: waits for the content files to be written
+// and reloads the ones that were
+// =================================================================
+
+void ContentWatcher::watch() {
+    TRACE_THREAD("content");
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents & POLLIN) return;
+
+        // One save can raise several events; each file is parsed once
+        set<string> changed;
+        ssize_t got;
+        while ((got = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + got; ) {
+                inotify_event* event = reinterpret_cast<inotify_event*>(p);
+                if (event->len > 0) {
+                    string name = event->name;
+                    if (name == "enemies.txt" || name == "levels.txt") changed.insert(name);
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        for (const string& file : changed) {
+            TRACE_SPAN("content", "reload");
+            string error;
+            bool ok = reload(file, error) && publish(error);
+            if (listener) listener(ok, ok ? "reloaded " + file : error);
+        }
+    }
+}
+
+#endif
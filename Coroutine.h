@@ -0,0 +1,389 @@
+// =================================================================
+//
+// File: Coroutine.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the Task,
+// Executor and Channel classes used to write scenes and battles as
+// C++20 coroutines.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "EventLoop.h"
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Resumes the coroutine that awaited a finished task, or returns to
+// whoever resumed it when nobody did
+// =================================================================
+
+struct TaskFinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+        coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+// =================================================================
+// Part of the promise shared by every Task
+// =================================================================
+
+struct TaskPromiseBase {
+    coroutine_handle<> continuation;
+
+    suspend_always initial_suspend() noexcept { return {}; }
+    TaskFinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { terminate(); }
+};
+
+// =================================================================
+// Contains the definition of the Task class
+// A coroutine that starts suspended and produces one value. Awaiting
+// a task runs it and resumes the awaiting coroutine when it finishes,
+// without going through the executor. The frame is owned by the Task
+// and freed with it.
+// =================================================================
+
+template <typename T>
+class Task {
+public:
+    struct promise_type : TaskPromiseBase {
+        T value{};
+
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T result) { value = move(result); }
+    };
+
+private:
+    coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    bool done() const { return !handle || handle.done(); }
+    coroutine_handle<> coroutine() const { return handle; }
+    T result() { return move(handle.promise().value); }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    T await_resume() { return result(); }
+};
+
+// =================================================================
+// A Task that produces no value
+// =================================================================
+
+template <>
+class Task<void> {
+public:
+    struct promise_type : TaskPromiseBase {
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+    };
+
+private:
+    coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(coroutine_handle<promise_type> h) : handle(h) {}
+    Task(Task&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    ~Task() { if (handle) handle.destroy(); }
+
+    bool done() const { return !handle || handle.done(); }
+    coroutine_handle<> coroutine() const { return handle; }
+    void result() {}
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> caller) noexcept {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    void await_resume() {}
+};
+
+// =================================================================
+// Contains the definition of the Executor class
+// Resumes coroutines from a ready queue on the thread that drives
+// it. When nothing is ready it sleeps on its event loop, where
+// timers and watched descriptors schedule the coroutines that wait
+// for them. Suspending costs a queue slot; the coroutine frame is
+// the only per-task memory.
+// =================================================================
+
+class Executor {
+private:
+    EventLoop& events;
+    deque<coroutine_handle<>> ready;
+    vector<Task<void>> spawned;
+    function<void()> idle;
+
+public:
+    // Awaitable returned by sleep()
+    struct Sleep {
+        Executor& executor;
+        int delayMs;
+
+        bool await_ready() const noexcept { return delayMs <= 0; }
+        void await_suspend(coroutine_handle<> handle);
+        void await_resume() noexcept {}
+    };
+
+    Executor(EventLoop& eventLoop);
+
+    EventLoop& loop();
+    void schedule(coroutine_handle<> handle);
+    bool runReady();
+    bool hasReady() const;
+    void setIdle(function<void()> wait);
+    void waitIdle();
+    Sleep sleep(int delayMs);
+
+    void spawn(Task<void> task);
+    size_t running() const;
+    void runAll();
+
+    template <typename T>
+    T run(Task<T> task);
+};
+
+// =================================================================
+// Constructor
+//
+// @param eventLoop The loop the executor sleeps on
+// =================================================================
+
+Executor::Executor(EventLoop& eventLoop) : events(eventLoop) {}
+
+// =================================================================
+// Returns the event loop of the executor
+// =================================================================
+
+EventLoop& Executor::loop() {
+    return events;
+}
+
+// =================================================================
+// Queues a suspended coroutine to be resumed. Executor thread only;
+// other threads go through loop().post().
+//
+// @param handle The coroutine
+// =================================================================
+
+void Executor::schedule(coroutine_handle<> handle) {
+    ready.push_back(handle);
+}
+
+// =================================================================
+// Resumes every coroutine that is ready, including the ones they
+// make ready
+//
+// @return false if nothing was ready
+// =================================================================
+
+bool Executor::runReady() {
+    if (ready.empty()) return false;
+    while (!ready.empty()) {
+        coroutine_handle<> handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+    }
+    return true;
+}
+
+// =================================================================
+// Checks if a coroutine is waiting to be resumed
+// =================================================================
+
+bool Executor::hasReady() const {
+    return !ready.empty();
+}
+
+// =================================================================
+// Sets what the executor does when nothing is ready. By default it
+// sleeps on the event loop until a coroutine is scheduled.
+//
+// @param wait Blocks until a coroutine may have been scheduled
+// =================================================================
+
+void Executor::setIdle(function<void()> wait) {
+    idle = wait;
+}
+
+// =================================================================
+// Blocks until a coroutine may have been scheduled
+// =================================================================
+
+void Executor::waitIdle() {
+    if (idle) {
+        idle();
+    } else {
+        events.waitFor([this]() { return !ready.empty(); });
+    }
+}
+
+// =================================================================
+// Returns an awaitable that resumes after a delay
+//
+// @param delayMs The delay in milliseconds
+// =================================================================
+
+Executor::Sleep Executor::sleep(int delayMs) {
+    return { *this, delayMs };
+}
+
+// =================================================================
+// Suspends the awaiting coroutine until its timer fires
+//
+// @param handle The awaiting coroutine
+// =================================================================
+
+void Executor::Sleep::await_suspend(coroutine_handle<> handle) {
+    Executor* owner = &executor;
+    owner->events.addTimer(delayMs, 0, [owner, handle]() { owner->schedule(handle); });
+}
+
+// =================================================================
+// Starts a task that runs on its own. The executor keeps it until
+// it finishes.
+//
+// @param task The task
+// =================================================================
+
+void Executor::spawn(Task<void> task) {
+    schedule(task.coroutine());
+    spawned.push_back(move(task));
+}
+
+// =================================================================
+// Returns the number of spawned tasks that have not finished
+// =================================================================
+
+size_t Executor::running() const {
+    size_t count = 0;
+    for (const Task<void>& task : spawned) {
+        if (!task.done()) ++count;
+    }
+    return count;
+}
+
+// =================================================================
+// Runs until every spawned task has finished, then frees them
+// =================================================================
+
+void Executor::runAll() {
+    while (running() > 0) {
+        if (!runReady()) waitIdle();
+    }
+    spawned.clear();
+}
+
+// =================================================================
+// Runs a task to completion on this executor. Other coroutines keep
+// running meanwhile. May be called from inside a coroutine of the
+// same executor to run a nested flow.
+//
+// @param task The task
+// @return The value produced by the task
+// =================================================================
+
+template <typename T>
+T Executor::run(Task<T> task) {
+    schedule(task.coroutine());
+    while (!task.done()) {
+        if (!runReady()) waitIdle();
+    }
+    return task.result();
+}
+
+// =================================================================
+// Contains the definition of the Channel class
+// A bounded queue between producers on the executor thread and one
+// consumer coroutine. Receiving suspends while the channel is empty
+// and sending resumes the consumer through the executor. Values are
+// stored inline, so a channel never allocates.
+// =================================================================
+
+template <typename T, size_t Capacity = 8>
+class Channel {
+private:
+    Executor& executor;
+    T items[Capacity];
+    size_t head, count;
+    coroutine_handle<> waiter;
+
+public:
+    // Awaitable returned by receive()
+    struct Receive {
+        Channel& channel;
+
+        bool await_ready() const noexcept { return channel.count > 0; }
+        void await_suspend(coroutine_handle<> handle) noexcept { channel.waiter = handle; }
+        T await_resume() { return channel.take(); }
+    };
+
+    Channel(Executor& owner) : executor(owner), head(0), count(0) {}
+
+    bool send(const T& item);
+    Receive receive() { return { *this }; }
+    T take();
+    bool empty() const { return count == 0; }
+    bool full() const { return count == Capacity; }
+    bool hasWaiter() const { return bool(waiter); }
+};
+
+// =================================================================
+// Sends a value and wakes the consumer if it is waiting
+//
+// @param item The value
+// @return false if the channel is full
+// =================================================================
+
+template <typename T, size_t Capacity>
+bool Channel<T, Capacity>::send(const T& item) {
+    if (count == Capacity) return false;
+    items[(head + count) % Capacity] = item;
+    ++count;
+    if (waiter) {
+        executor.schedule(waiter);
+        waiter = nullptr;
+    }
+    return true;
+}
+
+// =================================================================
+// Removes the oldest value. The channel must not be empty.
+// =================================================================
+
+template <typename T, size_t Capacity>
+T Channel<T, Capacity>::take() {
+    T item = items[head];
+    head = (head + 1) % Capacity;
+    --count;
+    return item;
+}
+
+#endif
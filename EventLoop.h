@@ -0,0 +1,382 @@
+// =================================================================
+//
+// File: EventLoop.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// EventLoop class, which multiplexes terminal input, timers and
+// internal events.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include "Clock.h"
+#include "RenderBackend.h"
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the EventLoop class
+// The loop sleeps in poll() on three descriptors: the input of the
+// render backend, a timerfd armed for the earliest timer and an
+// eventfd used to wake it up when an internal event is posted.
+// Other descriptors can be watched as well, such as the eventfd of
+// another thread. Nothing runs while the game is idle.
+// =================================================================
+
+class EventLoop {
+public:
+    typedef function<void()> Callback;
+    typedef function<bool(int key)> KeyHandler;
+
+private:
+    struct Timer {
+        int id;
+        int64_t interval; // nanoseconds, 0 for one-shot timers
+        Callback callback;
+    };
+
+    int timerFd, wakeFd;
+    int nextTimerId;
+    bool stopped;
+    RenderBackend* input;
+    KeyHandler keyHandler;
+    multimap<int64_t, Timer> timers;                       // by deadline
+    unordered_map<int, multimap<int64_t, Timer>::iterator> timerIndex;
+    vector<Callback> posted;
+    mutex postedMutex;
+    vector<pair<int, Callback>> watches;                   // descriptor, callback
+
+    void armTimer();
+    void fireTimers();
+    void runPosted();
+    void readInput();
+    void dispatch(bool withInput);
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    int addTimer(int delayMs, int intervalMs, Callback callback);
+    void cancelTimer(int id);
+    void post(Callback callback);
+    void addWatch(int fd, Callback onReadable);
+    void removeWatch(int fd);
+    void setInput(RenderBackend* backend);
+    void setKeyHandler(KeyHandler handler);
+    void run();
+    void stop();
+    int waitKey();
+    void waitFor(const function<bool()>& done);
+};
+
+// =================================================================
+// Constructor. Creates the timer and wake-up descriptors.
+// =================================================================
+
+EventLoop::EventLoop() : nextTimerId(1), stopped(false), input(nullptr) {
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+// =================================================================
+// Destructor. Closes the descriptors.
+// =================================================================
+
+EventLoop::~EventLoop() {
+    if (timerFd >= 0) close(timerFd);
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+// =================================================================
+// Adds a timer
+//
+// @param delayMs Milliseconds until the first expiration
+// @param intervalMs Milliseconds between expirations, 0 to fire once
+// @param callback Function called on every expiration
+// @return The id used to cancel the timer
+// =================================================================
+
+int EventLoop::addTimer(int delayMs, int intervalMs, Callback callback) {
+    int id = nextTimerId++;
+    int64_t deadline = monotonicNow() + int64_t(delayMs) * 1000000LL;
+    auto it = timers.insert({ deadline, Timer{ id, int64_t(intervalMs) * 1000000LL, callback } });
+    timerIndex[id] = it;
+    armTimer();
+    return id;
+}
+
+// =================================================================
+// Cancels a timer. Unknown ids are ignored.
+//
+// @param id The id returned by addTimer()
+// =================================================================
+
+void EventLoop::cancelTimer(int id) {
+    auto found = timerIndex.find(id);
+    if (found == timerIndex.end()) return;
+    timers.erase(found->second);
+    timerIndex.erase(found);
+    armTimer();
+}
+
+// =================================================================
+// Posts an internal event. The callback runs on the loop thread the
+// next time the loop wakes up; this is the only method that may be
+// called from another thread.
+//
+// @param callback Function to run on the loop thread
+// =================================================================
+
+void EventLoop::post(Callback callback) {
+    {
+        lock_guard<mutex> lock(postedMutex);
+        posted.push_back(callback);
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+// =================================================================
+// Watches a descriptor. The callback runs on the loop whenever the
+// descriptor is readable and must consume what made it readable.
+//
+// @param fd The descriptor
+// @param onReadable Called when the descriptor is readable
+// =================================================================
+
+void EventLoop::addWatch(int fd, Callback onReadable) {
+    watches.push_back({ fd, onReadable });
+}
+
+// =================================================================
+// Stops watching a descriptor
+//
+// @param fd The descriptor
+// =================================================================
+
+void EventLoop::removeWatch(int fd) {
+    for (size_t i = 0; i < watches.size(); ++i) {
+        if (watches[i].first == fd) {
+            watches.erase(watches.begin() + i);
+            return;
+        }
+    }
+}
+
+// =================================================================
+// Sets the backend whose keys are dispatched by the loop
+//
+// @param backend The render backend, or nullptr for no input
+// =================================================================
+
+void EventLoop::setInput(RenderBackend* backend) {
+    input = backend;
+}
+
+// =================================================================
+// Sets the handler that receives key presses while run() is active
+//
+// @param handler Returns true when the key was the last one it needs
+// =================================================================
+
+void EventLoop::setKeyHandler(KeyHandler handler) {
+    keyHandler = handler;
+}
+
+// =================================================================
+// Stops run() after the current dispatch
+// =================================================================
+
+void EventLoop::stop() {
+    stopped = true;
+}
+
+// =================================================================
+// Arms the timerfd for the earliest deadline, or disarms it
+// =================================================================
+
+void EventLoop::armTimer() {
+    itimerspec spec = {};
+    if (!timers.empty()) {
+        int64_t deadline = timers.begin()->first;
+        spec.it_value.tv_sec = deadline / 1000000000LL;
+        spec.it_value.tv_nsec = deadline % 1000000000LL;
+        // A zero value disarms the timer, so expired deadlines are
+        // pushed to the next nanosecond instead
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+// =================================================================
+// Runs every timer whose deadline has passed and reschedules the
+// periodic ones. Periodic timers that fell behind skip the missed
+// expirations instead of firing in a burst.
+// =================================================================
+
+void EventLoop::fireTimers() {
+    uint64_t expirations;
+    ssize_t got = read(timerFd, &expirations, sizeof(expirations));
+    (void)got;
+
+    int64_t current = monotonicNow();
+    while (!timers.empty() && timers.begin()->first <= current) {
+        auto it = timers.begin();
+        Timer timer = it->second;
+        int64_t deadline = it->first;
+        timers.erase(it);
+        timerIndex.erase(timer.id);
+
+        if (timer.interval > 0) {
+            int64_t next = deadline + timer.interval;
+            if (next <= current) {
+                next = current + timer.interval - (current - deadline) % timer.interval;
+            }
+            timerIndex[timer.id] = timers.insert({ next, timer });
+        }
+        timer.callback();
+    }
+    armTimer();
+}
+
+// =================================================================
+// Runs the internal events posted since the last wake-up
+// =================================================================
+
+void EventLoop::runPosted() {
+    uint64_t count;
+    ssize_t got = read(wakeFd, &count, sizeof(count));
+    (void)got;
+
+    vector<Callback> pending;
+    {
+        lock_guard<mutex> lock(postedMutex);
+        pending.swap(posted);
+    }
+    for (Callback& callback : pending) {
+        callback();
+    }
+}
+
+// =================================================================
+// Drains every key the backend has available and dispatches them to
+// the key handler. Backends never block in readKey().
+// =================================================================
+
+void EventLoop::readInput() {
+    if (!input) return;
+    int key;
+    while (!stopped && (key = input->readKey()) != ERR) {
+        if (keyHandler && keyHandler(key)) {
+            stopped = true;
+        }
+    }
+}
+
+// =================================================================
+// Dispatches input, timers and internal events until stop() is
+// called or the key handler returns true
+// =================================================================
+
+void EventLoop::run() {
+    stopped = false;
+    // Keys already buffered by ncurses do not show up in poll()
+    readInput();
+    while (!stopped) {
+        dispatch(true);
+    }
+}
+
+// =================================================================
+// Sleeps in poll() once and dispatches what woke it up
+//
+// @param withInput false to leave the keys in the backend
+// =================================================================
+
+void EventLoop::dispatch(bool withInput) {
+    // A negative descriptor is ignored by poll()
+    pollfd fds[16] = {
+        { withInput && input ? input->inputFd() : -1, POLLIN, 0 },
+        { timerFd, POLLIN, 0 },
+        { wakeFd, POLLIN, 0 }
+    };
+    int count = 3;
+    for (size_t i = 0; i < watches.size() && count < 16; ++i) {
+        fds[count++] = { watches[i].first, POLLIN, 0 };
+    }
+    int ready = poll(fds, count, -1);
+    if (ready < 0) {
+        // SIGWINCH interrupts poll(); ncurses reports it as KEY_RESIZE
+        if (errno == EINTR && withInput) readInput();
+        return;
+    }
+    if (fds[2].revents & POLLIN) runPosted();
+    if (!stopped && (fds[1].revents & POLLIN)) fireTimers();
+    for (int i = 3; i < count; ++i) {
+        if (!(fds[i].revents & POLLIN)) continue;
+        // A callback may remove watches; look the descriptor up again
+        for (size_t w = 0; w < watches.size(); ++w) {
+            if (watches[w].first == fds[i].fd) {
+                Callback callback = watches[w].second;
+                callback();
+                break;
+            }
+        }
+    }
+    if (withInput && !stopped && (fds[0].revents & POLLIN)) readInput();
+}
+
+// =================================================================
+// Runs the loop until a key is pressed. Timers and internal events
+// keep being dispatched while waiting.
+//
+// @return The key pressed by the user
+// =================================================================
+
+int EventLoop::waitKey() {
+    KeyHandler previous = keyHandler;
+    int pressed = ERR;
+    keyHandler = [&pressed](int key) {
+        pressed = key;
+        return true;
+    };
+    run();
+    keyHandler = previous;
+    return pressed;
+}
+
+// =================================================================
+// Runs the loop until a condition holds. Keys are left in the
+// backend for the next waitKey(); timers, internal events and
+// watched descriptors keep being dispatched.
+//
+// @param done Checked before sleeping and after every dispatch
+// =================================================================
+
+void EventLoop::waitFor(const function<bool()>& done) {
+    stopped = false;
+    while (!done()) {
+        dispatch(false);
+    }
+}
+
+#endif
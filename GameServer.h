@@ -0,0 +1,671 @@
+// =================================================================
+//
+// File: GameServer.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// GameServer class, which hosts many game sessions in one process
+// and serves them over a Unix domain socket.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef GAMESERVER_H
+#define GAMESERVER_H
+
+#include "BattleSim.h"
+#include "Character.h"
+#include "Coroutine.h"
+#include "EventLoop.h"
+#include "ContentWatcher.h"
+#include "History.h"
+#include "LevelCatalog.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Protocol.h"
+#include "RosterIndex.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+static_assert(uint8_t(WireEvent::Rewound) == uint8_t(CombatEvent::Type::Rewound), "WireEvent must follow CombatEvent::Type");
+static_assert(uint8_t(BattleCommand::Exit) == 3 && uint8_t(BattleCommand::Rewind) == 4, "Command bytes must follow BattleCommand");
+
+// =================================================================
+// Contains the definition of the GameServer class
+// The level definitions are shared read-only by every session and
+// may be swapped by the ContentWatcher at any time; a battle keeps
+// the catalog it started with. Each session owns its heroes, the
+// enemy it is fighting and its battle coroutine. An acceptor thread
+// hands connections out to a pool of workers, one per core. A worker multiplexes its
+// sessions with epoll and runs their battles on its own executor, so
+// a session is only ever touched by one thread and nothing on the
+// hot path takes a lock. Replies are buffered per session and
+// written once per wake-up. A wake-up reads at most MaxReadPerWake
+// bytes of a session, so one client cannot hold its worker, and a
+// session whose replies pile up past MaxQueuedOutput, because its
+// client sends without reading, is disconnected. Battles are
+// numbered in the order they start and roll on the stream of their
+// number, so any of them can be replayed from the seed of the
+// server and its number.
+// =================================================================
+
+class GameServer {
+public:
+    static const size_t MaxHeroes = 3; // the roster of the single-player game
+    static const size_t MaxReadPerWake = 64 * 1024;
+    static const size_t MaxQueuedOutput = 256 * 1024;
+
+private:
+    struct Session {
+        int fd;
+        vector<uint8_t> input, output;
+        size_t outputSent;
+        bool writing;                            // waiting for EPOLLOUT
+        vector<unique_ptr<Character>> heroes;
+        vector<bool> won;
+        shared_ptr<const LevelCatalog> catalog;  // of the running battle
+        unique_ptr<Enemy> enemy;
+        Channel<BattleCommand> commands;
+        unique_ptr<Task<bool>> battle;           // destroyed before the channel
+        size_t hero, level;
+        BattleTally tally;                       // of the running battle
+
+        Session(int socket, Executor& executor);
+    };
+
+    struct Worker {
+        int epollFd, wakeFd;
+        mutex pendingMutex;
+        vector<int> pending;                     // accepted, not yet adopted
+        EventLoop loop;
+        Executor executor;
+        unordered_map<int, unique_ptr<Session>> sessions;
+        thread runner;
+
+        Worker();
+        ~Worker();
+    };
+
+    ContentWatcher& content;
+    string socketPath;
+    int listenFd, stopFd;
+    atomic<bool> stopping;
+    atomic<size_t> sessionTotal;
+    uint64_t seed;                               // of the combat rolls
+    atomic<uint64_t> battleTotal;
+    mutex historyMutex;
+    HistoryWriter* history;                      // shared by the workers
+    vector<unique_ptr<Worker>> workers;
+
+    void serve(Worker& worker);
+    void adopt(Worker& worker);
+    bool receive(Worker& worker, Session& session);
+    bool handle(Worker& worker, Session& session, MessageType type, MessageReader& payload);
+    void startBattle(Worker& worker, Session& session, size_t hero, size_t level);
+    void finishBattle(Session& session);
+    void recordBattle(Session& session, BattleOutcome outcome);
+    bool flush(Worker& worker, Session& session);
+    void closeSession(Worker& worker, int fd);
+    void sendError(Session& session, ProtocolError error);
+    static void sendEvent(Session& session, const CombatEvent& event);
+
+public:
+    GameServer(ContentWatcher& levels, uint64_t rollSeed = 0);
+    ~GameServer();
+
+    void recordTo(HistoryWriter* writer);
+    bool listen(const string& path, int threads);
+    void run();
+    void stop();
+    size_t sessionCount() const;
+};
+
+// =================================================================
+// Session constructor
+//
+// @param socket The connection
+// @param executor The executor of the worker that owns the session
+// =================================================================
+
+GameServer::Session::Session(int socket, Executor& executor)
+    : fd(socket), outputSent(0), writing(false), commands(executor), hero(0), level(0) {}
+
+// =================================================================
+// Worker constructor. Creates the epoll instance and the eventfd
+// that announces new connections.
+// =================================================================
+
+GameServer::Worker::Worker() : executor(loop) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+// =================================================================
+// Worker destructor. Closes the sessions and the descriptors.
+// =================================================================
+
+GameServer::Worker::~Worker() {
+    for (auto& entry : sessions) {
+        close(entry.first);
+    }
+    sessions.clear();
+    for (int fd : pending) {
+        close(fd);
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+// =================================================================
+// Constructor
+//
+// @param levels The source of the level definitions
+// @param rollSeed The seed of the combat rolls
+// =================================================================
+
+GameServer::GameServer(ContentWatcher& levels, uint64_t rollSeed)
+    : content(levels), listenFd(-1), stopping(false), sessionTotal(0), seed(rollSeed), battleTotal(0),
+      history(nullptr) {
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+// =================================================================
+// Destructor. Stops the workers, closes their sessions and removes
+// the socket file.
+// =================================================================
+
+GameServer::~GameServer() {
+    stopping.store(true, memory_order_release);
+    for (auto& worker : workers) {
+        uint64_t one = 1;
+        ssize_t written = write(worker->wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    for (auto& worker : workers) {
+        if (worker->runner.joinable()) worker->runner.join();
+        // Battles still running are recorded as left
+        vector<int> open;
+        for (auto& entry : worker->sessions) {
+            open.push_back(entry.first);
+        }
+        for (int fd : open) {
+            closeSession(*worker, fd);
+        }
+    }
+    workers.clear();
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+    close(stopFd);
+}
+
+// =================================================================
+// Records every battle that ends in a battle history. A battle
+// adds its row under a lock; the rows of a chunk are written by
+// whichever worker fills it.
+//
+// @param writer The open history, kept by the caller until the
+// server is destroyed; nullptr to stop recording
+// =================================================================
+
+void GameServer::recordTo(HistoryWriter* writer) {
+    lock_guard<mutex> lock(historyMutex);
+    history = writer;
+}
+
+// =================================================================
+// Binds the socket and starts the workers
+//
+// @param path The path of the Unix socket
+// @param threads The number of workers, 0 for one per core
+// @return false if the socket could not be bound
+// =================================================================
+
+bool GameServer::listen(const string& path, int threads) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return false;
+    strcpy(address.sun_path, path.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) return false;
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(listenFd, 512) < 0) {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+
+    if (threads <= 0) threads = max(1u, thread::hardware_concurrency());
+    for (int i = 0; i < threads; ++i) {
+        workers.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        Worker* owner = workers[i].get();
+        owner->runner = thread([this, owner, i]() {
+            TRACE_THREAD("worker " + to_string(i));
+            serve(*owner);
+        });
+    }
+    return true;
+}
+
+// =================================================================
+// Accepts connections until stop() is called. Connections are dealt
+// to the workers in turn.
+// =================================================================
+
+void GameServer::run() {
+    size_t next = 0;
+    while (!stopping.load(memory_order_acquire)) {
+        pollfd fds[2] = { { listenFd, POLLIN, 0 }, { stopFd, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) continue;
+        if (fds[1].revents & POLLIN) break;
+
+        int fd;
+        while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            Worker& worker = *workers[next];
+            next = (next + 1) % workers.size();
+            {
+                lock_guard<mutex> lock(worker.pendingMutex);
+                worker.pending.push_back(fd);
+            }
+            uint64_t one = 1;
+            ssize_t written = write(worker.wakeFd, &one, sizeof(one));
+            (void)written;
+        }
+    }
+    stopping.store(true, memory_order_release);
+}
+
+// =================================================================
+// Makes run() return. Safe to call from a signal handler.
+// =================================================================
+
+void GameServer::stop() {
+    uint64_t one = 1;
+    ssize_t written = write(stopFd, &one, sizeof(one));
+    (void)written;
+}
+
+// =================================================================
+// Returns the number of open sessions
+// =================================================================
+
+size_t GameServer::sessionCount() const {
+    return sessionTotal.load(memory_order_relaxed);
+}
+
+// =================================================================
+// The worker thread: waits on its sessions and serves whichever
+// became readable or writable
+//
+// @param worker The worker
+// =================================================================
+
+void GameServer::serve(Worker& worker) {
+    epoll_event events[64];
+    while (!stopping.load(memory_order_acquire)) {
+        int count = epoll_wait(worker.epollFd, events, 64, -1);
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == worker.wakeFd) {
+                adopt(worker);
+                continue;
+            }
+            auto found = worker.sessions.find(fd);
+            if (found == worker.sessions.end()) continue;
+            Session& session = *found->second;
+
+            bool open = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) open = receive(worker, session);
+            if (open) open = flush(worker, session);
+            if (!open) closeSession(worker, fd);
+        }
+    }
+}
+
+// =================================================================
+// Takes the connections handed over by the acceptor and greets them
+//
+// @param worker The worker
+// =================================================================
+
+void GameServer::adopt(Worker& worker) {
+    uint64_t count;
+    ssize_t got = read(worker.wakeFd, &count, sizeof(count));
+    (void)got;
+
+    vector<int> accepted;
+    {
+        lock_guard<mutex> lock(worker.pendingMutex);
+        accepted.swap(worker.pending);
+    }
+    shared_ptr<const LevelCatalog> catalog = content.current();
+    for (int fd : accepted) {
+        unique_ptr<Session> session = make_unique<Session>(fd, worker.executor);
+        MessageWriter welcome(session->output, MessageType::Welcome);
+        welcome.putU16(uint16_t(catalog->size()));
+        welcome.putU16(uint16_t(workers.size()));
+        welcome.finish();
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(worker.epollFd, EPOLL_CTL_ADD, fd, &event);
+        Session& added = *(worker.sessions[fd] = move(session));
+        sessionTotal.fetch_add(1, memory_order_relaxed);
+        METRICS_GAUGE_ADD("server.sessions", 1);
+        if (!flush(worker, added)) closeSession(worker, fd);
+    }
+}
+
+// =================================================================
+// Reads what the client sent, up to MaxReadPerWake bytes, and
+// handles every complete message. What is left to read wakes the
+// worker again.
+//
+// @param worker The worker that owns the session
+// @param session The session
+// @return false if the session must be closed
+// =================================================================
+
+bool GameServer::receive(Worker& worker, Session& session) {
+    uint8_t chunk[4096];
+    size_t received = 0;
+    while (received < MaxReadPerWake) {
+        ssize_t got = recv(session.fd, chunk, sizeof(chunk), 0);
+        if (got > 0) {
+            session.input.insert(session.input.end(), chunk, chunk + got);
+            received += got;
+            continue;
+        }
+        if (got == 0) return false;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+
+    size_t offset = 0, payload, length;
+    MessageType type;
+    while (nextFrame(session.input, offset, type, payload, length)) {
+        if (length > MaxPayloadSize) return false;
+        MessageReader reader(session.input.data() + payload, length);
+        if (!handle(worker, session, type, reader)) return false;
+        if (session.output.size() - session.outputSent > MaxQueuedOutput) return false;
+    }
+    if (frameTooLarge(session.input, offset)) return false;
+    session.input.erase(session.input.begin(), session.input.begin() + offset);
+    return true;
+}
+
+// =================================================================
+// Handles one message of a client
+//
+// @param worker The worker that owns the session
+// @param session The session
+// @param type The type of the message
+// @param payload The payload of the message
+// @return false if the message was not understood
+// =================================================================
+
+bool GameServer::handle(Worker& worker, Session& session, MessageType type, MessageReader& payload) {
+    switch (type) {
+        case MessageType::CreateHero: {
+            uint8_t kind = payload.getU8();
+            string name = payload.getString();
+            if (!payload.ok() || kind > 2 || name.empty()) return false;
+            if (session.heroes.size() >= MaxHeroes) {
+                sendError(session, ProtocolError::RosterFull);
+                return true;
+            }
+            if (kind == 0) session.heroes.emplace_back(new Warrior(name));
+            else if (kind == 1) session.heroes.emplace_back(new Archer(name));
+            else session.heroes.emplace_back(new Mage(name));
+            MessageWriter reply(session.output, MessageType::HeroCreated);
+            reply.putU16(uint16_t(session.heroes.size() - 1));
+            reply.finish();
+            return true;
+        }
+        case MessageType::ListLevels: {
+            size_t first = payload.getU16();
+            if (!payload.ok()) return false;
+            shared_ptr<const LevelCatalog> catalog = content.current();
+            first = min(first, catalog->size());
+            // As many levels as fit in one frame
+            size_t count = 0, bytes = 6;
+            for (size_t i = first; i < catalog->size(); ++i, ++count) {
+                const LevelDef& def = catalog->at(i);
+                bytes += 5 + min(def.name.size(), MaxListedName) + min(def.enemy.getName().size(), MaxListedName);
+                if (bytes > MaxPayloadSize) break;
+            }
+            MessageWriter reply(session.output, MessageType::LevelList);
+            reply.putU16(uint16_t(catalog->size()));
+            reply.putU16(uint16_t(first));
+            reply.putU16(uint16_t(count));
+            for (size_t i = first; i < first + count; ++i) {
+                const LevelDef& def = catalog->at(i);
+                reply.putString(def.name, MaxListedName);
+                reply.putString(def.enemy.getName(), MaxListedName);
+                reply.putU16(uint16_t(def.enemy.getHealth()));
+                reply.putU8(i < session.won.size() && session.won[i]);
+            }
+            reply.finish();
+            return true;
+        }
+        case MessageType::StartBattle: {
+            size_t hero = payload.getU16();
+            size_t level = payload.getU16();
+            if (!payload.ok()) return false;
+            startBattle(worker, session, hero, level);
+            return true;
+        }
+        case MessageType::Command: {
+            uint8_t command = payload.getU8();
+            if (!payload.ok() || command > uint8_t(BattleCommand::Rewind)) return false;
+            if (!session.battle) {
+                sendError(session, ProtocolError::NoBattle);
+            } else if (!session.commands.send(BattleCommand(command))) {
+                sendError(session, ProtocolError::Busy);
+            } else {
+                METRICS_TIME("server.turn.ns");
+                TRACE_SPAN("server", "command");
+                worker.executor.runReady();
+                if (session.battle->done()) finishBattle(session);
+            }
+            return true;
+        }
+        case MessageType::ResetHeroes:
+            if (session.battle) {
+                sendError(session, ProtocolError::InBattle);
+            } else {
+                session.heroes.clear();
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// =================================================================
+// Starts a battle of the session on the current catalog. The enemy
+// is a copy of the shared definition; the battle runs until it
+// waits for the first command.
+//
+// @param worker The worker that owns the session
+// @param session The session
+// @param hero The index of the hero in the roster of the session
+// @param level The index of the level
+// =================================================================
+
+void GameServer::startBattle(Worker& worker, Session& session, size_t hero, size_t level) {
+    if (session.battle) return sendError(session, ProtocolError::InBattle);
+    if (hero >= session.heroes.size()) return sendError(session, ProtocolError::NoSuchHero);
+    if (!session.heroes[hero]->isAlive()) return sendError(session, ProtocolError::HeroDead);
+    shared_ptr<const LevelCatalog> catalog = content.current();
+    if (level >= catalog->size()) return sendError(session, ProtocolError::NoSuchLevel);
+
+    session.catalog = catalog;
+    session.hero = hero;
+    session.level = level;
+    session.enemy = make_unique<Enemy>(catalog->at(level).enemy);
+    session.tally = BattleTally();
+    Session* owner = &session;
+    RandomStream rolls(seed, battleTotal.fetch_add(1, memory_order_relaxed));
+    session.battle = make_unique<Task<bool>>(battleFlow(session.heroes[hero].get(), session.enemy.get(), rolls, session.commands,
+        [owner](const CombatEvent& event) { sendEvent(*owner, event); }));
+    worker.executor.schedule(session.battle->coroutine());
+    worker.executor.runReady();
+}
+
+// =================================================================
+// Records the outcome of a finished battle and frees its state
+//
+// @param session The session
+// =================================================================
+
+void GameServer::finishBattle(Session& session) {
+    BattleOutcome outcome = session.battle->result() ? BattleOutcome::Won
+                            : session.heroes[session.hero]->isAlive() ? BattleOutcome::Left : BattleOutcome::Lost;
+    recordBattle(session, outcome);
+    if (session.battle->result()) {
+        if (session.won.size() <= session.level) session.won.resize(session.level + 1, false);
+        session.won[session.level] = true;
+        session.heroes[session.hero]->pickUp(session.catalog->at(session.level).reward);
+        session.heroes[session.hero]->gainXp(session.enemy->getXpValue());
+    }
+    session.battle.reset();
+    session.enemy.reset();
+    session.catalog.reset();
+}
+
+// =================================================================
+// Adds the running battle of a session to the battle history
+//
+// @param session The session
+// @param outcome How the battle ended
+// =================================================================
+
+void GameServer::recordBattle(Session& session, BattleOutcome outcome) {
+    const Character* hero = session.heroes[session.hero].get();
+    BattleRow row = session.tally.toRow(RosterIndex::classOf(hero), hero, session.enemy.get(), outcome);
+    // recordTo() may change the history from another thread
+    lock_guard<mutex> lock(historyMutex);
+    if (history) history->append(row);
+}
+
+// =================================================================
+// Writes the buffered replies of a session. What the socket does
+// not take waits for EPOLLOUT.
+//
+// @param worker The worker that owns the session
+// @param session The session
+// @return false if the session must be closed
+// =================================================================
+
+bool GameServer::flush(Worker& worker, Session& session) {
+    while (session.outputSent < session.output.size()) {
+        ssize_t sent = send(session.fd, session.output.data() + session.outputSent,
+                            session.output.size() - session.outputSent, MSG_NOSIGNAL);
+        if (sent > 0) {
+            session.outputSent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return false;
+    }
+
+    bool pending = session.outputSent < session.output.size();
+    if (!pending) {
+        session.output.clear();
+        session.outputSent = 0;
+    }
+    if (pending != session.writing) {
+        epoll_event event = {};
+        event.events = pending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = session.fd;
+        epoll_ctl(worker.epollFd, EPOLL_CTL_MOD, session.fd, &event);
+        session.writing = pending;
+    }
+    return true;
+}
+
+// =================================================================
+// Closes a session and frees everything it owns. A battle the
+// client did not see to the end is recorded as left.
+//
+// @param worker The worker that owns the session
+// @param fd The connection of the session
+// =================================================================
+
+void GameServer::closeSession(Worker& worker, int fd) {
+    auto found = worker.sessions.find(fd);
+    if (found != worker.sessions.end() && found->second->battle && !found->second->battle->done()) {
+        recordBattle(*found->second, BattleOutcome::Left);
+    }
+    epoll_ctl(worker.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    worker.sessions.erase(fd);
+    sessionTotal.fetch_sub(1, memory_order_relaxed);
+    METRICS_GAUGE_ADD("server.sessions", -1);
+}
+
+// =================================================================
+// Queues an Error message
+//
+// @param session The session
+// @param error The error
+// =================================================================
+
+void GameServer::sendError(Session& session, ProtocolError error) {
+    MessageWriter reply(session.output, MessageType::Error);
+    reply.putU8(uint8_t(error));
+    reply.finish();
+}
+
+// =================================================================
+// Queues an Event message
+//
+// @param session The session
+// @param event The combat event, also counted in the battle's tally
+// =================================================================
+
+void GameServer::sendEvent(Session& session, const CombatEvent& event) {
+    session.tally.count(event);
+    MessageWriter reply(session.output, MessageType::Event);
+    reply.putU8(uint8_t(event.type));
+    reply.putU8(event.actor);
+    reply.putI16(event.amount);
+    reply.putI16(event.hero.health);
+    reply.putI16(event.hero.mana);
+    reply.putI16(event.enemy.health);
+    reply.putI16(event.enemy.mana);
+    reply.putU8((event.hero.alive ? 1 : 0) | (event.enemy.alive ? 2 : 0));
+    reply.finish();
+}
+
+#endif
@@ -0,0 +1,1218 @@
+// =================================================================
+//
+// File: History.h
+// Author: Alexis Berthou
+// Description: This file contains the battle history: a columnar
+// file every battle is appended to, the HistoryWriter that appends
+// to it, the HistoryFile that maps it for reading, and the queries
+// that scan it.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "Progression.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// One battle of the history
+// =================================================================
+
+enum class BattleOutcome : uint8_t {
+    Lost,
+    Won,
+    Left        // the player left before it ended
+};
+
+struct BattleRow {
+    int64_t timestamp = 0;      // seconds since the epoch
+    HeroClass heroClass = HeroClass::Any;
+    int heroLevel = 1;
+    string enemy;
+    int turns = 0;
+    int damageDealt = 0;        // by the hero
+    int damageTaken = 0;        // by the hero
+    BattleOutcome outcome = BattleOutcome::Left;
+};
+
+// =================================================================
+// The columns of the history, in the order they are stored. The
+// enemy column holds numbers into the enemy names of its chunk.
+// =================================================================
+
+enum class HistoryColumn : uint8_t {
+    Timestamp,
+    HeroClass,
+    HeroLevel,
+    Enemy,
+    Turns,
+    DamageDealt,
+    DamageTaken,
+    Outcome
+};
+
+const int HistoryColumnCount = 8;
+const char* const historyColumnNames[] = { "timestamp", "class", "level", "enemy", "turns", "dealt", "taken", "outcome" };
+
+// =================================================================
+// The history file is a header and a sequence of chunks of up to
+// HistoryChunkRows battles. A chunk is self-describing:
+//
+//   ChunkHeader          the size of the chunk and, for every
+//                        column, its zone: the smallest and largest
+//                        value of the chunk and where the column is
+//   enemy names          u8 length and name, in the order of their
+//                        numbers in the enemy column
+//   columns              one after the other
+//
+// A column stores every value minus the smallest one of its chunk
+// in the fewest whole bytes that hold the largest difference: 0
+// when every value is the same, then 1, 2, 4 or 8. Classes, levels,
+// outcomes and the few enemies of a chunk take a byte a battle or
+// nothing, turns and damage one or two, timestamps two or four.
+// The names and every column start on a multiple of 8 bytes, and so
+// does every chunk, so a mapped column is read in place.
+// =================================================================
+
+const uint32_t HistoryMagic = 'H' | 'S' << 8 | 'T' << 16 | '1' << 24;
+const uint32_t HistoryChunkMagic = 'H' | 'C' << 8 | 'K' << 16 | '1' << 24;
+const uint32_t HistoryChunkRows = 65536;
+const size_t MaxChunkEnemies = 65535;
+const size_t MaxEnemyName = 255;
+
+struct HistoryHeader {
+    uint32_t magic;
+    uint32_t chunkRows;
+};
+
+struct ColumnZone {
+    int64_t min, max;
+    uint32_t offset;            // from the start of the chunk
+    uint8_t width;              // bytes a value
+    uint8_t reserved[3];
+};
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t rows;
+    uint32_t bytes;             // of the whole chunk, this header included
+    uint16_t enemies;
+    uint16_t columns;
+    ColumnZone zones[HistoryColumnCount];
+};
+
+static_assert(sizeof(HistoryHeader) % 8 == 0 && sizeof(ChunkHeader) % 8 == 0, "History sections must stay 8-byte aligned");
+
+// =================================================================
+// The battles of the chunk still being filled are also kept in a
+// tail file next to the history, FILE.tail, one record a battle
+// appended as it is added, so a crash loses none of them. The tail
+// names the history file and its size when the chunk was started;
+// once the chunk is written the history has grown, and a tail that
+// no longer matches is dropped instead of being played again.
+//
+//   TailHeader           the history's inode and size
+//   TailRecord, name     for every battle, the name TailRecord
+//                        nameLength bytes long
+// =================================================================
+
+const uint32_t HistoryTailMagic = 'H' | 'T' << 8 | 'L' << 16 | '1' << 24;
+const uint8_t TailRecordMark = 0xB7;
+
+struct TailHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t inode;
+    uint64_t base;              // size of the history the tail follows
+};
+
+struct TailRecord {
+    int64_t timestamp;
+    int32_t heroLevel;
+    int32_t turns;
+    int32_t damageDealt;
+    int32_t damageTaken;
+    uint8_t heroClass;
+    uint8_t outcome;
+    uint8_t nameLength;
+    uint8_t mark;               // TailRecordMark, so a run of zeros is no battle
+    uint8_t reserved[4];
+};
+
+static_assert(sizeof(TailRecord) == 32, "Tail records must keep their size");
+
+// =================================================================
+// Rounds a size up to a multiple of 8
+//
+// @param size The size
+// =================================================================
+
+constexpr size_t alignHistory(size_t size) {
+    return (size + 7) & ~size_t(7);
+}
+
+// =================================================================
+// Returns the bytes a value needs to hold a difference
+//
+// @param span The largest difference of a column
+// =================================================================
+
+constexpr uint8_t widthForSpan(uint64_t span) {
+    return span == 0 ? 0 : span <= 0xFF ? 1 : span <= 0xFFFF ? 2 : span <= 0xFFFFFFFF ? 4 : 8;
+}
+
+// =================================================================
+// Stores the differences of a column from its smallest value
+//
+// @param values The values
+// @param base The smallest value
+// @param out Receives values.size() values of Stored
+// =================================================================
+
+template <typename Stored>
+void packColumn(const vector<int64_t>& values, int64_t base, uint8_t* out) {
+    Stored* stored = reinterpret_cast<Stored*>(out);
+    for (size_t i = 0; i < values.size(); ++i) {
+        stored[i] = Stored(uint64_t(values[i]) - uint64_t(base));
+    }
+}
+
+// =================================================================
+// Restores the values of a column. A plain loop over arrays: the
+// compiler widens and adds a vector of values at a time.
+//
+// @param data The stored differences
+// @param base The smallest value
+// @param out Receives the values
+// @param rows The number of values
+// =================================================================
+
+template <typename Stored, typename Value>
+void unpackColumn(const uint8_t* data, Value base, Value* out, uint32_t rows) {
+    typedef make_unsigned_t<Value> Unsigned;
+    const Stored* stored = reinterpret_cast<const Stored*>(data);
+    for (uint32_t i = 0; i < rows; ++i) {
+        out[i] = Value(Unsigned(base) + Unsigned(stored[i]));
+    }
+}
+
+// =================================================================
+// Writes a whole buffer to a file
+//
+// @param fd The file
+// @param data The buffer
+// @param size Its size
+// @return false if the file did not take all of it
+// =================================================================
+
+bool writeFully(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+// =================================================================
+// Contains the definition of the HistoryWriter class
+// Appends battles to a history file. Battles are kept a column at a
+// time until a chunk is full, then the chunk is packed and written
+// at the end of the file with one write. Until then every battle is
+// also appended to the tail file, which is played again when the
+// history is next opened. A chunk cut short by a crash is cut off
+// then, so the file always ends on a whole chunk.
+// =================================================================
+
+class HistoryWriter {
+private:
+    int fd;
+    int tailFd;                             // -1 when battles are not kept in a tail
+    string tailPath;
+    uint64_t inode;
+    vector<int64_t> columns[HistoryColumnCount];
+    vector<string> enemies;                 // of the chunk being filled
+    unordered_map<string, uint16_t> enemyIds;
+
+    vector<BattleRow> readTail(const TailHeader& expected);
+    void startTail();
+    void appendTail(const BattleRow& row, const string& name);
+
+public:
+    HistoryWriter();
+    HistoryWriter(const HistoryWriter&) = delete;
+    ~HistoryWriter();
+
+    bool open(const string& path, bool keepTail = true);
+    bool isOpen() const;
+    void append(const BattleRow& row);
+    size_t pending() const;
+    bool flush();
+    void close();
+};
+
+// =================================================================
+// Constructor. The writer starts closed and ignores battles.
+// =================================================================
+
+HistoryWriter::HistoryWriter() : fd(-1), tailFd(-1), inode(0) {}
+
+// =================================================================
+// Destructor. Writes the battles still waiting.
+// =================================================================
+
+HistoryWriter::~HistoryWriter() {
+    close();
+}
+
+// =================================================================
+// Opens a history file to append to, creating it if needed, and
+// adds again the battles its tail kept from the last run
+//
+// @param path The path of the file
+// @param keepTail false to keep the chunk being filled only in
+// memory, for bulk loads that close the writer when done
+// @return false if it cannot be opened or is not a history file
+// =================================================================
+
+bool HistoryWriter::open(const string& path, bool keepTail) {
+    close();
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) return false;
+
+    struct stat info;
+    fstat(file, &info);
+    off_t end = info.st_size;
+    HistoryHeader header = { HistoryMagic, HistoryChunkRows };
+    bool created = end < off_t(sizeof(header));
+    if (created) {
+        if (ftruncate(file, 0) != 0 || !writeFully(file, (const uint8_t*)&header, sizeof(header))) {
+            ::close(file);
+            return false;
+        }
+    } else {
+        if (pread(file, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || header.magic != HistoryMagic) {
+            ::close(file);
+            return false;
+        }
+        // Walk the chunks and cut off a torn one at the end
+        off_t at = sizeof(header);
+        uint32_t fields[3];     // magic, rows, bytes
+        while (at + off_t(sizeof(ChunkHeader)) <= end && pread(file, fields, sizeof(fields), at) == ssize_t(sizeof(fields)) &&
+               fields[0] == HistoryChunkMagic && fields[2] >= sizeof(ChunkHeader) && at + off_t(fields[2]) <= end) {
+            at += fields[2];
+        }
+        if (at != end && ftruncate(file, at) != 0) {
+            ::close(file);
+            return false;
+        }
+    }
+    off_t base = lseek(file, 0, SEEK_END);
+    fd = file;
+    inode = uint64_t(info.st_ino);
+
+    // The tail of a writer that did not close holds the battles it
+    // had not written yet. A new file has none, whatever a tail left
+    // from a removed one says.
+    tailPath = path + ".tail";
+    tailFd = ::open(tailPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    vector<BattleRow> kept;
+    if (tailFd >= 0) {
+        if (!created) kept = readTail({ HistoryTailMagic, 0, inode, uint64_t(base) });
+        startTail();
+    }
+    if (!keepTail && tailFd >= 0) {
+        ::close(tailFd);
+        unlink(tailPath.c_str());
+        tailFd = -1;
+    }
+    for (const BattleRow& row : kept) {
+        append(row);
+    }
+    return true;
+}
+
+// =================================================================
+// Reads the battles of a tail. A record cut short by a crash, or
+// never written, ends it.
+//
+// @param expected The header of a tail that follows the history
+// as it is now
+// @return The battles, none if the tail follows another file or
+// an older size of this one
+// =================================================================
+
+vector<BattleRow> HistoryWriter::readTail(const TailHeader& expected) {
+    vector<BattleRow> rows;
+    TailHeader header;
+    if (pread(tailFd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || header.magic != expected.magic ||
+        header.inode != expected.inode || header.base != expected.base) {
+        return rows;
+    }
+    off_t at = sizeof(header);
+    TailRecord record;
+    char name[MaxEnemyName];
+    while (pread(tailFd, &record, sizeof(record), at) == ssize_t(sizeof(record)) && record.mark == TailRecordMark &&
+           pread(tailFd, name, record.nameLength, at + sizeof(record)) == ssize_t(record.nameLength)) {
+        BattleRow row;
+        row.timestamp = record.timestamp;
+        row.heroClass = HeroClass(record.heroClass);
+        row.heroLevel = record.heroLevel;
+        row.enemy.assign(name, record.nameLength);
+        row.turns = record.turns;
+        row.damageDealt = record.damageDealt;
+        row.damageTaken = record.damageTaken;
+        row.outcome = BattleOutcome(record.outcome);
+        rows.push_back(row);
+        at += sizeof(record) + record.nameLength;
+    }
+    return rows;
+}
+
+// =================================================================
+// Empties the tail for a new chunk. The header is rewritten in
+// place before the records are cut off, so a crash in between
+// leaves records that no longer match the history.
+// =================================================================
+
+void HistoryWriter::startTail() {
+    if (tailFd < 0) return;
+    TailHeader header = { HistoryTailMagic, 0, inode, uint64_t(lseek(fd, 0, SEEK_END)) };
+    if (pwrite(tailFd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || ftruncate(tailFd, sizeof(header)) != 0) {
+        ::close(tailFd);
+        tailFd = -1;
+        return;
+    }
+    lseek(tailFd, 0, SEEK_END);
+}
+
+// =================================================================
+// Appends a battle to the tail with one write
+//
+// @param row The battle
+// @param name Its enemy, cut to MaxEnemyName
+// =================================================================
+
+void HistoryWriter::appendTail(const BattleRow& row, const string& name) {
+    if (tailFd < 0) return;
+    TailRecord record = {};
+    record.timestamp = row.timestamp;
+    record.heroLevel = row.heroLevel;
+    record.turns = row.turns;
+    record.damageDealt = row.damageDealt;
+    record.damageTaken = row.damageTaken;
+    record.heroClass = uint8_t(row.heroClass);
+    record.outcome = uint8_t(row.outcome);
+    record.nameLength = uint8_t(name.size());
+    record.mark = TailRecordMark;
+    uint8_t buffer[sizeof(record) + MaxEnemyName];
+    memcpy(buffer, &record, sizeof(record));
+    memcpy(buffer + sizeof(record), name.data(), name.size());
+    writeFully(tailFd, buffer, sizeof(record) + name.size());
+}
+
+// =================================================================
+// Returns true if a file is open
+// =================================================================
+
+bool HistoryWriter::isOpen() const {
+    return fd >= 0;
+}
+
+// =================================================================
+// Adds a battle. It reaches the tail now and the file with its
+// chunk.
+//
+// @param row The battle
+// =================================================================
+
+void HistoryWriter::append(const BattleRow& row) {
+    if (fd < 0) return;
+    string name = row.enemy.substr(0, MaxEnemyName);
+    auto found = enemyIds.find(name);
+    if (found == enemyIds.end()) {
+        if (enemies.size() == MaxChunkEnemies) flush();
+        found = enemyIds.emplace(name, uint16_t(enemies.size())).first;
+        enemies.push_back(name);
+    }
+    appendTail(row, name);
+    columns[int(HistoryColumn::Timestamp)].push_back(row.timestamp);
+    columns[int(HistoryColumn::HeroClass)].push_back(int64_t(row.heroClass));
+    columns[int(HistoryColumn::HeroLevel)].push_back(row.heroLevel);
+    columns[int(HistoryColumn::Enemy)].push_back(found->second);
+    columns[int(HistoryColumn::Turns)].push_back(clamp(row.turns, 0, 0xFFFF));
+    columns[int(HistoryColumn::DamageDealt)].push_back(row.damageDealt);
+    columns[int(HistoryColumn::DamageTaken)].push_back(row.damageTaken);
+    columns[int(HistoryColumn::Outcome)].push_back(int64_t(row.outcome));
+    if (pending() == HistoryChunkRows) flush();
+}
+
+// =================================================================
+// Returns the number of battles not written yet
+// =================================================================
+
+size_t HistoryWriter::pending() const {
+    return columns[0].size();
+}
+
+// =================================================================
+// Packs the battles waiting into a chunk, writes it and empties the
+// tail. A chunk that could not be written whole is cut off again.
+//
+// @return false if the chunk could not be written; its battles are
+// dropped either way
+// =================================================================
+
+bool HistoryWriter::flush() {
+    size_t rows = pending();
+    if (fd < 0 || rows == 0) return true;
+
+    ChunkHeader header = {};
+    header.magic = HistoryChunkMagic;
+    header.rows = uint32_t(rows);
+    header.enemies = uint16_t(enemies.size());
+    header.columns = HistoryColumnCount;
+    vector<uint8_t> chunk(sizeof(header));
+    for (const string& name : enemies) {
+        chunk.push_back(uint8_t(name.size()));
+        chunk.insert(chunk.end(), name.begin(), name.end());
+    }
+    chunk.resize(alignHistory(chunk.size()));
+
+    for (int c = 0; c < HistoryColumnCount; ++c) {
+        const vector<int64_t>& values = columns[c];
+        ColumnZone& zone = header.zones[c];
+        auto range = minmax_element(values.begin(), values.end());
+        zone.min = *range.first;
+        zone.max = *range.second;
+        zone.width = widthForSpan(uint64_t(zone.max) - uint64_t(zone.min));
+        zone.offset = uint32_t(chunk.size());
+        chunk.resize(alignHistory(chunk.size() + rows * zone.width));
+        uint8_t* out = chunk.data() + zone.offset;
+        switch (zone.width) {
+            case 1: packColumn<uint8_t>(values, zone.min, out); break;
+            case 2: packColumn<uint16_t>(values, zone.min, out); break;
+            case 4: packColumn<uint32_t>(values, zone.min, out); break;
+            case 8: packColumn<uint64_t>(values, zone.min, out); break;
+        }
+    }
+    header.bytes = uint32_t(chunk.size());
+    memcpy(chunk.data(), &header, sizeof(header));
+    off_t start = lseek(fd, 0, SEEK_END);
+    bool written = writeFully(fd, chunk.data(), chunk.size());
+    if (!written && ftruncate(fd, start) == 0) lseek(fd, start, SEEK_SET);
+    startTail();
+
+    for (vector<int64_t>& column : columns) {
+        column.clear();
+    }
+    enemies.clear();
+    enemyIds.clear();
+    return written;
+}
+
+// =================================================================
+// Writes the battles waiting and closes the file. Its tail is
+// empty then and is removed.
+// =================================================================
+
+void HistoryWriter::close() {
+    if (fd < 0) return;
+    flush();
+    if (tailFd >= 0) {
+        ::close(tailFd);
+        unlink(tailPath.c_str());
+        tailFd = -1;
+    }
+    ::close(fd);
+    fd = -1;
+}
+
+// =================================================================
+// Contains the definition of the HistoryChunk class
+// A chunk of a mapped history file. Only the columns a query asks
+// for are decoded, so only their pages are ever read from disk.
+// =================================================================
+
+class HistoryChunk {
+private:
+    const ChunkHeader* header;
+    vector<string_view> enemies;
+
+    friend class HistoryFile;
+
+public:
+    HistoryChunk();
+
+    uint32_t rows() const;
+    const ColumnZone& zone(HistoryColumn column) const;
+    size_t storedBytes(HistoryColumn column) const;
+    size_t enemyCount() const;
+    string_view enemyName(uint32_t enemy) const;
+    int findEnemy(string_view name) const;
+
+    void decode(HistoryColumn column, int32_t* out) const;
+    void decode(HistoryColumn column, int64_t* out) const;
+};
+
+// =================================================================
+// Constructor
+// =================================================================
+
+HistoryChunk::HistoryChunk() : header(nullptr) {}
+
+// =================================================================
+// Returns the number of battles of the chunk
+// =================================================================
+
+uint32_t HistoryChunk::rows() const {
+    return header->rows;
+}
+
+// =================================================================
+// Returns the smallest and largest values of a column
+//
+// @param column The column
+// =================================================================
+
+const ColumnZone& HistoryChunk::zone(HistoryColumn column) const {
+    return header->zones[int(column)];
+}
+
+// =================================================================
+// Returns the bytes a column takes in the chunk
+//
+// @param column The column
+// =================================================================
+
+size_t HistoryChunk::storedBytes(HistoryColumn column) const {
+    return size_t(header->rows) * zone(column).width;
+}
+
+// =================================================================
+// Returns the number of enemies of the chunk
+// =================================================================
+
+size_t HistoryChunk::enemyCount() const {
+    return enemies.size();
+}
+
+// =================================================================
+// Returns the name of an enemy of the chunk
+//
+// @param enemy Its number in the enemy column
+// =================================================================
+
+string_view HistoryChunk::enemyName(uint32_t enemy) const {
+    return enemies[enemy];
+}
+
+// =================================================================
+// Returns the number of an enemy in the chunk
+//
+// @param name The name of the enemy
+// @return Its number, or -1 if it never fought in the chunk
+// =================================================================
+
+int HistoryChunk::findEnemy(string_view name) const {
+    for (size_t i = 0; i < enemies.size(); ++i) {
+        if (enemies[i] == name) return int(i);
+    }
+    return -1;
+}
+
+// =================================================================
+// Decodes a column that fits 32 bits, which is every column but
+// the timestamps
+//
+// @param column The column
+// @param out Receives rows() values
+// =================================================================
+
+void HistoryChunk::decode(HistoryColumn column, int32_t* out) const {
+    const ColumnZone& z = zone(column);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(header) + z.offset;
+    int32_t base = int32_t(z.min);
+    switch (z.width) {
+        case 0: fill(out, out + header->rows, base); break;
+        case 1: unpackColumn<uint8_t>(data, base, out, header->rows); break;
+        case 2: unpackColumn<uint16_t>(data, base, out, header->rows); break;
+        default: unpackColumn<uint32_t>(data, base, out, header->rows); break;
+    }
+}
+
+// =================================================================
+// Decodes any column
+//
+// @param column The column
+// @param out Receives rows() values
+// =================================================================
+
+void HistoryChunk::decode(HistoryColumn column, int64_t* out) const {
+    const ColumnZone& z = zone(column);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(header) + z.offset;
+    switch (z.width) {
+        case 0: fill(out, out + header->rows, z.min); break;
+        case 1: unpackColumn<uint8_t>(data, z.min, out, header->rows); break;
+        case 2: unpackColumn<uint16_t>(data, z.min, out, header->rows); break;
+        case 4: unpackColumn<uint32_t>(data, z.min, out, header->rows); break;
+        default: unpackColumn<uint64_t>(data, z.min, out, header->rows); break;
+    }
+}
+
+// =================================================================
+// Contains the definition of the HistoryFile class
+// A history file mapped read-only. Opening it walks the chunk
+// headers and checks that every chunk and column lies inside the
+// file; a damaged tail is left out rather than failing the file.
+// =================================================================
+
+class HistoryFile {
+private:
+    const uint8_t* data;
+    size_t size;
+    vector<HistoryChunk> chunks;
+    uint64_t rows;
+    size_t unread;          // bytes of a damaged tail
+
+    void unmap();
+
+public:
+    HistoryFile();
+    HistoryFile(const HistoryFile&) = delete;
+    ~HistoryFile();
+
+    bool open(const string& path, string& error);
+    size_t chunkCount() const;
+    const HistoryChunk& chunk(size_t index) const;
+    uint64_t rowCount() const;
+    size_t fileSize() const;
+    size_t damagedBytes() const;
+};
+
+// =================================================================
+// Constructor
+// =================================================================
+
+HistoryFile::HistoryFile() : data(nullptr), size(0), rows(0), unread(0) {}
+
+// =================================================================
+// Destructor. Unmaps the file.
+// =================================================================
+
+HistoryFile::~HistoryFile() {
+    unmap();
+}
+
+// =================================================================
+// Unmaps the file and forgets its chunks
+// =================================================================
+
+void HistoryFile::unmap() {
+    if (data) munmap((void*)data, size);
+    data = nullptr;
+    size = 0;
+    chunks.clear();
+    rows = 0;
+    unread = 0;
+}
+
+// =================================================================
+// Maps a history file and finds its chunks
+//
+// @param path The path of the file
+// @param error Receives the reason when the file cannot be read
+// @return false if the file cannot be read
+// =================================================================
+
+bool HistoryFile::open(const string& path, string& error) {
+    unmap();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    size = size_t(info.st_size);
+    if (size >= sizeof(HistoryHeader)) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : (const uint8_t*)mapped;
+    }
+    ::close(fd);
+    if (!data || reinterpret_cast<const HistoryHeader*>(data)->magic != HistoryMagic) {
+        unmap();
+        error = path + ": not a battle history";
+        return false;
+    }
+    madvise((void*)data, size, MADV_SEQUENTIAL);
+
+    size_t at = sizeof(HistoryHeader);
+    while (at + sizeof(ChunkHeader) <= size) {
+        const ChunkHeader* header = reinterpret_cast<const ChunkHeader*>(data + at);
+        if (header->magic != HistoryChunkMagic || header->columns != HistoryColumnCount || header->bytes % 8 != 0 ||
+            header->bytes < sizeof(ChunkHeader) || header->bytes > size - at || header->rows > HistoryChunkRows ||
+            (header->rows > 0 && header->enemies == 0)) {
+            break;
+        }
+        bool whole = true;
+        for (const ColumnZone& zone : header->zones) {
+            bool width = zone.width == 0 || zone.width == 1 || zone.width == 2 || zone.width == 4 || zone.width == 8;
+            whole = whole && width && zone.offset % 8 == 0 && zone.offset <= header->bytes &&
+                    uint64_t(header->rows) * zone.width <= header->bytes - zone.offset;
+        }
+        HistoryChunk chunk;
+        chunk.header = header;
+        size_t name = at + sizeof(ChunkHeader), end = at + header->bytes;
+        for (uint16_t i = 0; whole && i < header->enemies; ++i) {
+            whole = name < end && name + 1 + data[name] <= end;
+            if (whole) chunk.enemies.emplace_back((const char*)data + name + 1, data[name]);
+            name += 1 + data[name];
+        }
+        if (!whole) break;
+        chunks.push_back(move(chunk));
+        rows += header->rows;
+        at += header->bytes;
+    }
+    unread = size - at;
+    return true;
+}
+
+// =================================================================
+// Returns the number of chunks
+// =================================================================
+
+size_t HistoryFile::chunkCount() const {
+    return chunks.size();
+}
+
+// =================================================================
+// Returns a chunk
+//
+// @param index The index of the chunk, from the start of the file
+// =================================================================
+
+const HistoryChunk& HistoryFile::chunk(size_t index) const {
+    return chunks[index];
+}
+
+// =================================================================
+// Returns the number of battles in the file
+// =================================================================
+
+uint64_t HistoryFile::rowCount() const {
+    return rows;
+}
+
+// =================================================================
+// Returns the size of the file
+// =================================================================
+
+size_t HistoryFile::fileSize() const {
+    return size;
+}
+
+// =================================================================
+// Returns the bytes at the end of the file that could not be read
+// =================================================================
+
+size_t HistoryFile::damagedBytes() const {
+    return unread;
+}
+
+// =================================================================
+// The battles a query looks at. Every bound is inclusive.
+// =================================================================
+
+struct HistoryFilter {
+    HeroClass heroClass = HeroClass::Any;
+    int minLevel = 1, maxLevel = MaxLevel;
+    int64_t since = INT64_MIN, until = INT64_MAX;
+    string enemy;       // empty for every enemy
+};
+
+// =================================================================
+// The buffers a scanning thread decodes columns into, a chunk long
+// =================================================================
+
+struct HistoryScratch {
+    vector<uint8_t> keep;           // 1 for the battles of the filter
+    vector<int32_t> values[4];
+    vector<int64_t> wide;
+
+    HistoryScratch();
+};
+
+// =================================================================
+// Constructor
+// =================================================================
+
+HistoryScratch::HistoryScratch() : keep(HistoryChunkRows), wide(HistoryChunkRows) {
+    for (vector<int32_t>& buffer : values) {
+        buffer.resize(HistoryChunkRows);
+    }
+}
+
+// =================================================================
+// Clears the mark of the values outside a range. Comparisons give 0
+// or 1 and are and-ed in, so the loop has no branches and the
+// compiler compares a vector of values at a time.
+//
+// @param values The values
+// @param low The smallest value kept
+// @param high The largest value kept
+// @param keep The marks, updated
+// @param rows The number of values
+// =================================================================
+
+template <typename Value>
+void keepBetween(const Value* values, Value low, Value high, uint8_t* keep, uint32_t rows) {
+    for (uint32_t i = 0; i < rows; ++i) {
+        keep[i] &= uint8_t(values[i] >= low) & uint8_t(values[i] <= high);
+    }
+}
+
+// =================================================================
+// Marks the battles of a chunk that pass a filter. The zone of a
+// column settles most conditions for the whole chunk: a range that
+// misses it skips the chunk without reading a column, and a range
+// that covers it needs no column either. Only the columns left
+// undecided are decoded and compared.
+//
+// @param chunk The chunk
+// @param filter The filter
+// @param scratch Receives the marks in keep
+// @return The number of battles marked; 0 if the chunk is skipped
+// =================================================================
+
+uint32_t selectRows(const HistoryChunk& chunk, const HistoryFilter& filter, HistoryScratch& scratch) {
+    struct Range {
+        HistoryColumn column;
+        int64_t low, high;
+    };
+    Range ranges[4];
+    int count = 0;
+    if (filter.heroClass != HeroClass::Any) {
+        ranges[count++] = { HistoryColumn::HeroClass, int64_t(filter.heroClass), int64_t(filter.heroClass) };
+    }
+    ranges[count++] = { HistoryColumn::HeroLevel, filter.minLevel, filter.maxLevel };
+    ranges[count++] = { HistoryColumn::Timestamp, filter.since, filter.until };
+    if (!filter.enemy.empty()) {
+        int enemy = chunk.findEnemy(filter.enemy);
+        if (enemy < 0) return 0;
+        ranges[count++] = { HistoryColumn::Enemy, enemy, enemy };
+    }
+
+    uint32_t rows = chunk.rows();
+    uint8_t* keep = scratch.keep.data();
+    fill(keep, keep + rows, uint8_t(1));
+    for (int r = 0; r < count; ++r) {
+        const Range& range = ranges[r];
+        const ColumnZone& zone = chunk.zone(range.column);
+        if (zone.max < range.low || zone.min > range.high) return 0;
+        if (zone.min >= range.low && zone.max <= range.high) continue;
+        if (range.column == HistoryColumn::Timestamp) {
+            chunk.decode(range.column, scratch.wide.data());
+            keepBetween(scratch.wide.data(), range.low, range.high, keep, rows);
+        } else {
+            chunk.decode(range.column, scratch.values[0].data());
+            keepBetween(scratch.values[0].data(), int32_t(max<int64_t>(range.low, INT32_MIN)),
+                        int32_t(min<int64_t>(range.high, INT32_MAX)), keep, rows);
+        }
+    }
+    uint32_t selected = 0;
+    for (uint32_t i = 0; i < rows; ++i) {
+        selected += keep[i];
+    }
+    return selected;
+}
+
+// =================================================================
+// Runs a query over the chunks of a file on many threads. Threads
+// take the next chunk from a shared counter, select its battles and
+// hand it to the query, which adds it to the partial result of the
+// thread. The caller merges the partial results.
+//
+// @param file The history
+// @param filter The battles to look at
+// @param threads The number of threads, 0 for one per core
+// @param visit Called with the partial result, a chunk with battles
+// selected and the scratch buffers holding the marks
+// @return The partial result of every thread
+// =================================================================
+
+template <typename Partial, typename Visit>
+vector<Partial> scanHistory(const HistoryFile& file, const HistoryFilter& filter, int threads, Visit visit) {
+    if (threads <= 0) threads = int(max(1u, thread::hardware_concurrency()));
+    threads = int(max<size_t>(1, min(size_t(threads), file.chunkCount())));
+    vector<Partial> partials(threads);
+    atomic<size_t> next(0);
+    auto work = [&](int t) {
+        HistoryScratch scratch;
+        for (size_t i = next.fetch_add(1); i < file.chunkCount(); i = next.fetch_add(1)) {
+            const HistoryChunk& chunk = file.chunk(i);
+            if (selectRows(chunk, filter, scratch) > 0) visit(partials[t], chunk, scratch);
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) {
+        pool.emplace_back(work, t);
+    }
+    work(0);
+    for (thread& worker : pool) {
+        worker.join();
+    }
+    return partials;
+}
+
+// =================================================================
+// The outcomes of the battles of a class at a level
+// =================================================================
+
+struct WinCount {
+    uint64_t outcomes[3] = {};      // by BattleOutcome
+
+    uint64_t battles() const;
+    double winRate() const;
+};
+
+// =================================================================
+// Returns the number of battles
+// =================================================================
+
+uint64_t WinCount::battles() const {
+    return outcomes[0] + outcomes[1] + outcomes[2];
+}
+
+// =================================================================
+// Returns the share of the battles that ended that were won, from
+// 0 to 1. Battles the player left do not count.
+// =================================================================
+
+double WinCount::winRate() const {
+    uint64_t ended = outcomes[int(BattleOutcome::Won)] + outcomes[int(BattleOutcome::Lost)];
+    return ended ? double(outcomes[int(BattleOutcome::Won)]) / ended : 0;
+}
+
+// Indexed by HeroClass, then by level
+typedef vector<array<WinCount, MaxLevel + 1>> WinTable;
+
+// =================================================================
+// Counts the outcomes of the battles by hero class and level. Reads
+// the class, level and outcome columns.
+//
+// @param file The history
+// @param filter The battles to count
+// @param threads The number of threads, 0 for one per core
+// =================================================================
+
+WinTable winRates(const HistoryFile& file, const HistoryFilter& filter, int threads) {
+    struct Partial {
+        WinTable table = WinTable(HeroClassCount + 1);
+    };
+    vector<Partial> partials = scanHistory<Partial>(file, filter, threads,
+        [](Partial& partial, const HistoryChunk& chunk, HistoryScratch& scratch) {
+            uint32_t rows = chunk.rows();
+            int32_t* classes = scratch.values[1].data();
+            int32_t* levels = scratch.values[2].data();
+            int32_t* outcomes = scratch.values[3].data();
+            chunk.decode(HistoryColumn::HeroClass, classes);
+            chunk.decode(HistoryColumn::HeroLevel, levels);
+            chunk.decode(HistoryColumn::Outcome, outcomes);
+            const uint8_t* keep = scratch.keep.data();
+            for (uint32_t i = 0; i < rows; ++i) {
+                uint32_t heroClass = min(uint32_t(classes[i]), uint32_t(HeroClassCount));
+                uint32_t level = min(uint32_t(levels[i]), uint32_t(MaxLevel));
+                uint32_t outcome = min(uint32_t(outcomes[i]), 2u);
+                partial.table[heroClass][level].outcomes[outcome] += keep[i];
+            }
+        });
+    WinTable table(HeroClassCount + 1);
+    for (const Partial& partial : partials) {
+        for (size_t c = 0; c < table.size(); ++c) {
+            for (int level = 0; level <= MaxLevel; ++level) {
+                for (int o = 0; o < 3; ++o) {
+                    table[c][level].outcomes[o] += partial.table[c][level].outcomes[o];
+                }
+            }
+        }
+    }
+    return table;
+}
+
+// =================================================================
+// How long battles last, in hero turns
+// =================================================================
+
+struct TurnStats {
+    uint64_t battles = 0;
+    double mean = 0;
+    int least = 0, median = 0, p90 = 0, p99 = 0, most = 0;
+};
+
+// =================================================================
+// Finds the turn percentiles of the battles. Turns are counted into
+// a histogram with a bucket for every possible length, so the
+// percentiles are exact and the partial results of the threads just
+// add up. Reads the turns column.
+//
+// @param file The history
+// @param filter The battles to look at
+// @param threads The number of threads, 0 for one per core
+// =================================================================
+
+TurnStats turnStats(const HistoryFile& file, const HistoryFilter& filter, int threads) {
+    struct Partial {
+        vector<uint64_t> histogram = vector<uint64_t>(0x10000);
+        uint64_t total = 0;
+    };
+    vector<Partial> partials = scanHistory<Partial>(file, filter, threads,
+        [](Partial& partial, const HistoryChunk& chunk, HistoryScratch& scratch) {
+            uint32_t rows = chunk.rows();
+            int32_t* turns = scratch.values[1].data();
+            chunk.decode(HistoryColumn::Turns, turns);
+            const uint8_t* keep = scratch.keep.data();
+            uint64_t total = 0;
+            for (uint32_t i = 0; i < rows; ++i) {
+                total += uint64_t(keep[i]) * uint32_t(turns[i]);
+            }
+            partial.total += total;
+            for (uint32_t i = 0; i < rows; ++i) {
+                partial.histogram[min(uint32_t(turns[i]), 0xFFFFu)] += keep[i];
+            }
+        });
+
+    vector<uint64_t> histogram(0x10000);
+    uint64_t total = 0;
+    for (const Partial& partial : partials) {
+        for (size_t t = 0; t < histogram.size(); ++t) {
+            histogram[t] += partial.histogram[t];
+        }
+        total += partial.total;
+    }
+    TurnStats stats;
+    for (uint64_t count : histogram) {
+        stats.battles += count;
+    }
+    if (stats.battles == 0) return stats;
+    stats.mean = double(total) / stats.battles;
+
+    // The smallest length that a share of the battles do not exceed
+    auto percentile = [&](double share) {
+        uint64_t wanted = max<uint64_t>(1, uint64_t(ceil(share * stats.battles))), seen = 0;
+        for (size_t t = 0; t < histogram.size(); ++t) {
+            seen += histogram[t];
+            if (seen >= wanted) return int(t);
+        }
+        return int(histogram.size() - 1);
+    };
+    stats.least = percentile(0);
+    stats.median = percentile(0.5);
+    stats.p90 = percentile(0.9);
+    stats.p99 = percentile(0.99);
+    stats.most = percentile(1);
+    return stats;
+}
+
+// =================================================================
+// The battles against one enemy, summed
+// =================================================================
+
+struct EnemyDamage {
+    string enemy;
+    uint64_t battles = 0, won = 0;
+    int64_t dealt = 0, taken = 0;
+};
+
+// =================================================================
+// Sums the battles and the damage dealt and taken by enemy, most
+// fought first. Every chunk is summed by its own enemy numbers, then
+// the few sums of the chunk are added by name. Reads the enemy,
+// damage and outcome columns.
+//
+// @param file The history
+// @param filter The battles to look at
+// @param threads The number of threads, 0 for one per core
+// =================================================================
+
+vector<EnemyDamage> damageByEnemy(const HistoryFile& file, const HistoryFilter& filter, int threads) {
+    typedef unordered_map<string, EnemyDamage> Partial;
+    vector<Partial> partials = scanHistory<Partial>(file, filter, threads,
+        [](Partial& partial, const HistoryChunk& chunk, HistoryScratch& scratch) {
+            uint32_t rows = chunk.rows();
+            int32_t* enemies = scratch.values[0].data();
+            int32_t* dealt = scratch.values[1].data();
+            int32_t* taken = scratch.values[2].data();
+            int32_t* outcomes = scratch.values[3].data();
+            chunk.decode(HistoryColumn::Enemy, enemies);
+            chunk.decode(HistoryColumn::DamageDealt, dealt);
+            chunk.decode(HistoryColumn::DamageTaken, taken);
+            chunk.decode(HistoryColumn::Outcome, outcomes);
+            const uint8_t* keep = scratch.keep.data();
+            uint32_t last = uint32_t(chunk.enemyCount() - 1);
+            vector<EnemyDamage> sums(chunk.enemyCount());
+            for (uint32_t i = 0; i < rows; ++i) {
+                EnemyDamage& sum = sums[min(uint32_t(enemies[i]), last)];
+                int64_t kept = keep[i];
+                sum.battles += kept;
+                sum.won += kept & uint64_t(outcomes[i] == int32_t(BattleOutcome::Won));
+                sum.dealt += kept * dealt[i];
+                sum.taken += kept * taken[i];
+            }
+            for (uint32_t e = 0; e <= last; ++e) {
+                if (sums[e].battles == 0) continue;
+                EnemyDamage& total = partial[string(chunk.enemyName(e))];
+                total.battles += sums[e].battles;
+                total.won += sums[e].won;
+                total.dealt += sums[e].dealt;
+                total.taken += sums[e].taken;
+            }
+        });
+
+    Partial merged;
+    for (const Partial& partial : partials) {
+        for (const auto& entry : partial) {
+            EnemyDamage& total = merged[entry.first];
+            total.battles += entry.second.battles;
+            total.won += entry.second.won;
+            total.dealt += entry.second.dealt;
+            total.taken += entry.second.taken;
+        }
+    }
+    vector<EnemyDamage> result;
+    for (auto& entry : merged) {
+        entry.second.enemy = entry.first;
+        result.push_back(entry.second);
+    }
+    sort(result.begin(), result.end(), [](const EnemyDamage& a, const EnemyDamage& b) {
+        return a.battles != b.battles ? a.battles > b.battles : a.enemy < b.enemy;
+    });
+    return result;
+}
+
+#endif
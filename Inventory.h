@@ -0,0 +1,354 @@
+// =================================================================
+//
+// File: Inventory.h
+// Author: Alexis Berthou
+// Description: This file contains the item table and the
+// implementation of the Inventory class, which holds the items and
+// the equipment of a character.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// =================================================================
+// Places where an item is worn
+// =================================================================
+
+enum class EquipSlot : uint8_t {
+    Weapon,
+    Offhand,
+    Armor,
+    Helmet,
+    Ring,
+    Amulet
+};
+
+const int EquipSlotCount = 6;
+
+// =================================================================
+// An item and the stats it gives while equipped
+// =================================================================
+
+struct ItemDef {
+    const char* name;
+    EquipSlot slot;
+    int16_t strength, shield;
+};
+
+// =================================================================
+// Every item of the game. Save files store items by their index in
+// this table, so new items go at the end.
+// =================================================================
+
+constexpr ItemDef itemTable[] = {
+    { "Rusty Dagger",      EquipSlot::Weapon,   4,  0 },
+    { "Iron Sword",        EquipSlot::Weapon,   8,  0 },
+    { "Dragonbone Blade",  EquipSlot::Weapon,  15,  0 },
+    { "Wooden Buckler",    EquipSlot::Offhand,  0,  3 },
+    { "Tower Shield",      EquipSlot::Offhand, -2,  8 },
+    { "Leather Armor",     EquipSlot::Armor,    0,  4 },
+    { "Orcish Mail",       EquipSlot::Armor,    0,  7 },
+    { "Iron Helm",         EquipSlot::Helmet,   0,  2 },
+    { "Ring of Might",     EquipSlot::Ring,     5,  0 },
+    { "Goblin Charm",      EquipSlot::Amulet,   2,  1 },
+    { "Amulet of Warding", EquipSlot::Amulet,   0,  5 }
+};
+
+const uint16_t ItemCount = sizeof(itemTable) / sizeof(itemTable[0]);
+const uint16_t NoItem = 0xFFFF;
+
+// =================================================================
+// Returns the definition of an item
+//
+// @param item The index of the item, below ItemCount
+// =================================================================
+
+const ItemDef& itemDef(uint16_t item) {
+    return itemTable[item];
+}
+
+// =================================================================
+// Finds an item by name
+//
+// @param name The name of the item
+// @return Its index, or NoItem
+// =================================================================
+
+uint16_t findItem(const string& name) {
+    for (uint16_t i = 0; i < ItemCount; ++i) {
+        if (name == itemTable[i].name) return i;
+    }
+    return NoItem;
+}
+
+// =================================================================
+// Contains the definition of the Inventory class
+// A fixed-size record: the carried items sit in an array whose free
+// places are tracked by a bitset, so finding one is a bit scan, and
+// the equipped items are one id per slot. The stats the equipment
+// gives are kept as sums that equipping and unequipping adjust by
+// the one item that changes, so the combat code never walks the
+// equipment. Equipping swaps the item with the one it replaces, so
+// it never needs a free place.
+// =================================================================
+
+class Inventory {
+public:
+    static const int Capacity = 24;
+
+private:
+    uint16_t items[Capacity];
+    bitset<Capacity> occupied;
+    uint16_t equipped[EquipSlotCount];
+    int16_t bonusStrength, bonusShield;
+
+    void wear(uint16_t item, int sign);
+
+public:
+    Inventory();
+
+    int add(uint16_t item);
+    bool remove(int place);
+    bool isOccupied(int place) const;
+    uint16_t at(int place) const;
+    int count() const;
+    bool owns(uint16_t item) const;
+
+    bool equip(int place);
+    bool unequip(EquipSlot slot);
+    uint16_t equippedItem(EquipSlot slot) const;
+    int getBonusStrength() const;
+    int getBonusShield() const;
+
+    // The form written to save files
+    struct Record {
+        uint16_t items[Capacity];
+        uint32_t occupied;
+        uint16_t equipped[EquipSlotCount];
+    };
+    static_assert(sizeof(Record) == 64, "Inventory records are written as they are");
+    Record toRecord() const;
+    static Inventory fromRecord(const Record& record);
+};
+
+// =================================================================
+// Constructor. The inventory starts empty with nothing equipped.
+// =================================================================
+
+Inventory::Inventory() : bonusStrength(0), bonusShield(0) {
+    for (uint16_t& item : items) {
+        item = NoItem;
+    }
+    for (uint16_t& item : equipped) {
+        item = NoItem;
+    }
+}
+
+// =================================================================
+// Adds or takes away the stats of an item from the sums
+//
+// @param item The item
+// @param sign 1 to add them, -1 to take them away
+// =================================================================
+
+void Inventory::wear(uint16_t item, int sign) {
+    bonusStrength += sign * itemDef(item).strength;
+    bonusShield += sign * itemDef(item).shield;
+}
+
+// =================================================================
+// Puts an item in the first free place
+//
+// @param item The item
+// @return The place, or -1 if the inventory is full or the item
+// does not exist
+// =================================================================
+
+int Inventory::add(uint16_t item) {
+    if (item >= ItemCount || occupied.all()) return -1;
+    int place = __builtin_ctzl(~occupied.to_ulong());
+    items[place] = item;
+    occupied.set(place);
+    return place;
+}
+
+// =================================================================
+// Throws away the item in a place
+//
+// @param place The place
+// @return false if the place was empty
+// =================================================================
+
+bool Inventory::remove(int place) {
+    if (!isOccupied(place)) return false;
+    occupied.reset(place);
+    items[place] = NoItem;
+    return true;
+}
+
+// =================================================================
+// Checks whether a place holds an item
+//
+// @param place The place
+// =================================================================
+
+bool Inventory::isOccupied(int place) const {
+    return place >= 0 && place < Capacity && occupied.test(place);
+}
+
+// =================================================================
+// Returns the item in a place
+//
+// @param place The place
+// @return The item, or NoItem
+// =================================================================
+
+uint16_t Inventory::at(int place) const {
+    return isOccupied(place) ? items[place] : NoItem;
+}
+
+// =================================================================
+// Returns the number of items carried, not counting the equipped
+// ones
+// =================================================================
+
+int Inventory::count() const {
+    return int(occupied.count());
+}
+
+// =================================================================
+// Checks whether an item is carried or equipped
+//
+// @param item The item
+// =================================================================
+
+bool Inventory::owns(uint16_t item) const {
+    for (uint16_t worn : equipped) {
+        if (worn == item) return true;
+    }
+    for (int place = 0; place < Capacity; ++place) {
+        if (occupied.test(place) && items[place] == item) return true;
+    }
+    return false;
+}
+
+// =================================================================
+// Equips the item in a place. The item it replaces, if any, takes
+// its place in the inventory.
+//
+// @param place The place
+// @return false if the place was empty
+// =================================================================
+
+bool Inventory::equip(int place) {
+    if (!isOccupied(place)) return false;
+    uint16_t item = items[place];
+    uint16_t& worn = equipped[int(itemDef(item).slot)];
+    if (worn != NoItem) {
+        wear(worn, -1);
+        items[place] = worn;
+    } else {
+        remove(place);
+    }
+    worn = item;
+    wear(item, 1);
+    return true;
+}
+
+// =================================================================
+// Takes off the item of a slot and puts it in the inventory
+//
+// @param slot The slot
+// @return false if the slot was empty or the inventory is full
+// =================================================================
+
+bool Inventory::unequip(EquipSlot slot) {
+    uint16_t& worn = equipped[int(slot)];
+    if (worn == NoItem || add(worn) < 0) return false;
+    wear(worn, -1);
+    worn = NoItem;
+    return true;
+}
+
+// =================================================================
+// Returns the item equipped in a slot
+//
+// @param slot The slot
+// @return The item, or NoItem
+// =================================================================
+
+uint16_t Inventory::equippedItem(EquipSlot slot) const {
+    return equipped[int(slot)];
+}
+
+// =================================================================
+// Returns the strength the equipment gives
+// =================================================================
+
+int Inventory::getBonusStrength() const {
+    return bonusStrength;
+}
+
+// =================================================================
+// Returns the shield the equipment gives
+// =================================================================
+
+int Inventory::getBonusShield() const {
+    return bonusShield;
+}
+
+// =================================================================
+// Returns the inventory as written to save files. The sums are not
+// written; they are rebuilt from the equipment on load.
+// =================================================================
+
+Inventory::Record Inventory::toRecord() const {
+    Record record;
+    for (int i = 0; i < Capacity; ++i) {
+        record.items[i] = items[i];
+    }
+    record.occupied = uint32_t(occupied.to_ulong());
+    for (int i = 0; i < EquipSlotCount; ++i) {
+        record.equipped[i] = equipped[i];
+    }
+    return record;
+}
+
+// =================================================================
+// Rebuilds an inventory from a save file. Unknown items and items
+// in the wrong slot are dropped.
+//
+// @param record The record read from the file
+// =================================================================
+
+Inventory Inventory::fromRecord(const Record& record) {
+    Inventory inventory;
+    for (int i = 0; i < Capacity; ++i) {
+        uint16_t item = record.items[i];
+        if ((record.occupied >> i & 1) && item < ItemCount) {
+            inventory.items[i] = item;
+            inventory.occupied.set(i);
+        }
+    }
+    for (int i = 0; i < EquipSlotCount; ++i) {
+        uint16_t item = record.equipped[i];
+        if (item < ItemCount && int(itemDef(item).slot) == i) {
+            inventory.equipped[i] = item;
+            inventory.wear(item, 1);
+        }
+    }
+    return inventory;
+}
+
+#endif
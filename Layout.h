@@ -0,0 +1,239 @@
+// =================================================================
+//
+// File: Layout.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the Layout
+// class, which computes the screen geometry of the UI.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+// =================================================================
+// A rectangular area of the screen
+// =================================================================
+
+struct Rect {
+    int top, left, height, width;
+};
+
+// =================================================================
+// A block of art already centered and clipped for the current
+// terminal size. Each line keeps the column where it starts.
+// =================================================================
+
+struct PlacedArt {
+    int row;
+    vector<pair<int, string>> lines;
+};
+
+// =================================================================
+// Contains the definition of the Layout class
+// The geometry is computed once per terminal size and cached until
+// the terminal is resized. The default values reproduce the
+// original 40x130 screen.
+// =================================================================
+
+class Layout {
+private:
+    int lines, cols;
+    map<const vector<string>*, PlacedArt> artCache;
+
+    void computeRegions();
+    void computeRuns();
+
+public:
+    // Frame rows
+    int titleRow, dividerRow, bottomRow;
+
+    // Off-screen regions inside the frame
+    Rect header, cards, log, menu;
+
+    // Named rows and columns used by the screens
+    int subtitleRow;   // level name
+    int promptRow;     // "Choose ..." prompts
+    int listRow;       // first entry of a list
+    int listCol;
+    int noticeRow;     // short notices below the prompt
+    int statusCol;     // level completion status
+    int cardRow;
+    int heroCardCol, enemyCardCol;
+    int bannerRow;     // victory / defeat banner
+    int menuRow;       // first menu entry
+    int menuCol;
+
+    // Pre-rendered frame glyph runs
+    string topRun;     // columns 2 to COLS - 3
+    string bottomRun;  // columns 3 to COLS - 3
+    string sideRun;    // one glyph per row, indexed by row
+
+    Layout();
+
+    bool update(int l, int c);
+    int getLines() const;
+    int getCols() const;
+    const PlacedArt& placeCentered(int row, const vector<string>& block);
+};
+
+// =================================================================
+// Default constructor. The geometry is empty until update() is
+// called with the terminal size.
+// =================================================================
+
+Layout::Layout() : lines(0), cols(0) {}
+
+// =================================================================
+// Recomputes the geometry if the terminal size changed
+//
+// @param l The number of terminal lines
+// @param c The number of terminal columns
+// @return true if the layout was recomputed
+// =================================================================
+
+bool Layout::update(int l, int c) {
+    if (l == lines && c == cols) return false;
+    lines = l;
+    cols = c;
+    artCache.clear();
+    computeRegions();
+    computeRuns();
+    return true;
+}
+
+// =================================================================
+// Returns the number of lines the layout was computed for
+// =================================================================
+
+int Layout::getLines() const {
+    return lines;
+}
+
+// =================================================================
+// Returns the number of columns the layout was computed for
+// =================================================================
+
+int Layout::getCols() const {
+    return cols;
+}
+
+// =================================================================
+// Computes the regions and the named rows and columns. The menu
+// keeps three rows under the divider; the header and the message
+// log shrink before the cards do on short terminals.
+// =================================================================
+
+void Layout::computeRegions() {
+    titleRow = 1;
+    bottomRow = max(lines - 1, 3);
+    dividerRow = max(bottomRow - 6, 2);
+
+    int innerLeft = 2;
+    int innerWidth = max(cols - 4, 1);
+
+    // Rows between the title and the divider are shared by the
+    // header, the cards and the message log
+    int available = max(dividerRow - 2, 0);
+    int headerHeight = 7;
+    int logHeight = 6;
+    int cardsHeight = available - headerHeight - logHeight;
+    if (cardsHeight < 12) {
+        int missing = 12 - cardsHeight;
+        int fromHeader = min(missing, headerHeight - 3);
+        headerHeight -= fromHeader;
+        missing -= fromHeader;
+        logHeight -= min(missing, logHeight - 4);
+        cardsHeight = max(available - headerHeight - logHeight, 0);
+    }
+
+    header = { 2, innerLeft, headerHeight, innerWidth };
+    cards = { header.top + headerHeight, innerLeft, cardsHeight, innerWidth };
+    log = { cards.top + cardsHeight, innerLeft, logHeight, innerWidth };
+    menu = { dividerRow + 1, innerLeft, max(bottomRow - dividerRow - 1, 1), innerWidth };
+
+    subtitleRow = header.top + 1;
+    promptRow = header.top + min(3, headerHeight - 1);
+    listRow = cards.top + 1;
+    listCol = 10;
+    noticeRow = cards.top + 2;
+    statusCol = max(cols - 30, listCol + 20);
+    cardRow = cards.top + 1;
+    bannerRow = cards.top + max(cardsHeight - 3, 0);
+    menuRow = dividerRow + 3;
+    menuCol = 4;
+
+    // Two battle cards need about 80 columns side by side
+    if (cols >= 80) {
+        heroCardCol = cols / 5 - 4;
+        enemyCardCol = cols / 5 * 3 - 3;
+    } else {
+        heroCardCol = 0;
+        enemyCardCol = cols / 2 - 2;
+    }
+}
+
+// =================================================================
+// Builds the frame glyph runs. Horizontal borders alternate '~'
+// on even columns and '-' on odd ones; vertical borders alternate
+// '!' on even rows and '|' on odd ones.
+// =================================================================
+
+void Layout::computeRuns() {
+    topRun.clear();
+    for (int x = 2; x < cols - 2; ++x) {
+        topRun += (x % 2 == 0) ? '~' : '-';
+    }
+    bottomRun.clear();
+    for (int x = 3; x < cols - 2; ++x) {
+        bottomRun += (x % 2 == 0) ? '~' : '-';
+    }
+    sideRun.clear();
+    for (int y = 0; y < lines; ++y) {
+        sideRun += (y % 2 == 0) ? '!' : '|';
+    }
+}
+
+// =================================================================
+// Returns a block of art centered on the screen starting at the
+// given row. Lines wider than the screen are clipped evenly on both
+// sides. The result is cached until the terminal is resized.
+//
+// @param row The first row of the block
+// @param block The art to place
+// @return The placed art
+// =================================================================
+
+const PlacedArt& Layout::placeCentered(int row, const vector<string>& block) {
+    auto it = artCache.find(&block);
+    if (it != artCache.end() && it->second.row == row) {
+        return it->second;
+    }
+
+    PlacedArt placed;
+    placed.row = row;
+    int innerWidth = max(cols - 4, 0);
+    for (const string& line : block) {
+        int length = line.length();
+        if (length > innerWidth) {
+            int cut = (length - innerWidth) / 2;
+            placed.lines.push_back({ 2, line.substr(cut, innerWidth) });
+        } else {
+            placed.lines.push_back({ (cols - length) / 2, line });
+        }
+    }
+    artCache[&block] = placed;
+    return artCache[&block];
+}
+
+#endif
@@ -32,6 +32,8 @@ private:
     Character* hero;
     Enemy* initialEnemy;
     bool won;
+    uint16_t reward;    // the item found on winning, or NoItem
+    Rating rating;      // of its enemy, which is replaced on every reset
 
 public:
     Level();
@@ -45,20 +47,24 @@ public:
     void setEpilogue(string e);
     void setEnemy(Character* en);
     void setHero(Character* h);
+    void setReward(uint16_t item);
     void resetEnemy();
+    void setRating(const Rating& value);
 
     string getName() const;
     string getPrologue() const;
     string getEpilogue() const;
     Character* getEnemy() const;
     Character* getHero() const;
+    uint16_t getReward() const;
+    const Rating& getRating() const;
 };
 
 // =================================================================
 // Default constructor for Level
 // =================================================================
 
-Level::Level(): name(""), prologue(""), epilogue(""), enemy(nullptr), won(false) {}
+Level::Level(): name(""), prologue(""), epilogue(""), enemy(nullptr), won(false), reward(NoItem) {}
 
 // =================================================================
 // Parameterized constructor for Level
@@ -70,7 +76,7 @@ Level::Level(): name(""), prologue(""), epilogue(""), enemy(nullptr), won(false)
 // =================================================================
 
 Level::Level(string n, string p, string e, Character* en)
-    : name(n), prologue(p), epilogue(e), enemy(en), won(false) {
+    : name(n), prologue(p), epilogue(e), enemy(en), won(false), reward(NoItem) {
         initialEnemy = new Enemy(*dynamic_cast<Enemy*>(en));
     }
 
@@ -81,7 +87,8 @@ Level::Level(string n, string p, string e, Character* en)
 // =================================================================
 
 Level::Level(const Level &l)
-    : name(l.name), prologue(l.prologue), epilogue(l.epilogue), enemy(l.enemy), won(l.won) {}
+    : name(l.name), prologue(l.prologue), epilogue(l.epilogue), enemy(l.enemy), won(l.won), reward(l.reward),
+      rating(l.rating) {}
 
 // =================================================================
 // Destructor for Level
@@ -154,6 +161,42 @@ void Level::setWon(bool w) {
     won = w;
 }
 
+// =================================================================
+// Sets the item found by the hero who wins the level
+//
+// @param item The item, or NoItem
+// =================================================================
+
+void Level::setReward(uint16_t item) {
+    reward = item;
+}
+
+// =================================================================
+// Returns the item found by the hero who wins the level, or NoItem
+// =================================================================
+
+uint16_t Level::getReward() const {
+    return reward;
+}
+
+// =================================================================
+// Returns the rating of the enemy of the level
+// =================================================================
+
+const Rating& Level::getRating() const {
+    return rating;
+}
+
+// =================================================================
+// Sets the rating of the enemy of the level
+//
+// @param value The rating
+// =================================================================
+
+void Level::setRating(const Rating& value) {
+    rating = value;
+}
+
 // =================================================================
 // Adds a prologue to the level
 //
@@ -0,0 +1,144 @@
+// =================================================================
+//
+// File: LevelCatalog.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// LevelCatalog class, the immutable definitions of the levels and
+// their enemies.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef LEVELCATALOG_H
+#define LEVELCATALOG_H
+
+#include "Character.h"
+#include "Level.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Definition of one level: its texts, the enemy it starts with and
+// the item its winner finds
+// =================================================================
+
+struct LevelDef {
+    string name, prologue, epilogue;
+    Enemy enemy;
+    uint16_t reward = NoItem;
+};
+
+// =================================================================
+// Contains the definition of the LevelCatalog class
+// The catalog never changes once built, so one instance is shared
+// through a shared_ptr<const LevelCatalog> by every session of the
+// server. Battles copy the enemy they fight; the definitions are
+// only read.
+// =================================================================
+
+class LevelCatalog {
+private:
+    vector<LevelDef> levels;
+
+public:
+    LevelCatalog(vector<LevelDef> definitions);
+
+    static shared_ptr<const LevelCatalog> builtin();
+
+    size_t size() const;
+    const LevelDef& at(size_t index) const;
+    vector<Level*> createLevels() const;
+};
+
+// =================================================================
+// Constructor
+//
+// @param definitions The levels, in campaign order
+// =================================================================
+
+LevelCatalog::LevelCatalog(vector<LevelDef> definitions) : levels(move(definitions)) {}
+
+// =================================================================
+// Returns the levels that ship with the game
+// =================================================================
+
+shared_ptr<const LevelCatalog> LevelCatalog::builtin() {
+    Enemy orc("Orc", 75, 45, 15, 5);
+    orc.setInflicts({ { EffectKind::Ward, 12, 3 } });
+    Enemy dragon("Dragon", 100, 60, 100, 10);
+    dragon.setInflicts({ { EffectKind::Poison, 5, 3 } });
+    // Breathes fire while it has the mana, and bites to get it back
+    dragon.setAbility(Ability::builtin(
+        "if self.mana < 20 goto bite\n"
+        "add r0, self.strength, 20\n"
+        "damage target, r0\n"
+        "sub self.mana, self.mana, 20\n"
+        "end\n"
+        "bite: damage target, self.strength\n"
+        "add self.mana, self.mana, 10\n"));
+    return make_shared<const LevelCatalog>(vector<LevelDef> {
+        {
+            "The Duel in the Goblin's Lair",
+            "The hero entered a foggy forest. Twisted trees whispered secrets. In a moonlit clearing, a mighty goblin appeared, ready to battle.",
+            "The hero bravely defeated the goblin. Exhausted but victorious, he looked at the sunrise, ready for future challenges.",
+            Enemy("Goblin", 25, 15, 5, 2),
+            findItem("Leather Armor")
+        },
+        {
+            "The Battle of the Shadow Cave",
+            "The cave was dark and damp, with stalactites, bats, and an oppressive atmosphere. An orc awaited the hero by a fire.",
+            "The hero, bleeding but victorious, defeated the orc. Exhausted, he picked up his sword and set out for new adventures.",
+            orc,
+            findItem("Iron Sword")
+        },
+        {
+            "The Confrontation at the Frosty Peak",
+            "On the snowy mountaintop, the hero faced the red dragon. Icy wind whipped as the dragon roared, its scales glistening. Battle imminent.",
+            "The hero stood over the fallen dragon. Wind scattered ashes. Sword smoking, he looked out over the snowy landscape, triumphant.",
+            dragon,
+            findItem("Dragonbone Blade")
+        }
+    });
+}
+
+// =================================================================
+// Returns the number of levels
+// =================================================================
+
+size_t LevelCatalog::size() const {
+    return levels.size();
+}
+
+// =================================================================
+// Returns the definition of a level
+//
+// @param index The position of the level
+// =================================================================
+
+const LevelDef& LevelCatalog::at(size_t index) const {
+    return levels[index];
+}
+
+// =================================================================
+// Creates the mutable levels played by the single-player game
+//
+// @return New Level objects; the caller owns them
+// =================================================================
+
+vector<Level*> LevelCatalog::createLevels() const {
+    vector<Level*> created;
+    created.reserve(levels.size());
+    for (const LevelDef& def : levels) {
+        created.push_back(new Level(def.name, def.prologue, def.epilogue, new Enemy(def.enemy)));
+        created.back()->setReward(def.reward);
+    }
+    return created;
+}
+
+#endif
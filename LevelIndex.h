@@ -0,0 +1,262 @@
+// =================================================================
+//
+// File: LevelIndex.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// LevelIndex class, which answers the queries of the level browser.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef LEVELINDEX_H
+#define LEVELINDEX_H
+
+#include "Level.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the LevelIndex class
+// A Fenwick tree counts the unbeaten levels, so "next unbeaten
+// level" is a prefix sum and a tree descent, both O(log n). Names
+// are kept in a sorted permutation for O(log n) prefix search.
+// Every change of Level::won must go through setWon() to keep the
+// tree in sync.
+// =================================================================
+
+class LevelIndex {
+private:
+    vector<Level*>* levels;
+    vector<int> tree;          // Fenwick tree over the unbeaten flags, 1-based
+    vector<string> lowerNames;
+    vector<uint32_t> sorted;   // level positions sorted by name
+    unordered_map<const Level*, int> positions;
+    int unbeaten;
+
+    void add(int position, int delta);
+    int prefix(int count) const;
+
+public:
+    LevelIndex();
+
+    void build(vector<Level*>& all);
+    int size() const;
+    Level* at(int position) const;
+    int positionOf(const Level* level) const;
+
+    void setWon(int position, bool won);
+    void setWon(const Level* level, bool won);
+    int countUnbeaten() const;
+    int nextUnbeaten(int from) const;
+
+    pair<int, int> nameRange(const string& prefixText) const;
+    int sortedAt(int rank) const;
+};
+
+// =================================================================
+// Constructor. The index is empty until build() is called.
+// =================================================================
+
+LevelIndex::LevelIndex() : levels(nullptr), unbeaten(0) {}
+
+// =================================================================
+// Adds delta to the unbeaten count of a level in the tree
+//
+// @param position The position of the level
+// @param delta +1 or -1
+// =================================================================
+
+void LevelIndex::add(int position, int delta) {
+    for (int i = position + 1; i < (int)tree.size(); i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+// =================================================================
+// Returns the number of unbeaten levels among the first count
+//
+// @param count The number of levels to count
+// =================================================================
+
+int LevelIndex::prefix(int count) const {
+    int sum = 0;
+    for (int i = count; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+// =================================================================
+// Builds the index over a list of levels. The list is kept by
+// reference and must outlive the index.
+//
+// @param all The levels of the campaign
+// =================================================================
+
+void LevelIndex::build(vector<Level*>& all) {
+    levels = &all;
+    int n = all.size();
+
+    // Linear Fenwick construction
+    tree.assign(n + 1, 0);
+    unbeaten = 0;
+    for (int i = 0; i < n; ++i) {
+        int flag = all[i]->hasWon() ? 0 : 1;
+        unbeaten += flag;
+        tree[i + 1] += flag;
+        int parent = (i + 1) + ((i + 1) & -(i + 1));
+        if (parent <= n) tree[parent] += tree[i + 1];
+    }
+
+    lowerNames.assign(n, "");
+    positions.clear();
+    for (int i = 0; i < n; ++i) {
+        for (char c : all[i]->getName()) {
+            lowerNames[i] += tolower((unsigned char)c);
+        }
+        positions[all[i]] = i;
+    }
+    sorted.resize(n);
+    for (int i = 0; i < n; ++i) {
+        sorted[i] = i;
+    }
+    stable_sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) {
+        return lowerNames[a] < lowerNames[b];
+    });
+}
+
+// =================================================================
+// Returns the number of levels
+// =================================================================
+
+int LevelIndex::size() const {
+    return levels ? levels->size() : 0;
+}
+
+// =================================================================
+// Returns the level at a position
+//
+// @param position The position of the level
+// =================================================================
+
+Level* LevelIndex::at(int position) const {
+    return (*levels)[position];
+}
+
+// =================================================================
+// Returns the position of a level, or -1 if it is not indexed
+//
+// @param level The level
+// =================================================================
+
+int LevelIndex::positionOf(const Level* level) const {
+    auto it = positions.find(level);
+    return it == positions.end() ? -1 : it->second;
+}
+
+// =================================================================
+// Marks a level as won or not and updates the tree
+//
+// @param position The position of the level
+// @param won True if the level is won, false otherwise
+// =================================================================
+
+void LevelIndex::setWon(int position, bool won) {
+    Level* level = at(position);
+    if (level->hasWon() == won) return;
+    level->setWon(won);
+    add(position, won ? -1 : 1);
+    unbeaten += won ? -1 : 1;
+}
+
+// =================================================================
+// Marks a level as won or not and updates the tree
+//
+// @param level The level
+// @param won True if the level is won, false otherwise
+// =================================================================
+
+void LevelIndex::setWon(const Level* level, bool won) {
+    int position = positionOf(level);
+    if (position >= 0) setWon(position, won);
+}
+
+// =================================================================
+// Returns the number of levels not won yet
+// =================================================================
+
+int LevelIndex::countUnbeaten() const {
+    return unbeaten;
+}
+
+// =================================================================
+// Finds the first unbeaten level at or after a position by
+// descending the Fenwick tree
+//
+// @param from The first position to consider
+// @return The position of the level, or -1 if there is none
+// =================================================================
+
+int LevelIndex::nextUnbeaten(int from) const {
+    int n = size();
+    if (from < 0) from = 0;
+    if (from >= n) return -1;
+    int target = prefix(from) + 1; // the k-th unbeaten level overall
+    if (target > unbeaten) return -1;
+
+    int position = 0;
+    int step = 1;
+    while (step * 2 <= n) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (position + step <= n && tree[position + step] < target) {
+            position += step;
+            target -= tree[position];
+        }
+    }
+    return position; // 0-based position of the level
+}
+
+// =================================================================
+// Returns the ranks, in name order, of the levels whose name starts
+// with a prefix. The matches are sortedAt(first) .. sortedAt(last - 1).
+//
+// @param prefixText The prefix, case insensitive
+// @return The pair (first, last) of ranks
+// =================================================================
+
+pair<int, int> LevelIndex::nameRange(const string& prefixText) const {
+    string lower;
+    for (char c : prefixText) {
+        lower += tolower((unsigned char)c);
+    }
+    size_t length = lower.length();
+    auto first = lower_bound(sorted.begin(), sorted.end(), lower, [this, length](uint32_t level, const string& p) {
+        return lowerNames[level].compare(0, length, p) < 0;
+    });
+    auto last = upper_bound(first, sorted.end(), lower, [this, length](const string& p, uint32_t level) {
+        return lowerNames[level].compare(0, length, p) > 0;
+    });
+    return { int(first - sorted.begin()), int(last - sorted.begin()) };
+}
+
+// =================================================================
+// Returns the position of the level with a given rank in name order
+//
+// @param rank The rank
+// =================================================================
+
+int LevelIndex::sortedAt(int rank) const {
+    return sorted[rank];
+}
+
+#endif
@@ -0,0 +1,512 @@
+// =================================================================
+//
+// File: Metrics.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the metrics
+// registry: counters, gauges and latency histograms that can be
+// shown in game and dumped to JSON.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Counts events. Safe from any thread.
+// =================================================================
+
+class Counter {
+private:
+    atomic<uint64_t> total;
+
+public:
+    Counter() : total(0) {}
+    void add(uint64_t amount) { total.fetch_add(amount, memory_order_relaxed); }
+    uint64_t value() const { return total.load(memory_order_relaxed); }
+};
+
+// =================================================================
+// Holds the last value set. Safe from any thread.
+// =================================================================
+
+class Gauge {
+private:
+    atomic<int64_t> current;
+
+public:
+    Gauge() : current(0) {}
+    void set(int64_t value) { current.store(value, memory_order_relaxed); }
+    void add(int64_t amount) { current.fetch_add(amount, memory_order_relaxed); }
+    int64_t value() const { return current.load(memory_order_relaxed); }
+};
+
+// =================================================================
+// Contains the definition of the Histogram class
+// An HDR-style histogram: every power of two is split into 32
+// buckets, so any value is known to within about 3% whatever its
+// magnitude, from nanoseconds to minutes, in a fixed 9 KB. Recording
+// is a bit scan and a relaxed increment, with no lock and no
+// allocation.
+// =================================================================
+
+class Histogram {
+public:
+    static const int SubBits = 5;
+    static const int SubBuckets = 1 << SubBits;
+    static const int MaxExponent = 40;   // values above 2^41 land in the last bucket
+    static const int BucketCount = (MaxExponent - SubBits + 2) * SubBuckets;
+
+private:
+    atomic<uint64_t> buckets[BucketCount];
+    atomic<uint64_t> total, sum, minimum, maximum;
+
+    static int bucketOf(uint64_t value);
+    static uint64_t bucketValue(int bucket);
+
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double fraction) const;
+};
+
+// =================================================================
+// Constructor. The histogram starts empty.
+// =================================================================
+
+Histogram::Histogram() : total(0), sum(0), minimum(UINT64_MAX), maximum(0) {
+    for (atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, memory_order_relaxed);
+    }
+}
+
+// =================================================================
+// Returns the bucket of a value. Values below 32 have a bucket
+// each; above, the exponent picks a group and the next five bits
+// the bucket within it.
+//
+// @param value The value
+// =================================================================
+
+int Histogram::bucketOf(uint64_t value) {
+    if (value < uint64_t(SubBuckets)) return int(value);
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > MaxExponent) return BucketCount - 1;
+    int shift = exponent - SubBits;
+    return (shift + 1) * SubBuckets + int((value >> shift) - SubBuckets);
+}
+
+// =================================================================
+// Returns the value that stands for a bucket: the middle of the
+// values it holds
+//
+// @param bucket The bucket
+// =================================================================
+
+uint64_t Histogram::bucketValue(int bucket) {
+    if (bucket < SubBuckets) return bucket;
+    int shift = bucket / SubBuckets - 1;
+    uint64_t lowest = uint64_t(SubBuckets + bucket % SubBuckets) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1) / 2;
+}
+
+// =================================================================
+// Records a value
+//
+// @param value The value, usually nanoseconds
+// =================================================================
+
+void Histogram::record(uint64_t value) {
+    buckets[bucketOf(value)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    sum.fetch_add(value, memory_order_relaxed);
+    uint64_t seen = minimum.load(memory_order_relaxed);
+    while (value < seen && !minimum.compare_exchange_weak(seen, value, memory_order_relaxed)) {}
+    seen = maximum.load(memory_order_relaxed);
+    while (value > seen && !maximum.compare_exchange_weak(seen, value, memory_order_relaxed)) {}
+}
+
+// =================================================================
+// Returns the number of values recorded
+// =================================================================
+
+uint64_t Histogram::count() const {
+    return total.load(memory_order_relaxed);
+}
+
+// =================================================================
+// Returns the smallest value recorded, or 0
+// =================================================================
+
+uint64_t Histogram::min() const {
+    return count() ? minimum.load(memory_order_relaxed) : 0;
+}
+
+// =================================================================
+// Returns the largest value recorded
+// =================================================================
+
+uint64_t Histogram::max() const {
+    return maximum.load(memory_order_relaxed);
+}
+
+// =================================================================
+// Returns the mean of the values recorded
+// =================================================================
+
+double Histogram::mean() const {
+    uint64_t n = count();
+    return n ? double(sum.load(memory_order_relaxed)) / n : 0;
+}
+
+// =================================================================
+// Returns the value below which a fraction of the values fall
+//
+// @param fraction From 0 to 1, such as 0.99
+// =================================================================
+
+uint64_t Histogram::percentile(double fraction) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = uint64_t(fraction * n);
+    if (rank >= n) rank = n - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[i].load(memory_order_relaxed);
+        // The middle of the bucket may lie past the values recorded
+        if (seen > rank) return std::min(std::max(bucketValue(i), min()), max());
+    }
+    return max();
+}
+
+// =================================================================
+// Records the time spent in a scope into a histogram
+// =================================================================
+
+class ScopedTimer {
+private:
+    Histogram& histogram;
+    int64_t start;
+
+public:
+    ScopedTimer(Histogram& into) : histogram(into), start(monotonicNow()) {}
+    ~ScopedTimer() { histogram.record(uint64_t(monotonicNow() - start)); }
+};
+
+// Allocations made by the current thread, counted by operator new
+inline thread_local uint64_t threadAllocations = 0;
+
+// =================================================================
+// Contains the definition of the Metrics class
+// The registry of every metric, by name. Looking a metric up takes
+// a lock, so the METRICS_ macros do it once per call site and keep
+// the reference; after that, updating a metric costs one relaxed
+// atomic operation. Building with -DRPG_NO_METRICS turns every macro
+// into nothing and leaves operator new alone.
+// =================================================================
+
+class Metrics {
+private:
+    struct Screen {
+        Histogram* time;   // spent in the scene
+        Histogram* render; // spent presenting its frames
+    };
+
+    static mutex registryMutex;
+    static map<string, unique_ptr<Counter>> counters;
+    static map<string, unique_ptr<Gauge>> gauges;
+    static map<string, unique_ptr<Histogram>> histograms;
+    static Screen screen;
+
+public:
+    static Counter& counter(const string& name);
+    static Gauge& gauge(const string& name);
+    static Histogram& histogram(const string& name);
+
+    static void enterScene(const string& name);
+    static Histogram& sceneTime();
+    static Histogram& renderTime();
+    static uint64_t allocations();
+
+    static vector<string> summary();
+    static string toJson();
+    static bool dumpJson(const string& path);
+};
+
+mutex Metrics::registryMutex;
+map<string, unique_ptr<Counter>> Metrics::counters;
+map<string, unique_ptr<Gauge>> Metrics::gauges;
+map<string, unique_ptr<Histogram>> Metrics::histograms;
+Metrics::Screen Metrics::screen = { nullptr, nullptr };
+
+// =================================================================
+// Returns a counter, creating it on first use. The reference stays
+// valid until the program ends.
+//
+// @param name The name of the counter
+// =================================================================
+
+Counter& Metrics::counter(const string& name) {
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Counter>& slot = counters[name];
+    if (!slot) slot.reset(new Counter());
+    return *slot;
+}
+
+// =================================================================
+// Returns a gauge, creating it on first use
+//
+// @param name The name of the gauge
+// =================================================================
+
+Gauge& Metrics::gauge(const string& name) {
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Gauge>& slot = gauges[name];
+    if (!slot) slot.reset(new Gauge());
+    return *slot;
+}
+
+// =================================================================
+// Returns a histogram, creating it on first use
+//
+// @param name The name of the histogram
+// =================================================================
+
+Histogram& Metrics::histogram(const string& name) {
+    lock_guard<mutex> lock(registryMutex);
+    unique_ptr<Histogram>& slot = histograms[name];
+    if (!slot) slot.reset(new Histogram());
+    return *slot;
+}
+
+// =================================================================
+// Makes a scene the current one, so its time and the frames it
+// presents are recorded under its name. UI thread only.
+//
+// @param name The name of the scene
+// =================================================================
+
+void Metrics::enterScene(const string& name) {
+    screen.time = &histogram("scene." + name + ".ns");
+    screen.render = &histogram("render." + name + ".ns");
+}
+
+// =================================================================
+// Returns the histogram of the time spent in the current scene
+// =================================================================
+
+Histogram& Metrics::sceneTime() {
+    if (!screen.time) enterScene("None");
+    return *screen.time;
+}
+
+// =================================================================
+// Returns the histogram of the frames presented by the current scene
+// =================================================================
+
+Histogram& Metrics::renderTime() {
+    if (!screen.render) enterScene("None");
+    return *screen.render;
+}
+
+// =================================================================
+// Returns the number of allocations made so far by this thread
+// =================================================================
+
+uint64_t Metrics::allocations() {
+    return threadAllocations;
+}
+
+// =================================================================
+// Formats every metric that has data as one short line, for the
+// debug overlay. Times are shown in microseconds.
+// =================================================================
+
+vector<string> Metrics::summary() {
+    lock_guard<mutex> lock(registryMutex);
+    vector<string> lines;
+    char line[128];
+    for (auto& entry : histograms) {
+        const Histogram& h = *entry.second;
+        if (h.count() == 0) continue;
+        bool time = entry.first.size() > 3 && entry.first.compare(entry.first.size() - 3, 3, ".ns") == 0;
+        double scale = time ? 1e-3 : 1;
+        snprintf(line, sizeof(line), "%-28.28s n=%-6llu p50=%-9.1f p99=%-9.1f%s", entry.first.c_str(),
+                 (unsigned long long)h.count(), h.percentile(0.5) * scale, h.percentile(0.99) * scale, time ? "us" : "");
+        lines.push_back(line);
+    }
+    for (auto& entry : counters) {
+        snprintf(line, sizeof(line), "%-28.28s %llu", entry.first.c_str(), (unsigned long long)entry.second->value());
+        lines.push_back(line);
+    }
+    for (auto& entry : gauges) {
+        snprintf(line, sizeof(line), "%-28.28s %lld", entry.first.c_str(), (long long)entry.second->value());
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// =================================================================
+// Returns every metric as a JSON object
+// =================================================================
+
+string Metrics::toJson() {
+    lock_guard<mutex> lock(registryMutex);
+    string json = "{\n  \"counters\": {";
+    char buffer[256];
+    const char* separator = "\n";
+    for (auto& entry : counters) {
+        snprintf(buffer, sizeof(buffer), "%s    \"%s\": %llu", separator, entry.first.c_str(),
+                 (unsigned long long)entry.second->value());
+        json += buffer;
+        separator = ",\n";
+    }
+    json += "\n  },\n  \"gauges\": {";
+    separator = "\n";
+    for (auto& entry : gauges) {
+        snprintf(buffer, sizeof(buffer), "%s    \"%s\": %lld", separator, entry.first.c_str(),
+                 (long long)entry.second->value());
+        json += buffer;
+        separator = ",\n";
+    }
+    json += "\n  },\n  \"histograms\": {";
+    separator = "\n";
+    for (auto& entry : histograms) {
+        const Histogram& h = *entry.second;
+        snprintf(buffer, sizeof(buffer),
+                 "%s    \"%s\": {\"count\": %llu, \"min\": %llu, \"mean\": %.1f, \"p50\": %llu, "
+                 "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+                 separator, entry.first.c_str(), (unsigned long long)h.count(), (unsigned long long)h.min(), h.mean(),
+                 (unsigned long long)h.percentile(0.5), (unsigned long long)h.percentile(0.9),
+                 (unsigned long long)h.percentile(0.99), (unsigned long long)h.percentile(0.999),
+                 (unsigned long long)h.max());
+        json += buffer;
+        separator = ",\n";
+    }
+    json += "\n  }\n}\n";
+    return json;
+}
+
+// =================================================================
+// Writes every metric to a JSON file
+//
+// @param path The file
+// @return false if the file could not be written
+// =================================================================
+
+bool Metrics::dumpJson(const string& path) {
+    ofstream out(path);
+    if (!out) return false;
+    out << toJson();
+    return bool(out);
+}
+
+#ifndef RPG_NO_METRICS
+
+#define METRICS_JOIN2(a, b) a##b
+#define METRICS_JOIN(a, b) METRICS_JOIN2(a, b)
+
+// Adds to a counter
+#define METRICS_COUNT(name, amount) \
+    do { static Counter& metricsCounter = Metrics::counter(name); metricsCounter.add(amount); } while (0)
+// Adds to a gauge
+#define METRICS_GAUGE_ADD(name, amount) \
+    do { static Gauge& metricsGauge = Metrics::gauge(name); metricsGauge.add(amount); } while (0)
+// Records a value into a histogram
+#define METRICS_RECORD(name, value) \
+    do { static Histogram& metricsHistogram = Metrics::histogram(name); metricsHistogram.record(value); } while (0)
+// Records the time until the end of the enclosing scope
+#define METRICS_TIME(name) \
+    static Histogram& METRICS_JOIN(metricsHistogram, __LINE__) = Metrics::histogram(name); \
+    ScopedTimer METRICS_JOIN(metricsTimer, __LINE__)(METRICS_JOIN(metricsHistogram, __LINE__))
+// Records the time until the end of the enclosing scope into a histogram
+#define METRICS_TIME_INTO(histogram) ScopedTimer METRICS_JOIN(metricsTimer, __LINE__)(histogram)
+// Makes a scene the current one
+#define METRICS_ENTER_SCENE(name) Metrics::enterScene(name)
+// Declares a stopwatch, started and stopped by the two macros below
+#define METRICS_STOPWATCH(watch) int64_t watch = 0
+#define METRICS_START(watch) (watch = monotonicNow())
+// Records the time since the stopwatch started, if it did
+#define METRICS_STOP(watch, name) \
+    do { if (watch) { METRICS_RECORD(name, uint64_t(monotonicNow() - watch)); watch = 0; } } while (0)
+// Declares a variable holding the allocations made so far by this thread
+#define METRICS_MARK_ALLOCATIONS(mark) uint64_t mark = Metrics::allocations()
+// Records the allocations made since the mark
+#define METRICS_RECORD_ALLOCATIONS(mark, name) METRICS_RECORD(name, Metrics::allocations() - mark)
+
+// =================================================================
+// Replacements of the global allocation functions that count the
+// allocations of every thread. The count lives in a thread-local
+// variable, so it costs one increment and no atomic. They are kept
+// out of line so the compiler does not see malloc() behind operator
+// new and warn about the matching delete.
+// =================================================================
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    ++threadAllocations;
+    void* memory = malloc(size ? size : 1);
+    if (!memory) throw bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+#else
+
+#define METRICS_COUNT(name, amount) do {} while (0)
+#define METRICS_GAUGE_ADD(name, amount) do {} while (0)
+#define METRICS_RECORD(name, value) do {} while (0)
+#define METRICS_TIME(name)
+#define METRICS_TIME_INTO(histogram)
+#define METRICS_ENTER_SCENE(name) do {} while (0)
+#define METRICS_STOPWATCH(watch)
+#define METRICS_START(watch) do {} while (0)
+#define METRICS_STOP(watch, name) do {} while (0)
+#define METRICS_MARK_ALLOCATIONS(mark)
+#define METRICS_RECORD_ALLOCATIONS(mark, name) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+// =================================================================
+//
+// File: Progression.h
+// Author: Alexis Berthou
+// Description: This file contains the experience curve and the stat
+// growth of the hero classes, as tables built at compile time.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef PROGRESSION_H
+#define PROGRESSION_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+const int MaxLevel = 50;
+
+// =================================================================
+// Class of a hero, used by the class filter of the character
+// selector and by the growth tables
+// =================================================================
+
+enum class HeroClass : uint8_t {
+    Any,
+    Warrior,
+    Archer,
+    Mage
+};
+
+const int HeroClassCount = 3;   // not counting Any
+
+// =================================================================
+// The stats of a hero class at one level
+// =================================================================
+
+struct StatLine {
+    int16_t maxHealth, maxMana, strength, shield;
+};
+
+// =================================================================
+// Returns the experience that takes a hero from a level to the
+// next: 100 at level 1, then 50 more at every level
+//
+// @param level The level, from 1
+// =================================================================
+
+constexpr int32_t xpToNextLevel(int level) {
+    return 100 + 50 * (level - 1);
+}
+
+// =================================================================
+// Builds the table of the total experience each level needs.
+// Entry 0 is unused and entry MaxLevel + 1 can never be reached, so
+// "the next level" can be looked up for any level.
+// =================================================================
+
+constexpr array<int32_t, MaxLevel + 2> makeXpTable() {
+    array<int32_t, MaxLevel + 2> table{};
+    table[1] = 0;
+    for (int level = 1; level < MaxLevel; ++level) {
+        table[level + 1] = table[level] + xpToNextLevel(level);
+    }
+    table[MaxLevel + 1] = INT32_MAX;
+    return table;
+}
+
+constexpr array<int32_t, MaxLevel + 2> xpTable = makeXpTable();
+
+// The most experience a hero keeps; beyond it nothing changes
+const int32_t MaxXp = xpTable[MaxLevel];
+
+// =================================================================
+// Builds the level of every multiple of XpStep experience. No level
+// is shorter than XpStep, so between two multiples a hero gains at
+// most one level, which makes finding the level of any experience
+// one lookup and one comparison.
+// =================================================================
+
+const int32_t XpStep = xpToNextLevel(1);
+
+constexpr bool noLevelShorterThanStep() {
+    for (int level = 1; level < MaxLevel; ++level) {
+        if (xpToNextLevel(level) < XpStep) return false;
+    }
+    return true;
+}
+static_assert(noLevelShorterThanStep(), "levelForXp() needs every level to be at least XpStep long");
+
+constexpr array<uint8_t, MaxXp / XpStep + 1> makeLevelIndex() {
+    array<uint8_t, MaxXp / XpStep + 1> index{};
+    int level = 1;
+    for (size_t bucket = 0; bucket < index.size(); ++bucket) {
+        while (level < MaxLevel && xpTable[level + 1] <= int32_t(bucket) * XpStep) ++level;
+        index[bucket] = uint8_t(level);
+    }
+    return index;
+}
+
+constexpr array<uint8_t, MaxXp / XpStep + 1> levelIndex = makeLevelIndex();
+
+// =================================================================
+// Returns the level a hero has with some experience
+//
+// @param xp The experience, from 0
+// =================================================================
+
+constexpr int levelForXp(int32_t xp) {
+    if (xp >= MaxXp) return MaxLevel;
+    if (xp < 0) return 1;
+    int level = levelIndex[xp / XpStep];
+    return level + (xp >= xpTable[level + 1] ? 1 : 0);
+}
+
+// =================================================================
+// Adds the same experience to many heroes kept as plain arrays, as
+// simulations that age thousands of heroes do. Every hero costs a
+// few loads and no branches that depend on its data.
+//
+// @param xp The experience of the heroes, updated
+// @param levels Receives their levels
+// @param count The number of heroes
+// @param amount The experience each one gains, from 0
+// =================================================================
+
+void gainXpBulk(int32_t* xp, uint8_t* levels, size_t count, int32_t amount) {
+    for (size_t i = 0; i < count; ++i) {
+        int32_t total = xp[i] > MaxXp - amount ? MaxXp : xp[i] + amount;
+        xp[i] = total;
+        levels[i] = uint8_t(levelForXp(total));
+    }
+}
+
+// =================================================================
+// Builds the stats of a class at every level. Every level adds the
+// gains of the class, and a fortieth more for every level already
+// gained, so late levels are worth a little more than early ones.
+//
+// @param base The stats at level 1
+// @param gain What a level adds at first
+// =================================================================
+
+constexpr array<StatLine, MaxLevel + 1> makeGrowth(StatLine base, StatLine gain) {
+    array<StatLine, MaxLevel + 1> table{};
+    for (int level = 1; level <= MaxLevel; ++level) {
+        int n = level - 1;
+        auto grow = [n](int start, int step) { return int16_t(start + step * n + step * n * n / 40); };
+        table[level] = { grow(base.maxHealth, gain.maxHealth), grow(base.maxMana, gain.maxMana),
+                         grow(base.strength, gain.strength), grow(base.shield, gain.shield) };
+    }
+    return table;
+}
+
+// =================================================================
+// The stats of every hero class at every level, in the order of
+// HeroClass after Any; row 0 is unused. Level 1 is what the class
+// constructors have always given.
+// =================================================================
+
+constexpr array<array<StatLine, MaxLevel + 1>, HeroClassCount> classGrowth = { {
+    makeGrowth({ 80, 30, 40, 20 }, { 12, 2, 4, 2 }),      // Warrior
+    makeGrowth({ 60, 50, 30, 15 }, { 8, 4, 4, 2 }),       // Archer
+    makeGrowth({ 65, 100, 20, 10 }, { 6, 8, 3, 1 })       // Mage
+} };
+
+// =================================================================
+// Returns the stats of a class, indexed by level
+//
+// @param heroClass The class, not Any
+// =================================================================
+
+constexpr const StatLine* growthOf(HeroClass heroClass) {
+    return classGrowth[int(heroClass) - 1].data();
+}
+
+#endif
@@ -0,0 +1,368 @@
+// =================================================================
+//
+// File: Protocol.h
+// Author: Alexis Berthou
+// Description: This file contains the binary protocol spoken by the
+// game server and its clients over a Unix domain socket.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Every message is a frame: a 16-bit payload length, a type byte and
+// the payload. Integers are little-endian and strings carry a one
+// byte length, so a battle event fits in 16 bytes. No payload is
+// longer than MaxPayloadSize; either side hangs up on a frame that
+// claims more.
+//
+// Client to server:
+//   CreateHero   u8 class (0 Warrior, 1 Archer, 2 Mage), str name
+//   ListLevels   u16 first level
+//   StartBattle  u16 hero, u16 level
+//   Command      u8 command (0 Attack, 1 Recover, 2 Continue, 3 Exit,
+//                4 Rewind)
+//   ResetHeroes  -
+//
+// Server to client:
+//   Welcome      u16 levels, u16 worker threads
+//   HeroCreated  u16 hero
+//   LevelList    u16 levels, u16 first, u16 count, then per level:
+//                str name, str enemy (both cut to MaxListedName),
+//                u16 enemy health, u8 won. As many levels as fit in
+//                a frame; the client asks again from first + count.
+//   Event        u8 type, u8 actor, i16 amount, i16 hero health,
+//                i16 hero mana, i16 enemy health, i16 enemy mana,
+//                u8 alive (bit 0 hero, bit 1 enemy)
+//   Error        u8 error
+// =================================================================
+
+const size_t FrameHeaderSize = 3;
+const size_t MaxPayloadSize = 512;
+const size_t MaxListedName = 64;
+
+enum class MessageType : uint8_t {
+    CreateHero = 1,
+    ListLevels,
+    StartBattle,
+    Command,
+    ResetHeroes,
+
+    Welcome = 64,
+    HeroCreated,
+    LevelList,
+    Event,
+    Error
+};
+
+// Values of the type byte of an Event; the same as CombatEvent::Type
+enum class WireEvent : uint8_t {
+    Attack,
+    Absorbed,
+    Recover,
+    Death,
+    AwaitAction,
+    AwaitContinue,
+    End,
+    Afflicted,
+    EffectTick,
+    Stunned,
+    EffectEnded,
+    Missed,
+    Critical,
+    Rewound
+};
+
+enum class ProtocolError : uint8_t {
+    BadMessage,
+    RosterFull,
+    NoSuchHero,
+    NoSuchLevel,
+    HeroDead,
+    InBattle,
+    NoBattle,
+    Busy
+};
+
+// =================================================================
+// A decoded Event message
+// =================================================================
+
+struct EventMessage {
+    WireEvent type;
+    uint8_t actor;
+    int amount;
+    int heroHealth, heroMana, enemyHealth, enemyMana;
+    bool heroAlive, enemyAlive;
+};
+
+// =================================================================
+// Contains the definition of the MessageWriter class
+// Appends one frame to an output buffer. The length is patched in
+// by finish(), so the payload is written once, in place.
+// =================================================================
+
+class MessageWriter {
+private:
+    vector<uint8_t>& out;
+    size_t start;
+
+public:
+    MessageWriter(vector<uint8_t>& buffer, MessageType type);
+
+    void putU8(uint8_t value);
+    void putU16(uint16_t value);
+    void putI16(int value);
+    void putString(const string& value, size_t maxLength = 255);
+    size_t size() const;
+    bool finish();
+};
+
+// =================================================================
+// Contains the definition of the MessageReader class
+// Reads the payload of one frame. Reading past its end returns
+// zeros and marks the reader as failed, so a handler can decode
+// every field and check ok() once.
+// =================================================================
+
+class MessageReader {
+private:
+    const uint8_t* data;
+    size_t size, position;
+    bool failed;
+
+public:
+    MessageReader(const uint8_t* payload, size_t length);
+
+    uint8_t getU8();
+    uint16_t getU16();
+    int getI16();
+    string getString();
+    bool ok() const;
+};
+
+// =================================================================
+// Constructor. Starts a frame at the end of the buffer.
+//
+// @param buffer The output buffer
+// @param type The type of the message
+// =================================================================
+
+MessageWriter::MessageWriter(vector<uint8_t>& buffer, MessageType type) : out(buffer), start(buffer.size()) {
+    out.push_back(0);
+    out.push_back(0);
+    out.push_back(uint8_t(type));
+}
+
+// =================================================================
+// Appends an unsigned byte
+//
+// @param value The byte
+// =================================================================
+
+void MessageWriter::putU8(uint8_t value) {
+    out.push_back(value);
+}
+
+// =================================================================
+// Appends an unsigned 16-bit integer
+//
+// @param value The integer
+// =================================================================
+
+void MessageWriter::putU16(uint16_t value) {
+    out.push_back(uint8_t(value));
+    out.push_back(uint8_t(value >> 8));
+}
+
+// =================================================================
+// Appends a signed 16-bit integer. Values out of range are clamped.
+//
+// @param value The integer
+// =================================================================
+
+void MessageWriter::putI16(int value) {
+    if (value > 32767) value = 32767;
+    if (value < -32768) value = -32768;
+    putU16(uint16_t(int16_t(value)));
+}
+
+// =================================================================
+// Appends a string; longer ones are cut
+//
+// @param value The string
+// @param maxLength The most bytes kept, up to 255
+// =================================================================
+
+void MessageWriter::putString(const string& value, size_t maxLength) {
+    if (maxLength > 255) maxLength = 255;
+    size_t length = value.size() < maxLength ? value.size() : maxLength;
+    out.push_back(uint8_t(length));
+    out.insert(out.end(), value.begin(), value.begin() + length);
+}
+
+// =================================================================
+// Returns the length of the payload written so far
+// =================================================================
+
+size_t MessageWriter::size() const {
+    return out.size() - start - FrameHeaderSize;
+}
+
+// =================================================================
+// Writes the length of the payload into the frame header. A payload
+// longer than MaxPayloadSize would be refused by the other side, so
+// the frame is taken back out of the buffer instead.
+//
+// @return false if the frame was too long and was dropped
+// =================================================================
+
+bool MessageWriter::finish() {
+    size_t length = size();
+    if (length > MaxPayloadSize) {
+        out.resize(start);
+        return false;
+    }
+    out[start] = uint8_t(length);
+    out[start + 1] = uint8_t(length >> 8);
+    return true;
+}
+
+// =================================================================
+// Constructor
+//
+// @param payload The first byte of the payload
+// @param length The length of the payload
+// =================================================================
+
+MessageReader::MessageReader(const uint8_t* payload, size_t length)
+    : data(payload), size(length), position(0), failed(false) {}
+
+// =================================================================
+// Reads an unsigned byte
+// =================================================================
+
+uint8_t MessageReader::getU8() {
+    if (position + 1 > size) {
+        failed = true;
+        return 0;
+    }
+    return data[position++];
+}
+
+// =================================================================
+// Reads an unsigned 16-bit integer
+// =================================================================
+
+uint16_t MessageReader::getU16() {
+    if (position + 2 > size) {
+        failed = true;
+        return 0;
+    }
+    uint16_t value = uint16_t(data[position] | (data[position + 1] << 8));
+    position += 2;
+    return value;
+}
+
+// =================================================================
+// Reads a signed 16-bit integer
+// =================================================================
+
+int MessageReader::getI16() {
+    return int16_t(getU16());
+}
+
+// =================================================================
+// Reads a string
+// =================================================================
+
+string MessageReader::getString() {
+    size_t length = getU8();
+    if (position + length > size) {
+        failed = true;
+        return "";
+    }
+    string value(reinterpret_cast<const char*>(data + position), length);
+    position += length;
+    return value;
+}
+
+// =================================================================
+// Checks that every field read so far was in the payload
+// =================================================================
+
+bool MessageReader::ok() const {
+    return !failed;
+}
+
+// =================================================================
+// Finds the next complete frame in an input buffer
+//
+// @param buffer The received bytes
+// @param offset Position of the frame; moved past it when complete
+// @param type Receives the type of the message
+// @param payload Receives the position of the payload
+// @param length Receives the length of the payload
+// @return false if the frame has not fully arrived yet
+// =================================================================
+
+bool nextFrame(const vector<uint8_t>& buffer, size_t& offset, MessageType& type, size_t& payload, size_t& length) {
+    if (buffer.size() - offset < FrameHeaderSize) return false;
+    length = buffer[offset] | (buffer[offset + 1] << 8);
+    if (buffer.size() - offset - FrameHeaderSize < length) return false;
+    type = MessageType(buffer[offset + 2]);
+    payload = offset + FrameHeaderSize;
+    offset = payload + length;
+    return true;
+}
+
+// =================================================================
+// Checks whether the frame at a position of an input buffer claims
+// a payload longer than MaxPayloadSize. It would never be read, so
+// the connection is given up on.
+//
+// @param buffer The received bytes
+// @param offset Position of the frame
+// =================================================================
+
+bool frameTooLarge(const vector<uint8_t>& buffer, size_t offset) {
+    if (buffer.size() - offset < 2) return false;
+    size_t claimed = buffer[offset] | (buffer[offset + 1] << 8);
+    return claimed > MaxPayloadSize;
+}
+
+// =================================================================
+// Decodes the payload of an Event message
+//
+// @param reader The payload
+// @return The event
+// =================================================================
+
+EventMessage readEvent(MessageReader& reader) {
+    EventMessage event;
+    event.type = WireEvent(reader.getU8());
+    event.actor = reader.getU8();
+    event.amount = reader.getI16();
+    event.heroHealth = reader.getI16();
+    event.heroMana = reader.getI16();
+    event.enemyHealth = reader.getI16();
+    event.enemyMana = reader.getI16();
+    uint8_t alive = reader.getU8();
+    event.heroAlive = alive & 1;
+    event.enemyAlive = alive & 2;
+    return event;
+}
+
+#endif
@@ -0,0 +1,284 @@
+// =================================================================
+//
+// File: Random.h
+// Author: Alexis Berthou
+// Description: This file contains the Philox counter-based random
+// number generator and the RandomStream class, which gives every
+// battle its own reproducible stream of numbers.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// =================================================================
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+// 1, 2, 3"). A block of four numbers is a keyed function of a
+// 128-bit counter, so any number of any stream is computed directly
+// from its position: nothing is shared between streams and nothing
+// has to be stepped through to reach a position.
+//
+// The key is the seed of the game. The counter holds the index of
+// the block in its low half and the id of the stream in its high
+// half, so every stream has 2^64 blocks of its own.
+// =================================================================
+
+const uint32_t PhiloxM0 = 0xD2511F53;
+const uint32_t PhiloxM1 = 0xCD9E8D57;
+const uint32_t PhiloxW0 = 0x9E3779B9;
+const uint32_t PhiloxW1 = 0xBB67AE85;
+const int PhiloxRounds = 10;
+
+struct PhiloxBlock {
+    uint32_t v[4];
+};
+
+// =================================================================
+// Computes one block
+//
+// @param seed The key
+// @param stream The id of the stream
+// @param index The index of the block in the stream
+// =================================================================
+
+constexpr PhiloxBlock philox(uint64_t seed, uint64_t stream, uint64_t index) {
+    uint32_t c0 = uint32_t(index), c1 = uint32_t(index >> 32);
+    uint32_t c2 = uint32_t(stream), c3 = uint32_t(stream >> 32);
+    uint32_t k0 = uint32_t(seed), k1 = uint32_t(seed >> 32);
+    for (int round = 0; round < PhiloxRounds; ++round) {
+        uint64_t p0 = uint64_t(PhiloxM0) * c0;
+        uint64_t p1 = uint64_t(PhiloxM1) * c2;
+        uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c1 = uint32_t(p1);
+        c3 = uint32_t(p0);
+        c0 = n0;
+        c2 = n2;
+        k0 += PhiloxW0;
+        k1 += PhiloxW1;
+    }
+    return { { c0, c1, c2, c3 } };
+}
+
+// The known answers published with the reference implementation
+static_assert(philox(0, 0, 0).v[0] == 0x6627e8d5 && philox(0, 0, 0).v[3] == 0x9b00dbd8,
+              "Philox4x32-10 does not match the reference");
+static_assert(philox(UINT64_MAX, UINT64_MAX, UINT64_MAX).v[0] == 0x408f276d &&
+              philox(UINT64_MAX, UINT64_MAX, UINT64_MAX).v[3] == 0x6d5451fd,
+              "Philox4x32-10 does not match the reference");
+
+// =================================================================
+// Fills a buffer with consecutive blocks of a stream, the same
+// numbers RandomStream::next() returns from that block on. Blocks
+// are computed eight at a time with every step of a round done for
+// all eight before the next one, plain loops over arrays that the
+// compiler turns into vector multiplies (pmuludq on x86), so batch
+// simulations pay a fraction of the scalar cost per number.
+//
+// @param seed The key
+// @param stream The id of the stream
+// @param first The index of the first block
+// @param out Receives 4 * blocks numbers
+// @param blocks The number of blocks
+// =================================================================
+
+void philoxFill(uint64_t seed, uint64_t stream, uint64_t first, uint32_t* out, size_t blocks) {
+    const int Lanes = 8;
+    size_t done = 0;
+    for (; done + Lanes <= blocks; done += Lanes) {
+        uint32_t c0[Lanes], c1[Lanes], c2[Lanes], c3[Lanes];
+        for (int i = 0; i < Lanes; ++i) {
+            uint64_t index = first + done + i;
+            c0[i] = uint32_t(index);
+            c1[i] = uint32_t(index >> 32);
+            c2[i] = uint32_t(stream);
+            c3[i] = uint32_t(stream >> 32);
+        }
+        uint32_t k0 = uint32_t(seed), k1 = uint32_t(seed >> 32);
+        for (int round = 0; round < PhiloxRounds; ++round) {
+            for (int i = 0; i < Lanes; ++i) {
+                uint64_t p0 = uint64_t(PhiloxM0) * c0[i];
+                uint64_t p1 = uint64_t(PhiloxM1) * c2[i];
+                uint32_t n0 = uint32_t(p1 >> 32) ^ c1[i] ^ k0;
+                uint32_t n2 = uint32_t(p0 >> 32) ^ c3[i] ^ k1;
+                c1[i] = uint32_t(p1);
+                c3[i] = uint32_t(p0);
+                c0[i] = n0;
+                c2[i] = n2;
+            }
+            k0 += PhiloxW0;
+            k1 += PhiloxW1;
+        }
+        uint32_t* block = out + 4 * done;
+        for (int i = 0; i < Lanes; ++i) {
+            block[4 * i] = c0[i];
+            block[4 * i + 1] = c1[i];
+            block[4 * i + 2] = c2[i];
+            block[4 * i + 3] = c3[i];
+        }
+    }
+    for (; done < blocks; ++done) {
+        PhiloxBlock block = philox(seed, stream, first + done);
+        for (int i = 0; i < 4; ++i) {
+            out[4 * done + i] = block.v[i];
+        }
+    }
+}
+
+// Streams from this id on belong to threads, below it to battles,
+// so a batch simulation can give its threads streams of their own
+// that never meet the stream of a battle
+const uint64_t ThreadStreams = uint64_t(1) << 63;
+
+// =================================================================
+// Returns the stream of a worker thread of a batch simulation
+//
+// @param thread The index of the thread
+// =================================================================
+
+constexpr uint64_t threadStream(uint64_t thread) {
+    return ThreadStreams | thread;
+}
+
+// =================================================================
+// Contains the definition of the RandomStream class
+// The numbers of one stream, read in order. The stream keeps the
+// block it is reading, so a number costs a copy out of it and a
+// block every fourth number. Two streams with the same seed and id
+// read the same numbers whatever thread they run on, which is what
+// makes a battle reproducible from the seed and its battle id.
+// =================================================================
+
+class RandomStream {
+private:
+    uint64_t seed, stream;
+    uint64_t block;     // the index of the next block to compute
+    PhiloxBlock buffer;
+    int used;           // numbers of the buffer already read
+
+public:
+    RandomStream(uint64_t seedValue = 0, uint64_t streamId = 0);
+
+    uint32_t next();
+    uint32_t below(uint32_t bound);
+    bool chance(int percent);
+    int range(int low, int high);
+
+    void seek(uint64_t position);
+    uint64_t position() const;
+    uint64_t getSeed() const;
+    uint64_t getStream() const;
+};
+
+// =================================================================
+// Constructor. Starts at the first number of a stream.
+//
+// @param seedValue The seed of the game
+// @param streamId The id of the stream, such as a battle id
+// =================================================================
+
+RandomStream::RandomStream(uint64_t seedValue, uint64_t streamId)
+    : seed(seedValue), stream(streamId), block(0), buffer{}, used(4) {}
+
+// =================================================================
+// Returns the next number, uniform over all 32-bit values
+// =================================================================
+
+uint32_t RandomStream::next() {
+    if (used == 4) {
+        buffer = philox(seed, stream, block++);
+        used = 0;
+    }
+    return buffer.v[used++];
+}
+
+// =================================================================
+// Returns a number uniform below a bound, by taking the high half of
+// a product and redrawing the few products that would make some
+// results likelier than others (Lemire's method)
+//
+// @param bound The bound, above 0
+// =================================================================
+
+uint32_t RandomStream::below(uint32_t bound) {
+    uint64_t product = uint64_t(next()) * bound;
+    if (uint32_t(product) < bound) {
+        uint32_t threshold = uint32_t(-bound) % bound;
+        while (uint32_t(product) < threshold) {
+            product = uint64_t(next()) * bound;
+        }
+    }
+    return uint32_t(product >> 32);
+}
+
+// =================================================================
+// Rolls for something that happens some percent of the time
+//
+// @param percent The chance, from 0 to 100
+// =================================================================
+
+bool RandomStream::chance(int percent) {
+    return int(below(100)) < percent;
+}
+
+// =================================================================
+// Returns a number uniform between two bounds
+//
+// @param low The lowest result
+// @param high The highest result, not below low
+// =================================================================
+
+int RandomStream::range(int low, int high) {
+    return low + int(below(uint32_t(high - low) + 1));
+}
+
+// =================================================================
+// Moves to any number of the stream without computing the ones
+// before it
+//
+// @param position The number of numbers read from the start
+// =================================================================
+
+void RandomStream::seek(uint64_t position) {
+    block = position / 4;
+    used = 4;
+    if (position % 4) {
+        next();
+        used = int(position % 4);
+    }
+}
+
+// =================================================================
+// Returns the number of numbers read from the start of the stream
+// =================================================================
+
+uint64_t RandomStream::position() const {
+    return block * 4 - (4 - used);
+}
+
+// =================================================================
+// Returns the seed of the stream
+// =================================================================
+
+uint64_t RandomStream::getSeed() const {
+    return seed;
+}
+
+// =================================================================
+// Returns the id of the stream
+// =================================================================
+
+uint64_t RandomStream::getStream() const {
+    return stream;
+}
+
+#endif
@@ -0,0 +1,422 @@
+// =================================================================
+//
+// File: Rating.h
+// Author: Alexis Berthou
+// Description: This file contains the Glicko ratings of heroes and
+// enemies, the RatingBoard class that ranks them, and the re-rating
+// of a whole battle history on many threads.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef RATING_H
+#define RATING_H
+
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// A Glicko rating (Glickman, "Parameter estimation in large dynamic
+// paired comparison experiments"): the strength and how uncertain it
+// still is. A new combatant starts at 1500, give or take 350.
+// =================================================================
+
+struct Rating {
+    double rating = 1500;
+    double deviation = 350;
+};
+
+const double MaxDeviation = 350;
+const double RatingDrift = 35;   // uncertainty gained every rating period; 100 idle periods undo a settled rating
+const double GlickoQ = 0.00575646273; // ln(10) / 400
+const double Pi = 3.14159265358979323846;
+
+// =================================================================
+// Returns how much a game against an opponent counts, less the more
+// uncertain its rating is
+//
+// @param deviation The deviation of the opponent
+// =================================================================
+
+double glickoWeight(double deviation) {
+    return 1 / sqrt(1 + 3 * GlickoQ * GlickoQ * deviation * deviation / (Pi * Pi));
+}
+
+// =================================================================
+// Returns the score a combatant is expected to make against another,
+// from 0 to 1
+//
+// @param player The rating of the combatant
+// @param opponent The rating of the other one
+// =================================================================
+
+double expectedScore(const Rating& player, const Rating& opponent) {
+    return 1 / (1 + exp(-GlickoQ * glickoWeight(opponent.deviation) * (player.rating - opponent.rating)));
+}
+
+// =================================================================
+// The games of one combatant in a rating period, summed. Games add
+// in any order, so they can be summed on many threads and merged.
+// =================================================================
+
+struct RatingTally {
+    double information = 0; // sum of g^2 * E * (1 - E)
+    double surprise = 0;    // sum of g * (score - E)
+    uint32_t games = 0;
+
+    void add(const Rating& player, const Rating& opponent, double score);
+    void merge(const RatingTally& other);
+    Rating apply(const Rating& player) const;
+};
+
+// =================================================================
+// Adds a game
+//
+// @param player The rating of the combatant at the start of the period
+// @param opponent The rating of the opponent at the start of the period
+// @param score 1 for a win, 0.5 for a draw and 0 for a loss
+// =================================================================
+
+void RatingTally::add(const Rating& player, const Rating& opponent, double score) {
+    double weight = glickoWeight(opponent.deviation);
+    double expected = 1 / (1 + exp(-GlickoQ * weight * (player.rating - opponent.rating)));
+    information += weight * weight * expected * (1 - expected);
+    surprise += weight * (score - expected);
+    ++games;
+}
+
+// =================================================================
+// Adds the games of another tally
+//
+// @param other The tally
+// =================================================================
+
+void RatingTally::merge(const RatingTally& other) {
+    information += other.information;
+    surprise += other.surprise;
+    games += other.games;
+}
+
+// =================================================================
+// Returns the rating at the end of the period. The deviation first
+// grows by the drift of a period, then shrinks with the games.
+//
+// @param player The rating at the start of the period
+// =================================================================
+
+Rating RatingTally::apply(const Rating& player) const {
+    double deviation = min(sqrt(player.deviation * player.deviation + RatingDrift * RatingDrift), MaxDeviation);
+    if (games == 0) return { player.rating, deviation };
+    double precision = 1 / (deviation * deviation) + GlickoQ * GlickoQ * information;
+    return { player.rating + GlickoQ / precision * surprise, sqrt(1 / precision) };
+}
+
+// =================================================================
+// Rates one battle as a rating period of its own, as the game does
+// after every battle
+//
+// @param first One combatant
+// @param second The other one
+// @param score The score of the first: 1 if it won, 0.5 for a draw
+// and 0 if it lost
+// =================================================================
+
+void rateBattle(Rating& first, Rating& second, double score) {
+    RatingTally tallies[2];
+    tallies[0].add(first, second, score);
+    tallies[1].add(second, first, 1 - score);
+    first = tallies[0].apply(first);
+    second = tallies[1].apply(second);
+}
+
+// =================================================================
+// Contains the definition of the RatingBoard class
+// The ratings of many combatants, numbered from 0, and their order.
+// The order is a red-black tree that keeps the size of every subtree
+// (the policy-based tree of libstdc++), so updating a rating, the
+// rank of a combatant and the combatant at a rank are all O(log n),
+// and the top k are read in O(log n + k).
+// =================================================================
+
+class RatingBoard {
+private:
+    // Higher ratings first; the number breaks ties so keys are unique
+    typedef pair<double, uint32_t> Key;
+    struct HigherFirst {
+        bool operator()(const Key& a, const Key& b) const {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        }
+    };
+    typedef __gnu_pbds::tree<Key, __gnu_pbds::null_type, HigherFirst, __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update> Order;
+
+    vector<Rating> ratings;
+    Order order;
+
+public:
+    RatingBoard(size_t players = 0);
+
+    uint32_t add(const Rating& rating = Rating());
+    void assign(const vector<Rating>& all);
+    void set(uint32_t player, const Rating& rating);
+    void recordBattle(uint32_t first, uint32_t second, double score);
+
+    size_t size() const;
+    const Rating& at(uint32_t player) const;
+    const vector<Rating>& all() const;
+    size_t rank(uint32_t player) const;
+    uint32_t atRank(size_t rank) const;
+    vector<uint32_t> top(size_t count) const;
+};
+
+// =================================================================
+// Constructor. Every combatant starts with a new rating.
+//
+// @param players The number of combatants
+// =================================================================
+
+RatingBoard::RatingBoard(size_t players) {
+    assign(vector<Rating>(players));
+}
+
+// =================================================================
+// Adds a combatant
+//
+// @param rating Its rating
+// @return Its number
+// =================================================================
+
+uint32_t RatingBoard::add(const Rating& rating) {
+    uint32_t player = uint32_t(ratings.size());
+    ratings.push_back(rating);
+    order.insert({ rating.rating, player });
+    return player;
+}
+
+// =================================================================
+// Replaces every rating, as a re-rating does
+//
+// @param all The ratings of the combatants, by number
+// =================================================================
+
+void RatingBoard::assign(const vector<Rating>& all) {
+    ratings = all;
+    order.clear();
+    for (uint32_t player = 0; player < ratings.size(); ++player) {
+        order.insert({ ratings[player].rating, player });
+    }
+}
+
+// =================================================================
+// Changes the rating of a combatant
+//
+// @param player The combatant
+// @param rating Its new rating
+// =================================================================
+
+void RatingBoard::set(uint32_t player, const Rating& rating) {
+    order.erase({ ratings[player].rating, player });
+    ratings[player] = rating;
+    order.insert({ rating.rating, player });
+}
+
+// =================================================================
+// Rates a battle between two combatants
+//
+// @param first One combatant
+// @param second The other one
+// @param score The score of the first
+// =================================================================
+
+void RatingBoard::recordBattle(uint32_t first, uint32_t second, double score) {
+    Rating a = ratings[first];
+    Rating b = ratings[second];
+    rateBattle(a, b, score);
+    set(first, a);
+    set(second, b);
+}
+
+// =================================================================
+// Returns the number of combatants
+// =================================================================
+
+size_t RatingBoard::size() const {
+    return ratings.size();
+}
+
+// =================================================================
+// Returns the rating of a combatant
+//
+// @param player The combatant
+// =================================================================
+
+const Rating& RatingBoard::at(uint32_t player) const {
+    return ratings[player];
+}
+
+// =================================================================
+// Returns the ratings of every combatant, by number
+// =================================================================
+
+const vector<Rating>& RatingBoard::all() const {
+    return ratings;
+}
+
+// =================================================================
+// Returns the place of a combatant, 0 for the best
+//
+// @param player The combatant
+// =================================================================
+
+size_t RatingBoard::rank(uint32_t player) const {
+    return order.order_of_key({ ratings[player].rating, player });
+}
+
+// =================================================================
+// Returns the combatant at a place
+//
+// @param rank The place, below size()
+// =================================================================
+
+uint32_t RatingBoard::atRank(size_t rank) const {
+    return order.find_by_order(rank)->second;
+}
+
+// =================================================================
+// Returns the best combatants
+//
+// @param count How many, at most
+// @return Their numbers, best first
+// =================================================================
+
+vector<uint32_t> RatingBoard::top(size_t count) const {
+    vector<uint32_t> best;
+    for (auto it = order.begin(); it != order.end() && best.size() < count; ++it) {
+        best.push_back(it->second);
+    }
+    return best;
+}
+
+// =================================================================
+// A battle of a history to re-rate
+// =================================================================
+
+struct RatedBattle {
+    uint32_t first, second;
+    float score;        // of the first
+};
+
+// Fills a buffer with the next battles of a history and returns how
+// many it wrote; 0 when the history is over
+typedef function<size_t(RatedBattle* battles, size_t capacity)> BattleSource;
+
+// =================================================================
+// Re-rates combatants from scratch over a history, read once from
+// start to end. The history is cut into rating periods of a number
+// of battles; in Glicko every battle of a period is rated against
+// the ratings at its start, so the battles of a period are tallied
+// on all the threads at once, each thread in its own tallies over
+// its share. The calling thread reads the next period while they
+// work, then merges the tallies of the combatants that played and
+// applies them. A std::barrier marks the start and the end of every
+// period. Combatants that sit out a period keep their rating as it
+// is, deviation included.
+//
+// @param ratings The ratings at the start, replaced by the ones at
+// the end; every combatant of the history must have one
+// @param source The history
+// @param period The battles of a rating period
+// @param threads The number of threads, 0 for one per core
+// @return The number of battles rated
+// =================================================================
+
+uint64_t rerate(vector<Rating>& ratings, const BattleSource& source, size_t period, int threads) {
+    if (threads <= 0) threads = int(max(1u, thread::hardware_concurrency()));
+    if (period == 0) period = 1;
+    size_t players = ratings.size();
+
+    struct Share {
+        vector<RatingTally> tallies;
+        vector<uint32_t> played;    // the combatants with a tally
+    };
+    vector<Share> shares(threads);
+    for (Share& share : shares) {
+        share.tallies.resize(players);
+    }
+    vector<RatedBattle> buffers[2] = { vector<RatedBattle>(period), vector<RatedBattle>(period) };
+    size_t counts[2] = { source(buffers[0].data(), period), 0 };
+    int current = 0;
+    bool done = counts[0] == 0;
+    uint64_t rated = 0;
+
+    barrier<> sync(threads + 1);
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            Share& share = shares[t];
+            while (true) {
+                sync.arrive_and_wait();     // a period is ready
+                if (done) return;
+                const RatedBattle* battles = buffers[current].data();
+                size_t count = counts[current];
+                size_t from = count * t / threads, to = count * (t + 1) / threads;
+                for (size_t i = from; i < to; ++i) {
+                    const RatedBattle& battle = battles[i];
+                    RatingTally& first = share.tallies[battle.first];
+                    RatingTally& second = share.tallies[battle.second];
+                    if (first.games == 0) share.played.push_back(battle.first);
+                    if (second.games == 0) share.played.push_back(battle.second);
+                    first.add(ratings[battle.first], ratings[battle.second], battle.score);
+                    second.add(ratings[battle.second], ratings[battle.first], 1 - battle.score);
+                }
+                sync.arrive_and_wait();     // the period is tallied
+            }
+        });
+    }
+
+    vector<RatingTally> merged(players);
+    vector<uint32_t> played;
+    while (!done) {
+        sync.arrive_and_wait();
+        rated += counts[current];
+        counts[1 - current] = source(buffers[1 - current].data(), period);
+        sync.arrive_and_wait();
+
+        for (Share& share : shares) {
+            for (uint32_t player : share.played) {
+                if (merged[player].games == 0) played.push_back(player);
+                merged[player].merge(share.tallies[player]);
+                share.tallies[player] = RatingTally();
+            }
+            share.played.clear();
+        }
+        for (uint32_t player : played) {
+            ratings[player] = merged[player].apply(ratings[player]);
+            merged[player] = RatingTally();
+        }
+        played.clear();
+        current = 1 - current;
+        done = counts[current] == 0;
+    }
+    sync.arrive_and_wait();
+    for (thread& worker : pool) {
+        worker.join();
+    }
+    return rated;
+}
+
+#endif
@@ -0,0 +1,568 @@
+// =================================================================
+//
+// File: RenderBackend.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// RenderBackend interface and its two implementations: the ncurses
+// terminal and an in-memory headless screen.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef RENDERBACKEND_H
+#define RENDERBACKEND_H
+
+#include "Layout.h"
+#include <ncurses.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the RenderBackend interface
+// The UI draws into numbered regions. Region 0 always covers the
+// whole screen; the others are composed on top of it, in order,
+// when present() is called.
+// =================================================================
+
+class RenderBackend {
+public:
+    virtual ~RenderBackend() {}
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual int getLines() const = 0;
+    virtual int getCols() const = 0;
+
+    virtual void setRegions(const vector<Rect>& regions) = 0;
+    virtual void clearRegion(int region) = 0;
+    virtual void putText(int region, int row, int col, const char* text, int length, int color) = 0;
+    virtual void putChar(int region, int row, int col, char c, int color) = 0;
+    virtual void present() = 0;
+
+    // Input. inputFd() is polled by the event loop; a backend without
+    // a descriptor returns -1 and must always have a key ready.
+    virtual int inputFd() const = 0;
+    virtual int readKey() = 0;
+};
+
+// =================================================================
+// Contains the definition of the NcursesBackend class
+// Every region is an off-screen window. present() copies them to
+// the virtual screen with wnoutrefresh() and flushes once with
+// doupdate().
+// =================================================================
+
+class NcursesBackend : public RenderBackend {
+private:
+    vector<WINDOW*> windows;
+
+    void destroyWindows();
+
+public:
+    NcursesBackend();
+    ~NcursesBackend();
+
+    void start() override;
+    void stop() override;
+    int getLines() const override;
+    int getCols() const override;
+
+    void setRegions(const vector<Rect>& regions) override;
+    void clearRegion(int region) override;
+    void putText(int region, int row, int col, const char* text, int length, int color) override;
+    void putChar(int region, int row, int col, char c, int color) override;
+    void present() override;
+
+    int inputFd() const override;
+    int readKey() override;
+};
+
+// =================================================================
+// Constructor
+// =================================================================
+
+NcursesBackend::NcursesBackend() {}
+
+// =================================================================
+// Destructor
+// =================================================================
+
+NcursesBackend::~NcursesBackend() {
+    destroyWindows();
+}
+
+// =================================================================
+// Initializes the ncurses library and sets up the terminal for
+// the game.
+// =================================================================
+
+void NcursesBackend::start() {
+    initscr(); // Initialize ncurses
+    cbreak(); // Disable line buffering
+    noecho(); // Don't echo input characters
+    keypad(stdscr, TRUE); // Enable function keys
+    set_escdelay(25); // Esc is a key of its own, don't wait for a sequence
+    nodelay(stdscr, TRUE); // getch() never blocks, the event loop waits instead
+    curs_set(0); // Hide the cursor
+    start_color(); // Start color functionality
+    init_pair(1, COLOR_WHITE, COLOR_BLACK); // Default color pair
+    init_pair(2, COLOR_RED, COLOR_BLACK); // Red color pair
+    init_pair(3, COLOR_GREEN, COLOR_BLACK); // Green color pair
+    init_pair(4, COLOR_BLUE, COLOR_BLACK); // Blue color pair
+    init_pair(5, COLOR_BLACK, COLOR_RED); // Red Black inverted
+    bkgd(COLOR_PAIR(1)); // Set the background color to default
+    refresh(); // Flush stdscr once so getch() never repaints it
+}
+
+// =================================================================
+// Deletes the windows and restores the terminal settings
+// =================================================================
+
+void NcursesBackend::stop() {
+    destroyWindows();
+    endwin();
+}
+
+// =================================================================
+// Returns the number of terminal lines
+// =================================================================
+
+int NcursesBackend::getLines() const {
+    return LINES;
+}
+
+// =================================================================
+// Returns the number of terminal columns
+// =================================================================
+
+int NcursesBackend::getCols() const {
+    return COLS;
+}
+
+// =================================================================
+// Deletes every region window
+// =================================================================
+
+void NcursesBackend::destroyWindows() {
+    for (WINDOW* win : windows) {
+        if (win) delwin(win);
+    }
+    windows.clear();
+}
+
+// =================================================================
+// Creates one off-screen window per region
+//
+// @param regions The region rectangles, region 0 first
+// =================================================================
+
+void NcursesBackend::setRegions(const vector<Rect>& regions) {
+    destroyWindows();
+    for (const Rect& r : regions) {
+        // Regions squeezed out by a tiny terminal get no window
+        WINDOW* win = (r.height > 0 && r.width > 0) ? newwin(r.height, r.width, r.top, r.left) : nullptr;
+        if (win) wbkgd(win, COLOR_PAIR(1));
+        windows.push_back(win);
+    }
+}
+
+// =================================================================
+// Clears a region
+//
+// @param region The region index
+// =================================================================
+
+void NcursesBackend::clearRegion(int region) {
+    if (region >= 0 && region < (int)windows.size() && windows[region]) werase(windows[region]);
+}
+
+// =================================================================
+// Writes text into a region. The caller has already clipped it.
+//
+// @param region The region index
+// @param row The row relative to the region
+// @param col The column relative to the region
+// @param text The text to write
+// @param length The number of characters to write
+// @param color The color pair
+// =================================================================
+
+void NcursesBackend::putText(int region, int row, int col, const char* text, int length, int color) {
+    if (region < 0 || region >= (int)windows.size() || !windows[region]) return;
+    WINDOW* win = windows[region];
+    wattrset(win, COLOR_PAIR(color));
+    mvwaddnstr(win, row, col, text, length);
+}
+
+// =================================================================
+// Writes a single character into a region
+//
+// @param region The region index
+// @param row The row relative to the region
+// @param col The column relative to the region
+// @param c The character to write
+// @param color The color pair
+// =================================================================
+
+void NcursesBackend::putChar(int region, int row, int col, char c, int color) {
+    if (region < 0 || region >= (int)windows.size() || !windows[region]) return;
+    WINDOW* win = windows[region];
+    wattrset(win, COLOR_PAIR(color));
+    mvwaddch(win, row, col, c);
+}
+
+// =================================================================
+// Composes every region into the virtual screen and flushes it to
+// the terminal in a single update.
+// =================================================================
+
+void NcursesBackend::present() {
+    if (windows.empty() || !windows[0]) return;
+    // A redrawn frame paints over the regions, so they have to be
+    // copied again even if their own contents did not change.
+    bool frameChanged = is_wintouched(windows[0]);
+    wnoutrefresh(windows[0]);
+    for (size_t i = 1; i < windows.size(); ++i) {
+        if (!windows[i]) continue;
+        if (frameChanged) touchwin(windows[i]);
+        wnoutrefresh(windows[i]);
+    }
+    doupdate();
+}
+
+// =================================================================
+// Returns the terminal descriptor polled by the event loop
+// =================================================================
+
+int NcursesBackend::inputFd() const {
+    return STDIN_FILENO;
+}
+
+// =================================================================
+// Returns the next key, or ERR if none is buffered
+// =================================================================
+
+int NcursesBackend::readKey() {
+    return getch();
+}
+
+// =================================================================
+// Contains the definition of the HeadlessBackend class
+// The screen is a grid of cells in memory and the input is a
+// script of keys. Once the script runs out every read returns
+// KEY_EXIT, which the screens treat as a request to leave.
+// =================================================================
+
+class HeadlessBackend : public RenderBackend {
+private:
+    struct Cell {
+        char glyph;
+        unsigned char color;
+    };
+
+    int lines, cols;
+    vector<Rect> rects;
+    vector<vector<Cell>> regions; // one grid per region
+    vector<Cell> screen;
+    deque<int> script;
+    long frames;
+    ostream* frameSink;
+    string finalScreen; // the frame shown when the script ran out
+
+public:
+    HeadlessBackend(int l, int c);
+
+    void start() override;
+    void stop() override;
+    int getLines() const override;
+    int getCols() const override;
+
+    void setRegions(const vector<Rect>& newRegions) override;
+    void clearRegion(int region) override;
+    void putText(int region, int row, int col, const char* text, int length, int color) override;
+    void putChar(int region, int row, int col, char c, int color) override;
+    void present() override;
+
+    int inputFd() const override;
+    int readKey() override;
+
+    void pushKey(int key);
+    void pushKeys(const string& keys);
+    void resize(int l, int c);
+    void setFrameSink(ostream* out);
+    long getFrameCount() const;
+    string getRow(int row) const;
+    void dumpFrame(ostream& out) const;
+    const string& getFinalScreen() const;
+};
+
+// =================================================================
+// Constructor
+//
+// @param l The number of screen lines
+// @param c The number of screen columns
+// =================================================================
+
+HeadlessBackend::HeadlessBackend(int l, int c)
+    : lines(l), cols(c), screen(l * c, Cell{ ' ', 1 }), frames(0), frameSink(nullptr) {}
+
+// =================================================================
+// Nothing to set up for an in-memory screen
+// =================================================================
+
+void HeadlessBackend::start() {}
+
+// =================================================================
+// Nothing to restore for an in-memory screen
+// =================================================================
+
+void HeadlessBackend::stop() {}
+
+// =================================================================
+// Returns the number of screen lines
+// =================================================================
+
+int HeadlessBackend::getLines() const {
+    return lines;
+}
+
+// =================================================================
+// Returns the number of screen columns
+// =================================================================
+
+int HeadlessBackend::getCols() const {
+    return cols;
+}
+
+// =================================================================
+// Allocates one cell grid per region
+//
+// @param newRegions The region rectangles, region 0 first
+// =================================================================
+
+void HeadlessBackend::setRegions(const vector<Rect>& newRegions) {
+    rects = newRegions;
+    regions.assign(rects.size(), vector<Cell>());
+    for (size_t i = 0; i < rects.size(); ++i) {
+        int h = max(rects[i].height, 0);
+        int w = max(rects[i].width, 0);
+        regions[i].assign(h * w, Cell{ ' ', 1 });
+    }
+}
+
+// =================================================================
+// Clears a region
+//
+// @param region The region index
+// =================================================================
+
+void HeadlessBackend::clearRegion(int region) {
+    if (region < 0 || region >= (int)regions.size()) return;
+    for (Cell& cell : regions[region]) {
+        cell = Cell{ ' ', 1 };
+    }
+}
+
+// =================================================================
+// Writes text into a region. Tabs advance to the next multiple of
+// eight like they do in an ncurses window.
+//
+// @param region The region index
+// @param row The row relative to the region
+// @param col The column relative to the region
+// @param text The text to write
+// @param length The number of characters to write
+// @param color The color pair
+// =================================================================
+
+void HeadlessBackend::putText(int region, int row, int col, const char* text, int length, int color) {
+    if (region < 0 || region >= (int)regions.size()) return;
+    const Rect& r = rects[region];
+    if (row < 0 || row >= r.height) return;
+    Cell* line = &regions[region][row * r.width];
+    for (int i = 0; i < length && text[i] && col < r.width; ++i) {
+        if (text[i] == '\t') {
+            int next = (col / 8 + 1) * 8;
+            while (col < next && col < r.width) {
+                if (col >= 0) line[col] = Cell{ ' ', (unsigned char)color };
+                ++col;
+            }
+        } else {
+            if (col >= 0) line[col] = Cell{ text[i], (unsigned char)color };
+            ++col;
+        }
+    }
+}
+
+// =================================================================
+// Writes a single character into a region
+//
+// @param region The region index
+// @param row The row relative to the region
+// @param col The column relative to the region
+// @param c The character to write
+// @param color The color pair
+// =================================================================
+
+void HeadlessBackend::putChar(int region, int row, int col, char c, int color) {
+    if (region < 0 || region >= (int)regions.size()) return;
+    const Rect& r = rects[region];
+    if (row < 0 || row >= r.height || col < 0 || col >= r.width) return;
+    regions[region][row * r.width + col] = Cell{ c, (unsigned char)color };
+}
+
+// =================================================================
+// Composes every region into the screen grid. Each call counts as
+// one frame and is written to the frame sink if there is one.
+// =================================================================
+
+void HeadlessBackend::present() {
+    for (size_t i = 0; i < rects.size(); ++i) {
+        const Rect& r = rects[i];
+        for (int y = 0; y < r.height; ++y) {
+            int sy = r.top + y;
+            if (sy < 0 || sy >= lines) continue;
+            for (int x = 0; x < r.width; ++x) {
+                int sx = r.left + x;
+                if (sx < 0 || sx >= cols) continue;
+                screen[sy * cols + sx] = regions[i][y * r.width + x];
+            }
+        }
+    }
+    ++frames;
+    if (frameSink) {
+        *frameSink << "--- frame " << frames << " ---\n";
+        dumpFrame(*frameSink);
+    }
+}
+
+// =================================================================
+// The headless screen has no descriptor; keys are always ready
+// =================================================================
+
+int HeadlessBackend::inputFd() const {
+    return -1;
+}
+
+// =================================================================
+// Returns the next scripted key, or KEY_EXIT once the script is done.
+// The first time the script runs out the screen is kept, so tests
+// can check where the keys led before the scenes back out.
+// =================================================================
+
+int HeadlessBackend::readKey() {
+    if (script.empty()) {
+        if (finalScreen.empty()) {
+            ostringstream out;
+            dumpFrame(out);
+            finalScreen = out.str();
+        }
+        return KEY_EXIT;
+    }
+    int key = script.front();
+    script.pop_front();
+    return key;
+}
+
+// =================================================================
+// Appends a key to the input script
+//
+// @param key The key code
+// =================================================================
+
+void HeadlessBackend::pushKey(int key) {
+    script.push_back(key);
+}
+
+// =================================================================
+// Appends every character of a string to the input script
+//
+// @param keys The keys to append
+// =================================================================
+
+void HeadlessBackend::pushKeys(const string& keys) {
+    for (char c : keys) {
+        script.push_back((unsigned char)c);
+    }
+}
+
+// =================================================================
+// Changes the screen size and queues KEY_RESIZE, like a terminal
+// receiving SIGWINCH
+//
+// @param l The new number of lines
+// @param c The new number of columns
+// =================================================================
+
+void HeadlessBackend::resize(int l, int c) {
+    lines = l;
+    cols = c;
+    screen.assign(l * c, Cell{ ' ', 1 });
+    script.push_front(KEY_RESIZE);
+}
+
+// =================================================================
+// Sets a stream that receives every presented frame as text
+//
+// @param out The stream, or nullptr to stop recording
+// =================================================================
+
+void HeadlessBackend::setFrameSink(ostream* out) {
+    frameSink = out;
+}
+
+// =================================================================
+// Returns the number of frames presented so far
+// =================================================================
+
+long HeadlessBackend::getFrameCount() const {
+    return frames;
+}
+
+// =================================================================
+// Returns a row of the last presented frame
+//
+// @param row The screen row
+// =================================================================
+
+string HeadlessBackend::getRow(int row) const {
+    string text(cols, ' ');
+    if (row < 0 || row >= lines) return text;
+    for (int x = 0; x < cols; ++x) {
+        text[x] = screen[row * cols + x].glyph;
+    }
+    return text;
+}
+
+// =================================================================
+// Writes the last presented frame as text, one line per row
+//
+// @param out The output stream
+// =================================================================
+
+void HeadlessBackend::dumpFrame(ostream& out) const {
+    for (int y = 0; y < lines; ++y) {
+        out << getRow(y) << '\n';
+    }
+}
+
+// =================================================================
+// Returns the frame that was shown when the script ran out
+//
+// @return The frame as text, or empty if the script never ran out
+// =================================================================
+
+const string& HeadlessBackend::getFinalScreen() const {
+    return finalScreen;
+}
+
+#endif
@@ -0,0 +1,262 @@
+// =================================================================
+//
+// File: RosterIndex.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// RosterIndex class, a search index over the names of the heroes.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef ROSTERINDEX_H
+#define ROSTERINDEX_H
+
+#include "Character.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the RosterIndex class
+// Lowercase names are packed in one buffer. A permutation sorted by
+// name answers prefix queries with two binary searches; fuzzy
+// queries scan the packed buffer, which stays in cache far better
+// than following a Character pointer per hero. Classes and alive
+// flags are cached next to the names so filtering never touches the
+// Character objects.
+// =================================================================
+
+class RosterIndex {
+private:
+    vector<char> names;        // lowercase names, '\0' terminated
+    vector<uint32_t> offsets;  // start of each name in names
+    vector<uint32_t> sorted;   // hero indices sorted by name
+    vector<HeroClass> classes;
+    vector<uint8_t> alive;
+
+    const char* nameOf(uint32_t hero) const;
+    static bool fuzzyMatch(const char* name, const char* query);
+    bool accepts(uint32_t hero, HeroClass classFilter, bool aliveOnly) const;
+
+public:
+    RosterIndex();
+
+    static HeroClass classOf(const Character* hero);
+
+    void build(const vector<Character*>& heroes);
+    void add(const Character* hero);
+    void sync(const vector<Character*>& heroes);
+    void refreshAlive(const vector<Character*>& heroes);
+    size_t size() const;
+
+    void filter(const string& query, bool fuzzy, HeroClass classFilter, bool aliveOnly, vector<uint32_t>& out) const;
+};
+
+// =================================================================
+// Constructor. The index starts empty.
+// =================================================================
+
+RosterIndex::RosterIndex() {}
+
+// =================================================================
+// Returns the lowercase name of a hero
+//
+// @param hero The index of the hero in the roster
+// =================================================================
+
+const char* RosterIndex::nameOf(uint32_t hero) const {
+    return &names[offsets[hero]];
+}
+
+// =================================================================
+// Returns the class of a hero
+//
+// @param hero The hero
+// =================================================================
+
+HeroClass RosterIndex::classOf(const Character* hero) {
+    if (dynamic_cast<const Warrior*>(hero)) return HeroClass::Warrior;
+    if (dynamic_cast<const Archer*>(hero)) return HeroClass::Archer;
+    if (dynamic_cast<const Mage*>(hero)) return HeroClass::Mage;
+    return HeroClass::Any;
+}
+
+// =================================================================
+// Rebuilds the index from scratch
+//
+// @param heroes The roster
+// =================================================================
+
+void RosterIndex::build(const vector<Character*>& heroes) {
+    names.clear();
+    offsets.clear();
+    sorted.clear();
+    classes.clear();
+    alive.clear();
+    offsets.reserve(heroes.size());
+    classes.reserve(heroes.size());
+    alive.reserve(heroes.size());
+
+    for (const Character* hero : heroes) {
+        offsets.push_back(names.size());
+        for (char c : hero->getName()) {
+            names.push_back(tolower((unsigned char)c));
+        }
+        names.push_back('\0');
+        classes.push_back(classOf(hero));
+        alive.push_back(hero->isAlive());
+    }
+
+    sorted.resize(heroes.size());
+    for (uint32_t i = 0; i < sorted.size(); ++i) {
+        sorted[i] = i;
+    }
+    stable_sort(sorted.begin(), sorted.end(), [this](uint32_t a, uint32_t b) {
+        return strcmp(nameOf(a), nameOf(b)) < 0;
+    });
+}
+
+// =================================================================
+// Adds the hero appended at the end of the roster
+//
+// @param hero The new hero
+// =================================================================
+
+void RosterIndex::add(const Character* hero) {
+    uint32_t index = offsets.size();
+    offsets.push_back(names.size());
+    for (char c : hero->getName()) {
+        names.push_back(tolower((unsigned char)c));
+    }
+    names.push_back('\0');
+    classes.push_back(classOf(hero));
+    alive.push_back(hero->isAlive());
+
+    auto position = upper_bound(sorted.begin(), sorted.end(), index, [this](uint32_t a, uint32_t b) {
+        return strcmp(nameOf(a), nameOf(b)) < 0;
+    });
+    sorted.insert(position, index);
+}
+
+// =================================================================
+// Brings the index up to date with the roster. A single hero added
+// at the end is inserted; any other change rebuilds the index.
+// Alive flags are refreshed in both cases.
+//
+// @param heroes The roster
+// =================================================================
+
+void RosterIndex::sync(const vector<Character*>& heroes) {
+    if (heroes.size() == offsets.size() + 1) {
+        add(heroes.back());
+    } else if (heroes.size() != offsets.size()) {
+        build(heroes);
+        return;
+    }
+    refreshAlive(heroes);
+}
+
+// =================================================================
+// Refreshes the cached alive flags. Heroes only die in battle, so
+// this runs once per visit to the selector, not per keystroke.
+//
+// @param heroes The roster
+// =================================================================
+
+void RosterIndex::refreshAlive(const vector<Character*>& heroes) {
+    for (size_t i = 0; i < heroes.size() && i < alive.size(); ++i) {
+        alive[i] = heroes[i]->isAlive();
+    }
+}
+
+// =================================================================
+// Returns the number of indexed heroes
+// =================================================================
+
+size_t RosterIndex::size() const {
+    return offsets.size();
+}
+
+// =================================================================
+// Checks whether every character of the query appears in the name
+// in the same order
+//
+// @param name The lowercase name
+// @param query The lowercase query
+// =================================================================
+
+bool RosterIndex::fuzzyMatch(const char* name, const char* query) {
+    while (*query) {
+        name = strchr(name, *query);
+        if (!name) return false;
+        ++name;
+        ++query;
+    }
+    return true;
+}
+
+// =================================================================
+// Checks the class and alive filters
+//
+// @param hero The index of the hero in the roster
+// @param classFilter The class to keep, or HeroClass::Any
+// @param aliveOnly true to drop dead heroes
+// =================================================================
+
+bool RosterIndex::accepts(uint32_t hero, HeroClass classFilter, bool aliveOnly) const {
+    if (classFilter != HeroClass::Any && classes[hero] != classFilter) return false;
+    if (aliveOnly && !alive[hero]) return false;
+    return true;
+}
+
+// =================================================================
+// Lists the heroes that match a query and the filters. An empty
+// query keeps the roster order; prefix results are sorted by name.
+//
+// @param query The text typed by the user
+// @param fuzzy true for subsequence matching, false for prefixes
+// @param classFilter The class to keep, or HeroClass::Any
+// @param aliveOnly true to drop dead heroes
+// @param out Receives the indices of the matching heroes
+// =================================================================
+
+void RosterIndex::filter(const string& query, bool fuzzy, HeroClass classFilter, bool aliveOnly, vector<uint32_t>& out) const {
+    out.clear();
+    string lower = query;
+    for (char& c : lower) {
+        c = tolower((unsigned char)c);
+    }
+
+    if (lower.empty() || fuzzy) {
+        const char* q = lower.c_str();
+        for (uint32_t i = 0; i < offsets.size(); ++i) {
+            if (accepts(i, classFilter, aliveOnly) && (lower.empty() || fuzzyMatch(nameOf(i), q))) {
+                out.push_back(i);
+            }
+        }
+        return;
+    }
+
+    // Every name starting with the prefix sits in one run of the
+    // sorted permutation
+    size_t length = lower.length();
+    auto first = lower_bound(sorted.begin(), sorted.end(), lower, [this, length](uint32_t hero, const string& prefix) {
+        return strncmp(nameOf(hero), prefix.c_str(), length) < 0;
+    });
+    auto last = upper_bound(first, sorted.end(), lower, [this, length](const string& prefix, uint32_t hero) {
+        return strncmp(prefix.c_str(), nameOf(hero), length) < 0;
+    });
+    for (auto it = first; it != last; ++it) {
+        if (accepts(*it, classFilter, aliveOnly)) out.push_back(*it);
+    }
+}
+
+#endif
@@ -16,6 +16,8 @@
 
 #include "Character.h"
 #include "Level.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -25,16 +27,34 @@ using namespace std;
 
 // =================================================================
 // SaveManager class for handling save and load operations
+// The heroes and the level status come first, as they always have.
+// Sections follow them, each one a tag, a size and a payload, so a
+// version of the game skips the sections it does not know and older
+// versions stop reading before them.
 // =================================================================
 
 class SaveManager {
-private:
-    string saveFileName;
+public:
+    // "INV1": one Inventory::Record per hero, in the order of the heroes
+    static const uint32_t InventoryTag = 'I' | 'N' << 8 | 'V' << 16 | '1' << 24;
+    // "PRG1": one ProgressRecord per hero. The level is kept for
+    // whoever reads the file; loading goes by the experience.
+    static const uint32_t ProgressTag = 'P' | 'R' << 8 | 'G' << 16 | '1' << 24;
+    struct ProgressRecord {
+        int32_t xp, level;
+    };
+
+    // "RAT1": the Rating of every hero, then of the enemy of every
+    // level
+    static const uint32_t RatingTag = 'R' | 'A' << 8 | 'T' << 16 | '1' << 24;
+
     static void saveGame(const vector<Character*>& heroes, const vector<Level*>& levels, const string& filename);
     static void loadGame(vector<Character*>& heroes, vector<Level*>& levels, const string& filename);
 };
 
 void SaveManager::saveGame(const vector<Character*>& heroes, const vector<Level*>& levels, const string& filename) {
+    METRICS_TIME("save.saveGame.ns");
+    TRACE_SPAN("save", "saveGame");
     ofstream out(filename, ios::binary);
     if (!out) return;
 
@@ -63,23 +83,55 @@ void SaveManager::saveGame(const vector<Character*>& heroes, const vector<Level*
 
     // Save level status
     int levelCount = levels.size();
-    file.write((char*)&levelCount, sizeof(int));
+    out.write((char*)&levelCount, sizeof(int));
 
     for (Level* level : levels) {
         bool won = level->hasWon();
-        file.write((char*)&won, sizeof(bool));
+        out.write((char*)&won, sizeof(bool));
+    }
+
+    // Save the items and equipment of every hero
+    uint32_t section[] = { InventoryTag, uint32_t(heroes.size() * sizeof(Inventory::Record)) };
+    out.write((char*)section, sizeof(section));
+    for (Character* c : heroes) {
+        Inventory::Record record = c->getInventory().toRecord();
+        out.write((char*)&record, sizeof(record));
+    }
+
+    // Save the experience and level of every hero
+    section[0] = ProgressTag;
+    section[1] = uint32_t(heroes.size() * sizeof(ProgressRecord));
+    out.write((char*)section, sizeof(section));
+    for (Character* c : heroes) {
+        ProgressRecord record = { c->getXp(), c->getLevel() };
+        out.write((char*)&record, sizeof(record));
+    }
+
+    // Save the ratings of the heroes and of the enemies
+    section[0] = RatingTag;
+    section[1] = uint32_t((heroes.size() + levels.size()) * sizeof(Rating));
+    out.write((char*)section, sizeof(section));
+    for (Character* c : heroes) {
+        out.write((char*)&c->getRating(), sizeof(Rating));
+    }
+    for (Level* level : levels) {
+        out.write((char*)&level->getRating(), sizeof(Rating));
     }
 
     out.close();
 }
 
 void SaveManager::loadGame(vector<Character*>& heroes, vector<Level*>& levels, const string& filename) {
+    METRICS_TIME("save.loadGame.ns");
+    TRACE_SPAN("save", "loadGame");
     ifstream in(filename, ios::binary);
     if (!in) return;
 
     heroes.clear();
 
-    // Read heroes
+    // Read heroes; a hero of an unknown type keeps its place as
+    // nullptr so the sections still line up with the heroes
+    vector<Character*> saved;
     int heroCount;
     in.read((char*)&heroCount, sizeof(int));
     for (int i = 0; i < heroCount; ++i) {
@@ -103,6 +155,7 @@ void SaveManager::loadGame(vector<Character*>& heroes, vector<Level*>& levels, c
         else if (type == "Mage")
             c = new Mage(name, stats[0], stats[1], stats[2], stats[3]);
 
+        saved.push_back(c);
         if (c) heroes.push_back(c);
     }
 
@@ -113,7 +166,38 @@ void SaveManager::loadGame(vector<Character*>& heroes, vector<Level*>& levels, c
     for (int i = 0; i < levelCount; ++i) {
         bool won;
         in.read((char*)&won, sizeof(bool));
-        levels[i]->setWon(won);
+        if (i < (int)levels.size()) levels[i]->setWon(won);
+    }
+
+    // Read the sections, skipping the unknown ones
+    uint32_t section[2];
+    while (in.read((char*)section, sizeof(section))) {
+        if (section[0] == InventoryTag && section[1] == saved.size() * sizeof(Inventory::Record)) {
+            for (Character* c : saved) {
+                Inventory::Record record;
+                in.read((char*)&record, sizeof(record));
+                if (in && c) c->setInventory(Inventory::fromRecord(record));
+            }
+        } else if (section[0] == ProgressTag && section[1] == saved.size() * sizeof(ProgressRecord)) {
+            for (Character* c : saved) {
+                ProgressRecord record;
+                in.read((char*)&record, sizeof(record));
+                if (in && c) c->setProgress(record.xp);
+            }
+        } else if (section[0] == RatingTag && section[1] == (saved.size() + levelCount) * sizeof(Rating)) {
+            for (Character* c : saved) {
+                Rating rating;
+                in.read((char*)&rating, sizeof(rating));
+                if (in && c) c->setRating(rating);
+            }
+            for (int i = 0; i < levelCount; ++i) {
+                Rating rating;
+                in.read((char*)&rating, sizeof(rating));
+                if (in && i < (int)levels.size()) levels[i]->setRating(rating);
+            }
+        } else {
+            in.seekg(section[1], ios::cur);
+        }
     }
 
         in.close();
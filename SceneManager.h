@@ -0,0 +1,323 @@
+// =================================================================
+//
+// File: SceneManager.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// SceneManager class, a table of scenes run as a stack.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef SCENEMANAGER_H
+#define SCENEMANAGER_H
+
+#include "ui.h"
+#include "Coroutine.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Result of running a scene: what the manager does next
+// =================================================================
+
+struct Transition {
+    enum class Kind {
+        Stay,   // run the same scene again
+        Switch, // replace the current scene
+        Push,   // run a scene on top of the current one
+        Pop,    // return to the scene below
+        Quit    // leave the game
+    };
+
+    Kind kind;
+    Scene target;
+
+    static Transition stay();
+    static Transition switchTo(Scene scene);
+    static Transition push(Scene scene);
+    static Transition pop();
+    static Transition quit();
+};
+
+// =================================================================
+// Returns a transition that runs the same scene again
+// =================================================================
+
+Transition Transition::stay() {
+    return { Kind::Stay, Scene::Exit };
+}
+
+// =================================================================
+// Returns a transition that replaces the current scene
+//
+// @param scene The next scene
+// =================================================================
+
+Transition Transition::switchTo(Scene scene) {
+    if (scene == Scene::Exit) return quit();
+    return { Kind::Switch, scene };
+}
+
+// =================================================================
+// Returns a transition that runs a scene on top of the current one
+//
+// @param scene The scene to push
+// =================================================================
+
+Transition Transition::push(Scene scene) {
+    return { Kind::Push, scene };
+}
+
+// =================================================================
+// Returns a transition back to the scene below the current one
+// =================================================================
+
+Transition Transition::pop() {
+    return { Kind::Pop, Scene::Exit };
+}
+
+// =================================================================
+// Returns a transition that leaves the game
+// =================================================================
+
+Transition Transition::quit() {
+    return { Kind::Quit, Scene::Exit };
+}
+
+// =================================================================
+// Contains the definition of the GameScene class
+// Base class of the scenes registered in the manager. run() is a
+// coroutine that shows the scene until the player leaves it and can
+// await other tasks, such as the battle. prepare() does the work
+// the scene needs before it is shown; the manager runs it ahead of
+// time, while the previous scene waits for input.
+// =================================================================
+
+class GameScene {
+public:
+    virtual ~GameScene() {}
+
+    virtual Task<Transition> run() = 0;
+    virtual void prepare() {}
+    virtual Scene likelyNext() const;
+};
+
+// =================================================================
+// Returns the scene most likely to follow this one, or Scene::Exit
+// if there is nothing worth preparing
+// =================================================================
+
+Scene GameScene::likelyNext() const {
+    return Scene::Exit;
+}
+
+// =================================================================
+// Returns the name of a scene, as used by the metrics
+//
+// @param id The scene
+// =================================================================
+
+const char* sceneName(Scene id) {
+    static const char* const names[] = {
+        "MainMenu", "CharacterSelector", "CharacterCreator", "LevelSelect", "Battle", "GameOver", "Options", "Exit"
+    };
+    return names[int(id)];
+}
+
+// =================================================================
+// Contains the definition of the SceneManager class
+// Scenes are kept in a table indexed by Scene and run from a stack,
+// each one as a task on the executor of the UI.
+// A scene can also be overlaid on the one that is running, which
+// keeps running once the overlay pops.
+//
+// Before a scene runs, the preparation of its likely successor is
+// posted on the event loop, so it happens while the scene waits
+// for the first key. A scene that is entered before its posted
+// preparation ran is prepared right away instead.
+// =================================================================
+
+class SceneManager {
+private:
+    static const int SceneCount = int(Scene::Exit) + 1;
+
+    Executor& executor;
+    GameScene* scenes[SceneCount];
+    bool ready[SceneCount];     // prepared ahead of time for the next step
+    vector<Scene> stack;
+    long generation;            // invalidates stale preparations
+
+    void step();
+    void apply(const Transition& transition);
+    void prepareAhead(Scene next);
+
+public:
+    SceneManager(Executor& uiExecutor);
+    ~SceneManager();
+
+    void add(Scene id, GameScene* scene);
+    void run(Scene first);
+    bool overlay(Scene id);
+    bool isOverlay() const;
+    Scene current() const;
+};
+
+// =================================================================
+// Constructor. The table starts empty.
+//
+// @param uiExecutor The executor that runs the scenes
+// =================================================================
+
+SceneManager::SceneManager(Executor& uiExecutor) : executor(uiExecutor), generation(0) {
+    for (int i = 0; i < SceneCount; ++i) {
+        scenes[i] = nullptr;
+        ready[i] = false;
+    }
+}
+
+// =================================================================
+// Destructor. Deletes the registered scenes.
+// =================================================================
+
+SceneManager::~SceneManager() {
+    for (GameScene* scene : scenes) {
+        delete scene;
+    }
+}
+
+// =================================================================
+// Registers a scene. The manager takes ownership of it.
+//
+// @param id The scene identifier
+// @param scene The scene object
+// =================================================================
+
+void SceneManager::add(Scene id, GameScene* scene) {
+    delete scenes[int(id)];
+    scenes[int(id)] = scene;
+}
+
+// =================================================================
+// Runs scenes until one of them quits or the stack is empty
+//
+// @param first The first scene
+// =================================================================
+
+void SceneManager::run(Scene first) {
+    stack.assign(1, first);
+    while (!stack.empty()) {
+        step();
+    }
+}
+
+// =================================================================
+// Runs a scene on top of the current one until it pops. Meant to be
+// called from inside a running scene.
+//
+// @param id The scene to overlay
+// @return false if the overlay quit the game
+// =================================================================
+
+bool SceneManager::overlay(Scene id) {
+    size_t depth = stack.size();
+    stack.push_back(id);
+    while (stack.size() > depth) {
+        step();
+    }
+    // Frames presented from now on belong to the scene underneath
+    if (!stack.empty()) METRICS_ENTER_SCENE(sceneName(stack.back()));
+    return !stack.empty();
+}
+
+// =================================================================
+// Checks if the current scene runs on top of another one
+// =================================================================
+
+bool SceneManager::isOverlay() const {
+    return stack.size() > 1;
+}
+
+// =================================================================
+// Returns the scene on top of the stack
+// =================================================================
+
+Scene SceneManager::current() const {
+    return stack.empty() ? Scene::Exit : stack.back();
+}
+
+// =================================================================
+// Runs the scene on top of the stack once and applies its result
+// =================================================================
+
+void SceneManager::step() {
+    Scene id = stack.back();
+    GameScene* scene = scenes[int(id)];
+    if (id == Scene::Exit || !scene) {
+        stack.clear();
+        return;
+    }
+
+    // Preparations only hold for the scene entered right after them
+    ++generation;
+    if (!ready[int(id)]) scene->prepare();
+    for (bool& flag : ready) {
+        flag = false;
+    }
+    prepareAhead(scene->likelyNext());
+
+    METRICS_ENTER_SCENE(sceneName(id));
+    METRICS_TIME_INTO(Metrics::sceneTime());
+    TRACE_SPAN("scene", sceneName(id));
+    apply(executor.run(scene->run()));
+}
+
+// =================================================================
+// Posts the preparation of the likely next scene on the event loop
+//
+// @param next The scene to prepare
+// =================================================================
+
+void SceneManager::prepareAhead(Scene next) {
+    if (next == Scene::Exit || !scenes[int(next)] || ready[int(next)]) return;
+    long posted = generation;
+    executor.loop().post([this, next, posted]() {
+        // The scene that asked for it is gone, or it was done already
+        if (posted != generation || ready[int(next)]) return;
+        scenes[int(next)]->prepare();
+        ready[int(next)] = true;
+    });
+}
+
+// =================================================================
+// Updates the stack with the result of a scene
+//
+// @param transition The result of the scene
+// =================================================================
+
+void SceneManager::apply(const Transition& transition) {
+    if (stack.empty()) return; // an overlay quit the game
+    switch (transition.kind) {
+        case Transition::Kind::Stay:
+            break;
+        case Transition::Kind::Switch:
+            stack.back() = transition.target;
+            break;
+        case Transition::Kind::Push:
+            stack.push_back(transition.target);
+            break;
+        case Transition::Kind::Pop:
+            stack.pop_back();
+            break;
+        case Transition::Kind::Quit:
+            stack.clear();
+            break;
+    }
+}
+
+#endif
@@ -0,0 +1,343 @@
+// =================================================================
+//
+// File: Scenes.h
+// Author: Alexis Berthou
+// Description: This file contains the scenes of the game registered
+// in the SceneManager, and the GameState they share.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "Character.h"
+#include "ContentWatcher.h"
+#include "History.h"
+#include "Level.h"
+#include "LevelIndex.h"
+#include "Random.h"
+#include "SaveManager.h"
+#include "SceneManager.h"
+#include "ui.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// State shared by the scenes
+// =================================================================
+
+struct GameState {
+    vector<Character*> heroes;
+    vector<Level*> levels;
+    LevelIndex levelIndex;
+    Character* player = nullptr;
+    Level* currentLevel = nullptr;
+    Level* lastFought = nullptr;   // enemy to reset before the next battle
+    string saveFile;
+    ContentWatcher* content = nullptr;
+    uint64_t contentGeneration = 0;  // of the catalog the levels come from
+    uint64_t seed = 0;               // of the combat rolls
+    uint64_t battleCount = 0;        // the id of the next battle's stream
+    HistoryWriter* history = nullptr; // where battles are recorded, if anywhere
+};
+
+// =================================================================
+// Replaces the levels with the ones of the current catalog if the
+// content files changed. Only called between battles: nothing holds
+// a level then. Won levels stay won when the new catalog has a
+// level with the same name.
+//
+// @param game The state shared by the scenes
+// =================================================================
+
+void refreshLevels(GameState& game) {
+    if (!game.content || game.content->generation() == game.contentGeneration) return;
+    game.contentGeneration = game.content->generation();
+    vector<Level*> fresh = game.content->current()->createLevels();
+
+    for (Level* level : fresh) {
+        for (Level* old : game.levels) {
+            if (old->getName() == level->getName()) {
+                level->setWon(old->hasWon());
+                level->setRating(old->getRating());
+                break;
+            }
+        }
+    }
+    for (Level* old : game.levels) {
+        delete old;
+    }
+    game.levels = fresh;
+    game.currentLevel = nullptr;
+    game.lastFought = nullptr;
+    game.levelIndex.build(game.levels);
+}
+
+// =================================================================
+// Main menu
+// =================================================================
+
+class MainMenuScene : public GameScene {
+public:
+    Task<Transition> run() override;
+    Scene likelyNext() const override;
+};
+
+// =================================================================
+// Shows the main menu and goes to the chosen scene
+// =================================================================
+
+Task<Transition> MainMenuScene::run() {
+    co_return Transition::switchTo(UI::showMainMenu());
+}
+
+// =================================================================
+// Most players start a game from the main menu
+// =================================================================
+
+Scene MainMenuScene::likelyNext() const {
+    return Scene::CharacterSelector;
+}
+
+// =================================================================
+// Character selector
+// =================================================================
+
+class CharacterSelectorScene : public GameScene {
+private:
+    GameState& game;
+
+public:
+    CharacterSelectorScene(GameState& state) : game(state) {}
+    Task<Transition> run() override;
+    Scene likelyNext() const override;
+};
+
+// =================================================================
+// Shows the character selector and keeps the chosen hero
+// =================================================================
+
+Task<Transition> CharacterSelectorScene::run() {
+    HeroChoice choice = UI::showCharacterSelector(game.heroes);
+    switch (choice.action) {
+        case HeroChoice::Action::Create:
+            co_return Transition::switchTo(Scene::CharacterCreator);
+        case HeroChoice::Action::Select:
+            game.player = choice.hero;
+            co_return Transition::switchTo(Scene::LevelSelect);
+        default:
+            co_return Transition::switchTo(Scene::MainMenu);
+    }
+}
+
+// =================================================================
+// A chosen hero goes on to the level browser
+// =================================================================
+
+Scene CharacterSelectorScene::likelyNext() const {
+    return Scene::LevelSelect;
+}
+
+// =================================================================
+// Character creator
+// =================================================================
+
+class CharacterCreatorScene : public GameScene {
+private:
+    GameState& game;
+
+public:
+    CharacterCreatorScene(GameState& state) : game(state) {}
+    Task<Transition> run() override;
+};
+
+// =================================================================
+// Shows the character creator and adds the new hero to the roster
+// =================================================================
+
+Task<Transition> CharacterCreatorScene::run() {
+    Character* newHero = UI::showCharacterCreator();
+    if (!newHero) co_return Transition::switchTo(Scene::MainMenu);
+    game.heroes.push_back(newHero);
+    co_return Transition::switchTo(Scene::CharacterSelector);
+}
+
+// =================================================================
+// Level browser
+// =================================================================
+
+class LevelSelectScene : public GameScene {
+private:
+    GameState& game;
+
+public:
+    LevelSelectScene(GameState& state) : game(state) {}
+    Task<Transition> run() override;
+    Scene likelyNext() const override;
+};
+
+// =================================================================
+// Shows the level browser and keeps the chosen level. Content that
+// changed since the last battle is picked up here.
+// =================================================================
+
+Task<Transition> LevelSelectScene::run() {
+    refreshLevels(game);
+    Level* level = UI::showLevelSelector(game.levelIndex);
+    if (!level) co_return Transition::switchTo(Scene::MainMenu);
+    game.currentLevel = level;
+    co_return Transition::switchTo(Scene::Battle);
+}
+
+// =================================================================
+// A chosen level starts a battle
+// =================================================================
+
+Scene LevelSelectScene::likelyNext() const {
+    return Scene::Battle;
+}
+
+// =================================================================
+// Battle. Preparing it resets the enemy of the last fight and gets
+// the battle log ready, so the screen appears as soon as a level is
+// picked.
+// =================================================================
+
+class BattleScene : public GameScene {
+private:
+    GameState& game;
+
+public:
+    BattleScene(GameState& state) : game(state) {}
+    Task<Transition> run() override;
+    void prepare() override;
+    Scene likelyNext() const override;
+};
+
+// =================================================================
+// Fights the chosen level with the chosen hero. A win is saved
+// and leads back to the level browser; a dead hero ends the game.
+// Every battle goes into the battle history, left ones included.
+// =================================================================
+
+Task<Transition> BattleScene::run() {
+    if (!game.player || !game.currentLevel) co_return Transition::switchTo(Scene::MainMenu);
+    game.lastFought = game.currentLevel;
+
+    game.currentLevel->setHero(game.player);
+    BattleTally tally;
+    bool won = co_await UI::battle(game.currentLevel, RandomStream(game.seed, game.battleCount++), tally);
+    if (game.history) {
+        BattleOutcome outcome = won ? BattleOutcome::Won
+                                : game.player->isAlive() ? BattleOutcome::Left : BattleOutcome::Lost;
+        game.history->append(tally.toRow(RosterIndex::classOf(game.player), game.player,
+                                         game.currentLevel->getEnemy(), outcome));
+    }
+
+    // A battle the player left is not rated
+    if (won || !game.player->isAlive()) {
+        Rating hero = game.player->getRating();
+        Rating enemy = game.currentLevel->getRating();
+        rateBattle(hero, enemy, won ? 1 : 0);
+        game.player->setRating(hero);
+        game.currentLevel->setRating(enemy);
+    }
+    if (won) {
+        game.levelIndex.setWon(game.currentLevel, true);
+        game.player->pickUp(game.currentLevel->getReward());
+        game.player->gainXp(static_cast<Enemy*>(game.currentLevel->getEnemy())->getXpValue());
+        SaveManager::saveGame(game.heroes, game.levels, game.saveFile);
+        co_return Transition::switchTo(Scene::LevelSelect);
+    }
+    if (!game.player->isAlive()) co_return Transition::switchTo(Scene::GameOver);
+    co_return Transition::switchTo(Scene::MainMenu);
+}
+
+// =================================================================
+// Resets the enemy of the last fight and prepares the battle screen
+// =================================================================
+
+void BattleScene::prepare() {
+    if (game.lastFought) game.lastFought->resetEnemy();
+    game.lastFought = nullptr;
+    UI::prepareBattle();
+}
+
+// =================================================================
+// After a won battle the player picks the next level
+// =================================================================
+
+Scene BattleScene::likelyNext() const {
+    return Scene::LevelSelect;
+}
+
+// =================================================================
+// Game over
+// =================================================================
+
+class GameOverScene : public GameScene {
+public:
+    Task<Transition> run() override;
+};
+
+// =================================================================
+// Shows the game over screen
+// =================================================================
+
+Task<Transition> GameOverScene::run() {
+    co_return Transition::switchTo(UI::showGameOver());
+}
+
+// =================================================================
+// Options menu. Shown on its own from the main menu, or on top of a
+// battle, in which case leaving it returns to the battle.
+// =================================================================
+
+class OptionsScene : public GameScene {
+private:
+    GameState& game;
+    SceneManager& manager;
+
+public:
+    OptionsScene(GameState& state, SceneManager& scenes) : game(state), manager(scenes) {}
+    Task<Transition> run() override;
+};
+
+// =================================================================
+// Shows the options menu. On top of a battle, leaving the menu
+// pops back to the battle instead of going to the main menu.
+// =================================================================
+
+Task<Transition> OptionsScene::run() {
+    bool overlay = manager.isOverlay();
+    Scene next = UI::Options(game.heroes, game.levelIndex, overlay);
+    if (next == Scene::Options) co_return Transition::stay();
+    co_return overlay ? Transition::pop() : Transition::switchTo(next);
+}
+
+// =================================================================
+// Registers every scene of the game
+//
+// @param manager The scene manager
+// @param game The state shared by the scenes
+// =================================================================
+
+void registerScenes(SceneManager& manager, GameState& game) {
+    manager.add(Scene::MainMenu, new MainMenuScene());
+    manager.add(Scene::CharacterSelector, new CharacterSelectorScene(game));
+    manager.add(Scene::CharacterCreator, new CharacterCreatorScene(game));
+    manager.add(Scene::LevelSelect, new LevelSelectScene(game));
+    manager.add(Scene::Battle, new BattleScene(game));
+    manager.add(Scene::GameOver, new GameOverScene());
+    manager.add(Scene::Options, new OptionsScene(game, manager));
+    UI::setOverlayHandler([&manager](Scene scene) { return manager.overlay(scene); });
+}
+
+#endif
@@ -0,0 +1,116 @@
+// =================================================================
+//
+// File: SpscQueue.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// SpscQueue class, a lock-free single-producer single-consumer ring.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the SpscQueue class
+// One thread pushes and one thread pops. Each side owns one index
+// and only reads the other side's with acquire ordering, so neither
+// push() nor pop() ever locks or waits. The indices live on their
+// own cache lines and each side keeps a cached copy of the other's
+// index, refreshed only when the ring looks full or empty, so the
+// two threads do not keep stealing each other's lines.
+// =================================================================
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    alignas(64) atomic<size_t> head; // next slot to pop, written by the consumer
+    size_t cachedTail;               // consumer's copy of tail
+    alignas(64) atomic<size_t> tail; // next slot to push, written by the producer
+    size_t cachedHead;               // producer's copy of head
+    alignas(64) T slots[Capacity];
+
+public:
+    SpscQueue();
+
+    bool push(const T& item);
+    bool pop(T& item);
+    bool empty() const;
+    size_t size() const;
+};
+
+// =================================================================
+// Constructor. The ring starts empty.
+// =================================================================
+
+template <typename T, size_t Capacity>
+SpscQueue<T, Capacity>::SpscQueue() : head(0), cachedTail(0), tail(0), cachedHead(0) {}
+
+// =================================================================
+// Pushes an item. Producer thread only.
+//
+// @param item The item to copy into the ring
+// @return false if the ring is full
+// =================================================================
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::push(const T& item) {
+    size_t t = tail.load(memory_order_relaxed);
+    if (t - cachedHead == Capacity) {
+        cachedHead = head.load(memory_order_acquire);
+        if (t - cachedHead == Capacity) return false;
+    }
+    slots[t & (Capacity - 1)] = item;
+    tail.store(t + 1, memory_order_release);
+    return true;
+}
+
+// =================================================================
+// Pops the oldest item. Consumer thread only.
+//
+// @param item Receives the item
+// @return false if the ring is empty
+// =================================================================
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::pop(T& item) {
+    size_t h = head.load(memory_order_relaxed);
+    if (h == cachedTail) {
+        cachedTail = tail.load(memory_order_acquire);
+        if (h == cachedTail) return false;
+    }
+    item = slots[h & (Capacity - 1)];
+    head.store(h + 1, memory_order_release);
+    return true;
+}
+
+// =================================================================
+// Checks if the ring is empty. Exact only on the consumer thread.
+// =================================================================
+
+template <typename T, size_t Capacity>
+bool SpscQueue<T, Capacity>::empty() const {
+    return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+}
+
+// =================================================================
+// Returns the number of items in the ring. Approximate while the
+// other thread is running.
+// =================================================================
+
+template <typename T, size_t Capacity>
+size_t SpscQueue<T, Capacity>::size() const {
+    return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+}
+
+#endif
@@ -0,0 +1,385 @@
+// =================================================================
+//
+// File: StatusEffects.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// StatusEngine class, which applies, ticks and expires the status
+// effects of the combatants of a battle.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef STATUSEFFECTS_H
+#define STATUSEFFECTS_H
+
+#include "Character.h"
+#include "TimerWheel.h"
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Names of the effects, as written in the content files
+// =================================================================
+
+const char* const effectNames[] = { "poison", "regeneration", "strengthen", "weaken", "ward", "sunder", "stun" };
+const int EffectKindCount = 7;
+
+// =================================================================
+// Returns the name of an effect
+//
+// @param kind The effect
+// =================================================================
+
+const char* effectName(EffectKind kind) {
+    return effectNames[int(kind)];
+}
+
+// =================================================================
+// Checks whether an effect is meant for the enemies of whoever
+// causes it
+//
+// @param kind The effect
+// =================================================================
+
+bool isHarmful(EffectKind kind) {
+    return kind == EffectKind::Poison || kind == EffectKind::Weaken || kind == EffectKind::Sunder ||
+           kind == EffectKind::Stun;
+}
+
+// =================================================================
+// Parses a comma-separated list of effects, each as
+// "name magnitude turns", such as "poison 4 3, weaken 5 2"
+//
+// @param text The list
+// @param effects Receives the effects
+// @param error Receives the reason when the list is malformed
+// @return false if the list is malformed
+// =================================================================
+
+bool parseEffectList(const string& text, vector<EffectSpec>& effects, string& error) {
+    stringstream list(text);
+    string item;
+    while (getline(list, item, ',')) {
+        stringstream fields(item);
+        string name;
+        long magnitude = -1, turns = -1;
+        string extra;
+        if (!(fields >> name >> magnitude >> turns) || (fields >> extra)) {
+            error = "effect \"" + item + "\" must be: name magnitude turns";
+            return false;
+        }
+        int kind = 0;
+        while (kind < EffectKindCount && name != effectNames[kind]) ++kind;
+        if (kind == EffectKindCount) {
+            error = "unknown effect " + name;
+            return false;
+        }
+        if (magnitude < 0 || magnitude > 30000 || turns < 1 || turns > 1000000) {
+            error = "effect " + name + ": magnitude must be 0 to 30000 and turns 1 to 1000000";
+            return false;
+        }
+        effects.push_back({ EffectKind(kind), int(magnitude), int(turns) });
+    }
+    return true;
+}
+
+// =================================================================
+// Contains the definition of the StatusEngine class
+// Holds the status effects of a battle. An effect applied on turn t
+// acts on turns t+1 to t+turns and is gone at the start of turn
+// t+turns+1:
+//   poison        loses magnitude health at the start of every turn
+//   regeneration  gains magnitude health at the start of every turn
+//   strengthen    adds magnitude to the strength while it lasts
+//   weaken        takes magnitude from the strength while it lasts
+//   ward          adds magnitude to the shield at once and loses an
+//                 equal part of it at the start of every turn
+//   sunder        takes magnitude from the shield while it lasts
+//   stun          the combatant loses its turns while it lasts
+//
+// Effects are never visited one by one while they last. What they
+// do every turn is kept as a sum per combatant (health per turn,
+// ward decay, stun count), changed only when an effect starts or
+// ends, and the ends are found by a TimerWheel. Starting a turn so
+// costs one step per combatant plus one per effect that ends, which
+// lets a battle carry thousands of effects. Effect ids index a pool
+// that reuses the ids of ended effects. The effects end with the
+// engine, so the stats of the characters are restored however the
+// battle ends.
+// =================================================================
+
+class StatusEngine {
+private:
+    struct Effect {
+        EffectSpec spec;
+        int target;
+        int decay;          // shield a ward loses every turn
+        uint64_t applied;   // the turn it was applied on
+        bool live;
+    };
+
+    struct Combatant {
+        Character* character;
+        int healthPerTurn, wardDecay, stuns;
+    };
+
+    vector<Effect> effects;
+    vector<uint32_t> freeIds;
+    vector<Combatant> combatants;
+    TimerWheel wheel;
+
+    void start(Effect& effect);
+    void end(Effect& effect, uint64_t elapsed);
+
+public:
+    // The effects and their sums at one turn. The stats they changed
+    // live in the characters and are saved with them.
+    struct Snapshot {
+        vector<Effect> effects;
+        vector<uint32_t> freeIds;
+        vector<Combatant> combatants;
+        uint64_t turn;
+    };
+
+    ~StatusEngine();
+
+    int addCombatant(Character* character);
+    uint32_t apply(int target, const EffectSpec& spec);
+    void dispel(uint32_t id);
+    void clear();
+
+    template <typename OnTick, typename OnEnd>
+    void beginTurn(OnTick onTick, OnEnd onEnd);
+
+    bool isStunned(int combatant) const;
+    size_t activeCount() const;
+    uint64_t turn() const;
+
+    Snapshot snapshot() const;
+    void restore(const Snapshot& saved);
+};
+
+// =================================================================
+// Destructor. Ends every effect still in place.
+// =================================================================
+
+StatusEngine::~StatusEngine() {
+    clear();
+}
+
+// =================================================================
+// Adds a combatant
+//
+// @param character The character, which must outlive its effects
+// @return The index of the combatant
+// =================================================================
+
+int StatusEngine::addCombatant(Character* character) {
+    combatants.push_back({ character, 0, 0, 0 });
+    return int(combatants.size()) - 1;
+}
+
+// =================================================================
+// Puts an effect on a combatant. It acts at once on the stats and
+// stuns, and from the next turn on health.
+//
+// @param target The combatant
+// @param spec The effect
+// @return The id of the effect, to dispel it
+// =================================================================
+
+uint32_t StatusEngine::apply(int target, const EffectSpec& spec) {
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = uint32_t(effects.size());
+        effects.push_back({});
+    }
+    Effect& effect = effects[id];
+    effect.spec = spec;
+    effect.target = target;
+    effect.applied = wheel.turn();
+    effect.decay = spec.kind == EffectKind::Ward ? spec.magnitude / spec.turns : 0;
+    effect.live = true;
+    start(effect);
+    wheel.schedule(id, wheel.turn() + spec.turns + 1);
+    return id;
+}
+
+// =================================================================
+// Adds what an effect does to the sums of its combatant
+//
+// @param effect The effect
+// =================================================================
+
+void StatusEngine::start(Effect& effect) {
+    Combatant& c = combatants[effect.target];
+    int magnitude = effect.spec.magnitude;
+    switch (effect.spec.kind) {
+        case EffectKind::Poison:       c.healthPerTurn -= magnitude; break;
+        case EffectKind::Regeneration: c.healthPerTurn += magnitude; break;
+        case EffectKind::Strengthen:   c.character->addModifiers(magnitude, 0); break;
+        case EffectKind::Weaken:       c.character->addModifiers(-magnitude, 0); break;
+        case EffectKind::Sunder:       c.character->addModifiers(0, -magnitude); break;
+        case EffectKind::Stun:         ++c.stuns; break;
+        case EffectKind::Ward:
+            c.character->addModifiers(0, magnitude);
+            c.wardDecay += effect.decay;
+            break;
+    }
+}
+
+// =================================================================
+// Takes what an effect does out of the sums of its combatant and
+// frees its id
+//
+// @param effect The effect
+// @param elapsed The turns it has acted on
+// =================================================================
+
+void StatusEngine::end(Effect& effect, uint64_t elapsed) {
+    Combatant& c = combatants[effect.target];
+    int magnitude = effect.spec.magnitude;
+    switch (effect.spec.kind) {
+        case EffectKind::Poison:       c.healthPerTurn += magnitude; break;
+        case EffectKind::Regeneration: c.healthPerTurn -= magnitude; break;
+        case EffectKind::Strengthen:   c.character->addModifiers(-magnitude, 0); break;
+        case EffectKind::Weaken:       c.character->addModifiers(magnitude, 0); break;
+        case EffectKind::Sunder:       c.character->addModifiers(0, magnitude); break;
+        case EffectKind::Stun:         --c.stuns; break;
+        case EffectKind::Ward:
+            // Only what has not decayed yet is still on the shield
+            c.character->addModifiers(0, -(magnitude - effect.decay * int(elapsed)));
+            c.wardDecay -= effect.decay;
+            break;
+    }
+    effect.live = false;
+    freeIds.push_back(uint32_t(&effect - effects.data()));
+}
+
+// =================================================================
+// Removes an effect before it ends. Dispelling one that has ended
+// does nothing.
+//
+// @param id The effect
+// =================================================================
+
+void StatusEngine::dispel(uint32_t id) {
+    if (!wheel.isScheduled(id)) return;
+    wheel.cancel(id);
+    Effect& effect = effects[id];
+    end(effect, wheel.turn() - effect.applied);
+}
+
+// =================================================================
+// Removes every effect, restoring the stats of the combatants.
+// Called when a battle ends, however it ends.
+// =================================================================
+
+void StatusEngine::clear() {
+    for (uint32_t id = 0; id < effects.size(); ++id) {
+        if (effects[id].live) dispel(id);
+    }
+}
+
+// =================================================================
+// Starts the next turn: ends the effects that are over, then
+// applies what the others do every turn
+//
+// @param onTick Called with a combatant and the health it gained or
+// lost, for every living combatant whose health changed
+// @param onEnd Called with a combatant and the kind of every effect
+// of it that ended
+// =================================================================
+
+template <typename OnTick, typename OnEnd>
+void StatusEngine::beginTurn(OnTick onTick, OnEnd onEnd) {
+    wheel.advance([this, &onEnd](uint32_t id) {
+        Effect& effect = effects[id];
+        int target = effect.target;
+        EffectKind kind = effect.spec.kind;
+        end(effect, effect.spec.turns);
+        onEnd(target, kind);
+    });
+
+    for (int i = 0; i < int(combatants.size()); ++i) {
+        Combatant& c = combatants[i];
+        if (c.wardDecay) c.character->addModifiers(0, -c.wardDecay);
+        if (c.healthPerTurn && c.character->isAlive()) {
+            int before = c.character->getHealth();
+            c.character->changeHealth(c.healthPerTurn);
+            int change = c.character->getHealth() - before;
+            if (change) onTick(i, change);
+        }
+    }
+}
+
+// =================================================================
+// Checks whether a combatant loses its turn
+//
+// @param combatant The combatant
+// =================================================================
+
+bool StatusEngine::isStunned(int combatant) const {
+    return combatants[combatant].stuns > 0;
+}
+
+// =================================================================
+// Returns the number of effects in place
+// =================================================================
+
+size_t StatusEngine::activeCount() const {
+    return wheel.size();
+}
+
+// =================================================================
+// Returns the current turn, 0 until the first beginTurn()
+// =================================================================
+
+uint64_t StatusEngine::turn() const {
+    return wheel.turn();
+}
+
+// =================================================================
+// Returns the effects in place and their sums. The timer wheel is
+// not copied: the turn every effect ends on follows from when it was
+// applied, so it is scheduled again on restore.
+// =================================================================
+
+StatusEngine::Snapshot StatusEngine::snapshot() const {
+    return { effects, freeIds, combatants, wheel.turn() };
+}
+
+// =================================================================
+// Puts back the effects of a snapshot without acting on the
+// characters, whose stats are restored with them. Effects that end
+// on the same turn may end in another order than they first did,
+// which changes nothing but the order of their messages.
+//
+// @param saved A snapshot of this engine, with the same combatants
+// =================================================================
+
+void StatusEngine::restore(const Snapshot& saved) {
+    effects = saved.effects;
+    freeIds = saved.freeIds;
+    for (size_t i = 0; i < combatants.size() && i < saved.combatants.size(); ++i) {
+        Character* character = combatants[i].character;
+        combatants[i] = saved.combatants[i];
+        combatants[i].character = character;
+    }
+    wheel.reset(saved.turn);
+    for (uint32_t id = 0; id < effects.size(); ++id) {
+        if (effects[id].live) wheel.schedule(id, effects[id].applied + effects[id].spec.turns + 1);
+    }
+}
+
+#endif
@@ -0,0 +1,232 @@
+// =================================================================
+//
+// File: TimerWheel.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// TimerWheel class, a hierarchical timer wheel keyed on turn number.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// Contains the definition of the TimerWheel class
+// Timers are small integer ids that expire on a given turn. The
+// wheel has levels of 64 slots: level 0 holds the timers of the next
+// 64 turns, one slot per turn, and each level above covers 64 times
+// the turns of the one below. A timer goes in the lowest level whose
+// slot still tells it apart from the current turn; when the current
+// turn reaches a slot of a higher level, the timers in it move down.
+// Scheduling and cancelling are O(1), and advancing a turn costs the
+// timers that expire plus the occasional move down, however many
+// timers wait further ahead. Every slot is an intrusive list through
+// the nodes, which are indexed by id, so nothing is allocated once
+// the ids in use have been seen.
+// =================================================================
+
+class TimerWheel {
+public:
+    static const uint32_t None = UINT32_MAX;
+
+private:
+    static const int SlotBits = 6;
+    static const int Slots = 1 << SlotBits;
+    static const int Levels = (64 + SlotBits - 1) / SlotBits;    // any 64-bit turn
+
+    struct Node {
+        uint64_t due;
+        uint32_t next, prev;
+        int slot;           // -1 while not scheduled
+    };
+
+    vector<Node> nodes;
+    uint32_t heads[Levels * Slots];
+    uint64_t current;
+    size_t scheduledCount;
+
+    void link(uint32_t id);
+    void unlink(uint32_t id);
+
+public:
+    TimerWheel();
+
+    void schedule(uint32_t id, uint64_t due);
+    void cancel(uint32_t id);
+    bool isScheduled(uint32_t id) const;
+    uint64_t turn() const;
+    size_t size() const;
+    void reset(uint64_t turn);
+
+    template <typename Expire>
+    void advance(Expire expire);
+};
+
+// =================================================================
+// Constructor. The wheel starts empty at turn 0.
+// =================================================================
+
+TimerWheel::TimerWheel() : current(0), scheduledCount(0) {
+    for (uint32_t& head : heads) {
+        head = None;
+    }
+}
+
+// =================================================================
+// Puts a scheduled node in the slot for its turn: the level is the
+// group of six bits where the turn first differs from the current
+// one, and the slot is the turn's bits in that group
+//
+// @param id The node
+// =================================================================
+
+void TimerWheel::link(uint32_t id) {
+    Node& node = nodes[id];
+    uint64_t differ = node.due ^ current;
+    int level = differ ? (63 - __builtin_clzll(differ)) / SlotBits : 0;
+    int slot = level * Slots + int((node.due >> (level * SlotBits)) & (Slots - 1));
+    node.slot = slot;
+    node.prev = None;
+    node.next = heads[slot];
+    if (node.next != None) nodes[node.next].prev = id;
+    heads[slot] = id;
+}
+
+// =================================================================
+// Takes a node out of its slot
+//
+// @param id The node
+// =================================================================
+
+void TimerWheel::unlink(uint32_t id) {
+    Node& node = nodes[id];
+    if (node.prev != None) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.slot] = node.next;
+    }
+    if (node.next != None) nodes[node.next].prev = node.prev;
+    node.slot = -1;
+}
+
+// =================================================================
+// Schedules a timer, replacing its previous schedule if any
+//
+// @param id The timer
+// @param due The turn it expires on; turns already reached expire
+// on the next advance
+// =================================================================
+
+void TimerWheel::schedule(uint32_t id, uint64_t due) {
+    if (id >= nodes.size()) nodes.resize(id + 1, { 0, None, None, -1 });
+    if (nodes[id].slot >= 0) {
+        unlink(id);
+    } else {
+        ++scheduledCount;
+    }
+    nodes[id].due = due > current ? due : current + 1;
+    link(id);
+}
+
+// =================================================================
+// Cancels a timer. Cancelling one that is not scheduled does nothing.
+//
+// @param id The timer
+// =================================================================
+
+void TimerWheel::cancel(uint32_t id) {
+    if (!isScheduled(id)) return;
+    unlink(id);
+    --scheduledCount;
+}
+
+// =================================================================
+// Checks whether a timer is scheduled
+//
+// @param id The timer
+// =================================================================
+
+bool TimerWheel::isScheduled(uint32_t id) const {
+    return id < nodes.size() && nodes[id].slot >= 0;
+}
+
+// =================================================================
+// Returns the current turn
+// =================================================================
+
+uint64_t TimerWheel::turn() const {
+    return current;
+}
+
+// =================================================================
+// Returns the number of timers scheduled
+// =================================================================
+
+size_t TimerWheel::size() const {
+    return scheduledCount;
+}
+
+// =================================================================
+// Cancels every timer and moves to a turn without expiring anything,
+// so an earlier state can be scheduled again from scratch
+//
+// @param turn The new current turn
+// =================================================================
+
+void TimerWheel::reset(uint64_t turn) {
+    for (Node& node : nodes) {
+        node.slot = -1;
+    }
+    for (uint32_t& head : heads) {
+        head = None;
+    }
+    current = turn;
+    scheduledCount = 0;
+}
+
+// =================================================================
+// Moves to the next turn and expires the timers due on it. The
+// function may schedule and cancel timers, including the ones of
+// this turn that have not been expired yet.
+//
+// @param expire Called with the id of every timer that expires
+// =================================================================
+
+template <typename Expire>
+void TimerWheel::advance(Expire expire) {
+    ++current;
+
+    // Entering a slot of a higher level: its timers now differ from
+    // the current turn only in lower bits and move down
+    for (int level = 1; level < Levels; ++level) {
+        uint64_t low = current & ((uint64_t(1) << (level * SlotBits)) - 1);
+        if (low != 0) break;
+        int slot = level * Slots + int((current >> (level * SlotBits)) & (Slots - 1));
+        uint32_t id = heads[slot];
+        heads[slot] = None;
+        while (id != None) {
+            uint32_t next = nodes[id].next;
+            link(id);
+            id = next;
+        }
+    }
+
+    int slot = int(current & (Slots - 1));
+    while (heads[slot] != None) {
+        uint32_t id = heads[slot];
+        unlink(id);
+        --scheduledCount;
+        expire(id);
+    }
+}
+
+#endif
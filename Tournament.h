@@ -0,0 +1,716 @@
+// =================================================================
+//
+// File: Tournament.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the
+// Tournament class, which plays every combatant against every other
+// one on a pool of threads and keeps the results as a binary matrix
+// and a leaderboard.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include "BattleSim.h"
+#include "Character.h"
+#include "Random.h"
+#include "StatusEffects.h"
+#include "Trace.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// What a combatant of a tournament is
+// =================================================================
+
+enum class EntrantKind : uint8_t {
+    Warrior,
+    Archer,
+    Mage,
+    Enemy
+};
+
+const char* const entrantKindNames[] = { "Warrior", "Archer", "Mage", "Enemy" };
+
+// =================================================================
+// The result of one match, for the combatant that moved first
+// =================================================================
+
+enum class MatchOutcome : uint8_t {
+    Lost,
+    Won,
+    Draw,
+    NotPlayed   // a combatant against itself, or past the last one
+};
+
+struct MatchCell {
+    MatchOutcome outcome;
+    uint8_t turns;
+    uint16_t health;    // what the winner has left, 0 in a draw
+};
+static_assert(sizeof(MatchCell) == 4, "Match cells are written as they are");
+
+// =================================================================
+// The totals of a combatant over the tournament
+// =================================================================
+
+struct Standing {
+    uint32_t wins, losses, draws, matches;
+    uint64_t healthLeft;    // summed over its wins
+};
+static_assert(sizeof(Standing) == 24, "Standings are written as they are");
+
+// =================================================================
+// The start of a tournament file. After it come, for every
+// combatant, a byte with its EntrantKind, a byte with the length of
+// its name and the name; then one Standing per combatant; then the
+// matrix, in blocks of BlockSize by BlockSize cells. The blocks go
+// row by row, and the cells of a block too, so the cell of the row
+// r and the column c is found without reading the others.
+// =================================================================
+
+const uint32_t TournamentMagic = 'T' | 'R' << 8 | 'N' << 16 | '1' << 24;
+
+struct TournamentHeader {
+    uint32_t magic;
+    uint32_t entrants;
+    uint32_t blockSize;
+    uint32_t maxTurns;
+    uint64_t seed;
+};
+
+// =================================================================
+// Contains the definition of the Tournament class
+// Every combatant plays every other one twice, once moving first,
+// so the matrix of n combatants holds n * (n - 1) matches. A match
+// is an automatic battle under the rules of battleFlow(): both sides
+// attack every turn with the same rolls, status effects and stuns,
+// until one dies or MaxTurns have passed. It rolls on the stream of
+// its cell, so any match is replayed from the seed alone, whatever
+// thread played it.
+//
+// The matrix is cut into blocks of BlockSize by BlockSize cells, and
+// a block is the task a thread takes: it reads the BlockSize
+// combatants of its rows and the BlockSize of its columns over and
+// over while they stay in cache, and writes its cells as one
+// contiguous run of the file. Matches are played on copies kept per
+// block, one of each kind per side, which are overwritten for every
+// match instead of allocated. Each thread keeps its own standings,
+// added up at the end, so nothing is shared while the tournament
+// runs. Only a block of cells per thread is ever in memory, so tens
+// of thousands of combatants fit.
+// =================================================================
+
+class Tournament {
+public:
+    static const uint32_t BlockSize = 64;
+    static const uint32_t BlockCells = BlockSize * BlockSize;
+    static const int MaxTurns = 200;
+
+private:
+    struct Entrant {
+        unique_ptr<Character> character;
+        EntrantKind kind;
+        const vector<EffectSpec>* inflicts;     // nullptr if its attacks carry none
+    };
+
+    // One side of a match: a combatant of each kind to copy into
+    struct Corner {
+        Warrior warrior;
+        Archer archer;
+        Mage mage;
+        Enemy enemy;
+
+        Character* load(const Entrant& entrant);
+    };
+
+    vector<Entrant> entrants;
+    vector<Standing> standings;
+    uint64_t seed;
+
+    MatchCell play(size_t first, size_t second, Corner& a, Corner& b) const;
+    static bool writeAt(int fd, const void* data, size_t size, off_t offset);
+
+public:
+    Tournament(uint64_t rollSeed);
+
+    bool add(const Character& character);
+    void addGenerated(size_t count);
+    size_t size() const;
+    uint64_t matchCount() const;
+
+    void playBlock(size_t row, size_t col, MatchCell* cells, Standing* table) const;
+    bool run(const string& path, int threads, string& error);
+
+    const vector<Standing>& getStandings() const;
+    vector<size_t> leaderboard() const;
+    void printLeaderboard(ostream& out, size_t top) const;
+
+    static bool exportCsv(const string& matrixPath, const string& csvPath, string& error);
+};
+
+// The stream the generated combatants are drawn from; the streams
+// of the matches stay far below it
+const uint64_t GenerationStream = ThreadStreams - 1;
+
+// =================================================================
+// Copies a combatant into the copy of its kind
+//
+// @param entrant The combatant
+// @return The copy, ready to fight
+// =================================================================
+
+Character* Tournament::Corner::load(const Entrant& entrant) {
+    switch (entrant.kind) {
+        case EntrantKind::Warrior:
+            warrior = static_cast<const Warrior&>(*entrant.character);
+            return &warrior;
+        case EntrantKind::Archer:
+            archer = static_cast<const Archer&>(*entrant.character);
+            return &archer;
+        case EntrantKind::Mage:
+            mage = static_cast<const Mage&>(*entrant.character);
+            return &mage;
+        case EntrantKind::Enemy:
+            break;
+    }
+    enemy = static_cast<const Enemy&>(*entrant.character);
+    return &enemy;
+}
+
+// =================================================================
+// Constructor
+//
+// @param rollSeed The seed of the rolls of every match
+// =================================================================
+
+Tournament::Tournament(uint64_t rollSeed) : seed(rollSeed) {}
+
+// =================================================================
+// Adds a copy of a character as it is
+//
+// @param character The character
+// @return false if it is of no kind a tournament knows
+// =================================================================
+
+bool Tournament::add(const Character& character) {
+    Entrant entrant = { nullptr, EntrantKind::Warrior, nullptr };
+    if (const Warrior* warrior = dynamic_cast<const Warrior*>(&character)) {
+        entrant.character = make_unique<Warrior>(*warrior);
+    } else if (const Archer* archer = dynamic_cast<const Archer*>(&character)) {
+        entrant.character = make_unique<Archer>(*archer);
+        entrant.kind = EntrantKind::Archer;
+    } else if (const Mage* mage = dynamic_cast<const Mage*>(&character)) {
+        entrant.character = make_unique<Mage>(*mage);
+        entrant.kind = EntrantKind::Mage;
+    } else if (const Enemy* enemy = dynamic_cast<const Enemy*>(&character)) {
+        unique_ptr<Enemy> copy = make_unique<Enemy>(*enemy);
+        if (!copy->getInflicts().empty()) entrant.inflicts = &copy->getInflicts();
+        entrant.character = move(copy);
+        entrant.kind = EntrantKind::Enemy;
+    } else {
+        return false;
+    }
+    entrants.push_back(move(entrant));
+    return true;
+}
+
+// =================================================================
+// Adds heroes of random classes and levels, the same ones for the
+// same seed, at full health
+//
+// @param count The number of heroes
+// =================================================================
+
+void Tournament::addGenerated(size_t count) {
+    RandomStream rolls(seed, GenerationStream);
+    for (size_t i = 0; i < count; ++i) {
+        EntrantKind kind = EntrantKind(rolls.below(3));
+        int level = rolls.range(1, MaxLevel);
+        string name = string(entrantKindNames[int(kind)]) + " " + to_string(i + 1);
+        unique_ptr<Character> hero;
+        if (kind == EntrantKind::Warrior) {
+            hero = make_unique<Warrior>(name);
+        } else if (kind == EntrantKind::Archer) {
+            hero = make_unique<Archer>(name);
+        } else {
+            hero = make_unique<Mage>(name);
+        }
+        hero->gainXp(xpTable[level]);
+        entrants.push_back({ move(hero), kind, nullptr });
+    }
+}
+
+// =================================================================
+// Returns the number of combatants
+// =================================================================
+
+size_t Tournament::size() const {
+    return entrants.size();
+}
+
+// =================================================================
+// Returns the number of matches a run plays
+// =================================================================
+
+uint64_t Tournament::matchCount() const {
+    return uint64_t(entrants.size()) * (entrants.size() - (entrants.empty() ? 0 : 1));
+}
+
+// =================================================================
+// Plays one match
+//
+// @param first The combatant that moves first
+// @param second The other one
+// @param a The copies for the first
+// @param b The copies for the second
+// @return The result for the first
+// =================================================================
+
+MatchCell Tournament::play(size_t first, size_t second, Corner& a, Corner& b) const {
+    Character* fighters[2] = { a.load(entrants[first]), b.load(entrants[second]) };
+    const vector<EffectSpec>* inflicts[2] = { entrants[first].inflicts, entrants[second].inflicts };
+    RandomStream rolls(seed, uint64_t(first) * entrants.size() + second);
+
+    // Only matches with effects pay for an engine
+    optional<StatusEngine> status;
+    if (inflicts[0] || inflicts[1]) {
+        status.emplace();
+        status->addCombatant(fighters[0]);
+        status->addCombatant(fighters[1]);
+    }
+
+    int turn = 0;
+    bool over = false;
+    while (!over && turn < MaxTurns) {
+        ++turn;
+        if (status) {
+            status->beginTurn([](int, int) {}, [](int, EffectKind) {});
+            if (!fighters[0]->isAlive() || !fighters[1]->isAlive()) break;
+        }
+        for (int side = 0; side < 2 && !over; ++side) {
+            if (status && status->isStunned(side)) continue;
+            Character* target = fighters[1 - side];
+            int before = target->getHealth();
+            strike(fighters[side], target, rolls);
+            over = !target->isAlive();
+            if (over || !inflicts[side]) continue;
+            for (const EffectSpec& effect : *inflicts[side]) {
+                bool harmful = isHarmful(effect.kind);
+                if (harmful && target->getHealth() == before) continue;
+                status->apply(harmful ? 1 - side : side, effect);
+            }
+        }
+    }
+
+    MatchCell cell = { MatchOutcome::Draw, uint8_t(turn), 0 };
+    bool firstAlive = fighters[0]->isAlive();
+    if (firstAlive != fighters[1]->isAlive()) {
+        cell.outcome = firstAlive ? MatchOutcome::Won : MatchOutcome::Lost;
+        cell.health = uint16_t(min(fighters[firstAlive ? 0 : 1]->getHealth(), int(UINT16_MAX)));
+    }
+    return cell;
+}
+
+// =================================================================
+// Plays the matches of one block of the matrix
+//
+// @param row The row of the block
+// @param col The column of the block
+// @param cells Receives the BlockCells cells of the block
+// @param table The standings to add the results to
+// =================================================================
+
+void Tournament::playBlock(size_t row, size_t col, MatchCell* cells, Standing* table) const {
+    TRACE_SPAN("tournament", "block");
+    Corner a, b;
+    size_t count = entrants.size();
+    for (size_t r = 0; r < BlockSize; ++r) {
+        size_t first = row * BlockSize + r;
+        for (size_t c = 0; c < BlockSize; ++c) {
+            size_t second = col * BlockSize + c;
+            MatchCell& cell = cells[r * BlockSize + c];
+            if (first >= count || second >= count || first == second) {
+                cell = { MatchOutcome::NotPlayed, 0, 0 };
+                continue;
+            }
+            cell = play(first, second, a, b);
+
+            Standing& mover = table[first];
+            Standing& other = table[second];
+            ++mover.matches;
+            ++other.matches;
+            if (cell.outcome == MatchOutcome::Won) {
+                ++mover.wins;
+                ++other.losses;
+                mover.healthLeft += cell.health;
+            } else if (cell.outcome == MatchOutcome::Lost) {
+                ++mover.losses;
+                ++other.wins;
+                other.healthLeft += cell.health;
+            } else {
+                ++mover.draws;
+                ++other.draws;
+            }
+        }
+    }
+}
+
+// =================================================================
+// Writes all of a buffer at an offset of a file
+//
+// @param fd The file
+// @param data The buffer
+// @param size Its size
+// @param offset Where it goes
+// @return false if the file could not be written
+// =================================================================
+
+bool Tournament::writeAt(int fd, const void* data, size_t size, off_t offset) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        bytes += written;
+        size -= size_t(written);
+        offset += written;
+    }
+    return true;
+}
+
+// =================================================================
+// Plays the tournament and writes it to a file. The blocks are
+// handed out in order to the threads, which write each one where it
+// goes in the file as soon as it is played.
+//
+// @param path The file
+// @param threads The number of threads, 0 for one per core
+// @param error Receives the reason when it fails
+// @return false if there are fewer than two combatants or the file
+// could not be written
+// =================================================================
+
+bool Tournament::run(const string& path, int threads, string& error) {
+    size_t count = entrants.size();
+    if (count < 2) {
+        error = "a tournament needs at least two combatants";
+        return false;
+    }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+
+    TournamentHeader header = { TournamentMagic, uint32_t(count), BlockSize, MaxTurns, seed };
+    vector<char> head((char*)&header, (char*)&header + sizeof(header));
+    for (const Entrant& entrant : entrants) {
+        string name = entrant.character->getName().substr(0, 255);
+        head.push_back(char(entrant.kind));
+        head.push_back(char(name.size()));
+        head.insert(head.end(), name.begin(), name.end());
+    }
+    off_t standingsAt = off_t(head.size());
+    off_t blocksAt = standingsAt + off_t(count * sizeof(Standing));
+    size_t blocks = (count + BlockSize - 1) / BlockSize;
+    size_t blockBytes = BlockCells * sizeof(MatchCell);
+    bool ok = ftruncate(fd, blocksAt + off_t(blocks * blocks * blockBytes)) == 0 &&
+              writeAt(fd, head.data(), head.size(), 0);
+
+    if (threads <= 0) threads = int(max(1u, thread::hardware_concurrency()));
+    vector<vector<Standing>> tables(threads, vector<Standing>(count, Standing{}));
+    atomic<size_t> nextBlock(0);
+    atomic<bool> failed(!ok);
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            TRACE_THREAD("tournament " + to_string(t));
+            vector<MatchCell> cells(BlockCells);
+            size_t block;
+            while (!failed.load(memory_order_relaxed) &&
+                   (block = nextBlock.fetch_add(1, memory_order_relaxed)) < blocks * blocks) {
+                playBlock(block / blocks, block % blocks, cells.data(), tables[t].data());
+                if (!writeAt(fd, cells.data(), blockBytes, blocksAt + off_t(block * blockBytes))) {
+                    failed.store(true, memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (thread& worker : pool) {
+        worker.join();
+    }
+
+    standings.assign(count, Standing{});
+    for (const vector<Standing>& table : tables) {
+        for (size_t i = 0; i < count; ++i) {
+            standings[i].wins += table[i].wins;
+            standings[i].losses += table[i].losses;
+            standings[i].draws += table[i].draws;
+            standings[i].matches += table[i].matches;
+            standings[i].healthLeft += table[i].healthLeft;
+        }
+    }
+    ok = !failed && writeAt(fd, standings.data(), count * sizeof(Standing), standingsAt);
+    if (close(fd) != 0) ok = false;
+    if (!ok) error = path + ": cannot be written";
+    return ok;
+}
+
+// =================================================================
+// Returns the totals of every combatant after run()
+// =================================================================
+
+const vector<Standing>& Tournament::getStandings() const {
+    return standings;
+}
+
+// =================================================================
+// Ranks the combatants after run(): a win is worth two points and a
+// draw one, and combatants with the same points are ranked by the
+// health they kept in their wins
+//
+// @return The combatants, best first
+// =================================================================
+
+vector<size_t> Tournament::leaderboard() const {
+    vector<size_t> order(standings.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    sort(order.begin(), order.end(), [this](size_t x, size_t y) {
+        const Standing& a = standings[x];
+        const Standing& b = standings[y];
+        uint64_t pointsA = 2 * uint64_t(a.wins) + a.draws;
+        uint64_t pointsB = 2 * uint64_t(b.wins) + b.draws;
+        if (pointsA != pointsB) return pointsA > pointsB;
+        if (a.healthLeft != b.healthLeft) return a.healthLeft > b.healthLeft;
+        return x < y;
+    });
+    return order;
+}
+
+// =================================================================
+// Prints the top of the leaderboard
+//
+// @param out Where to print it
+// @param top The number of combatants to print
+// =================================================================
+
+void Tournament::printLeaderboard(ostream& out, size_t top) const {
+    vector<size_t> order = leaderboard();
+    out << left << setw(6) << "rank" << setw(24) << "name" << setw(9) << "class" << right << setw(4) << "lv"
+        << setw(9) << "wins" << setw(9) << "losses" << setw(8) << "draws" << setw(8) << "score" << "\n";
+    for (size_t rank = 0; rank < order.size() && rank < top; ++rank) {
+        const Entrant& entrant = entrants[order[rank]];
+        const Standing& standing = standings[order[rank]];
+        double score = standing.matches ? 50.0 * (2 * standing.wins + standing.draws) / standing.matches : 0;
+        out << left << setw(6) << rank + 1 << setw(24) << entrant.character->getName().substr(0, 23)
+            << setw(9) << entrantKindNames[int(entrant.kind)] << right << setw(4) << entrant.character->getLevel()
+            << setw(9) << standing.wins << setw(9) << standing.losses << setw(8) << standing.draws
+            << setw(7) << fixed << setprecision(1) << score << "%\n";
+    }
+}
+
+// =================================================================
+// Contains the definition of the TournamentReader class
+// Reads a tournament file written by Tournament::run(): the header
+// and the names at once, then the blocks of the matrix in order.
+// =================================================================
+
+class TournamentReader {
+private:
+    ifstream in;
+    TournamentHeader header;
+    vector<string> names;
+    vector<EntrantKind> kinds;
+    size_t blocksRead;
+
+public:
+    TournamentReader();
+
+    bool open(const string& path, string& error);
+    const TournamentHeader& getHeader() const;
+    const string& nameOf(size_t entrant) const;
+    EntrantKind kindOf(size_t entrant) const;
+    size_t blocksPerSide() const;
+    bool readBlock(MatchCell* cells);
+};
+
+// =================================================================
+// Constructor
+// =================================================================
+
+TournamentReader::TournamentReader() : header{}, blocksRead(0) {}
+
+// =================================================================
+// Opens a tournament file and reads its header and names
+//
+// @param path The file
+// @param error Receives the reason when it fails
+// @return false if it is not a tournament file
+// =================================================================
+
+bool TournamentReader::open(const string& path, string& error) {
+    in.open(path, ios::binary);
+    if (!in.read((char*)&header, sizeof(header)) || header.magic != TournamentMagic || header.blockSize == 0) {
+        error = path + ": not a tournament file";
+        return false;
+    }
+    names.resize(header.entrants);
+    kinds.resize(header.entrants);
+    for (size_t i = 0; i < header.entrants; ++i) {
+        unsigned char field[2];
+        in.read((char*)field, sizeof(field));
+        kinds[i] = EntrantKind(field[0]);
+        names[i].resize(field[1]);
+        in.read(&names[i][0], field[1]);
+    }
+    in.seekg(header.entrants * sizeof(Standing), ios::cur);
+    if (!in) {
+        error = path + ": the names are cut short";
+        return false;
+    }
+    blocksRead = 0;
+    return true;
+}
+
+// =================================================================
+// Returns the header of the file
+// =================================================================
+
+const TournamentHeader& TournamentReader::getHeader() const {
+    return header;
+}
+
+// =================================================================
+// Returns the name of a combatant
+//
+// @param entrant The combatant
+// =================================================================
+
+const string& TournamentReader::nameOf(size_t entrant) const {
+    return names[entrant];
+}
+
+// =================================================================
+// Returns the kind of a combatant
+//
+// @param entrant The combatant
+// =================================================================
+
+EntrantKind TournamentReader::kindOf(size_t entrant) const {
+    return kinds[entrant];
+}
+
+// =================================================================
+// Returns the number of blocks in a row of the matrix
+// =================================================================
+
+size_t TournamentReader::blocksPerSide() const {
+    return (header.entrants + header.blockSize - 1) / header.blockSize;
+}
+
+// =================================================================
+// Reads the next block of the matrix. Block b is row b / side and
+// column b % side of the blocks, where side is blocksPerSide().
+//
+// @param cells Receives the blockSize * blockSize cells
+// @return false when every block has been read or the file is cut
+// short
+// =================================================================
+
+bool TournamentReader::readBlock(MatchCell* cells) {
+    if (blocksRead == blocksPerSide() * blocksPerSide()) return false;
+    size_t bytes = size_t(header.blockSize) * header.blockSize * sizeof(MatchCell);
+    if (!in.read((char*)cells, bytes)) return false;
+    ++blocksRead;
+    return true;
+}
+
+// =================================================================
+// Writes a tournament file as CSV, one line per match in the order
+// of the rows: first,second,outcome,turns,health. Names with commas
+// or quotes are quoted.
+//
+// @param matrixPath The tournament file
+// @param csvPath The CSV file
+// @param error Receives the reason when it fails
+// @return false if a file could not be read or written
+// =================================================================
+
+bool Tournament::exportCsv(const string& matrixPath, const string& csvPath, string& error) {
+    TournamentReader reader;
+    if (!reader.open(matrixPath, error)) return false;
+    size_t count = reader.getHeader().entrants;
+    vector<string> names(count);
+    for (size_t i = 0; i < count; ++i) {
+        names[i] = reader.nameOf(i);
+        if (names[i].find_first_of(",\"") != string::npos) {
+            string quoted = "\"";
+            for (char ch : names[i]) {
+                quoted += ch;
+                if (ch == '"') quoted += ch;
+            }
+            names[i] = quoted + "\"";
+        }
+    }
+
+    ofstream out(csvPath);
+    if (!out) {
+        error = csvPath + ": cannot be written";
+        return false;
+    }
+    static const char* const outcomes[] = { "lost", "won", "draw" };
+    size_t side = reader.getHeader().blockSize;
+    size_t blocks = reader.blocksPerSide();
+
+    // One row of blocks at a time gives whole rows of the matrix
+    vector<MatchCell> band(blocks * side * side);
+    out << "first,second,outcome,turns,health\n";
+    for (size_t row = 0; row < blocks; ++row) {
+        for (size_t col = 0; col < blocks; ++col) {
+            if (!reader.readBlock(&band[col * side * side])) {
+                error = matrixPath + ": the matrix is cut short";
+                return false;
+            }
+        }
+        for (size_t r = 0; r < side && row * side + r < count; ++r) {
+            const string& first = names[row * side + r];
+            for (size_t second = 0; second < count; ++second) {
+                const MatchCell& cell = band[(second / side) * side * side + r * side + second % side];
+                if (cell.outcome == MatchOutcome::NotPlayed) continue;
+                out << first << ',' << names[second] << ',' << outcomes[int(cell.outcome)] << ','
+                    << int(cell.turns) << ',' << cell.health << '\n';
+            }
+        }
+    }
+    out.close();
+    if (!out) {
+        error = csvPath + ": cannot be written";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,362 @@
+// =================================================================
+//
+// File: Trace.h
+// Author: Alexis Berthou
+// Description: This file contains the implementation of the Trace
+// class, which records timed spans into per-thread buffers and
+// writes them as a Chrome/Perfetto trace.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//
+// =================================================================
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Clock.h"
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// =================================================================
+// One span. The names are not copied: they must be string literals
+// or otherwise live until the trace is written.
+// =================================================================
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    int64_t start, duration;    // nanoseconds
+};
+
+// =================================================================
+// Contains the definition of the TraceBuffer class
+// The spans of one thread. Only that thread appends, so appending
+// takes no lock: the event is written, then the size is published
+// with a release store, and a reader that loads the size with
+// acquire sees every event below it. Events live in chunks that are
+// never moved or freed, so writing the trace while threads keep
+// recording is safe; when the last chunk is full, spans are counted
+// as dropped.
+// =================================================================
+
+class TraceBuffer {
+public:
+    static const size_t ChunkSize = 4096;
+    static const size_t MaxChunks = 256;    // 1M spans, 32 MB per thread at most
+
+private:
+    atomic<TraceEvent*> chunks[MaxChunks];
+    atomic<size_t> size;
+    atomic<uint64_t> lost;
+
+public:
+    const int tid;
+    string name;    // guarded by the registry of the Trace class
+
+    TraceBuffer(int threadId);
+    ~TraceBuffer();
+
+    void push(const TraceEvent& event);
+    size_t count() const;
+    const TraceEvent& at(size_t index) const;
+    uint64_t dropped() const;
+};
+
+// =================================================================
+// Constructor. Chunks are allocated as they fill.
+//
+// @param threadId The id of the thread in the trace
+// =================================================================
+
+TraceBuffer::TraceBuffer(int threadId) : size(0), lost(0), tid(threadId) {
+    for (atomic<TraceEvent*>& chunk : chunks) {
+        chunk.store(nullptr, memory_order_relaxed);
+    }
+}
+
+// =================================================================
+// Destructor. Frees the chunks.
+// =================================================================
+
+TraceBuffer::~TraceBuffer() {
+    for (atomic<TraceEvent*>& chunk : chunks) {
+        delete[] chunk.load(memory_order_relaxed);
+    }
+}
+
+// =================================================================
+// Appends a span. Called only by the owning thread.
+//
+// @param event The span
+// =================================================================
+
+void TraceBuffer::push(const TraceEvent& event) {
+    size_t n = size.load(memory_order_relaxed);
+    size_t chunk = n / ChunkSize;
+    if (chunk >= MaxChunks) {
+        lost.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    TraceEvent* events = chunks[chunk].load(memory_order_relaxed);
+    if (!events) {
+        events = new TraceEvent[ChunkSize];
+        chunks[chunk].store(events, memory_order_relaxed);
+    }
+    events[n % ChunkSize] = event;
+    size.store(n + 1, memory_order_release);
+}
+
+// =================================================================
+// Returns the number of spans published. Safe from any thread.
+// =================================================================
+
+size_t TraceBuffer::count() const {
+    return size.load(memory_order_acquire);
+}
+
+// =================================================================
+// Returns a published span
+//
+// @param index The span, below count()
+// =================================================================
+
+const TraceEvent& TraceBuffer::at(size_t index) const {
+    return chunks[index / ChunkSize].load(memory_order_relaxed)[index % ChunkSize];
+}
+
+// =================================================================
+// Returns the number of spans that did not fit
+// =================================================================
+
+uint64_t TraceBuffer::dropped() const {
+    return lost.load(memory_order_relaxed);
+}
+
+// =================================================================
+// Contains the definition of the Trace class
+// Every thread records into its own TraceBuffer, created on its
+// first span and kept until exit, so the trace still holds the
+// spans of threads that have finished. Recording is switched on and
+// off at run time; while it is off a span costs one relaxed load.
+// The trace is written in the Chrome trace event format, which
+// chrome://tracing and ui.perfetto.dev open.
+// =================================================================
+
+class Trace {
+private:
+    static inline atomic<bool> recording{ false };
+    static inline atomic<int64_t> epoch{ 0 }; // set once, maybe from a signal handler
+    static_assert(atomic<int64_t>::is_always_lock_free, "setEnabled() must stay safe in a signal handler");
+    static inline string path = "trace.json";
+    static inline thread_local TraceBuffer* local = nullptr;
+
+    static mutex& registryLock();
+    static vector<unique_ptr<TraceBuffer>>& buffers();
+    static TraceBuffer& buffer();
+
+public:
+    static bool enabled() { return recording.load(memory_order_relaxed); }
+    static void setEnabled(bool on);
+    static void setPath(const string& file);
+    static void nameThread(const string& name);
+
+    static void record(const char* category, const char* name, int64_t start);
+    static size_t spanCount();
+    static bool write();
+};
+
+// =================================================================
+// Returns the lock of the list of buffers
+// =================================================================
+
+mutex& Trace::registryLock() {
+    static mutex lock;
+    return lock;
+}
+
+// =================================================================
+// Returns the buffers of every thread that has recorded. The list
+// is never destroyed, so threads still running at exit can record.
+// =================================================================
+
+vector<unique_ptr<TraceBuffer>>& Trace::buffers() {
+    static vector<unique_ptr<TraceBuffer>>* all = new vector<unique_ptr<TraceBuffer>>();
+    return *all;
+}
+
+// =================================================================
+// Returns the buffer of the calling thread, registering it first
+// =================================================================
+
+TraceBuffer& Trace::buffer() {
+    if (!local) {
+        lock_guard<mutex> guard(registryLock());
+        buffers().push_back(make_unique<TraceBuffer>(int(buffers().size()) + 1));
+        local = buffers().back().get();
+    }
+    return *local;
+}
+
+// =================================================================
+// Starts or stops recording. Spans already open when recording
+// stops are still kept. Safe from a signal handler.
+//
+// @param on Whether to record
+// =================================================================
+
+void Trace::setEnabled(bool on) {
+    // The trace starts at zero on the first recording
+    int64_t unset = 0;
+    if (on) epoch.compare_exchange_strong(unset, monotonicNow(), memory_order_relaxed);
+    recording.store(on, memory_order_relaxed);
+}
+
+// =================================================================
+// Sets the file written by write()
+//
+// @param file The path, trace.json by default
+// =================================================================
+
+void Trace::setPath(const string& file) {
+    path = file;
+}
+
+// =================================================================
+// Names the calling thread in the trace
+//
+// @param name The name, such as "main" or "worker 2"
+// =================================================================
+
+void Trace::nameThread(const string& name) {
+    TraceBuffer& mine = buffer();
+    lock_guard<mutex> guard(registryLock());
+    mine.name = name;
+}
+
+// =================================================================
+// Records a span of the calling thread that ends now
+//
+// @param category The category, a string literal
+// @param name The name, a string literal
+// @param start When the span started, from monotonicNow()
+// =================================================================
+
+void Trace::record(const char* category, const char* name, int64_t start) {
+    buffer().push({ category, name, start, monotonicNow() - start });
+}
+
+// =================================================================
+// Returns the number of spans recorded by every thread
+// =================================================================
+
+size_t Trace::spanCount() {
+    lock_guard<mutex> guard(registryLock());
+    size_t total = 0;
+    for (const unique_ptr<TraceBuffer>& b : buffers()) {
+        total += b->count();
+    }
+    return total;
+}
+
+// =================================================================
+// Writes every span recorded so far to the trace file. Threads may
+// keep recording meanwhile; their later spans are left out.
+//
+// @return false if the file could not be written
+// =================================================================
+
+bool Trace::write() {
+    ofstream out(path);
+    if (!out) return false;
+    char line[256];
+    bool first = true;
+    auto separate = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    lock_guard<mutex> guard(registryLock());
+    int64_t start = epoch.load(memory_order_relaxed);
+    for (const unique_ptr<TraceBuffer>& b : buffers()) {
+        if (!b->name.empty()) {
+            separate();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"args\":{\"name\":\"" << b->name << "\"}}";
+        }
+        size_t n = b->count();
+        for (size_t i = 0; i < n; ++i) {
+            const TraceEvent& e = b->at(i);
+            // Timestamps are microseconds with nanosecond decimals
+            snprintf(line, sizeof(line),
+                     "{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     e.category, e.name, b->tid, (e.start - start) / 1e3, e.duration / 1e3);
+            separate();
+            out << line;
+        }
+        if (b->dropped()) {
+            separate();
+            out << "{\"ph\":\"M\",\"name\":\"dropped_spans\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"args\":{\"count\":" << b->dropped() << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return bool(out);
+}
+
+// =================================================================
+// Records the time spent in a scope as a span
+// =================================================================
+
+class TraceSpan {
+private:
+    const char* category;
+    const char* name;
+    int64_t start;
+
+public:
+    TraceSpan(const char* spanCategory, const char* spanName)
+        : category(spanCategory), name(spanName), start(Trace::enabled() ? monotonicNow() : 0) {}
+    ~TraceSpan() {
+        if (start) Trace::record(category, name, start);
+    }
+};
+
+#ifndef RPG_NO_TRACE
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+
+// Records the time until the end of the enclosing scope
+#define TRACE_SPAN(category, name) TraceSpan TRACE_JOIN(traceSpan, __LINE__)(category, name)
+// Declares a stopwatch for spans that cross scopes
+#define TRACE_STOPWATCH(watch) int64_t watch = 0
+// Starts the stopwatch, if recording
+#define TRACE_START(watch) (watch = Trace::enabled() ? monotonicNow() : 0)
+// Records the span since the stopwatch started, if it did
+#define TRACE_STOP(watch, category, name) \
+    do { if (watch) { Trace::record(category, name, watch); watch = 0; } } while (0)
+// Names the calling thread
+#define TRACE_THREAD(name) Trace::nameThread(name)
+
+#else
+
+#define TRACE_SPAN(category, name)
+#define TRACE_STOPWATCH(watch)
+#define TRACE_START(watch) do {} while (0)
+#define TRACE_STOP(watch, category, name) do {} while (0)
+#define TRACE_THREAD(name) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,563 @@
+//===============================================================
+// File: benchmark.cpp
+// Author: Alexis Berthou
+// Description: Micro-benchmarks of the combat and rendering hot
+// paths. Prints the median and the MAD of every benchmark as text,
+// JSON lines or CSV.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//===============================================================
+
+#include "Benchmark.h"
+#include "BattleSim.h"
+#include "Character.h"
+#include "History.h"
+#include "Level.h"
+#include "LevelCatalog.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Tournament.h"
+#include "Random.h"
+#include "SaveManager.h"
+#include "StatusEffects.h"
+#include "RenderBackend.h"
+#include "ui.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Targets are replaced every chunk of operations, long before
+// they could die, so every hit really lands
+const int DummyHealth = 2000000000;
+const long TargetChunk = 65536;
+
+//===============================================================
+// The hero attacks as they were written in C++ before they became
+// abilities, to compare the interpreter with them
+//===============================================================
+
+class NativeWarrior : public Warrior {
+public:
+    using Warrior::Warrior;
+
+    void attack(Character* target) override {
+        if (isAlive() && target != nullptr && target->isAlive()) {
+            if (mana >= 10) {
+                target->takeDamage(effectiveStrength * 2);
+                mana -= 10;
+            } else {
+                target->takeDamage(effectiveStrength);
+                mana += 5;
+            }
+        }
+    }
+};
+
+template <typename Hero, int Cost>
+class NativeCaster : public Hero {
+public:
+    using Hero::Hero;
+
+    void attack(Character* target) override {
+        if (this->isAlive() && target != nullptr && target->isAlive()) {
+            if (this->mana >= Cost) {
+                target->takeDamage(this->effectiveStrength * 2);
+                this->mana -= Cost;
+            } else {
+                target->takeDamage(this->effectiveStrength);
+                if (this->mana < this->maxMana) {
+                    this->mana += 10;
+                }
+            }
+        }
+    }
+};
+
+//===============================================================
+// Adds the benchmark of the attack of a character
+//
+// @param suite The suite
+// @param name The name of the benchmark
+// @param character The attacker, copied by the benchmark
+//===============================================================
+
+template <typename Attacker>
+void addAttackBenchmark(BenchmarkSuite& suite, const string& name, const Attacker& character) {
+    suite.add(name, [character](long n) {
+        Attacker attacker(character);
+        // Called through a Character*, as battles do, so the compiler
+        // cannot inline the attack into the loop
+        Character* subject = &attacker;
+        asm volatile("" : "+r"(subject));
+        for (long done = 0; done < n; done += TargetChunk) {
+            Enemy target("Dummy", DummyHealth, 0, 0, 0);
+            for (long i = 0; i < min(TargetChunk, n - done); ++i) {
+                subject->attack(&target);
+            }
+            keepValue(target.getHealth());
+        }
+    });
+}
+
+//===============================================================
+// Adds the benchmarks of one hero class
+//
+// @param suite The suite
+// @param group The name of the class
+// @param hero A hero of the class, copied by every benchmark
+//===============================================================
+
+template <typename Hero>
+void addHeroBenchmarks(BenchmarkSuite& suite, const string& group, const Hero& hero) {
+    addAttackBenchmark(suite, group + "/attack", hero);
+    // Every recovery follows a hit, so it never stops at full health
+    suite.add(group + "/recover", [hero](long n) {
+        Hero wounded(hero);
+        for (long i = 0; i < n; ++i) {
+            wounded.takeDamage(wounded.getShield() + 20);
+            wounded.recover();
+        }
+        keepValue(wounded.getHealth());
+    });
+    suite.add(group + "/getHealthPercent", [hero](long n) {
+        Hero subject(hero);
+        for (long i = 0; i < n; ++i) {
+            keepValue(subject.getHealthPercent());
+        }
+    });
+    suite.add(group + "/getManaPercent", [hero](long n) {
+        Hero subject(hero);
+        for (long i = 0; i < n; ++i) {
+            keepValue(subject.getManaPercent());
+        }
+    });
+    suite.add(group + "/toString", [hero](long n) {
+        Hero subject(hero);
+        for (long i = 0; i < n; ++i) {
+            string text = subject.toString();
+            keepValue(text.size());
+        }
+    });
+}
+
+//===============================================================
+// Plays one battle as a detached task
+//
+// @param hero The hero
+// @param enemy The enemy
+// @param rolls The stream of the battle
+// @param commands The commands of the player
+// @param sink Receives the events of the battle
+//===============================================================
+
+Task<void> playBattle(Character* hero, Character* enemy, RandomStream rolls, Channel<BattleCommand>& commands,
+                      CombatEventSink sink) {
+    co_await battleFlow(hero, enemy, rolls, commands, sink);
+}
+
+//===============================================================
+// Plays battles side by side on one executor, the way a server
+// thread does. Each battle is a spawned task suspended on its own
+// channel, and the commands are only sent from the idle hook, once
+// every battle that is still going waits for one. The hero always
+// attacks and lets the enemy answer.
+//
+// @param count The number of battles
+// @return The most battles that waited for a command at once
+//===============================================================
+
+size_t playConcurrentBattles(int count) {
+    EventLoop events;
+    Executor executor(events);
+    vector<Warrior> heroes(count, Warrior("Aragorn"));
+    vector<Enemy> enemies(count, Enemy("Orc", 75, 45, 15, 5));
+    deque<Channel<BattleCommand>> channels;
+    vector<pair<int, BattleCommand>> replies;
+    size_t waiting = 0;
+
+    executor.setIdle([&]() {
+        waiting = max(waiting, replies.size());
+        for (const pair<int, BattleCommand>& reply : replies) {
+            channels[reply.first].send(reply.second);
+        }
+        replies.clear();
+    });
+    for (int i = 0; i < count; ++i) {
+        channels.emplace_back(executor);
+        CombatEventSink answer = [&replies, i](const CombatEvent& event) {
+            if (event.type == CombatEvent::Type::AwaitAction) replies.push_back({ i, BattleCommand::Attack });
+            if (event.type == CombatEvent::Type::AwaitContinue) replies.push_back({ i, BattleCommand::Continue });
+        };
+        executor.spawn(playBattle(&heroes[i], &enemies[i], RandomStream(42, i), channels[i], answer));
+    }
+    executor.runAll();
+    return waiting;
+}
+
+//===============================================================
+// --json | --csv     Machine-readable output (text by default)
+// --filter TEXT      Only the benchmarks whose name contains TEXT
+// --reps N           Measured repetitions (15)
+// --warmup N         Repetitions thrown away first (3)
+// --min-time MS      Minimum length of one repetition (5)
+//===============================================================
+
+int main(int argc, char* argv[]) {
+    BenchmarkSuite suite;
+    BenchmarkSuite::Format format = BenchmarkSuite::Format::Text;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0) format = BenchmarkSuite::Format::Json;
+        else if (strcmp(argv[i], "--csv") == 0) format = BenchmarkSuite::Format::Csv;
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) suite.setFilter(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) suite.setRepetitions(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) suite.setWarmup(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) suite.setMinTime(atof(argv[++i]));
+    }
+
+    suite.add("character/takeDamage", [](long n) {
+        for (long done = 0; done < n; done += TargetChunk) {
+            Enemy target("Dummy", DummyHealth, 0, 0, 0);
+            for (long i = 0; i < min(TargetChunk, n - done); ++i) {
+                target.takeDamage(1);
+            }
+            keepValue(target.getHealth());
+        }
+    });
+    addHeroBenchmarks(suite, "warrior", Warrior("Warrior"));
+    addHeroBenchmarks(suite, "archer", Archer("Archer"));
+    addHeroBenchmarks(suite, "mage", Mage("Mage"));
+    addHeroBenchmarks(suite, "enemy", Enemy("Dragon", 100, 60, 100, 10));
+
+    // The hero attacks run as abilities; their C++ versions give the
+    // cost of the interpreter
+    addAttackBenchmark(suite, "ability/warriorNative", NativeWarrior("Warrior"));
+    addAttackBenchmark(suite, "ability/archerNative", NativeCaster<Archer, 20>("Archer"));
+    addAttackBenchmark(suite, "ability/mageNative", NativeCaster<Mage, 30>("Mage"));
+    addAttackBenchmark(suite, "ability/dragonBreath", LevelCatalog::builtin()->at(2).enemy);
+    suite.add("ability/compile", [](long n) {
+        const string source = "if self.mana < 20 goto bite\nadd r0, self.strength, 20\ndamage target, r0\n"
+                              "sub self.mana, self.mana, 20\nend\nbite: damage target, self.strength\n";
+        string error;
+        for (long i = 0; i < n; ++i) {
+            keepValue(Ability::compile(source, error).get());
+        }
+    });
+
+    suite.add("level/resetEnemy", [](long n) {
+        vector<Level*> levels = LevelCatalog::builtin()->createLevels();
+        for (long i = 0; i < n; ++i) {
+            levels[2]->resetEnemy();
+        }
+        keepValue(levels[2]->getEnemy());
+        for (Level* level : levels) delete level;
+    });
+
+    // A crowded battle: 1000 combatants under 10000 effects lasting
+    // up to 1000 turns; every effect that ends is replaced, so the
+    // count stays the same
+    suite.add("effects/beginTurn10k", [](long n) {
+        vector<Enemy> crowd(1000, Enemy("Dummy", DummyHealth, 0, 10, 10));
+        StatusEngine status;
+        for (Enemy& enemy : crowd) {
+            status.addCombatant(&enemy);
+        }
+        unsigned seed = 1;
+        auto nextEffect = [&seed]() {
+            seed = seed * 1103515245 + 12345;
+            return EffectSpec{ EffectKind((seed >> 8) % 6), int(seed >> 20) % 5, 1 + int(seed >> 12) % 1000 };
+        };
+        for (int i = 0; i < 10000; ++i) {
+            status.apply(i % 1000, nextEffect());
+        }
+        for (long i = 0; i < n; ++i) {
+            status.beginTurn([](int, int) {}, [&](int combatant, EffectKind) { status.apply(combatant, nextEffect()); });
+        }
+        keepValue(status.activeCount());
+    });
+
+    // Undoing the last action of a long battle, at the turn farthest
+    // from its keyframe: a restore and KeyframeInterval - 2 turns
+    // played again, per undo
+    suite.add("battle/rewind", [](long n) {
+        Warrior hero("Aragorn");
+        Enemy enemy("Dummy", DummyHealth, 0, 10, 10);
+        enemy.setInflicts({ { EffectKind::Poison, 2, 3 }, { EffectKind::Ward, 1, 2 } });
+        BattleState state(&hero, &enemy, RandomStream(42, 7));
+        BattleTimeline timeline;
+        CombatEventSink quiet = [](const CombatEvent&) {};
+        auto playTurn = [&]() {
+            timeline.startTurn(state);
+            state.beginTurn(quiet);
+            timeline.record(BattleCommand::Attack);
+            state.heroTurn(BattleCommand::Attack, quiet);
+            state.enemyTurn(quiet);
+        };
+        while (timeline.turn() < 4 * BattleTimeline::KeyframeInterval - 1) {
+            playTurn();
+        }
+        for (long i = 0; i < n; ++i) {
+            undoLastAction(timeline, state, &hero, &enemy, quiet);
+            playTurn();
+        }
+        keepValue(enemy.getHealth());
+    });
+
+    // Ten thousand battles at a time on one executor, all of them
+    // waiting for a command at once
+    suite.add("battle/concurrent10k", [](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(playConcurrentBattles(10000));
+        }
+    });
+
+    // Ten thousand heroes gain a little experience at a time, so most
+    // gains cross no level and some cross one
+    suite.add("progression/gainXp10k", [](long n) {
+        vector<Warrior> heroes(10000, Warrior("Aragorn"));
+        for (long i = 0; i < n; ++i) {
+            for (Warrior& hero : heroes) {
+                hero.gainXp(1);
+            }
+        }
+        keepValue(heroes[0].getLevel());
+    });
+    suite.add("progression/gainXpBulk10k", [](long n) {
+        vector<int32_t> xp(10000);
+        vector<uint8_t> levels(10000);
+        for (size_t i = 0; i < xp.size(); ++i) {
+            xp[i] = int32_t(i * 7 % MaxXp);
+        }
+        for (long i = 0; i < n; ++i) {
+            gainXpBulk(xp.data(), levels.data(), xp.size(), 1);
+        }
+        keepValue(levels[0]);
+    });
+
+    suite.add("random/next", [](long n) {
+        RandomStream rolls(42, 7);
+        uint32_t sum = 0;
+        for (long i = 0; i < n; ++i) {
+            sum += rolls.next();
+        }
+        keepValue(sum);
+    });
+    suite.add("random/fill4k", [](long n) {
+        vector<uint32_t> numbers(4096);
+        for (long i = 0; i < n; ++i) {
+            philoxFill(42, 7, uint64_t(i) * 1024, numbers.data(), numbers.size() / 4);
+        }
+        keepValue(numbers[0]);
+    });
+    suite.add("random/rollAttack", [](long n) {
+        RandomStream rolls(42, 7);
+        int sum = 0;
+        for (long i = 0; i < n; ++i) {
+            sum += rollAttack(rolls).damagePercent;
+        }
+        keepValue(sum);
+    });
+
+    // One block of a tournament of generated heroes, per match
+    suite.add("tournament/playBlock", [](long n) {
+        Tournament tournament(42);
+        tournament.addGenerated(Tournament::BlockSize);
+        vector<MatchCell> cells(Tournament::BlockCells);
+        vector<Standing> table(tournament.size(), Standing{});
+        long matches = Tournament::BlockSize * (Tournament::BlockSize - 1);
+        for (long i = 0; i < n; i += matches) {
+            tournament.playBlock(0, 0, cells.data(), table.data());
+        }
+        keepValue(table[0].wins);
+    });
+
+    // A board of 100000 combatants after as many battles, and a
+    // history of a million battles between 10000 of them
+    RatingBoard board(100000);
+    RandomStream rolls(42, 7);
+    for (int i = 0; i < 100000; ++i) {
+        board.recordBattle(rolls.below(100000), rolls.below(100000), rolls.below(2));
+    }
+    vector<RatedBattle> history(1000000);
+    for (RatedBattle& battle : history) {
+        battle = { rolls.below(10000), rolls.below(10000), float(rolls.below(2)) };
+    }
+    suite.add("rating/recordBattle", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            board.recordBattle(rolls.below(100000), rolls.below(100000), rolls.below(2));
+        }
+        keepValue(board.atRank(0));
+    });
+    suite.add("rating/top10", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(board.top(10)[0]);
+        }
+    });
+    suite.add("rating/rank", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(board.rank(uint32_t(i % 100000)));
+        }
+    });
+    // Per battle, in periods of 100000
+    suite.add("rating/rerate", [&](long n) {
+        vector<Rating> ratings(10000);
+        long next = 0;
+        rerate(ratings, [&](RatedBattle* battles, size_t capacity) {
+            size_t count = 0;
+            for (; count < capacity && next < n; ++count, ++next) {
+                battles[count] = history[next % history.size()];
+            }
+            return count;
+        }, 100000, 0);
+        keepValue(ratings[0].rating);
+    });
+
+    suite.add("inventory/equipSwap", [](long n) {
+        Warrior hero("Aragorn");
+        hero.pickUp(findItem("Iron Sword"));
+        hero.pickUp(findItem("Rusty Dagger"));
+        for (long i = 0; i < n; ++i) {
+            hero.equip(0);
+            keepValue(hero.getEffectiveStrength());
+        }
+    });
+
+    // Save files go to a temporary file that is removed at the end
+    char savePath[] = "/tmp/rpg_benchmarkXXXXXX";
+    int saveFd = mkstemp(savePath);
+    if (saveFd >= 0) close(saveFd);
+    vector<Character*> heroes = { new Warrior("Aragorn"), new Archer("Legolas"), new Mage("Gandalf") };
+    vector<Level*> levels = LevelCatalog::builtin()->createLevels();
+    suite.add("save/saveGame", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            SaveManager::saveGame(heroes, levels, savePath);
+        }
+    });
+    suite.add("save/roundTrip", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            SaveManager::saveGame(heroes, levels, savePath);
+            vector<Character*> loaded;
+            SaveManager::loadGame(loaded, levels, savePath);
+            keepValue(loaded.size());
+            for (Character* hero : loaded) delete hero;
+        }
+    });
+
+    // A history of a million battles to query, and another file to
+    // append to; both are removed at the end
+    char historyPath[] = "/tmp/rpg_historyXXXXXX";
+    char appendPath[] = "/tmp/rpg_historyXXXXXX";
+    for (char* path : { historyPath, appendPath }) {
+        int fd = mkstemp(path);
+        if (fd >= 0) close(fd);
+    }
+    const char* const historyEnemies[] = { "Goblin", "Wolf", "Orc", "Troll", "Dragon" };
+    auto makeBattle = [&](long i) {
+        BattleRow row;
+        row.timestamp = 1735689600 + i;
+        row.heroClass = HeroClass(1 + rolls.below(HeroClassCount));
+        row.heroLevel = 1 + int(rolls.below(MaxLevel));
+        row.enemy = historyEnemies[rolls.below(5)];
+        row.turns = rolls.range(1, 30);
+        row.damageDealt = rolls.range(0, 3000);
+        row.damageTaken = rolls.range(0, 2000);
+        row.outcome = BattleOutcome(rolls.below(3));
+        return row;
+    };
+    {
+        HistoryWriter writer;
+        writer.open(historyPath, false);
+        for (long i = 0; i < 1000000; ++i) {
+            writer.append(makeBattle(i));
+        }
+    }
+    HistoryFile historyFile;
+    string historyError;
+    historyFile.open(historyPath, historyError);
+    HistoryFilter everyBattle, someBattles;
+    someBattles.heroClass = HeroClass::Mage;
+    someBattles.minLevel = 20;
+    someBattles.maxLevel = 29;
+    // Per battle appended, its write to the tail and the packing and
+    // writing of chunks included
+    suite.add("history/append", [&](long n) {
+        HistoryWriter writer;
+        writer.open(appendPath);
+        BattleRow row = makeBattle(0);
+        for (long i = 0; i < n; ++i) {
+            row.timestamp = i;
+            writer.append(row);
+        }
+    });
+    // Per scan of the million battles on one thread
+    suite.add("history/winRates1M", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(winRates(historyFile, everyBattle, 1)[1][1].battles());
+        }
+    });
+    suite.add("history/winRatesFiltered1M", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(winRates(historyFile, someBattles, 1)[3][20].battles());
+        }
+    });
+    suite.add("history/turnStats1M", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(turnStats(historyFile, everyBattle, 1).median);
+        }
+    });
+    suite.add("history/damageByEnemy1M", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            keepValue(damageByEnemy(historyFile, everyBattle, 1).size());
+        }
+    });
+
+    // The cost of the metrics on the paths they instrument
+    suite.add("metrics/counter", [](long n) {
+        for (long i = 0; i < n; ++i) {
+            METRICS_COUNT("benchmark.counter", 1);
+        }
+    });
+    suite.add("metrics/histogram", [](long n) {
+        for (long i = 0; i < n; ++i) {
+            METRICS_RECORD("benchmark.histogram", uint64_t(i) & 0xFFFFF);
+        }
+    });
+    suite.add("metrics/scopedTimer", [](long n) {
+        for (long i = 0; i < n; ++i) {
+            METRICS_TIME("benchmark.timer.ns");
+        }
+    });
+    // A span while recording is off, the cost paid by every build
+    suite.add("trace/spanDisabled", [](long n) {
+        for (long i = 0; i < n; ++i) {
+            TRACE_SPAN("benchmark", "span");
+        }
+    });
+
+    // The card is drawn into the regions of an in-memory screen
+    UI::init(new HeadlessBackend(40, 130));
+    Warrior cardHero("Aragorn");
+    suite.add("ui/printBattleCard", [&](long n) {
+        for (long i = 0; i < n; ++i) {
+            UI::printBattleCard(&cardHero, 4, 8);
+        }
+    });
+
+    vector<BenchmarkResult> results = suite.run();
+    UI::shutdown();
+    BenchmarkSuite::print(results, format, stdout);
+
+    unlink(savePath);
+    unlink(historyPath);
+    unlink(appendPath);
+    for (Character* hero : heroes) delete hero;
+    for (Level* level : levels) delete level;
+    return 0;
+}
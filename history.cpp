@@ -0,0 +1,230 @@
+//===============================================================
+// File: history.cpp
+// Author: Alexis Berthou
+// Description: Query tool for the battle history. Prints the win
+// rates by class and level, the turn percentiles and the damage
+// by enemy of the battles that pass a filter, and can fill a
+// history with made-up battles to try the queries at scale.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//===============================================================
+
+#include "History.h"
+#include "Random.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+const char* const classNames[] = { "any", "warrior", "archer", "mage" };
+
+//===============================================================
+// Prints how to use the tool
+//===============================================================
+
+void usage() {
+    cerr << "usage: history FILE info\n"
+            "       history FILE wins|turns|enemies [filters] [--threads N]\n"
+            "       history FILE generate N [--seed S]\n"
+            "filters: --class warrior|archer|mage  --min-level N  --max-level N\n"
+            "         --since T  --until T  (seconds since the epoch)  --enemy NAME\n";
+}
+
+//===============================================================
+// Prints the size of the file and what each column takes
+//
+// @param file The history
+//===============================================================
+
+void printInfo(const HistoryFile& file) {
+    printf("battles         %llu\n", (unsigned long long)file.rowCount());
+    printf("chunks          %zu\n", file.chunkCount());
+    printf("file            %zu bytes (%.1f a battle)\n", file.fileSize(),
+           file.rowCount() ? double(file.fileSize()) / file.rowCount() : 0.0);
+    if (file.damagedBytes()) printf("damaged tail    %zu bytes, not read\n", file.damagedBytes());
+    if (file.chunkCount() == 0) return;
+    printf("\n%-10s %14s %14s %16s %22s\n", "column", "bytes", "per battle", "chunk widths", "first .. last zone");
+    for (int c = 0; c < HistoryColumnCount; ++c) {
+        HistoryColumn column = HistoryColumn(c);
+        size_t bytes = 0;
+        int widths[9] = {};
+        for (size_t i = 0; i < file.chunkCount(); ++i) {
+            bytes += file.chunk(i).storedBytes(column);
+            ++widths[file.chunk(i).zone(column).width];
+        }
+        string mix;
+        for (int width : { 0, 1, 2, 4, 8 }) {
+            if (widths[width]) mix += to_string(widths[width]) + "x" + to_string(width) + "B ";
+        }
+        const ColumnZone& first = file.chunk(0).zone(column);
+        const ColumnZone& last = file.chunk(file.chunkCount() - 1).zone(column);
+        printf("%-10s %14zu %14.2f %16s %10lld .. %lld\n", historyColumnNames[c], bytes, double(bytes) / file.rowCount(),
+               mix.c_str(), (long long)first.min, (long long)last.max);
+    }
+}
+
+//===============================================================
+// Prints the win rates by class and level
+//
+// @param table The outcomes
+//===============================================================
+
+void printWins(const WinTable& table) {
+    printf("%-8s %5s %12s %12s %12s %8s\n", "class", "level", "battles", "won", "lost", "win rate");
+    for (int heroClass = 1; heroClass <= HeroClassCount; ++heroClass) {
+        WinCount all;
+        for (int level = 1; level <= MaxLevel; ++level) {
+            const WinCount& count = table[heroClass][level];
+            for (int o = 0; o < 3; ++o) {
+                all.outcomes[o] += count.outcomes[o];
+            }
+            if (count.battles() == 0) continue;
+            printf("%-8s %5d %12llu %12llu %12llu %7.1f%%\n", classNames[heroClass], level,
+                   (unsigned long long)count.battles(), (unsigned long long)count.outcomes[int(BattleOutcome::Won)],
+                   (unsigned long long)count.outcomes[int(BattleOutcome::Lost)], 100 * count.winRate());
+        }
+        if (all.battles() == 0) continue;
+        printf("%-8s %5s %12llu %12llu %12llu %7.1f%%\n", classNames[heroClass], "all",
+               (unsigned long long)all.battles(), (unsigned long long)all.outcomes[int(BattleOutcome::Won)],
+               (unsigned long long)all.outcomes[int(BattleOutcome::Lost)], 100 * all.winRate());
+    }
+}
+
+//===============================================================
+// Prints the turn percentiles
+//
+// @param stats The turns
+//===============================================================
+
+void printTurns(const TurnStats& stats) {
+    printf("battles         %llu\n", (unsigned long long)stats.battles);
+    if (stats.battles == 0) return;
+    printf("mean            %.2f turns\n", stats.mean);
+    printf("turns           min %d  p50 %d  p90 %d  p99 %d  max %d\n", stats.least, stats.median, stats.p90, stats.p99,
+           stats.most);
+}
+
+//===============================================================
+// Prints the damage by enemy
+//
+// @param enemies The sums, most fought first
+//===============================================================
+
+void printEnemies(const vector<EnemyDamage>& enemies) {
+    printf("%-24s %12s %8s %12s %12s\n", "enemy", "battles", "won", "dealt/battle", "taken/battle");
+    for (const EnemyDamage& enemy : enemies) {
+        printf("%-24s %12llu %7.1f%% %12.1f %12.1f\n", enemy.enemy.c_str(), (unsigned long long)enemy.battles,
+               100.0 * enemy.won / enemy.battles, double(enemy.dealt) / enemy.battles, double(enemy.taken) / enemy.battles);
+    }
+}
+
+//===============================================================
+// Appends made-up battles, one a second up to now. The stronger
+// the hero is against the enemy, the likelier the win and the
+// shorter the battle. The writer keeps no tail: a run cut short
+// is simply run again.
+//
+// @param path The history file
+// @param count The number of battles
+// @param seed The seed of the battles
+// @return false if the file cannot be written
+//===============================================================
+
+bool generate(const string& path, uint64_t count, uint64_t seed) {
+    static const char* const enemies[] = { "Goblin", "Wolf", "Skeleton", "Orc", "Bandit", "Giant Spider",
+                                           "Troll", "Wraith", "Ogre", "Golem", "Lich", "Dragon" };
+    const int enemyCount = sizeof(enemies) / sizeof(enemies[0]);
+    HistoryWriter writer;
+    if (!writer.open(path, false)) return false;
+    RandomStream rolls(seed, 0);
+    int64_t start = int64_t(time(nullptr)) - int64_t(count);
+    BattleRow row;
+    for (uint64_t i = 0; i < count; ++i) {
+        int enemy = int(rolls.below(enemyCount));
+        row.timestamp = start + int64_t(i);
+        row.heroClass = HeroClass(1 + rolls.below(HeroClassCount));
+        row.heroLevel = 1 + int(rolls.below(MaxLevel));
+        row.enemy = enemies[enemy];
+        int edge = row.heroLevel - 4 * enemy;
+        int winPercent = clamp(50 + edge + 5 * int(row.heroClass), 5, 95);
+        row.outcome = rolls.chance(3) ? BattleOutcome::Left
+                    : rolls.chance(winPercent) ? BattleOutcome::Won : BattleOutcome::Lost;
+        row.turns = max(1, 3 + enemy - edge / 10 + rolls.range(-2, 6));
+        row.damageDealt = row.turns * (20 + 2 * row.heroLevel) + rolls.range(0, 40);
+        row.damageTaken = row.turns * (10 + 6 * enemy) + rolls.range(0, 40);
+        writer.append(row);
+    }
+    writer.close();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    string path = argv[1], command = argv[2];
+    HistoryFilter filter;
+    int threads = 0;
+    uint64_t seed = 0;
+    for (int i = 3; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--class") == 0) {
+            ++i;
+            for (int c = 1; c <= HeroClassCount; ++c) {
+                if (strcmp(argv[i], classNames[c]) == 0) filter.heroClass = HeroClass(c);
+            }
+        } else if (strcmp(argv[i], "--min-level") == 0) {
+            filter.minLevel = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-level") == 0) {
+            filter.maxLevel = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--since") == 0) {
+            filter.since = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--until") == 0) {
+            filter.until = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--enemy") == 0) {
+            filter.enemy = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+    }
+
+    auto begin = chrono::steady_clock::now();
+    if (command == "generate") {
+        uint64_t count = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+        if (!generate(path, count, seed)) {
+            cerr << "cannot write " << path << endl;
+            return 1;
+        }
+    } else {
+        HistoryFile file;
+        string error;
+        if (!file.open(path, error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        if (command == "info") {
+            printInfo(file);
+        } else if (command == "wins") {
+            printWins(winRates(file, filter, threads));
+        } else if (command == "turns") {
+            printTurns(turnStats(file, filter, threads));
+        } else if (command == "enemies") {
+            printEnemies(damageByEnemy(file, filter, threads));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    cerr << command << " took " << seconds << " s" << endl;
+    return 0;
+}
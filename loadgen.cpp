@@ -0,0 +1,342 @@
+//===============================================================
+// File: loadgen.cpp
+// Author: Alexis Berthou
+// Description: Load generator for the game server. Opens many
+// sessions that play battles as fast as the server answers and
+// reports the turn latency and the sessions served per core.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//===============================================================
+
+#include "Protocol.h"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//===============================================================
+// One simulated player. It always has exactly one request in
+// flight: a turn starts when a command is sent and ends when the
+// server waits for the next one.
+//===============================================================
+
+struct Client {
+    int fd = -1;
+    vector<uint8_t> input, output;
+    size_t levels = 1, level = 0;
+    int number = 0;
+    Clock::time_point sentAt;
+};
+
+//===============================================================
+// Results of one load thread
+//===============================================================
+
+struct LoadResult {
+    vector<uint32_t> latencies; // microseconds per turn
+    long battles = 0, wins = 0, errors = 0;
+};
+
+//===============================================================
+// Connects to the server
+//
+// @param path The path of the Unix socket
+// @return The connection, or -1
+//===============================================================
+
+int connectTo(const string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//===============================================================
+// Writes everything queued for a client. The sockets block, and
+// a request is a few bytes, so this never waits in practice.
+//===============================================================
+
+bool sendAll(Client& client) {
+    size_t sent = 0;
+    while (sent < client.output.size()) {
+        ssize_t n = send(client.fd, client.output.data() + sent, client.output.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    client.output.clear();
+    return true;
+}
+
+//===============================================================
+// Queues a fresh hero in place of the old roster. Requests are
+// pipelined: the server answers them in order.
+//===============================================================
+
+void newHero(Client& client) {
+    MessageWriter reset(client.output, MessageType::ResetHeroes);
+    reset.finish();
+    MessageWriter create(client.output, MessageType::CreateHero);
+    create.putU8(uint8_t(client.number % 3));
+    create.putString("Load" + to_string(client.number));
+    create.finish();
+}
+
+//===============================================================
+// Queues the next battle and starts timing its first turn
+//===============================================================
+
+void startBattle(Client& client) {
+    MessageWriter start(client.output, MessageType::StartBattle);
+    start.putU16(0);
+    start.putU16(uint16_t(client.level));
+    start.finish();
+    client.sentAt = Clock::now();
+}
+
+//===============================================================
+// Queues a battle command and starts timing the turn
+//===============================================================
+
+void sendCommand(Client& client, uint8_t command) {
+    MessageWriter message(client.output, MessageType::Command);
+    message.putU8(command);
+    message.finish();
+    client.sentAt = Clock::now();
+}
+
+//===============================================================
+// Handles one message from the server and answers it
+//===============================================================
+
+void handleMessage(Client& client, MessageType type, MessageReader& payload, LoadResult& result) {
+    if (type == MessageType::Welcome) {
+        client.levels = max<size_t>(1, payload.getU16());
+        newHero(client);
+        startBattle(client);
+        return;
+    }
+    if (type == MessageType::Error) {
+        ++result.errors;
+        newHero(client);
+        startBattle(client);
+        return;
+    }
+    if (type != MessageType::Event) return;
+
+    EventMessage event = readEvent(payload);
+    if (event.type != WireEvent::AwaitAction && event.type != WireEvent::AwaitContinue && event.type != WireEvent::End) {
+        return;
+    }
+    auto elapsed = chrono::duration_cast<chrono::microseconds>(Clock::now() - client.sentAt).count();
+    result.latencies.push_back(uint32_t(elapsed));
+
+    if (event.type == WireEvent::AwaitAction) {
+        // Recover when the next attack could kill the hero
+        bool low = event.heroHealth < 20 && event.heroMana > 0;
+        sendCommand(client, low ? 1 : 0);
+    } else if (event.type == WireEvent::AwaitContinue) {
+        sendCommand(client, 2);
+    } else {
+        ++result.battles;
+        if (event.amount) {
+            ++result.wins;
+            client.level = (client.level + 1) % client.levels;
+        } else {
+            client.level = 0;
+            newHero(client);
+        }
+        startBattle(client);
+    }
+}
+
+//===============================================================
+// A load thread: drives its clients until the deadline
+//===============================================================
+
+void drive(vector<Client>& clients, Clock::time_point deadline, LoadResult& result) {
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i = 0; i < clients.size(); ++i) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].fd, &event);
+    }
+
+    epoll_event events[64];
+    uint8_t chunk[4096];
+    while (Clock::now() < deadline) {
+        int count = epoll_wait(epollFd, events, 64, 100);
+        for (int i = 0; i < count; ++i) {
+            Client& client = clients[events[i].data.u64];
+            ssize_t got = recv(client.fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                if (got < 0 && errno == EINTR) continue;
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                ++result.errors;
+                continue;
+            }
+            client.input.insert(client.input.end(), chunk, chunk + got);
+
+            size_t offset = 0, payload, length;
+            MessageType type;
+            bool broken = false;
+            while (nextFrame(client.input, offset, type, payload, length)) {
+                if ((broken = length > MaxPayloadSize)) break;
+                MessageReader reader(client.input.data() + payload, length);
+                handleMessage(client, type, reader, result);
+            }
+            // The server never sends a frame over the limit
+            if (broken || frameTooLarge(client.input, offset)) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+                ++result.errors;
+                continue;
+            }
+            client.input.erase(client.input.begin(), client.input.begin() + offset);
+            if (!client.output.empty() && !sendAll(client)) ++result.errors;
+        }
+    }
+    close(epollFd);
+}
+
+//===============================================================
+// Returns the CPU time used so far by a process, in seconds
+//
+// @param pid The process
+// @return The user and system time, or -1 if it is unknown
+//===============================================================
+
+double processCpu(pid_t pid) {
+    ifstream stat("/proc/" + to_string(pid) + "/stat");
+    string line;
+    if (!getline(stat, line)) return -1;
+    // The command name may contain spaces; fields restart after ')'
+    size_t close = line.rfind(')');
+    if (close == string::npos) return -1;
+    vector<string> fields;
+    string field;
+    for (size_t i = close + 2; i <= line.size(); ++i) {
+        if (i == line.size() || line[i] == ' ') {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += line[i];
+        }
+    }
+    if (fields.size() < 13) return -1;
+    double ticks = atof(fields[11].c_str()) + atof(fields[12].c_str());
+    return ticks / sysconf(_SC_CLK_TCK);
+}
+
+//===============================================================
+// Returns a percentile of sorted latencies
+//===============================================================
+
+uint32_t percentile(const vector<uint32_t>& sorted, double fraction) {
+    if (sorted.empty()) return 0;
+    size_t index = size_t(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+//===============================================================
+// --socket PATH     The socket of the server (rpg.sock)
+// --sessions N      Concurrent sessions (64)
+// --threads N       Load threads (2)
+// --seconds N       Length of the run (5)
+//===============================================================
+
+int main(int argc, char* argv[]) {
+    string path = "rpg.sock";
+    int sessions = 64, threads = 2, seconds = 5;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--socket") == 0) path = argv[++i];
+        else if (strcmp(argv[i], "--sessions") == 0) sessions = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--threads") == 0) threads = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--seconds") == 0) seconds = max(1, atoi(argv[++i]));
+    }
+    threads = min(threads, sessions);
+
+    vector<vector<Client>> groups(threads);
+    pid_t serverPid = 0;
+    for (int i = 0; i < sessions; ++i) {
+        Client client;
+        client.fd = connectTo(path);
+        client.number = i;
+        if (client.fd < 0) {
+            cerr << "cannot connect to " << path << ": " << strerror(errno) << endl;
+            return 1;
+        }
+        if (!serverPid) {
+            ucred peer;
+            socklen_t size = sizeof(peer);
+            if (getsockopt(client.fd, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0) serverPid = peer.pid;
+        }
+        groups[i % threads].push_back(move(client));
+    }
+
+    double cpuBefore = serverPid ? processCpu(serverPid) : -1;
+    Clock::time_point begin = Clock::now();
+    Clock::time_point deadline = begin + chrono::seconds(seconds);
+    vector<LoadResult> results(threads);
+    vector<thread> runners;
+    for (int t = 0; t < threads; ++t) {
+        runners.emplace_back(drive, ref(groups[t]), deadline, ref(results[t]));
+    }
+    for (thread& runner : runners) {
+        runner.join();
+    }
+    double elapsed = chrono::duration<double>(Clock::now() - begin).count();
+    double cpuAfter = serverPid ? processCpu(serverPid) : -1;
+
+    LoadResult total;
+    for (LoadResult& result : results) {
+        total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+        total.battles += result.battles;
+        total.wins += result.wins;
+        total.errors += result.errors;
+    }
+    for (vector<Client>& group : groups) {
+        for (Client& client : group) close(client.fd);
+    }
+    sort(total.latencies.begin(), total.latencies.end());
+
+    double turnsPerSecond = total.latencies.size() / elapsed;
+    printf("sessions        %d\n", sessions);
+    printf("turns           %zu (%.0f/s)\n", total.latencies.size(), turnsPerSecond);
+    printf("battles         %ld (%ld won)\n", total.battles, total.wins);
+    printf("errors          %ld\n", total.errors);
+    printf("turn latency    p50 %u us  p99 %u us  max %u us\n",
+           percentile(total.latencies, 0.50), percentile(total.latencies, 0.99),
+           total.latencies.empty() ? 0 : total.latencies.back());
+    if (cpuBefore >= 0 && cpuAfter >= 0) {
+        double cores = (cpuAfter - cpuBefore) / elapsed;
+        printf("server cpu      %.2f cores\n", cores);
+        if (cores > 0) {
+            printf("per core        %.0f turns/s, %.0f sessions\n", turnsPerSecond / cores, sessions / cores);
+        }
+    }
+    return 0;
+}
@@ -5,127 +5,411 @@
 #include "Character.h"
 #include "ui.h"
 #include "SaveManager.h"
+#include "Scenes.h"
+#include "ContentWatcher.h"
+#include "GameServer.h"
+#include "Tournament.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <cerrno>
+#include <chrono>
+#include <random>
 using namespace std;
 
-vector<Level*> levels(3);
-vector<Character*> heroes;
-Character* player = nullptr;
-Level* currentLevel = nullptr;
-
-void createLevels() {
-    levels[0] = new Level(
-        "The Duel in the Goblin's Lair",
-        "The hero entered a foggy forest. Twisted trees whispered secrets. In a moonlit clearing, a mighty goblin appeared, ready to battle.",
-        "The hero bravely defeated the goblin. Exhausted but victorious, he looked at the sunrise, ready for future challenges.",
-        new Enemy("Goblin", 25, 15, 5, 2)
-    );
-
-    levels[1] = new Level(
-        "The Battle of the Shadow Cave",
-        "The cave was dark and damp, with stalactites, bats, and an oppressive atmosphere. An orc awaited the hero by a fire.",
-        "The hero, bleeding but victorious, defeated the orc. Exhausted, he picked up his sword and set out for new adventures.",
-        new Enemy("Orc", 75, 45, 15, 5)
-    );
-
-    levels[2] = new Level(
-        "The Confrontation at the Frosty Peak",
-        "On the snowy mountaintop, the hero faced the red dragon. Icy wind whipped as the dragon roared, its scales glistening. Battle imminent.",
-        "The hero stood over the fallen dragon. Wind scattered ashes. Sword smoking, he looked out over the snowy landscape, triumphant.",
-        new Enemy("Dragon", 100, 60, 100, 10)
-    );
+GameState game;
+ContentWatcher content("content");
+
+GameServer* server = nullptr;
+
+//===============================================================
+// Returns the file the metrics are written to at exit
+//
+// --metrics FILE    Write every counter, gauge and histogram to
+//                   FILE as JSON
+//
+// @return The path, or nullptr to keep them in memory only
+//===============================================================
+
+const char* metricsPath(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--metrics") == 0) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+//===============================================================
+// Applies the trace options of the command line. Recording can
+// also be switched with F11 in game and SIGUSR1 in the server; the
+// spans recorded are written at exit.
+//
+// --trace FILE      Record from the start and write the trace to
+//                   FILE (trace.json otherwise)
+//===============================================================
+
+void configureTrace(int argc, char* argv[]) {
+    TRACE_THREAD("main");
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--trace") == 0) {
+            Trace::setPath(argv[i + 1]);
+            Trace::setEnabled(true);
+        }
+    }
+}
+
+//===============================================================
+// Returns the seed of the combat rolls. A battle is replayed by
+// running again with the same seed and the same commands.
+//
+// --seed N          Seed of the combat rolls (a random one,
+//                   printed at exit, otherwise; 0 when headless)
+//
+// @param fixed The seed when none is given, or nullptr for a
+// random one
+//===============================================================
+
+uint64_t rollSeed(int argc, char* argv[], const uint64_t* fixed) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0) return strtoull(argv[i + 1], nullptr, 10);
+    }
+    if (fixed) return *fixed;
+    random_device entropy;
+    return uint64_t(entropy()) << 32 | entropy();
+}
+
+//===============================================================
+// Starts or stops recording the trace on SIGUSR1
+//===============================================================
+
+void toggleTrace(int) {
+    Trace::setEnabled(!Trace::enabled());
 }
 
-int main() {
-    createLevels();
+//===============================================================
+// Stops the game server on SIGINT and SIGTERM
+//===============================================================
+
+void stopServer(int) {
+    if (server) server->stop();
+}
+
+//===============================================================
+// Runs the game server when asked on the command line. Server
+// runs never touch the terminal or the save file.
+//
+// --server PATH     Serve sessions on the Unix socket PATH
+// --threads N       Worker threads of the server (one per core)
+// --history FILE    Append every battle to the battle history FILE
+//
+// @return false if the game should run in the terminal instead
+//===============================================================
+
+bool runServer(int argc, char* argv[]) {
+    const char* path = nullptr;
+    const char* historyPath = nullptr;
+    int threads = 0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--server") == 0) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--history") == 0) {
+            historyPath = argv[++i];
+        }
+    }
+    if (!path) return false;
+
+    string error;
+    if (!content.load(error)) cerr << "using the built-in levels: " << error << endl;
+    content.setListener([](bool ok, const string& message) {
+        cerr << (ok ? "" : "content not reloaded: ") << message << endl;
+    });
+    content.start();
+
+    uint64_t seed = rollSeed(argc, argv, nullptr);
+    HistoryWriter history;
+    if (historyPath && !history.open(historyPath)) cerr << "not recording battles: cannot open " << historyPath << endl;
+    GameServer instance(content, seed);
+    if (history.isOpen()) instance.recordTo(&history);
+    if (!instance.listen(path, threads)) {
+        cerr << "cannot listen on " << path << ": " << strerror(errno) << endl;
+        return true;
+    }
+    server = &instance;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGUSR1, toggleTrace);
+    cerr << "serving on " << path << " with seed " << seed << endl;
+    instance.run();
+    server = nullptr;
+    if (const char* metrics = metricsPath(argc, argv)) Metrics::dumpJson(metrics);
+    if (Trace::spanCount()) Trace::write();
+    return true;
+}
+
+//===============================================================
+// Plays a tournament when asked on the command line: the living
+// heroes of save.dat, the enemy of every level and any number of
+// generated heroes all play each other. The results go to a binary
+// file, and the top of the leaderboard to stdout.
+//
+// --tournament FILE  Play the tournament and write it to FILE
+// --entrants N       Add N generated heroes of random classes
+//                    and levels
+// --threads N        Threads that play the matches (one per core)
+// --top N            Rows of the leaderboard printed (20)
+// --csv FILE         Also export every match to FILE as CSV
+//
+// @return false if the game should run in the terminal instead
+//===============================================================
+
+bool runTournament(int argc, char* argv[]) {
+    const char* path = nullptr;
+    const char* csv = nullptr;
+    int threads = 0;
+    size_t generated = 0, top = 20;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--tournament") == 0) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--entrants") == 0) {
+            generated = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--top") == 0) {
+            top = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = argv[++i];
+        }
+    }
+    if (!path) return false;
+
+    string error;
+    if (!content.load(error)) cerr << "using the built-in levels: " << error << endl;
+    vector<Character*> heroes;
+    vector<Level*> levels = content.current()->createLevels();
     SaveManager::loadGame(heroes, levels, "save.dat");
 
-    UI::init();
-    Scene currentScene = Scene::MainMenu;
-    while (currentScene != Scene::Exit) {
-        switch (currentScene) {
-            case Scene::MainMenu:
-                currentScene = UI::showMainMenu();
-                break;
-            case Scene::CharacterSelector: {
-                Character* selectedHero = UI::showCharacterSelector(heroes);
-                if (selectedHero == (Character*)-1) {
-                    currentScene = Scene::CharacterCreator;
-                    break;
-                } else if (selectedHero) {
-                    player = selectedHero;
-                    currentScene = Scene::LevelSelect;
-                    break;
-                } else {
-                    currentScene = Scene::MainMenu;
-                    break;
-                }
-            }
-            case Scene::CharacterCreator: {
-                Character* newHero = UI::showCharacterCreator();
-                if (newHero) {
-                    heroes.push_back(newHero);
-                    currentScene = Scene::CharacterSelector;
-                    break;
-                } else {
-                    currentScene = Scene::MainMenu;
-                    break;
-                }
-            }
-            case Scene::LevelSelect: {
-                Level* level = UI::showLevelSelector(levels);
-                if (level) {
-                    currentLevel = level;
-                    currentScene = Scene::Battle;
-                } else {
-                    cout << "No level selected!" << endl;
-                    currentScene = Scene::MainMenu;
-                }
-                break;
-            }
-            case Scene::Battle: {
-                if (player && currentLevel) {
-                    currentLevel->addHero(player);
-                    bool battleResult = UI::showBattleScreen(currentLevel);
-                    if (battleResult) {
-                        currentScene = Scene::LevelSelect;
-                        currentLevel->setWon(true);
-                    } else if (!player->isAlive()) {
-                        currentScene = Scene::GameOver;
-                    } else {
-                        currentScene = Scene::MainMenu;
-                    }
-                } else {
-                    cout << "No character selected!" << endl;
-                    currentScene = Scene::MainMenu;
-                }
-                if (battleResult) {
-                    SaveManager::saveGame(heroes, levels, "save.dat");
-                }
-                break;
-            }
-            case Scene::GameOver: {
-                currentScene = UI::showGameOver();
-                break;
-            }
-            case Scene::Options: {
-                currentScene = UI::Options(vector<Character*>& heroes, vectors<Level*>& levels);
-                break;
+    uint64_t seed = rollSeed(argc, argv, nullptr);
+    Tournament tournament(seed);
+    for (Character* hero : heroes) {
+        if (hero->isAlive()) tournament.add(*hero);
+        delete hero;
+    }
+    for (Level* level : levels) {
+        tournament.add(*level->getEnemy());
+        delete level;
+    }
+    tournament.addGenerated(generated);
+
+    auto start = chrono::steady_clock::now();
+    if (!tournament.run(path, threads, error)) {
+        cerr << error << endl;
+        return true;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << tournament.matchCount() << " matches between " << tournament.size() << " combatants in " << seconds
+         << " s with seed " << seed << endl;
+    tournament.printLeaderboard(cout, top);
+    if (csv && !Tournament::exportCsv(path, csv, error)) cerr << error << endl;
+    if (const char* metrics = metricsPath(argc, argv)) Metrics::dumpJson(metrics);
+    if (Trace::spanCount()) Trace::write();
+    return true;
+}
+
+//===============================================================
+// Re-rates every combatant of a tournament file from scratch when
+// asked on the command line, and prints the best ratings
+//
+// --rate FILE        Re-rate the matches of the tournament FILE
+// --period N         Matches of a rating period (100000)
+// --threads N        Threads that tally the matches (one per core)
+// --top N            Rows of the leaderboard printed (20)
+//
+// @return false if the game should run in the terminal instead
+//===============================================================
+
+bool runRating(int argc, char* argv[]) {
+    const char* path = nullptr;
+    int threads = 0;
+    size_t period = 100000, top = 20;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--rate") == 0) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--period") == 0) {
+            period = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--top") == 0) {
+            top = strtoul(argv[++i], nullptr, 10);
+        }
+    }
+    if (!path) return false;
+
+    TournamentReader reader;
+    string error;
+    if (!reader.open(path, error)) {
+        cerr << error << endl;
+        return true;
+    }
+
+    // The matches come out block by block, in the order of the file
+    size_t side = reader.getHeader().blockSize;
+    size_t count = reader.getHeader().entrants;
+    size_t blocks = reader.blocksPerSide();
+    vector<MatchCell> cells(side * side);
+    size_t block = 0, cell = cells.size();
+    auto source = [&](RatedBattle* battles, size_t capacity) {
+        size_t filled = 0;
+        while (filled < capacity) {
+            if (cell == cells.size()) {
+                if (!reader.readBlock(cells.data())) break;
+                ++block;
+                cell = 0;
             }
+            const MatchCell& match = cells[cell];
+            uint32_t first = uint32_t((block - 1) / blocks * side + cell / side);
+            uint32_t second = uint32_t((block - 1) % blocks * side + cell % side);
+            ++cell;
+            if (match.outcome == MatchOutcome::NotPlayed) continue;
+            float score = match.outcome == MatchOutcome::Won ? 1 : match.outcome == MatchOutcome::Lost ? 0 : 0.5f;
+            battles[filled++] = { first, second, score };
+        }
+        return filled;
+    };
+
+    vector<Rating> ratings(count);
+    auto start = chrono::steady_clock::now();
+    uint64_t rated = rerate(ratings, source, period, threads);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << rated << " matches rated in " << seconds << " s" << endl;
+
+    RatingBoard board;
+    board.assign(ratings);
+    cout << left << setw(6) << "rank" << setw(24) << "name" << setw(9) << "class" << right << setw(8) << "rating"
+         << setw(6) << "rd" << "\n";
+    for (uint32_t player : board.top(top)) {
+        const Rating& rating = board.at(player);
+        cout << left << setw(6) << board.rank(player) + 1 << setw(24) << reader.nameOf(player).substr(0, 23)
+             << setw(9) << entrantKindNames[int(reader.kindOf(player))] << right << fixed << setprecision(0)
+             << setw(8) << rating.rating << setw(6) << rating.deviation << "\n";
+    }
+    return true;
+}
+
+//===============================================================
+// Builds a headless backend from the command line. The scripted
+// keys are read from a file; every byte is one key press.
+//
+// --headless FILE   Run on an in-memory screen fed by FILE
+// --size LxC        Screen size for the headless run (40x130)
+// --dump            Print every presented frame to stdout
+// --screen OUT      Write the screen the script ends on to OUT
+//
+// @return The backend, or nullptr to use the terminal
+//===============================================================
+
+HeadlessBackend* createHeadless(int argc, char* argv[]) {
+    const char* script = nullptr;
+    int lines = 40, cols = 130;
+    bool dump = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            script = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sscanf(argv[++i], "%dx%d", &lines, &cols);
+        } else if (strcmp(argv[i], "--dump") == 0) {
+            dump = true;
+        }
+    }
+    if (!script) return nullptr;
+
+    ifstream in(script, ios::binary);
+    stringstream keys;
+    keys << in.rdbuf();
+
+    HeadlessBackend* headless = new HeadlessBackend(lines, cols);
+    headless->pushKeys(keys.str());
+    if (dump) headless->setFrameSink(&cout);
+    return headless;
+}
+
+//===============================================================
+// Applies the animation options of the command line
+//
+// --fps N            Frame rate of the battle animations (30)
+// --frame-budget P   Percent of one core the animations may use (10)
+//===============================================================
+
+void configureAnimation(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--fps") == 0) {
+            UI::animation().setFrameRate(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--frame-budget") == 0) {
+            UI::animation().setBudget(atof(argv[++i]) / 100);
         }
     }
+}
+
+int main(int argc, char* argv[]) {
+    configureTrace(argc, argv);
+    if (runServer(argc, argv)) return 0;
+    if (runTournament(argc, argv)) return 0;
+    if (runRating(argc, argv)) return 0;
+
+    // Headless runs keep their own save file and battle history so they
+    // never touch the player's progress
+    HeadlessBackend* headless = createHeadless(argc, argv);
+    game.saveFile = headless ? "headless_save.dat" : "save.dat";
+    HistoryWriter history;
+    if (history.open(headless ? "headless_history.dat" : "history.dat")) game.history = &history;
+    const uint64_t headlessSeed = 0;
+    game.seed = rollSeed(argc, argv, headless ? &headlessSeed : nullptr);
+
+    // Levels come from the content files when they can be read, or
+    // are the built-in ones, and are reloaded when the files change
+    string contentError;
+    content.load(contentError);
+    content.start();
+    game.content = &content;
+    game.contentGeneration = content.generation();
+    game.levels = content.current()->createLevels();
+    SaveManager::loadGame(game.heroes, game.levels, game.saveFile);
+    game.levelIndex.build(game.levels);
+
+    UI::init(headless);
+    configureAnimation(argc, argv);
+
+    SceneManager scenes(UI::executor());
+    registerScenes(scenes, game);
+    scenes.run(Scene::MainMenu);
 
     // Cleanup before exiting
-    SaveManager::saveGame(heroes, levels, "save.dat");
-    for (Character* hero : heroes) {
+    SaveManager::saveGame(game.heroes, game.levels, game.saveFile);
+    history.close();
+    for (Character* hero : game.heroes) {
         delete hero;
     }
-    for (Level* level : levels) {
+    for (Level* level : game.levels) {
         delete level;
     }
+    long frames = headless ? headless->getFrameCount() : 0;
+    for (int i = 1; headless && i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--screen") == 0) {
+            ofstream(argv[i + 1], ios::binary) << headless->getFinalScreen();
+        }
+    }
     UI::shutdown();
+    if (headless) cerr << "frames: " << frames << endl;
+    cerr << "seed: " << game.seed << endl;
+    if (const char* metrics = metricsPath(argc, argv)) Metrics::dumpJson(metrics);
+    if (Trace::spanCount()) Trace::write();
     return 0;
 }
 
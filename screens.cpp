@@ -0,0 +1,181 @@
+//===============================================================
+// File: screens.cpp
+// Author: Alexis Berthou
+// Description: Golden screen tests. Plays scripted keys through
+// every scene with rpg --headless and compares the screen each
+// script ends on with the frame checked in under golden/. Every
+// case starts from a new game, so the headless save file and
+// battle history are removed before and after each run. Headless games roll with
+// seed 0, so a script lands on the same frame every time.
+//
+// Copyright (c) 2025 by Tecnologico de Monterrey.
+// All Rights Reserved. May be reproduced for any non-commercial
+// purpose.
+//===============================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+using namespace std;
+
+//===============================================================
+// A scripted run: the keys that lead to a screen, the size of the
+// screen they are played on and a text the screen must show, so
+// a script that drifts to another scene fails even on --update
+//===============================================================
+
+struct ScreenCase {
+    const char* name;
+    const char* keys;
+    int lines, cols;
+    const char* marker;
+};
+
+const ScreenCase screenCases[] = {
+    { "main_menu", "", 40, 130, "Welcome to the Game" },
+    { "main_menu_small", "", 24, 80, "Welcome to the Game" },
+    { "options", "2", 40, 130, "Options Menu" },
+    { "character_selector_empty", "1", 40, 130, "Create character" },
+    { "character_creator", "1\n", 40, 130, "Enter your character's name" },
+    { "character_creator_class", "1\nHero\n", 40, 130, "Choose a class" },
+    { "character_created", "1\nHero\n1", 40, 130, "Character created successfully" },
+    { "character_selector", "1\nHero\n1x", 40, 130, "1) Hero" },
+    { "character_search", "1\nHero\n1xZ", 40, 130, "0 of 1 heroes" },
+    { "level_select", "1\nHero\n1x\n", 40, 130, "Level Selection" },
+    { "level_jump", "1\nHero\n1x\n3\n", 40, 130, "> 3) The Confrontation" },
+    { "battle", "1\nHero\n1x\n\n", 40, 130, "Battle Screen" },
+    { "battle_won", "1\nHero\n1x\n\n1", 40, 130, "You have won the battle" },
+    { "level_select_won", "1\nHero\n1x\n\n1x", 40, 130, "Status: Completed" },
+    { "battle_turn", "1\nHero\n1x\n3\n\n1", 40, 130, "It is now the enemy's turn" },
+    { "battle_enemy_turn", "1\nHero\n1x\n\n1x\n1x", 40, 130, "It is now your turn" },
+    { "battle_rewind", "1\nHero\n1x\n\n1x\n1x5", 40, 130, "Time flows backwards" },
+    { "battle_options", "1\nHero\n1x\n3\n\n4", 40, 130, "Back to battle" },
+    { "battle_small", "1\nHero\n1x\n3\n\n1", 24, 80, "Battle Screen" },
+    { "battle_lost", "1\nHero\n1x\n3\n\n1x", 40, 130, "Dragon has won the battle" },
+    { "game_over", "1\nHero\n1x\n3\n\n1xx", 40, 130, "You have been defeated" },
+};
+
+const char* const saveFile = "headless_save.dat";
+const char* const historyFile = "headless_history.dat";
+const char* const keysFile = "screens_keys.txt";
+const char* const screenFile = "screens_screen.txt";
+
+//===============================================================
+// Reads a whole file
+//
+// @param path The file
+// @param text Receives its contents
+// @return false if it cannot be read
+//===============================================================
+
+bool readFile(const string& path, string& text) {
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    ostringstream out;
+    out << in.rdbuf();
+    text = out.str();
+    return true;
+}
+
+//===============================================================
+// Plays a case from a new game
+//
+// @param rpg The game binary
+// @param screenCase The case
+// @param screen Receives the screen the keys lead to
+// @return false if the game could not be run
+//===============================================================
+
+bool play(const string& rpg, const ScreenCase& screenCase, string& screen) {
+    remove(saveFile);
+    remove(historyFile);
+    remove(screenFile);
+    ofstream(keysFile, ios::binary) << screenCase.keys;
+
+    string command = rpg + " --headless " + keysFile
+        + " --size " + to_string(screenCase.lines) + "x" + to_string(screenCase.cols)
+        + " --screen " + screenFile + " > /dev/null 2>&1";
+    bool ran = system(command.c_str()) == 0 && readFile(screenFile, screen);
+
+    remove(saveFile);
+    remove(historyFile);
+    remove(keysFile);
+    remove(screenFile);
+    return ran;
+}
+
+//===============================================================
+// Prints the first line where two screens differ
+//
+// @param expected The golden screen
+// @param actual The screen played
+//===============================================================
+
+void printDifference(const string& expected, const string& actual) {
+    istringstream left(expected), right(actual);
+    string a, b;
+    for (int row = 0; left || right; ++row) {
+        a.clear();
+        b.clear();
+        getline(left, a);
+        getline(right, b);
+        if (a != b) {
+            cerr << "  row " << row << " expected: " << a << "\n"
+                 << "  row " << row << "   actual: " << b << "\n";
+            return;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string rpg = "./rpg";
+    string directory = "golden";
+    bool update = false;
+    const char* only = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--update") == 0) update = true;
+        else if (strcmp(argv[i], "--rpg") == 0 && i + 1 < argc) rpg = argv[++i];
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) directory = argv[++i];
+        else if (strcmp(argv[i], "--case") == 0 && i + 1 < argc) only = argv[++i];
+    }
+
+    int failed = 0, played = 0;
+    for (const ScreenCase& screenCase : screenCases) {
+        if (only && strcmp(only, screenCase.name) != 0) continue;
+        ++played;
+        string path = directory + "/" + screenCase.name + ".txt";
+        string screen;
+        if (!play(rpg, screenCase, screen)) {
+            cout << "ERROR   " << screenCase.name << ": could not run " << rpg << endl;
+            ++failed;
+            continue;
+        }
+        if (screen.find(screenCase.marker) == string::npos) {
+            cout << "FAIL    " << screenCase.name << ": no \"" << screenCase.marker << "\" on screen" << endl;
+            ++failed;
+            continue;
+        }
+        if (update) {
+            ofstream(path, ios::binary) << screen;
+            cout << "wrote   " << path << endl;
+            continue;
+        }
+        string golden;
+        if (!readFile(path, golden)) {
+            cout << "MISSING " << screenCase.name << endl;
+            ++failed;
+        } else if (golden != screen) {
+            cout << "FAIL    " << screenCase.name << endl;
+            printDifference(golden, screen);
+            ++failed;
+        } else {
+            cout << "ok      " << screenCase.name << endl;
+        }
+    }
+    if (!update) cout << played - failed << "/" << played << " screens match" << endl;
+    return failed ? 1 : 0;
+}
@@ -16,13 +16,26 @@
 
 #include "Character.h"
 #include "Level.h"
+#include "Layout.h"
+#include "RenderBackend.h"
+#include "EventLoop.h"
+#include "BattleLog.h"
+#include "RosterIndex.h"
+#include "LevelIndex.h"
+#include "Animation.h"
+#include "BattleSim.h"
+#include "Coroutine.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <ncurses.h>
 #include <string>
 #include <vector>
 #include <utility> // for pair
 #include <iostream>
 #include <cstring>
+#include <cstdlib>
 #include <iomanip>
+#include <functional>
 
 using namespace std;
 
@@ -41,6 +54,17 @@ enum class Scene {
     Exit
 };
 
+//==================================================================
+// Result of the character selector
+//==================================================================
+
+struct HeroChoice {
+    enum class Action { Back, Create, Select };
+
+    Action action;
+    Character* hero; // the chosen hero when action is Select
+};
+
 //==================================================================
 // The definition of class UI
 // This class handles the user interface for the game, including
@@ -49,26 +73,131 @@ enum class Scene {
 
 class UI {
 private:
+    // Off-screen regions, composed in this order
+    enum class Region { Frame, Header, Cards, Log, Menu };
+    static const int RegionCount = 5;
+
+    static RenderBackend* backend;
+    static int color;
+    static Layout layout;
+    static EventLoop events;
+    static function<void()> sceneDrawer;
+    static BattleLog battleLog;
+    static RosterIndex rosterIndex;
+    static vector<uint32_t> rosterMatches;
+    static const char* prompt;
+
+    // Displayed state of a battle card while its bars are animated
+    struct CardView {
+        const Character* character;
+        int row, col;
+        Tween healthBar, healthValue, manaBar, manaValue;
+        int drawnHealth, drawnMana;   // bar cells drawn in the last frame
+        int drawnHealthColor;
+        int drawnHealthDigits, drawnManaDigits; // width of the numbers drawn in the last frame
+        bool alive;
+    };
+
+    // Damage number rising above a card
+    struct Popup {
+        char text[8];
+        int row, col, color;
+        int drawnRow;                 // -1 when not on screen
+        float age;
+        bool live;
+    };
+
+    static const int MaxPopups = 8;
+    static CardView cards[2];
+    static Popup popups[MaxPopups];
+    static FrameScheduler animations;
+    static function<bool(Scene)> overlayHandler;
+    static bool battlePrepared;
+    static bool metricsOverlay;
+
+    // Coroutines of the UI and what they are suspended on
+    static Executor tasks;
+    static coroutine_handle<> keyWaiter;
+    static int pendingKey;
+    static coroutine_handle<> eventWaiter;
+    static CombatEvent* eventTarget;
+
+    // Awaitable: the next key of a battle
+    struct BattleKey {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<> handle) noexcept { keyWaiter = handle; }
+        int await_resume() const noexcept { return pendingKey; }
+    };
+
+    // Awaitable: the next event of the battle simulation
+    struct NextCombatEvent {
+        BattleSim& sim;
+        CombatEvent& event;
+        bool await_ready() const { return sim.poll(event); }
+        void await_suspend(coroutine_handle<> handle) noexcept {
+            eventWaiter = handle;
+            eventTarget = &event;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // Awaitable: the end of the running animations
+    struct AnimationsSettled {
+        bool await_ready() const { return !animations.isRunning(); }
+        void await_suspend(coroutine_handle<> handle) {
+            animations.whenIdle([handle]() { tasks.schedule(handle); });
+        }
+        void await_resume() const noexcept {}
+    };
+
+    static Rect regionRect(Region region);
+    static void createRegions();
+    static Region regionAt(int row, int col, int& localRow, int& localCol);
+    static void putText(int row, int col, const string& text);
+    static void putChar(int row, int col, char c);
+    static void setColor(int pair);
+    static void present();
+    static void drawMetricsOverlay();
+    static void relayout();
+    static void beginScene(const function<void()>& draw);
+    static int waitKey();
+    static bool readText(int row, int col, char* buffer, int length);
     static void drawFrame();
     static void printCentered(int row, const string& text);
     static void printCenteredTitle(int row, const string& text);
     static void printBlock(int startRow, int startCol, const vector<string>& block);
     static void printCenteredBlock(int startRow, const vector<string>& block);
-    static void printBattleCard(const Character* character, int row, int col);
+    static void printBattleLog();
+    static CardView* cardView(const Character* character);
+    static string statText(int base, int bonus);
+    static void trackCard(int slot, const Character* character);
+    static void animateCard(int slot, const CombatantState& state);
+    static void addPopup(const CardView& card, int delta, int color);
+    static void drawBar(int row, int col, int from, int to, int cells, int color);
+    static void drawBars(CardView& card, bool all);
+    static bool animate(float dt);
+    static int waitBattleKey();
+    static void idle();
     static const vector<string> gameName;
     static const vector<string> SkullArt;
 public:
-    static void init();
+    static void init(RenderBackend* renderBackend = nullptr);
     static void shutdown();
+    static EventLoop& eventLoop();
+    static FrameScheduler& animation();
+    static void setOverlayHandler(const function<bool(Scene)>& handler);
+    static void prepareBattle();
     static void clearScreen();
+    static void printBattleCard(const Character* character, int row, int col);
     
     static Scene showMainMenu();
-    static Character* showCharacterSelector(const vector<Character*>& heroes);
+    static HeroChoice showCharacterSelector(const vector<Character*>& heroes);
     static Character* showCharacterCreator();
-    static Level* showLevelSelector(const vector<Level*>& levels);
-    static bool showBattleScreen(const Level* level);
+    static Level* showLevelSelector(LevelIndex& levels);
+    static Task<bool> battle(const Level* level, RandomStream rolls, BattleTally& tally);
+    static Executor& executor();
     static Scene showGameOver();
-    static Scene Options(vector<Character*>& heroes, vector<Level*>& levels);
+    static Scene Options(vector<Character*>& heroes, LevelIndex& levels, bool inBattle = false);
 
 };
 
@@ -145,59 +274,314 @@ vector<string> battleCardFrame = {
 };
 
 //==================================================================
-// Clears the screen and refreshes the display
+// Regions and drawing state. Every screen is composed into the
+// backend's off-screen regions and only reaches the terminal when
+// present() is called.
 //==================================================================
 
-void UI::clearScreen() {
-    erase();
-    refresh();
+RenderBackend* UI::backend = nullptr;
+int UI::color = 1;
+Layout UI::layout;
+EventLoop UI::events;
+function<void()> UI::sceneDrawer;
+BattleLog UI::battleLog;
+RosterIndex UI::rosterIndex;
+vector<uint32_t> UI::rosterMatches;
+const char* UI::prompt = "";
+UI::CardView UI::cards[2] = {};
+UI::Popup UI::popups[UI::MaxPopups] = {};
+FrameScheduler UI::animations(UI::events);
+function<bool(Scene)> UI::overlayHandler;
+bool UI::battlePrepared = false;
+bool UI::metricsOverlay = false;
+Executor UI::tasks(UI::events);
+coroutine_handle<> UI::keyWaiter;
+int UI::pendingKey = ERR;
+coroutine_handle<> UI::eventWaiter;
+CombatEvent* UI::eventTarget = nullptr;
+
+//==================================================================
+// Returns the rectangle of a region in the current layout. The
+// frame covers the whole screen; the other regions sit inside the
+// border and are composed on top of it.
+//
+// @param region The region
+//==================================================================
+
+Rect UI::regionRect(Region region) {
+    switch (region) {
+        case Region::Header: return layout.header;
+        case Region::Cards: return layout.cards;
+        case Region::Log: return layout.log;
+        case Region::Menu: return layout.menu;
+        default: return { 0, 0, layout.getLines(), layout.getCols() };
+    }
 }
 
 //==================================================================
-// Draws the frame around the game area
-// This includes borders, corners, and horizontal lines
+// Hands the region rectangles of the current layout to the backend
 //==================================================================
 
-void UI::drawFrame() {
+void UI::createRegions() {
+    vector<Rect> rects;
+    for (int i = 0; i < RegionCount; ++i) {
+        rects.push_back(regionRect(Region(i)));
+    }
+    backend->setRegions(rects);
+}
+
+//==================================================================
+// Finds the region that owns a screen row and column. Positions
+// outside every inner region belong to the frame.
+//
+// @param row The screen row
+// @param col The screen column
+// @param localRow Receives the row relative to the returned region
+// @param localCol Receives the column relative to the returned region
+// @return The region to draw into
+//==================================================================
 
-    //TOP BORDER
-    for (int x = 2; x < COLS - 2; ++x) {
-        char c = (x % 2 == 0) ? '~' : '-';
-        mvaddch(1, x, c);
+UI::Region UI::regionAt(int row, int col, int& localRow, int& localCol) {
+    for (int i = 1; i < RegionCount; ++i) {
+        Rect r = regionRect(Region(i));
+        if (row >= r.top && row < r.top + r.height && col >= r.left && col < r.left + r.width) {
+            localRow = row - r.top;
+            localCol = col - r.left;
+            return Region(i);
+        }
     }
+    localRow = row;
+    localCol = col;
+    return Region::Frame;
+}
+
+//==================================================================
+// Writes text into the region that owns the given screen position.
+// The text is clipped to the region instead of wrapping.
+//
+// @param row The screen row
+// @param col The screen column
+// @param text The text to write
+//==================================================================
+
+void UI::putText(int row, int col, const string& text) {
+    int start = 0;
+    if (col < 0) {
+        start = -col;
+        col = 0;
+    }
+    if (start >= (int)text.length()) return;
+
+    int localRow, localCol;
+    Region region = regionAt(row, col, localRow, localCol);
+    Rect r = regionRect(region);
+    if (localRow < 0 || localRow >= r.height) return;
+
+    int width = min(r.width - localCol, (int)text.length() - start);
+    if (width <= 0) return;
+    backend->putText(int(region), localRow, localCol, text.c_str() + start, width, color);
+}
+
+//==================================================================
+// Writes a single character into the region that owns the given
+// screen position.
+//
+// @param row The screen row
+// @param col The screen column
+// @param c The character to write
+//==================================================================
+
+void UI::putChar(int row, int col, char c) {
+    int localRow, localCol;
+    Region region = regionAt(row, col, localRow, localCol);
+    Rect r = regionRect(region);
+    if (localRow < 0 || localRow >= r.height) return;
+    if (localCol < 0 || localCol >= r.width) return;
+    backend->putChar(int(region), localRow, localCol, c, color);
+}
+
+//==================================================================
+// Sets the color pair used by the following writes
+//
+// @param pair The color pair registered by the backend
+//==================================================================
+
+void UI::setColor(int pair) {
+    color = pair;
+}
+
+//==================================================================
+// Composes every region and flushes the frame in a single update
+//==================================================================
+
+void UI::present() {
+    METRICS_TIME_INTO(Metrics::renderTime());
+    METRICS_COUNT("ui.frames", 1);
+    TRACE_SPAN("ui", "present");
+    if (metricsOverlay) drawMetricsOverlay();
+    backend->present();
+}
+
+//==================================================================
+// Draws the metrics over the top right corner of the screen. The
+// overlay is toggled with F12 and redrawn on every frame.
+//==================================================================
 
-    // First horiztal border
-    for (int x = 2; x < COLS - 2; ++x) {
-        char c = (x % 2 == 0) ? '~' : '-';
-        mvaddch(33, x, c);
+void UI::drawMetricsOverlay() {
+    vector<string> lines = Metrics::summary();
+    if (lines.empty()) lines.push_back("no metrics in this build");
+    int width = 74;
+    int col = max(layout.getCols() - width - 2, 0);
+    int rows = min((int)lines.size(), layout.getLines() - 3);
+    int previous = color;
+    setColor(3);
+    putText(1, col, " Metrics [F12]" + string(width - 14, ' '));
+    for (int i = 0; i < rows; ++i) {
+        string line = " " + lines[i];
+        line.resize(width, ' ');
+        putText(2 + i, col, line);
     }
+    setColor(previous);
+}
 
-    // Bottom border
-    for (int x = 3; x < COLS - 2; ++x) {
-        char c = (x % 2 == 0) ? '~' : '-';
-        mvaddch(LINES - 1, x, c);
+//==================================================================
+// Recomputes the layout for the current screen size and rebuilds
+// the regions. Called only when the backend reports a resize.
+//==================================================================
+
+void UI::relayout() {
+    if (!layout.update(backend->getLines(), backend->getCols())) return;
+    createRegions();
+}
+
+//==================================================================
+// Clears the regions and draws a new screen. The drawing function
+// is kept so the screen can be rebuilt after a terminal resize.
+//
+// @param draw Draws the static part of the screen
+//==================================================================
+
+void UI::beginScene(const function<void()>& draw) {
+    // Animations belong to the screen that started them
+    animations.stop();
+    for (CardView& card : cards) {
+        card.character = nullptr;
     }
-    
-    // Left border
-    for (int y = 2; y < LINES - 1; ++y) {
-        char c = (y % 2 == 0) ? '!' : '|';
-        mvaddch(y, 1, c);
+    for (Popup& popup : popups) {
+        popup.live = false;
+    }
+    sceneDrawer = draw;
+    clearScreen();
+    sceneDrawer();
+}
+
+//==================================================================
+// Flushes the current frame and waits for a key press on the event
+// loop, so timers and internal events keep running meanwhile.
+// Resizes are handled here: the layout is recomputed and the
+// current screen is redrawn without returning to the caller, and
+// so is F12, which shows or hides the metrics overlay, and F11,
+// which starts or stops recording the trace.
+//
+// @return The key pressed by the user, or KEY_EXIT when the input
+// has been closed
+//==================================================================
+
+int UI::waitKey() {
+    while (true) {
+        present();
+        int key = events.waitKey();
+        if (key == KEY_F(11)) {
+            Trace::setEnabled(!Trace::enabled());
+            continue;
+        } else if (key == KEY_F(12)) {
+            // Hiding the overlay redraws what it covered
+            metricsOverlay = !metricsOverlay;
+            if (metricsOverlay) continue;
+        } else if (key != KEY_RESIZE) {
+            return key;
+        } else {
+            relayout();
+        }
+        if (sceneDrawer) {
+            clearScreen();
+            sceneDrawer();
+        }
     }
+}
+
+//==================================================================
+// Reads a line of text typed at the given screen position. Keys are
+// read through waitKey(), so the event loop keeps running while the
+// user types. Enter finishes the line and backspace deletes.
+//
+// @param row The screen row where the input is echoed
+// @param col The screen column where the input is echoed
+// @param buffer Receives the text
+// @param length The maximum number of characters to read
+// @return false if the input was closed before Enter was pressed
+//==================================================================
 
-    // Right border
-    for (int y = 2; y < LINES - 1; ++y) {
-        char c = (y % 2 == 0) ? '!' : '|';
-        mvaddch(y, COLS - 2, c);
+bool UI::readText(int row, int col, char* buffer, int length) {
+    int size = 0;
+    buffer[0] = '\0';
+    while (true) {
+        int key = waitKey();
+        if (key == KEY_EXIT) {
+            return false;
+        } else if (key == '\n' || key == '\r' || key == KEY_ENTER) {
+            return true;
+        } else if ((key == KEY_BACKSPACE || key == 127 || key == '\b') && size > 0) {
+            buffer[--size] = '\0';
+            putChar(row, col + size, ' ');
+        } else if (key >= 32 && key < 127 && size < length) {
+            buffer[size] = (char)key;
+            putChar(row, col + size, (char)key);
+            buffer[++size] = '\0';
+        }
     }
+}
 
-    mvaddch(1, 1, '+'); // Left-Top
-    mvaddch(1, COLS - 2, '+'); // Right-Top
-    mvaddch(33, 1, '+'); // Left-1
-    mvaddch(33, COLS - 2, '+'); // Right-1
-    mvaddch(LINES - 1, 1, '+'); // Bottom-left corner
-    mvaddch(LINES - 1, COLS - 2, '+'); // Bottom-right corner
+//==================================================================
+// Clears every off-screen region. The terminal is updated on the
+// next present().
+//==================================================================
 
-    refresh();
+void UI::clearScreen() {
+    for (int i = 0; i < RegionCount; ++i) {
+        backend->clearRegion(i);
+    }
+}
+
+//==================================================================
+// Draws the frame around the game area
+// This includes borders, corners, and horizontal lines. The glyph
+// runs are pre-rendered by the layout for the current size.
+//==================================================================
+
+void UI::drawFrame() {
+    const int top = layout.titleRow;
+    const int divider = layout.dividerRow;
+    const int bottom = layout.bottomRow;
+    const int right = layout.getCols() - 2;
+
+    // Top border, first horizontal border and bottom border
+    putText(top, 2, layout.topRun);
+    putText(divider, 2, layout.topRun);
+    putText(bottom, 3, layout.bottomRun);
+
+    // Left and right borders
+    for (int y = top + 1; y < bottom; ++y) {
+        putChar(y, 1, layout.sideRun[y]);
+        putChar(y, right, layout.sideRun[y]);
+    }
+
+    putChar(top, 1, '+'); // Left-Top
+    putChar(top, right, '+'); // Right-Top
+    putChar(divider, 1, '+'); // Left-1
+    putChar(divider, right, '+'); // Right-1
+    putChar(bottom, 1, '+'); // Bottom-left corner
+    putChar(bottom, right, '+'); // Bottom-right corner
 }
 
 //==================================================================
@@ -218,43 +602,340 @@ void UI::printBattleCard(const Character* character, int tableStartRow, int tabl
 
     // Draw the card frame
     printBlock(tableStartRow, tableStartCol, battleCardFrame);
-    // Print Name
-    mvprintw(tableStartRow + 1, tableStartCol + 4, "%s", character->getName().c_str());
+    // Print Name, and the level of a hero
+    putText(tableStartRow + 1, tableStartCol + 4, character->getName());
+    if (character->canLevel()) {
+        putText(tableStartRow + 1, tableStartCol + 28, "Lv " + to_string(character->getLevel()));
+    }
     
+    // The bars show the animated values of a tracked card, or the
+    // current values otherwise. A tracked character may belong to
+    // the battle simulation, so only its name and fixed stats are read.
+    CardView* card = cardView(character);
+    CardView still = {};
+    if (!card) {
+        card = &still;
+        card->character = character;
+        card->healthBar.set(character->getHealthPercent());
+        card->healthValue.set(character->getHealth());
+        card->manaBar.set(character->getManaPercent());
+        card->manaValue.set(character->getMana());
+        card->alive = character->isAlive();
+    }
+
     // Print Health Bar
-    float healthPercent = character->getHealthPercent();
-    mvprintw(tableStartRow + 3, tableStartCol + 4, "Health:  [");
-    if (healthPercent > 0.3) {
-        attron(COLOR_PAIR(3)); // Green for health
-    } else if (healthPercent > 0) {
-        attron(COLOR_PAIR(2)); // Red for low health
-    }
-    for (int i = 0; i < int(20 * healthPercent); ++i) {
-        mvaddch(tableStartRow + 3, tableStartCol + 14 + i, '#');
-    }
-    mvprintw(tableStartRow + 3, tableStartCol + 23, "%i", character->getHealth());
-    if (character->isAlive()) {
-        attron(COLOR_PAIR(1)); // Reset color
+    putText(tableStartRow + 3, tableStartCol + 4, "Health:  [");
+    if (card->alive) {
+        setColor(1); // Reset color
     } else {
-        attron(COLOR_PAIR(2)); // Red
+        setColor(2); // Red
     }
-    mvprintw(tableStartRow + 3, tableStartCol + 34, "]");
-    attron(COLOR_PAIR(1)); // Reset color
+    putText(tableStartRow + 3, tableStartCol + 34, "]");
+    setColor(1); // Reset color
 
     // Print Mana Bar
-    float manaPercent = character->getManaPercent();
-    mvprintw(tableStartRow + 4, tableStartCol + 4, "Mana:    [");
-    attron(COLOR_PAIR(4)); // Blue for mana
-    for (int i = 0; i < int(20 * manaPercent); ++i) {
-        mvaddch(tableStartRow + 4, tableStartCol + 14 + i, '#');
+    putText(tableStartRow + 4, tableStartCol + 4, "Mana:    [");
+    putText(tableStartRow + 4, tableStartCol + 34, "]");
+
+    // Print Strength and Shield, with what the equipment adds
+    const Inventory& gear = character->getInventory();
+    putText(tableStartRow + 5, tableStartCol + 4, "Strength: " + statText(character->getStrength(), gear.getBonusStrength()));
+    putText(tableStartRow + 6, tableStartCol + 4, "Shield:   " + statText(character->getShield(), gear.getBonusShield()));
+
+    card->row = tableStartRow;
+    card->col = tableStartCol;
+    drawBars(*card, true);
+}
+
+//==================================================================
+// Formats a stat of a card with what the equipment adds to it
+//
+// @param base The stat of the character
+// @param bonus The equipment bonus
+// @return "40", or "48 (+8)" with equipment
+//==================================================================
+
+string UI::statText(int base, int bonus) {
+    if (bonus == 0) return to_string(base);
+    return to_string(base + bonus) + " (" + (bonus > 0 ? "+" : "") + to_string(bonus) + ")";
+}
+
+//==================================================================
+// Returns the animated view of a character's card
+//
+// @param character The character
+// @return The view, or nullptr if the card is not tracked
+//==================================================================
+
+UI::CardView* UI::cardView(const Character* character) {
+    for (CardView& card : cards) {
+        if (card.character && card.character == character) return &card;
     }
-    mvprintw(tableStartRow + 4, tableStartCol + 23, "%i", character->getMana());
-    attron(COLOR_PAIR(1)); // Reset color
-    mvprintw(tableStartRow + 4, tableStartCol + 34, "]");
+    return nullptr;
+}
+
+//==================================================================
+// Starts tracking the card of a character so later changes to its
+// health and mana are animated. The bars start at the current values.
+//
+// @param slot 0 for the hero, 1 for the enemy
+// @param character The character shown on the card
+//==================================================================
+
+void UI::trackCard(int slot, const Character* character) {
+    CardView& card = cards[slot];
+    card.character = character;
+    card.row = layout.cardRow;
+    card.col = slot == 0 ? layout.heroCardCol : layout.enemyCardCol;
+    card.healthBar.set(character->getHealthPercent());
+    card.healthValue.set(character->getHealth());
+    card.manaBar.set(character->getManaPercent());
+    card.manaValue.set(character->getMana());
+    card.drawnHealth = card.drawnMana = -1;
+    card.drawnHealthColor = -1;
+    card.drawnHealthDigits = card.drawnManaDigits = 0;
+    card.alive = character->isAlive();
+}
+
+//==================================================================
+// Animates the bars of a tracked card towards a new state of its
+// character, and pops up the change in health
+//
+// @param slot 0 for the hero, 1 for the enemy
+// @param state The state published by the battle simulation
+//==================================================================
 
-    // Print Strength and Shield
-    mvprintw(tableStartRow + 5, tableStartCol + 4, "Strength: %d", character->getStrength());
-    mvprintw(tableStartRow + 6, tableStartCol + 4, "Shield:   %d", character->getShield());
+void UI::animateCard(int slot, const CombatantState& state) {
+    CardView& card = cards[slot];
+    if (!card.character) return;
+    const float seconds = 0.4f;
+
+    int healthDelta = state.health - int(card.healthValue.target());
+    int manaDelta = state.mana - int(card.manaValue.target());
+    if (healthDelta != 0) addPopup(card, healthDelta, healthDelta < 0 ? 2 : 3);
+    else if (manaDelta > 0) addPopup(card, manaDelta, 4);
+
+    card.healthBar.retarget(state.healthPercent, seconds);
+    card.healthValue.retarget(state.health, seconds);
+    card.manaBar.retarget(state.manaPercent, seconds);
+    card.manaValue.retarget(state.mana, seconds);
+    card.alive = state.alive;
+    animations.start();
+}
+
+//==================================================================
+// Adds a number that rises above a card and fades out. The oldest
+// popup is reused when every slot is taken.
+//
+// @param card The card the popup belongs to
+// @param delta The change to show
+// @param color The color pair of the number
+//==================================================================
+
+void UI::addPopup(const CardView& card, int delta, int color) {
+    Popup* slot = &popups[0];
+    for (Popup& popup : popups) {
+        if (!popup.live) {
+            slot = &popup;
+            break;
+        }
+        if (popup.age > slot->age) slot = &popup;
+    }
+    if (slot->live && slot->drawnRow >= 0) {
+        putText(slot->drawnRow, slot->col, string(strlen(slot->text), ' '));
+    }
+    snprintf(slot->text, sizeof(slot->text), "%+d", delta);
+    slot->row = card.row - 1;
+    slot->col = card.col + 20;
+    slot->color = color;
+    slot->drawnRow = -1;
+    slot->age = 0;
+    slot->live = true;
+}
+
+//==================================================================
+// Draws a range of cells of a bar: '#' up to the filled width and
+// blanks after it
+//
+// @param row The row of the bar
+// @param col The column of the first cell
+// @param from The first cell to draw
+// @param to One past the last cell to draw
+// @param cells The number of filled cells
+// @param color The color pair of the filled cells
+//==================================================================
+
+void UI::drawBar(int row, int col, int from, int to, int cells, int color) {
+    setColor(color);
+    for (int i = from; i < to; ++i) {
+        putChar(row, col + i, i < cells ? '#' : ' ');
+    }
+    setColor(1);
+}
+
+//==================================================================
+// Draws the health and mana bars of a card. Unless all is set only
+// the cells that changed since the last frame are drawn, plus the
+// cells under the number printed over the bar and under the one
+// printed before it, which may have been wider.
+//
+// @param card The card
+// @param all true to draw every cell
+//==================================================================
+
+void UI::drawBars(CardView& card, bool all) {
+    const int width = 20, numberCell = 9;
+    int barCol = card.col + 14;
+
+    float healthPercent = card.healthBar.value();
+    int health = int(width * healthPercent);
+    int healthColor = healthPercent > 0.3 ? 3 : (healthPercent > 0 ? 2 : 1);
+    int row = card.row + 3;
+    if (all || healthColor != card.drawnHealthColor) {
+        drawBar(row, barCol, 0, width, health, healthColor);
+    } else if (health != card.drawnHealth) {
+        drawBar(row, barCol, min(health, card.drawnHealth), max(health, card.drawnHealth), health, healthColor);
+    }
+    string number = to_string(int(card.healthValue.value() + 0.5f));
+    drawBar(row, barCol, numberCell, numberCell + max(int(number.size()), card.drawnHealthDigits), health, healthColor);
+    setColor(healthColor);
+    putText(row, barCol + numberCell, number);
+    card.drawnHealth = health;
+    card.drawnHealthColor = healthColor;
+    card.drawnHealthDigits = int(number.size());
+
+    int mana = int(width * card.manaBar.value());
+    row = card.row + 4;
+    if (all || card.drawnMana < 0) {
+        drawBar(row, barCol, 0, width, mana, 4);
+    } else if (mana != card.drawnMana) {
+        drawBar(row, barCol, min(mana, card.drawnMana), max(mana, card.drawnMana), mana, 4);
+    }
+    number = to_string(int(card.manaValue.value() + 0.5f));
+    drawBar(row, barCol, numberCell, numberCell + max(int(number.size()), card.drawnManaDigits), mana, 4);
+    setColor(4);
+    putText(row, barCol + numberCell, number);
+    setColor(1);
+    card.drawnMana = mana;
+    card.drawnManaDigits = int(number.size());
+}
+
+//==================================================================
+// Runs one animation frame: advances the bars and popups, draws
+// only what moved and flushes the frame
+//
+// @param dt Seconds since the previous frame
+// @return true while something is still moving
+//==================================================================
+
+bool UI::animate(float dt) {
+    const float popupLife = 0.9f;
+    const int popupRise = 3;
+    bool active = false;
+
+    for (CardView& card : cards) {
+        if (!card.character) continue;
+        if (!card.healthBar.active() && !card.healthValue.active() && !card.manaBar.active() && !card.manaValue.active()) continue;
+        card.healthBar.advance(dt);
+        card.healthValue.advance(dt);
+        card.manaBar.advance(dt);
+        card.manaValue.advance(dt);
+        drawBars(card, false);
+        active = active || card.healthBar.active() || card.healthValue.active() || card.manaBar.active() || card.manaValue.active();
+    }
+
+    for (Popup& popup : popups) {
+        if (!popup.live) continue;
+        popup.age += dt;
+        int row = popup.age >= popupLife ? -1 : popup.row - int(popup.age / popupLife * popupRise);
+        if (row >= 0 && row == popup.drawnRow) {
+            active = true;
+            continue;
+        }
+        if (popup.drawnRow >= 0) {
+            putText(popup.drawnRow, popup.col, string(strlen(popup.text), ' '));
+        }
+        if (row >= 0) {
+            setColor(popup.color);
+            putText(row, popup.col, popup.text);
+            setColor(1);
+            active = true;
+        } else {
+            popup.live = false;
+        }
+        popup.drawnRow = row;
+    }
+
+    present();
+    return active;
+}
+
+//==================================================================
+// Prints the battle log panel. The last row of the log region holds
+// the current prompt; the rows above it show the visible window of
+// the log, so the cost does not depend on the length of the fight.
+//==================================================================
+
+void UI::printBattleLog() {
+    const Rect& r = layout.log;
+    int rows = r.height - 1;
+    if (rows <= 0) return;
+
+    const char* text[64];
+    int colors[64];
+    int count = battleLog.getVisible(min(rows, 64), text, colors);
+    for (int i = 0; i < rows; ++i) {
+        printCentered(r.top + i, "");
+    }
+    for (int i = 0; i < count; ++i) {
+        setColor(colors[i]);
+        putText(r.top + i, r.left + 2, text[i]);
+    }
+    setColor(1);
+
+    printCentered(r.top + rows, prompt);
+    if (battleLog.getScroll() > 0) {
+        putText(r.top + rows, r.left + r.width - 22, "[" + to_string(battleLog.getScroll()) + " lines back]");
+    }
+}
+
+//==================================================================
+// Waits for a key during a battle. Page Up and Page Down scroll the
+// battle log and keep waiting; any other key is returned.
+//
+// @return The key pressed by the user
+//==================================================================
+
+int UI::waitBattleKey() {
+    int page = max(layout.log.height - 1, 1);
+    while (true) {
+        int key = waitKey();
+        if (key == KEY_PPAGE) {
+            battleLog.scrollUp(page);
+        } else if (key == KEY_NPAGE) {
+            battleLog.scrollDown(page);
+        } else {
+            return key;
+        }
+        printBattleLog();
+    }
+}
+
+//==================================================================
+// Runs when no UI coroutine is ready. A coroutine waiting for a key
+// gets the next one; otherwise the loop sleeps until a timer, an
+// animation or the battle simulation schedules one.
+//==================================================================
+
+void UI::idle() {
+    if (keyWaiter) {
+        pendingKey = waitBattleKey();
+        coroutine_handle<> handle = keyWaiter;
+        keyWaiter = nullptr;
+        tasks.schedule(handle);
+        return;
+    }
+    events.waitFor([]() { return tasks.hasReady(); });
 }
 
 //==================================================================
@@ -266,11 +947,11 @@ void UI::printBattleCard(const Character* character, int tableStartRow, int tabl
 
 void UI::printCentered(int row, const string& text) {
     // Clear the line before printing
-    mvprintw(row, 4, "%s", string(COLS - 4, ' ').c_str()); 
+    putText(row, 4, string(max(layout.getCols() - 6, 0), ' '));
     // Calculate the column to center the text
-    int col = (COLS - text.length()) / 2;
+    int col = (layout.getCols() - (int)text.length()) / 2;
     // Print the text at the calculated position
-    mvprintw(row, col, "%s", text.c_str());
+    putText(row, col, text);
 }
 
 //==================================================================
@@ -283,9 +964,9 @@ void UI::printCentered(int row, const string& text) {
 
 void UI::printCenteredTitle(int row, const string& text) {
     // Calculate the column to center the title text
-    int col = (COLS - text.length()) / 2;
+    int col = (layout.getCols() - (int)text.length()) / 2;
     // Print the title at the calculated position
-    mvprintw(row, col, "%s", text.c_str());
+    putText(row, col, text);
 }
 
 //==================================================================
@@ -298,7 +979,7 @@ void UI::printCenteredTitle(int row, const string& text) {
 
 void UI::printBlock(int startRow, int startCol, const vector<string>& block) {
     for (size_t i = 0; i < block.size(); ++i) {
-        mvprintw(startRow + i, startCol, "%s", block[i].c_str());
+        putText(startRow + i, startCol, block[i]);
     }
 }
 
@@ -310,38 +991,96 @@ void UI::printBlock(int startRow, int startCol, const vector<string>& block) {
 //==================================================================
 
 void UI::printCenteredBlock(int startRow, const vector<string>& block) {
-    for (size_t i = 0; i < block.size(); ++i) {
-        int col = (COLS - block[i].length()) / 2;
-        mvprintw(startRow + i, col, "%s", block[i].c_str());
+    // The centered positions are cached by the layout per terminal size
+    const PlacedArt& art = layout.placeCentered(startRow, block);
+    for (size_t i = 0; i < art.lines.size(); ++i) {
+        putText(startRow + i, art.lines[i].first, art.lines[i].second);
     }
 }
 
 //==================================================================
-// Initializes the ncurses library and sets up the terminal for 
-// the game.
+// Initializes the render backend and sets up the screen for the
+// game. The UI takes ownership of the backend.
+//
+// @param renderBackend The backend to draw on, or nullptr for the
+// ncurses terminal
 //==================================================================
 
-void UI::init() {
-    initscr(); // Initialize ncurses
-    cbreak(); // Disable line buffering
-    noecho(); // Don't echo input characters
-    keypad(stdscr, TRUE); // Enable function keys
-    curs_set(0); // Hide the cursor
-    start_color(); // Start color functionality
-    init_pair(1, COLOR_WHITE, COLOR_BLACK); // Default color pair
-    init_pair(2, COLOR_RED, COLOR_BLACK); // Red color pair
-    init_pair(3, COLOR_GREEN, COLOR_BLACK); // Green color pair
-    init_pair(4, COLOR_BLUE, COLOR_BLACK); // Blue color pair
-    init_pair(5, COLOR_BLACK, COLOR_RED); // Red Black inverted
-    bkgd(COLOR_PAIR(1)); // Set the background color to default
+void UI::init(RenderBackend* renderBackend) {
+    backend = renderBackend ? renderBackend : new NcursesBackend();
+    backend->start();
+    events.setInput(backend);
+    layout.update(backend->getLines(), backend->getCols()); // Geometry for the current screen size
+    createRegions(); // Off-screen regions for the UI
+    animations.setAnimate(animate);
+    tasks.setIdle(idle);
+    // Without a terminal no time passes between keys, so scripted
+    // runs jump straight to the end of every animation
+    animations.setEnabled(backend->inputFd() >= 0);
 }
 
 //==================================================================
-// Shuts down the ncurses library and restores the terminal settings
+// Shuts down the render backend and restores the terminal settings
 //==================================================================
 
 void UI::shutdown() {
-    endwin();
+    animations.stop();
+    backend->stop();
+    events.setInput(nullptr);
+    delete backend;
+    backend = nullptr;
+}
+
+//==================================================================
+// Returns the event loop that drives the UI. Timers and internal
+// events added to it run while a screen waits for input.
+//==================================================================
+
+EventLoop& UI::eventLoop() {
+    return events;
+}
+
+//==================================================================
+// Returns the scheduler of the battle animations, to set the frame
+// rate and the CPU budget
+//==================================================================
+
+FrameScheduler& UI::animation() {
+    return animations;
+}
+
+//==================================================================
+// Returns the executor that runs the coroutines of the UI on the
+// event loop
+//==================================================================
+
+Executor& UI::executor() {
+    return tasks;
+}
+
+//==================================================================
+// Sets the function that shows a scene on top of the current one,
+// such as the options menu during a battle
+//
+// @param handler Runs the scene until it closes; returns false if
+// the game should quit
+//==================================================================
+
+void UI::setOverlayHandler(const function<bool(Scene)>& handler) {
+    overlayHandler = handler;
+}
+
+//==================================================================
+// Gets the battle screen ready before it is shown: empties the log
+// and sets its wrap width for the current layout. Called ahead of
+// time while the previous screen waits for input; the battle screen
+// does it itself otherwise.
+//==================================================================
+
+void UI::prepareBattle() {
+    battleLog.clear();
+    battleLog.setWidth(layout.log.width - 4);
+    battlePrepared = true;
 }
 
 //==================================================================
@@ -349,96 +1088,160 @@ void UI::shutdown() {
 //==================================================================
 
 Scene UI::showMainMenu() {
-    // Clear the screen and draw the frame
-    clearScreen();
-    drawFrame();
-
-    // Print the title, game name and skull art
-    printCenteredTitle(1, "Welcome to the Game!");
-    printCenteredBlock(3, UI::gameName);
-    printCenteredBlock(10, UI::SkullArt);
-    
-    // Print the options and wait for user input
-    mvprintw(36, 4, "[1] Start Game");
-    mvprintw(37, 4, "[2] Options");
-    mvprintw(37, 4, "[3] Exit");
-    int choice = getch();
+    beginScene([]() {
+        drawFrame();
+
+        // Print the title, game name and skull art
+        printCenteredTitle(layout.titleRow, "Welcome to the Game!");
+        printCenteredBlock(layout.subtitleRow, UI::gameName);
+        printCenteredBlock(layout.listRow, UI::SkullArt);
+
+        // Print the options
+        putText(layout.menuRow, layout.menuCol, "[1] Start Game");
+        putText(layout.menuRow + 1, layout.menuCol, "[2] Options");
+        putText(layout.menuRow + 2, layout.menuCol, "[3] Exit");
+    });
+
+    // Wait for user input
+    int choice = waitKey();
     switch (choice) {
         case '1':
             return Scene::CharacterSelector;
         case '2':
             return Scene::Options;
         case '3':
+        case KEY_EXIT:
             return Scene::Exit;
         default:
-            printCentered(11, "Invalid choice, please try again.");
-            getch();
+            printCentered(layout.noticeRow, "Invalid choice, please try again.");
+            waitKey();
             return Scene::MainMenu;
     }
 }
 
 //==================================================================
-// Displays the character selector screen
+// Displays the character selector screen. Only the visible page of
+// the roster is drawn. Typing searches the hero names through the
+// roster index, by prefix or fuzzy (Tab); F2 cycles the class filter
+// and F3 hides dead heroes. The last entry creates a new character.
 //
 // @param heroes Vector of available Character pointers
-// @return Character* pointer to the selected Character, or nullptr 
-// if the user chooses to exit, or (Character*)-1 if the user 
-// chooses to create a new character.
+// @return Select with the chosen hero, Create if the user chooses
+// to create a new character, or Back to return to the main menu
 //==================================================================
 
-Character* UI::showCharacterSelector(const vector<Character*>& heroes) {
-    // Clear the screen, draw the frame and print the title
-    clearScreen();
-    drawFrame();
-
-    printCenteredTitle(1, "Character Selection!");
-    printCentered(5, "Choose your character:");
-
-    // Print the list of characters    
-    for (int i = 0; i < heroes.size(); ++i) {
-        Character* h = heroes[i];
-        int y = 10 + i;
-        if (!h->isAlive()) {
-            attron(COLOR_PAIR(2));
-        } 
-        mvprintw(y, 10, "%d) %s", i + 1, h->toString().c_str());
-        attron(COLOR_PAIR(1));
-    }
-
-    // Print the create character option if there are less than 5 characters
-    int optionCount = heroes.size();
-    if (heroes.size() < 5) {
-        mvprintw(10 + optionCount, 10, "%d) Create character [+]", optionCount + 1);
-        ++optionCount;
-    }
+HeroChoice UI::showCharacterSelector(const vector<Character*>& heroes) {
+    static const char* classNames[] = { "All", "Warrior", "Archer", "Mage" };
+
+    rosterIndex.sync(heroes);
+    string query;
+    bool fuzzy = false;
+    HeroClass classFilter = HeroClass::Any;
+    bool aliveOnly = false;
+    int cursor = 0, top = 0;
+    rosterIndex.filter(query, fuzzy, classFilter, aliveOnly, rosterMatches);
+
+    // Draws the search line and the visible page of the list
+    auto drawList = [&]() {
+        int pageRows = max(layout.log.top + layout.log.height - 1 - layout.listRow, 1);
+        int entries = rosterMatches.size() + 1;
+        if (cursor >= entries) cursor = entries - 1;
+        if (cursor < top) top = cursor;
+        if (cursor >= top + pageRows) top = cursor - pageRows + 1;
+
+        string search = "Search: " + query + "_  (" + (fuzzy ? "fuzzy" : "prefix") + ")   Class: "
+            + classNames[int(classFilter)] + "   Alive only: " + (aliveOnly ? "yes" : "no")
+            + "   " + to_string(rosterMatches.size()) + " of " + to_string(heroes.size()) + " heroes";
+        printCentered(layout.promptRow + 2, search);
+
+        for (int row = 0; row < pageRows; ++row) {
+            int entry = top + row;
+            int y = layout.listRow + row;
+            printCentered(y, "");
+            if (entry >= entries) continue;
+
+            string line;
+            if (entry == (int)rosterMatches.size()) {
+                line = "[+] Create character";
+            } else {
+                uint32_t hero = rosterMatches[entry];
+                line = to_string(hero + 1) + ") " + heroes[hero]->toString();
+                if (!heroes[hero]->isAlive()) setColor(2);
+            }
+            if (entry == cursor) setColor(5);
+            putText(y, layout.listCol - 2, entry == cursor ? "> " + line : "  " + line);
+            setColor(1);
+        }
+    };
+
+    beginScene([&]() {
+        // Draw the frame and print the title
+        drawFrame();
+        printCenteredTitle(layout.titleRow, "Character Selection!");
+        printCentered(layout.promptRow, "Choose your character:");
+        putText(layout.menuRow, layout.menuCol, "[Up/Down] Move   [PgUp/PgDn] Page   [Enter] Select   [Esc] Back");
+        putText(layout.menuRow + 1, layout.menuCol, "[Type] Search   [Tab] Prefix/Fuzzy   [F2] Class   [F3] Alive only");
+        drawList();
+    });
 
     // Evaluate user input
-    mvprintw(10 + optionCount + 1, 10, "Enter your choice: ");
     while (true) {
-        int key = getch();
-        // Check if the user wants to exit
-        if (key == '0') {
-            return nullptr;
-        }
-        // Check if the input is a valid choice and return said choice
-        int choice = key - '1';
-        if (choice >= 0 && choice < (int)heroes.size()) {
-            if (heroes[choice]->isAlive()) {
-                return heroes[choice];
-            } else {
-                printCentered(36, "This character is not alive, please choose another.");
-                getch();
+        int key = waitKey();
+        int pageRows = max(layout.log.top + layout.log.height - 1 - layout.listRow, 1);
+        int entries = rosterMatches.size() + 1;
+        bool refilter = false;
+
+        if (key == 27 || key == KEY_EXIT) {
+            // Back to the main menu
+            return { HeroChoice::Action::Back, nullptr };
+        } else if (key == '\n' || key == '\r' || key == KEY_ENTER) {
+            // The last entry creates a new character
+            if (cursor == (int)rosterMatches.size()) {
+                return { HeroChoice::Action::Create, nullptr };
             }
-        // Check if the user wants to create a new character
-        } else if (choice == heroes.size() && heroes.size() < 5) {
-            // Create character option
-            return (Character*)-1;
-        // If the input is invalid, prompt the user to try again
-        } else {
-            printCentered(36, "Invalid choice, please try again.");
-            getch();
+            Character* hero = heroes[rosterMatches[cursor]];
+            if (hero->isAlive()) {
+                return { HeroChoice::Action::Select, hero };
+            }
+            printCentered(layout.menuRow + 2, "This character is not alive, please choose another.");
+            continue;
+        } else if (key == KEY_UP) {
+            cursor = max(cursor - 1, 0);
+        } else if (key == KEY_DOWN) {
+            cursor = min(cursor + 1, entries - 1);
+        } else if (key == KEY_PPAGE) {
+            cursor = max(cursor - pageRows, 0);
+        } else if (key == KEY_NPAGE) {
+            cursor = min(cursor + pageRows, entries - 1);
+        } else if (key == KEY_HOME) {
+            cursor = 0;
+        } else if (key == KEY_END) {
+            cursor = entries - 1;
+        } else if (key == '\t') {
+            fuzzy = !fuzzy;
+            refilter = true;
+        } else if (key == KEY_F(2)) {
+            classFilter = HeroClass((int(classFilter) + 1) % 4);
+            refilter = true;
+        } else if (key == KEY_F(3)) {
+            aliveOnly = !aliveOnly;
+            refilter = true;
+        } else if ((key == KEY_BACKSPACE || key == 127 || key == '\b') && !query.empty()) {
+            query.pop_back();
+            refilter = true;
+        } else if (key >= 32 && key < 127) {
+            query += (char)key;
+            refilter = true;
         }
-    } 
+
+        if (refilter) {
+            rosterIndex.filter(query, fuzzy, classFilter, aliveOnly, rosterMatches);
+            cursor = 0;
+            top = 0;
+        }
+        printCentered(layout.menuRow + 2, "");
+        drawList();
+    }
 }
 
 //==================================================================
@@ -449,25 +1252,32 @@ Character* UI::showCharacterSelector(const vector<Character*>& heroes) {
 //==================================================================
 
 Character* UI::showCharacterCreator() {
-    clearScreen();
-    drawFrame();
-
-    printCenteredTitle(1, "Character Creation");
-    printCentered(6, "Enter your character's name: ");
-    printCentered(7, "");
+    beginScene([]() {
+        drawFrame();
+        printCenteredTitle(layout.titleRow, "Character Creation");
+        printCentered(layout.promptRow + 1, "Enter your character's name: ");
+        printCentered(layout.promptRow + 2, "");
+    });
 
     // Get the character's name from user input
     char name[20] = {0};
-    echo(); // Enable echoing input characters
     while (strlen(name) == 0 || strlen(name) > 20) {
-        getnstr(name, sizeof(name) - 1);
+        if (!readText(layout.promptRow + 2, layout.getCols() / 2, name, sizeof(name) - 1)) {
+            return nullptr;
+        }
     }
-    noecho(); // Disable echoing input characters
 
     // Print the class selection options
-    printCentered(8, "Choose a class:");
-    printCentered(10, "[1] Warrior   [2] Archer   [3] Mage");
-    int classChoice = getch();
+    string chosenName = name;
+    beginScene([chosenName]() {
+        drawFrame();
+        printCenteredTitle(layout.titleRow, "Character Creation");
+        printCentered(layout.promptRow + 1, "Enter your character's name: ");
+        printCentered(layout.promptRow + 2, chosenName);
+        printCentered(layout.promptRow + 3, "Choose a class:");
+        printCentered(layout.listRow, "[1] Warrior   [2] Archer   [3] Mage");
+    });
+    int classChoice = waitKey();
 
     // Check the class choice and create the corresponding character
     Character* newHero = nullptr;
@@ -482,162 +1292,432 @@ Character* UI::showCharacterCreator() {
             newHero = new Mage(name);
             break;
         default:
-            printCentered(10, "Invalid class choice!");
-            getch();
+            printCentered(layout.listRow, "Invalid class choice!");
+            waitKey();
             return nullptr;
     }
 
-    printCentered(36, "Character created successfully!");
-    getch();
+    printCentered(layout.menuRow, "Character created successfully!");
+    waitKey();
 
     return newHero;
 }
 
 //==================================================================
-// Displays the level selector screen
+// Displays the level browser. Only the visible page is drawn.
+// Digits followed by Enter jump to a level number, '/' starts a
+// name search (Enter cycles through the matches) and 'n' moves to
+// the next unbeaten level. Every query is answered by the index in
+// O(log n).
 //
-// @param levels Vector of available Level pointers
+// @param levels The index over the levels of the campaign
 // @return A pointer to the selected Level, or nullptr if the user
-// chooses to go back to the main menu or enters an invalid choice.
+// chooses to go back to the main menu.
 //==================================================================
 
-Level* UI::showLevelSelector(const vector<Level*>& levels) {
-    clearScreen();
-    drawFrame();
-
-    // Print the title and level options with their completion status
-    printCenteredTitle(1, "Level Selection");
-    printCentered(5, "Choose a level:");
-    for (size_t i = 0; i < levels.size(); ++i) {
-        string status;
-        if (levels[i]->hasWon()) {
-            status = "Completed";
-        } else {
-            status = "Not Completed";
+Level* UI::showLevelSelector(LevelIndex& levels) {
+    int count = levels.size();
+    int cursor = max(levels.nextUnbeaten(0), 0);
+    int top = 0;
+    string jump;          // level number being typed
+    string search;        // name prefix being typed
+    bool searching = false;
+    int matchRank = -1;   // rank of the current name match
+    string notice;
+
+    // Draws the query line and the visible page of the list
+    auto drawList = [&]() {
+        int pageRows = max(layout.log.top + layout.log.height - 1 - layout.listRow, 1);
+        if (cursor >= count) cursor = count - 1;
+        if (cursor < 0) cursor = 0;
+        if (cursor < top) top = cursor;
+        if (cursor >= top + pageRows) top = cursor - pageRows + 1;
+
+        string status = "Completed " + to_string(count - levels.countUnbeaten()) + " of " + to_string(count);
+        if (!jump.empty()) status += "   Jump to: " + jump + "_";
+        if (searching) status += "   Search: /" + search + "_";
+        if (!notice.empty()) status += "   " + notice;
+        printCentered(layout.promptRow + 2, status);
+
+        for (int row = 0; row < pageRows; ++row) {
+            int i = top + row;
+            int y = layout.listRow + row;
+            printCentered(y, "");
+            if (i >= count) continue;
+
+            Level* level = levels.at(i);
+            string line = to_string(i + 1) + ") " + level->getName();
+            if (i == cursor) setColor(5);
+            putText(y, layout.listCol - 2, (i == cursor ? "> " : "  ") + line);
+            setColor(level->hasWon() ? 3 : 1);
+            putText(y, layout.statusCol, level->hasWon() ? "Status: Completed" : "Status: Not Completed");
+            setColor(1);
         }
-        string line = to_string(i + 1) + ") " + levels[i]->getName();
-        mvprintw(10 + i, 10, "%s", line.c_str());
-        mvprintw(10 + i, 100, "%s", ("Status: " + status).c_str());
-    }
-    mvprintw(36, 10, "[0] Back to Main Menu");
+    };
+
+    beginScene([&]() {
+        drawFrame();
+
+        // Print the title and the controls
+        printCenteredTitle(layout.titleRow, "Level Selection");
+        printCentered(layout.promptRow, "Choose a level:");
+        putText(layout.menuRow, layout.listCol, "[Up/Down] Move   [PgUp/PgDn] Page   [Enter] Select   [0/Esc] Back to Main Menu");
+        putText(layout.menuRow + 1, layout.listCol, "[Digits+Enter] Jump to level   [/] Search by name   [n] Next unbeaten level");
+        drawList();
+    });
 
-    // Print the prompt for user input
-    mvprintw(10 + levels.size(), 10, "Enter your choice: ");
     while (true){
-        int key = getch();
-        // Back to main menu
-        if (key == '0') {
-            return nullptr; 
-        } 
-        int index = key - '1';
-        // Input validation and returning the selected level
-        if (index >= 0 && index < (int)levels.size()) {
-            return levels[index];
-        } else {
-            printCentered(36, "Invalid choice, please try again.");
+        int key = waitKey();
+        int pageRows = max(layout.log.top + layout.log.height - 1 - layout.listRow, 1);
+        bool enter = (key == '\n' || key == '\r' || key == KEY_ENTER);
+        bool erase = (key == KEY_BACKSPACE || key == 127 || key == '\b');
+        notice.clear();
+
+        if (key == KEY_EXIT) {
+            return nullptr;
+        } else if (searching) {
+            // Typing a name prefix; Enter moves to the next match
+            if (key == 27) {
+                searching = false;
+                search.clear();
+            } else if (erase && !search.empty()) {
+                search.pop_back();
+                matchRank = -1;
+            } else if (enter) {
+                pair<int, int> range = levels.nameRange(search);
+                if (range.first == range.second) {
+                    notice = "No level matches";
+                } else {
+                    matchRank = (matchRank < range.first || matchRank + 1 >= range.second) ? range.first : matchRank + 1;
+                    cursor = levels.sortedAt(matchRank);
+                }
+            } else if (key >= 32 && key < 127) {
+                search += (char)key;
+                matchRank = -1;
+            }
+        } else if (isdigit(key)) {
+            // Back to main menu, unless a level number is being typed
+            if (key == '0' && jump.empty()) {
+                return nullptr;
+            }
+            jump += (char)key;
+        } else if (erase && !jump.empty()) {
+            jump.pop_back();
+        } else if (enter) {
+            if (jump.empty()) {
+                if (count > 0) return levels.at(cursor);
+            } else {
+                int number = atoi(jump.c_str());
+                jump.clear();
+                if (number >= 1 && number <= count) {
+                    cursor = number - 1;
+                } else {
+                    notice = "Invalid choice, please try again.";
+                }
+            }
+        } else if (key == 27) {
+            if (jump.empty()) return nullptr;
+            jump.clear();
+        } else if (key == '/') {
+            searching = true;
+            search.clear();
+            matchRank = -1;
+        } else if (key == 'n') {
+            int next = levels.nextUnbeaten(cursor + 1);
+            if (next < 0) next = levels.nextUnbeaten(0);
+            if (next < 0) {
+                notice = "Every level is completed";
+            } else {
+                cursor = next;
+            }
+        } else if (key == KEY_UP) {
+            --cursor;
+        } else if (key == KEY_DOWN) {
+            ++cursor;
+        } else if (key == KEY_PPAGE) {
+            cursor -= pageRows;
+        } else if (key == KEY_NPAGE) {
+            cursor += pageRows;
+        } else if (key == KEY_HOME) {
+            cursor = 0;
+        } else if (key == KEY_END) {
+            cursor = count - 1;
         }
+        drawList();
     }
 }
 
 //==================================================================
-// Displays the battle screen for a given level. 
+// The battle screen as a coroutine. The battle itself runs on the
+// simulation thread; this coroutine turns its events into log lines
+// and animations and forwards the player's keys. Waiting for an
+// event, a key or the end of an animation suspends it.
 //
 // @param level The Level object containing the hero and enemy characters
+// @param rolls The stream of the battle
+// @param tally Receives the turns and damage of the battle
 // @return true if the player wins the battle, false if the player loses or exits
 //==================================================================
 
-bool UI::showBattleScreen(const Level* level) {
-    clearScreen();
-    drawFrame();
-
-    // Print the title and level information
-    printCenteredTitle(1, "Battle Screen");
-    printCentered(3, level->getName());
-    printCentered(5, level->getPrologue());
-    
-    // Print the options for the player
-    mvprintw(36, 10, "[1] Attack");
-    mvprintw(37, 10, "[2] Recover");
-    mvprintw(38, 10, "[3] Exit");
-    
-    while (true) {
-        // Print the initial battle cards for hero and enemy
-        printBattleCard(level->getHero(), 10, COLS / 5 - 4);
-        printBattleCard(level->getEnemy(), 10, COLS / 5 * 3 - 3);
-        
-        // Ask for the player's action
-        int choice = getch();
-        switch (choice) {
-            case '1':
-                //heroes attack cicle
-                level->getHero()->attack(level->getEnemy());
-                if ((level->getEnemy()->getShield()) > (level->getHero()->getStrength())) {
-                    printCentered(28, "Your attack was absorbed by the enemy's shield!");
+Task<bool> UI::battle(const Level* level, RandomStream rolls, BattleTally& tally) {
+    // The prologue is wrapped into the log instead of being cut at
+    // the edge of the screen
+    if (!battlePrepared) prepareBattle();
+    battlePrepared = false;
+    battleLog.pushText(1, level->getPrologue().c_str());
+    prompt = "Select your next action...";
+
+    function<void()> drawBattle = [level]() {
+        drawFrame();
+
+        // Print the title and level information
+        printCenteredTitle(layout.titleRow, "Battle Screen");
+        printCentered(layout.subtitleRow, level->getName());
+
+        // Print the options for the player
+        putText(layout.menuRow, layout.listCol, "[1] Attack");
+        putText(layout.menuRow + 1, layout.listCol, "[2] Recover");
+        putText(layout.menuRow + 2, layout.listCol, "[3] Exit");
+        putText(layout.menuRow, layout.listCol + 20, "[PgUp/PgDn] Scroll log");
+        putText(layout.menuRow + 1, layout.listCol + 20, "[4] Options");
+        putText(layout.menuRow + 2, layout.listCol + 20, "[5] Rewind a turn");
+
+        // Print the battle cards for hero and enemy
+        printBattleCard(level->getHero(), layout.cardRow, layout.heroCardCol);
+        printBattleCard(level->getEnemy(), layout.cardRow, layout.enemyCardCol);
+        printBattleLog();
+    };
+    beginScene(drawBattle);
+    trackCard(0, level->getHero());
+    trackCard(1, level->getEnemy());
+
+    BattleSim sim;
+    events.addWatch(sim.eventFd(), [&sim]() {
+        sim.clearNotify();
+        if (eventWaiter && sim.poll(*eventTarget)) {
+            tasks.schedule(eventWaiter);
+            eventWaiter = nullptr;
+        }
+    });
+    sim.start(level->getHero(), level->getEnemy(), rolls);
+
+    const string heroName = level->getHero()->getName();
+    const string enemyName = level->getEnemy()->getName();
+    bool won = false;
+    bool running = true;
+    CombatEvent event;
+    // A turn lasts from the player's command until the outcome is on
+    // screen and the battle waits for the next key
+    METRICS_STOPWATCH(turnWatch);
+    TRACE_STOPWATCH(turnTrace);
+    while (running) {
+        co_await NextCombatEvent{ sim, event };
+        tally.count(event);
+
+        switch (event.type) {
+            case CombatEvent::Type::Attack:
+                if (event.actor == 0) {
+                    battleLog.push(1, "You have attacked the enemy and dealt %d damage!", event.amount);
+                    if (event.enemy.alive) battleLog.push(1, "It is now the enemy's turn");
                 } else {
-                    printCentered(28, "You have attacked the enemy and dealt " + to_string(level->getHero()->getStrength()) + " damage!");
+                    battleLog.push(2, "The enemy has attacked you and dealt %d damage!", event.amount);
+                    battleLog.push(1, "It is now your turn");
                 }
-                if (level->getEnemy()->isAlive()) printCentered(29, "It is now the enemy's turn");
-                printCentered(30, "Press any key to continue...");
+                animateCard(0, event.hero);
+                animateCard(1, event.enemy);
                 break;
-            case '2':
-                //heroes recover cicle
-                level->getHero()->recover();
-                printCentered(28, "You have recovered some health and mana.");
-                printCentered(30, "Press any key to continue...");
+            case CombatEvent::Type::Critical:
+                if (event.actor == 0) {
+                    battleLog.push(1, "A critical hit! You have dealt %d damage!", event.amount);
+                    if (event.enemy.alive) battleLog.push(1, "It is now the enemy's turn");
+                } else {
+                    battleLog.push(2, "A critical hit! The enemy has dealt you %d damage!", event.amount);
+                    battleLog.push(1, "It is now your turn");
+                }
+                animateCard(0, event.hero);
+                animateCard(1, event.enemy);
                 break;
-            case '3':
-                // Exit the battle
-                printCentered(10, "Exiting battle...");
-                return false;
+            case CombatEvent::Type::Missed:
+                if (event.actor == 0) {
+                    battleLog.push(1, "Your attack missed the enemy!");
+                    battleLog.push(1, "It is now the enemy's turn");
+                } else {
+                    battleLog.push(1, "The enemy has attacked you but missed!");
+                    battleLog.push(1, "It is now your turn");
+                }
+                animateCard(0, event.hero);
+                animateCard(1, event.enemy);
+                break;
+            case CombatEvent::Type::Absorbed:
+                if (event.actor == 0) {
+                    battleLog.push(1, "Your attack was absorbed by the enemy's shield!");
+                    if (event.enemy.alive) battleLog.push(1, "It is now the enemy's turn");
+                } else {
+                    battleLog.push(1, "The enemy has attacked you but your shield absorbed the attack!");
+                    battleLog.push(1, "It is now your turn");
+                }
+                break;
+            case CombatEvent::Type::Recover:
+                battleLog.push(1, "You have recovered some health and mana.");
+                animateCard(0, event.hero);
+                break;
+            case CombatEvent::Type::Afflicted: {
+                const char* effect = effectName(EffectKind(event.amount));
+                if (event.actor == 0) {
+                    battleLog.push(2, "The enemy's attack has put %s on you!", effect);
+                } else {
+                    battleLog.push(2, "The enemy has cast %s on itself!", effect);
+                }
+                break;
+            }
+            case CombatEvent::Type::EffectTick:
+                if (event.actor == 0) {
+                    battleLog.push(event.amount < 0 ? 2 : 1, "Your effects %s %d health.",
+                                   event.amount < 0 ? "cost you" : "restore", abs(event.amount));
+                    animateCard(0, event.hero);
+                } else {
+                    battleLog.push(1, "The enemy's effects %s %d health.",
+                                   event.amount < 0 ? "cost it" : "restore", abs(event.amount));
+                    animateCard(1, event.enemy);
+                }
+                break;
+            case CombatEvent::Type::Stunned:
+                if (event.actor == 0) {
+                    battleLog.push(2, "You are stunned and lose your turn!");
+                } else {
+                    battleLog.push(1, "The enemy is stunned and loses its turn!");
+                    battleLog.push(1, "It is now your turn");
+                }
+                break;
+            case CombatEvent::Type::Rewound:
+                battleLog.push(3, "Time flows backwards... back to the start of turn %d.", event.amount + 1);
+                animateCard(0, event.hero);
+                animateCard(1, event.enemy);
+                break;
+            case CombatEvent::Type::EffectEnded:
+                battleLog.push(1, "The %s on %s has worn off.", effectName(EffectKind(event.amount)),
+                               event.actor == 0 ? "you" : "the enemy");
+                break;
+            case CombatEvent::Type::Death:
+                if (event.actor == 0) {
+                    printCentered(layout.bannerRow, "You have been defeated!");
+                    battleLog.push(2, "%s has won the battle.", enemyName.c_str());
+                    battleLog.push(2, "%s is now dead!", heroName.c_str());
+                    printBattleCard(level->getHero(), layout.cardRow, layout.heroCardCol);
+                } else {
+                    printCentered(layout.bannerRow, "You have defeated the enemy!");
+                    battleLog.pushText(1, level->getEpilogue().c_str());
+                    battleLog.push(3, "You have won the battle!");
+                    printBattleCard(level->getHero(), layout.cardRow, layout.heroCardCol);
+                    setColor(2);
+                    printBattleCard(level->getEnemy(), layout.cardRow, layout.enemyCardCol);
+                    setColor(1);
+                }
+                break;
+            case CombatEvent::Type::AwaitAction: {
+                // Ask for the player's action
+                prompt = "Select your next action...";
+                printBattleLog();
+                METRICS_STOP(turnWatch, "battle.turn.ns");
+                TRACE_STOP(turnTrace, "battle", "turn");
+                int choice = co_await BattleKey{};
+                switch (choice) {
+                    case '1':
+                        METRICS_START(turnWatch);
+                        TRACE_START(turnTrace);
+                        sim.send(BattleCommand::Attack);
+                        prompt = "Press any key to continue...";
+                        break;
+                    case '2':
+                        METRICS_START(turnWatch);
+                        TRACE_START(turnTrace);
+                        sim.send(BattleCommand::Recover);
+                        prompt = "Press any key to continue...";
+                        break;
+                    case '3':
+                    case KEY_EXIT:
+                        // Exit the battle
+                        printCentered(layout.cardRow, "Exiting battle...");
+                        sim.send(BattleCommand::Exit);
+                        running = false;
+                        if (animations.isEnabled()) {
+                            // Let the message be seen before the next screen
+                            present();
+                            co_await tasks.sleep(400);
+                        }
+                        break;
+                    case '4':
+                        // Options on top of the battle, which resumes as
+                        // it was; the simulation waits for the next action
+                        if (overlayHandler && !overlayHandler(Scene::Options)) {
+                            sim.send(BattleCommand::Exit);
+                            running = false;
+                            break;
+                        }
+                        beginScene(drawBattle);
+                        trackCard(0, level->getHero());
+                        trackCard(1, level->getEnemy());
+                        sim.send(BattleCommand::Continue);
+                        break;
+                    case '5':
+                        // Undo the last action; the battle asks again
+                        sim.send(BattleCommand::Rewind);
+                        break;
+                    default:
+                        // Invalid choice
+                        printCentered(layout.cardRow, "Invalid choice, try again.");
+                        co_await BattleKey{};
+                        printBattleCard(level->getHero(), layout.cardRow, layout.heroCardCol);
+                        printBattleCard(level->getEnemy(), layout.cardRow, layout.enemyCardCol);
+                        sim.send(BattleCommand::Continue);
+                        break;
+                }
                 break;
-            default:
-                // Invalid choice
-                printCentered(10, "Invalid choice, try again.");
-                getch();
-                continue;
-        }
-
-        // Reprint the battle cards after player's turn
-        printBattleCard(level->getHero(), 10, COLS / 5 - 4);
-        printBattleCard(level->getEnemy(), 10, COLS / 5 * 3 - 3);
-
-        // Check if the enemy is still alive and activate the enemy's turn
-        if (level->getEnemy()->isAlive()) {
-            getch();
-            // Enemies attack cicle
-            level->getEnemy()->attack(level->getHero());
-            int damage = level->getEnemy()->getStrength() - level->getHero()->getShield();
-            if (damage <= 0) {
-                printCentered(28, "The enemy has attacked you but your shield absorbed the attack!");
-            } else {
-                printCentered(28, "The enemy has attacked you and dealt " + to_string(damage) + " damage!");
             }
-            printCentered(29, "It is now your turn");
-            printCentered(30, "Select your next action...");
-            // Check if the hero is still alive
-            if (!level->getHero()->isAlive()) {
-                printCentered(24, "You have been defeated!");
-                printCentered(28, level->getEnemy()->getName() + " has won the battle.");
-                printCentered(29, level->getHero()->getName() + " is now dead!");
-                printCentered(30, "Press any key to continue...");
-                getch();
-                return false;
+            case CombatEvent::Type::AwaitContinue: {
+                printBattleLog();
+                METRICS_STOP(turnWatch, "battle.turn.ns");
+                TRACE_STOP(turnTrace, "battle", "turn");
+                // Any key lets the enemy answer; [5] takes the action back
+                int key = co_await BattleKey{};
+                prompt = "Select your next action...";
+                METRICS_START(turnWatch);
+                TRACE_START(turnTrace);
+                sim.send(key == '5' ? BattleCommand::Rewind : BattleCommand::Continue);
+                break;
+            }
+            case CombatEvent::Type::End: {
+                won = event.amount != 0;
+                // The scene hands the reward over once the battle is done
+                uint16_t reward = level->getReward();
+                if (won && reward != NoItem && !level->getHero()->getInventory().owns(reward)) {
+                    battleLog.push(3, "You found %s!", itemDef(reward).name);
+                }
+                // And the experience
+                const Character* hero = level->getHero();
+                if (won && hero->canLevel()) {
+                    int32_t gained = static_cast<const Enemy*>(level->getEnemy())->getXpValue();
+                    battleLog.push(3, "%s gains %d experience.", hero->getName().c_str(), gained);
+                    int reached = levelForXp(hero->getXp() + gained);
+                    if (reached > hero->getLevel()) {
+                        battleLog.push(3, "%s reaches level %d!", hero->getName().c_str(), reached);
+                    }
+                }
+                prompt = "Press any key to continue...";
+                printBattleLog();
+                METRICS_STOP(turnWatch, "battle.turn.ns");
+                TRACE_STOP(turnTrace, "battle", "turn");
+                co_await AnimationsSettled{};
+                co_await BattleKey{};
+                running = false;
                 break;
             }
-        // If the enemy is defeated, print the victory message
-        } else {
-            printCentered(24, "You have defeated the enemy!");
-            printCentered(28, level->getEpilogue());
-            printCentered(29, "You have won the battle!");
-            printCentered(30, "Press any key to continue...");
-            printBattleCard(level->getHero(), 10, COLS / 5 - 4);
-            attron(COLOR_PAIR(2));
-            printBattleCard(level->getEnemy(), 10, COLS / 5 * 3 - 3);
-            attroff(COLOR_PAIR(1));
-            getch();
-            return true;
         }
     }
+
+    sim.join();
+    events.removeWatch(sim.eventFd());
+    co_return won;
 }
 
 //==================================================================
@@ -647,60 +1727,74 @@ bool UI::showBattleScreen(const Level* level) {
 //==================================================================
 
 Scene UI::showGameOver() {
-    clearScreen();
-    attron(COLOR_PAIR(2));
-    drawFrame();
-    printCenteredTitle(1, "You have been defeated.");
-    printCenteredBlock(8, gameOverArt);
-    printCentered(35, "Press any key to return to the main menu...");
-    getch();
-    attron(COLOR_PAIR(1));
+    beginScene([]() {
+        setColor(2);
+        drawFrame();
+        printCenteredTitle(layout.titleRow, "You have been defeated.");
+        printCenteredBlock(layout.listRow - 2, gameOverArt);
+        printCentered(layout.menuRow - 1, "Press any key to return to the main menu...");
+    });
+    waitKey();
+    setColor(1);
     return Scene::MainMenu;
 }
 
 //==================================================================
 // Displays the options menu
-// Options include: reset levels, reset characters, and exit to main 
-// menu.
+// Options include: reset levels, reset characters, toggle the
+// animations and exit. The resets are not offered during a battle,
+// where the menu is shown on top of the battle screen.
 //
-// @return Scene::MainMenu to return to the main menu
+// @param inBattle true when opened from a battle
+// @return Scene::MainMenu to leave the menu, or Scene::Options to
+// show it again
 //==================================================================
 
-Scene UI::Options(vector<Character*>& heroes, vector<Level*>& levels) {
-    clearScreen();
-    drawFrame();
-    printCenteredTitle(1, "Options Menu");
-    printCentered(5, "Choose an option:");
-    mvprintw(36, 4, "[1] Reset Levels");
-    mvprintw(37, 4, "[2] Reset Characters");
-    mvprintw(37, 4, "[3] Exit");
-
-    int choice = getch();
+Scene UI::Options(vector<Character*>& heroes, LevelIndex& levels, bool inBattle) {
+    beginScene([inBattle]() {
+        drawFrame();
+        printCenteredTitle(layout.titleRow, "Options Menu");
+        printCentered(layout.promptRow, "Choose an option:");
+        if (!inBattle) {
+            putText(layout.menuRow, layout.menuCol, "[1] Reset Levels");
+            putText(layout.menuRow + 1, layout.menuCol, "[2] Reset Characters");
+        }
+        putText(layout.menuRow + 2, layout.menuCol, inBattle ? "[3] Back to battle" : "[3] Exit");
+        putText(layout.menuRow, layout.listCol + 30, string("[4] Animations: ") + (animations.isEnabled() ? "on" : "off"));
+    });
+
+    int choice = waitKey();
     switch (choice) {
         case '1':
+            if (inBattle) break;
             // Reset all levels and set their won status to false
-            for (Level* level : levels) {
-                level->setWon(false);
-                level->resetEnemy();
+            for (int i = 0; i < levels.size(); ++i) {
+                levels.setWon(i, false);
+                levels.at(i)->resetEnemy();
             }
-            printCentered(11, "Levels have been reset.");
-            getch();
+            printCentered(layout.noticeRow, "Levels have been reset.");
+            waitKey();
             return Scene::MainMenu;
         case '2':
+            if (inBattle) break;
             // Delete all characters and reset the heroes vector
             for (Character* hero : heroes) {
                 delete hero;
             }
-            printCentered(11, "Characters have been reset.");
-            getch();
+            heroes.clear();
+            printCentered(layout.noticeRow, "Characters have been reset.");
+            waitKey();
             return Scene::MainMenu;
         case '3':
+        case KEY_EXIT:
             return Scene::MainMenu;
-        default:
-            printCentered(11, "Invalid choice, please try again.");
-            getch();
+        case '4':
+            animations.setEnabled(!animations.isEnabled());
             return Scene::Options;
     }
+    printCentered(layout.noticeRow, "Invalid choice, please try again.");
+    waitKey();
+    return Scene::Options;
 }
 
 #endif